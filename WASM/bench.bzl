@@ -0,0 +1,26 @@
+"""Catch2 suites under bench/: one binary for running benchmarks, one test for the checks."""
+
+def catch2_bench(name, srcs, deps = [], copts = [], linkopts = [], size = "medium"):
+    """Declares `<name>_bench` (cc_binary) and `<name>_test` (cc_test) from the same sources.
+
+    The binary runs everything, benchmarks included, for `bazel run`. The test
+    runs every visible TEST_CASE with --skip-benchmarks, so `bazel test //WASM/...`
+    gates the REQUIRE checks without timing anything.
+    """
+    deps = deps + ["@catch2//:catch2_main"]
+    native.cc_binary(
+        name = name + "_bench",
+        srcs = srcs,
+        copts = copts,
+        linkopts = linkopts,
+        deps = deps,
+    )
+    native.cc_test(
+        name = name + "_test",
+        srcs = srcs,
+        args = ["--skip-benchmarks"],
+        copts = copts,
+        linkopts = linkopts,
+        size = size,
+        deps = deps,
+    )
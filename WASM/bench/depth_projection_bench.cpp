@@ -0,0 +1,153 @@
+// DepthProjector on a 256x192 LiDAR depth map (the 30 Hz iPhone sceneDepth
+// size): full frame, 2x2 stride and a centered ROI, checked against a plain
+// per-pixel reference first.
+//
+//   bazel run --config=opt //WASM:depth_projection_bench
+//   bazel run --config=opt //WASM:depth_projection_bench -- "[summary]"   # us/frame and 30 Hz budget share
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "depth_projection.h"
+
+namespace {
+
+constexpr int kWidth = 256;
+constexpr int kHeight = 192;
+
+// ARKit reports intrinsics for the 1920x1440 camera image
+const CameraIntrinsics kIntrinsics = CameraIntrinsics{1450.0f, 1450.0f, 959.5f, 719.5f}.scaled(1920, 1440, kWidth, kHeight);
+
+// a slanted wall 1-4 m away with ~5% holes (0 / NaN) and a few far returns
+std::vector<float> depth_map() {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+  std::vector<float> d(kWidth * kHeight);
+  for (int v = 0; v < kHeight; ++v) {
+    for (int u = 0; u < kWidth; ++u) {
+      float z = 1.0f + 3.0f * u / kWidth + 0.5f * v / kHeight;
+      const float r = u01(rng);
+      if (r < 0.03f) z = 0.0f;
+      else if (r < 0.05f) z = std::numeric_limits<float>::quiet_NaN();
+      else if (r < 0.06f) z = 9.0f;
+      d[v * kWidth + u] = z;
+    }
+  }
+  return d;
+}
+
+CameraPose test_pose() {
+  // 30 degrees of yaw about world z plus a translation
+  const float c = std::cos(0.5236f), s = std::sin(0.5236f);
+  return CameraPose{{c, -s, 0, s, c, 0, 0, 0, 1}, {1.0f, -2.0f, 0.3f}};
+}
+
+// straightforward per-pixel version of DepthProjector::project
+int reference(const std::vector<float> &depth, const DepthProjectionParams &p, const CameraPose &pose,
+              std::vector<float> &out) {
+  out.clear();
+  const int x1 = p.roi.x1 > 0 ? p.roi.x1 : kWidth, y1 = p.roi.y1 > 0 ? p.roi.y1 : kHeight;
+  for (int v = p.roi.y0; v < y1; v += p.stride_y) {
+    for (int u = p.roi.x0; u < x1; u += p.stride_x) {
+      const float z = depth[v * kWidth + u];
+      if (!(z >= p.min_depth && z <= p.max_depth)) continue;
+      const float c[3] = {(u - kIntrinsics.cx) * z / kIntrinsics.fx, (v - kIntrinsics.cy) * z / kIntrinsics.fy, z};
+      for (int i = 0; i < 3; ++i)
+        out.push_back(pose.r[3 * i] * c[0] + pose.r[3 * i + 1] * c[1] + pose.r[3 * i + 2] * c[2] + pose.t[i]);
+    }
+  }
+  return static_cast<int>(out.size() / 3);
+}
+
+DepthProjectionParams params(int stride, DepthRoi roi) {
+  DepthProjectionParams p;
+  p.stride_x = p.stride_y = stride;
+  p.roi = roi;
+  return p;
+}
+
+} // namespace
+
+TEST_CASE("depth back-projection", "[depth]") {
+  const std::vector<float> depth = depth_map();
+  const CameraPose pose = test_pose();
+  struct Case {
+    const char *name;
+    DepthProjectionParams p;
+  } cases[] = {
+      {"full 256x192", params(1, {0, 0, 0, 0})},
+      {"stride 2", params(2, {0, 0, 0, 0})},
+      {"stride 3, odd ROI", params(3, {5, 7, 250, 190})},
+      {"ROI 128x96", params(1, {64, 48, 192, 144})},
+  };
+  for (const Case &tc : cases) {
+    DepthProjector proj(kIntrinsics, tc.p);
+    PointCloud cloud;
+    cloud.reserve(proj.max_points(kWidth, kHeight));
+    std::vector<float> ref;
+    const int n = proj.project(depth.data(), kWidth, kHeight, pose, cloud);
+    REQUIRE(n == reference(depth, tc.p, pose, ref));
+    float err = 0.0f;
+    for (int i = 0; i < n; ++i) {
+      err = std::fmax(err, std::fabs(cloud.x[i] - ref[3 * i]));
+      err = std::fmax(err, std::fabs(cloud.y[i] - ref[3 * i + 1]));
+      err = std::fmax(err, std::fabs(cloud.z[i] - ref[3 * i + 2]));
+    }
+    REQUIRE(err < 1e-4f);
+
+    // a reused cloud must not reallocate
+    const float *before = cloud.x.data();
+    BENCHMARK(tc.name) { return proj.project(depth.data(), kWidth, kHeight, pose, cloud); };
+    REQUIRE(cloud.x.data() == before);
+  }
+
+  // undersized clouds are filled up to capacity and no further
+  DepthProjector proj(kIntrinsics, DepthProjectionParams{});
+  PointCloud small;
+  small.reserve(1000);
+  REQUIRE(proj.project(depth.data(), kWidth, kHeight, pose, small) == 1000);
+}
+
+TEST_CASE("camera pose of a robot pose", "[depth]") {
+  const Pose2 robot{1.0f, -2.0f, 0.7f};
+  const CameraMount mount{0.2f, 0.1f, 0.9f, 0.3f};
+  const CameraPose pose = camera_pose(robot, mount);
+  // a rotation
+  for (int a = 0; a < 3; ++a)
+    for (int b = 0; b < 3; ++b) {
+      float dot = 0.0f;
+      for (int i = 0; i < 3; ++i) dot += pose.r[3 * i + a] * pose.r[3 * i + b];
+      REQUIRE(std::fabs(dot - (a == b ? 1.0f : 0.0f)) < 1e-6f);
+    }
+  // looking along the heading, pitched down, x to the robot's right
+  REQUIRE(std::fabs(pose.r[2] - std::cos(0.7f) * std::cos(0.3f)) < 1e-6f);
+  REQUIRE(std::fabs(pose.r[5] - std::sin(0.7f) * std::cos(0.3f)) < 1e-6f);
+  REQUIRE(std::fabs(pose.r[8] + std::sin(0.3f)) < 1e-6f);
+  REQUIRE(std::fabs(pose.r[0] - std::sin(0.7f)) < 1e-6f);
+  REQUIRE(std::fabs(pose.r[3] + std::cos(0.7f)) < 1e-6f);
+  REQUIRE(pose.r[7] < 0.0f); // image down is world down
+  // mounted forward and left of the robot's origin
+  REQUIRE(std::fabs(pose.t[0] - (1.0f + 0.2f * std::cos(0.7f) - 0.1f * std::sin(0.7f))) < 1e-6f);
+  REQUIRE(std::fabs(pose.t[1] - (-2.0f + 0.2f * std::sin(0.7f) + 0.1f * std::cos(0.7f))) < 1e-6f);
+  REQUIRE(pose.t[2] == 0.9f);
+}
+
+TEST_CASE("30 Hz budget", "[.][summary]") {
+  const std::vector<float> depth = depth_map();
+  const CameraPose pose = test_pose();
+  DepthProjector proj(kIntrinsics, DepthProjectionParams{});
+  PointCloud cloud;
+  cloud.reserve(proj.max_points(kWidth, kHeight));
+  constexpr int kFrames = 300;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kFrames; ++i) proj.project(depth.data(), kWidth, kHeight, pose, cloud);
+  const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / kFrames;
+  std::printf("256x192 -> %d points: %.1f us/frame, %.2f%% of a 33.3 ms frame, %.2f ns/pixel\n", cloud.size, us,
+              us / 333.3, us * 1000.0 / (kWidth * kHeight));
+}
@@ -0,0 +1,288 @@
+// ErrorStateEkf on a synthetic drive: a robot weaving over a slightly uneven
+// floor, a biased noisy 100 Hz IMU and 10 Hz scan-match poses. Checks the
+// tracking error and bias estimates, the consistency of the innovations,
+// pose gating, body velocity (wheel) updates, and times predict and update.
+//
+//   bazel run --config=opt //WASM:error_state_ekf_bench
+//   bazel run --config=opt //WASM:error_state_ekf_bench -- "[summary]"   # error, NIS and latency per setup
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "error_state_ekf.h"
+
+namespace {
+
+// Planar weave with small roll and pitch from the floor; rotation vector and
+// position are closed-form so rates are exact.
+struct Drive {
+  Vec3 theta(double t) const { return Vec3{0.03 * std::sin(1.7 * t), 0.02 * std::sin(1.3 * t + 1.0), 0.3 * t + 0.6 * std::sin(0.4 * t)}; }
+  Vec3 theta_dot(double t) const {
+    return Vec3{0.051 * std::cos(1.7 * t), 0.026 * std::cos(1.3 * t + 1.0), 0.3 + 0.24 * std::cos(0.4 * t)};
+  }
+  Mat3 rotation(double t) const { return so3_exp(theta(t)); }
+  Vec3 body_rate(double t) const { return so3_right_jacobian(theta(t)) * theta_dot(t); }
+  Vec3 position(double t) const { return Vec3{3.0 * std::sin(0.2 * t), 2.0 * std::sin(0.3 * t), 0.01 * std::sin(2.0 * t)}; }
+  Vec3 velocity(double t) const { return Vec3{0.6 * std::cos(0.2 * t), 0.6 * std::cos(0.3 * t), 0.02 * std::cos(2.0 * t)}; }
+  Vec3 acceleration(double t) const {
+    return Vec3{-0.12 * std::sin(0.2 * t), -0.18 * std::sin(0.3 * t), -0.04 * std::sin(2.0 * t)};
+  }
+  NavState state(double t) const { return NavState{rotation(t), velocity(t), position(t)}; }
+};
+
+struct Sensors {
+  ImuBias bias{{0.002, -0.003, 0.004}, {0.03, -0.02, 0.05}};
+  double gyro_noise = 2e-3, accel_noise = 2e-2; // densities, a cheap phone
+  double pose_sigma = 0.02, heading_sigma = 0.01;
+
+  IMUData imu(const Drive &d, double t, double hz, std::mt19937 &rng) const {
+    std::normal_distribution<double> gn(0.0, gyro_noise * std::sqrt(hz)), an(0.0, accel_noise * std::sqrt(hz));
+    const Vec3 w = d.body_rate(t) + bias.gyro + Vec3{gn(rng), gn(rng), gn(rng)};
+    const Vec3 f = transpose_mul(d.rotation(t), d.acceleration(t) - kGravity) + bias.accel + Vec3{an(rng), an(rng), an(rng)};
+    return IMUData{t, f.x, f.y, f.z, t, w.x, w.y, w.z};
+  }
+  Pose2 pose(const Drive &d, double t, std::mt19937 &rng) const {
+    std::normal_distribution<double> pn(0.0, pose_sigma), hn(0.0, heading_sigma);
+    const Pose2 p = planar_pose(d.state(t));
+    return Pose2{static_cast<float>(p.x + pn(rng)), static_cast<float>(p.y + pn(rng)),
+                 wrap_angle(static_cast<float>(p.theta + hn(rng)))};
+  }
+  void pose_covariance(float c[9]) const {
+    for (int i = 0; i < 9; ++i) c[i] = 0.0f;
+    c[0] = c[4] = static_cast<float>(pose_sigma * pose_sigma);
+    c[8] = static_cast<float>(heading_sigma * heading_sigma);
+  }
+};
+
+EkfParams params_for(const Sensors &s) {
+  EkfParams p;
+  p.imu.gyro_noise = s.gyro_noise;
+  p.imu.accel_noise = s.accel_noise;
+  return p;
+}
+
+struct RunStats {
+  double position_rms = 0.0, heading_rms = 0.0; // after the first 5 s
+  double nis_mean = 0.0;
+  int updates = 0, rejected = 0;
+};
+
+// Runs the filter over the drive for `seconds`, starting from a perturbed
+// state, with a pose fix every 10th sample.
+RunStats run(ErrorStateEkf &ekf, const Drive &d, const Sensors &s, double seconds, unsigned seed) {
+  std::mt19937 rng(seed);
+  const double hz = 100.0;
+  NavState start = d.state(0.0);
+  start.position += Vec3{0.05, -0.05, 0.0};
+  start.rotation = start.rotation * so3_exp(Vec3{0.01, -0.01, 0.03});
+  ekf.reset(0.0, start, ImuBias{}, 0.05, 0.1, 0.1, 0.01, 0.1);
+  float cov[9];
+  s.pose_covariance(cov);
+  RunStats st;
+  double sq_pos = 0.0, sq_heading = 0.0, nis = 0.0;
+  int scored = 0;
+  const int n = static_cast<int>(seconds * hz);
+  for (int k = 0; k <= n; ++k) {
+    const double t = k / hz;
+    ekf.predict(s.imu(d, t, hz, rng));
+    if (k % 10 != 0 || k == 0) continue;
+    double d2;
+    if (ekf.update_pose2(s.pose(d, t, rng), cov, &d2)) {
+      ++st.updates;
+      nis += d2;
+    } else {
+      ++st.rejected;
+    }
+    if (t < 5.0) continue;
+    const Pose2 e = planar_pose(d.state(t)), p = ekf.pose2();
+    sq_pos += (e.x - p.x) * (e.x - p.x) + (e.y - p.y) * (e.y - p.y);
+    sq_heading += wrap_angle(e.theta - p.theta) * wrap_angle(e.theta - p.theta);
+    ++scored;
+  }
+  st.position_rms = std::sqrt(sq_pos / scored);
+  st.heading_rms = std::sqrt(sq_heading / scored);
+  st.nis_mean = nis / st.updates;
+  return st;
+}
+
+} // namespace
+
+TEST_CASE("tracks the drive and estimates the biases", "[ekf]") {
+  const Drive d;
+  const Sensors s;
+  ErrorStateEkf ekf(params_for(s));
+  const RunStats st = run(ekf, d, s, 60.0, 1);
+  // the 99.9% gate drops about one good fix in a thousand
+  REQUIRE(st.rejected <= 2);
+  // better than the fixes alone
+  REQUIRE(st.position_rms < s.pose_sigma);
+  REQUIRE(st.heading_rms < s.heading_sigma);
+  // the yaw rate bias is observed through the headings, roll and pitch
+  // rate biases through gravity; the estimate is in IMU axes like the
+  // truth. Horizontal accelerometer bias trades off against tilt on a flat
+  // drive, so only the tilt is checked, and the vertical one against height,
+  // which no fix observes.
+  REQUIRE(norm(ekf.bias().gyro - s.bias.gyro) < 1e-3);
+  const Mat3 truth = d.rotation(60.0);
+  const Vec3 up = transpose_mul(truth, Vec3{0, 0, 1}), up_est = transpose_mul(ekf.state().rotation, Vec3{0, 0, 1});
+  // within three sigma of the filter's own roll and pitch uncertainty
+  const ErrorStateEkf::Covariance &P = ekf.covariance();
+  REQUIRE(norm(up - up_est) < 3.0 * std::sqrt(P(0, 0) + P(1, 1)));
+}
+
+TEST_CASE("innovations are consistent", "[ekf]") {
+  const Drive d;
+  const Sensors s;
+  ErrorStateEkf ekf(params_for(s));
+  // the normalized innovation squared of a 3-dof fix averages 3; over 300
+  // fixes per run the mean's standard error is about 0.15
+  double mean = 0.0;
+  for (unsigned seed = 1; seed <= 4; ++seed) mean += run(ekf, d, s, 30.0, seed).nis_mean / 4;
+  REQUIRE(mean > 2.5);
+  REQUIRE(mean < 3.5);
+  // the covariance stays symmetric positive definite
+  ErrorStateEkf::Covariance inv;
+  REQUIRE(invert_spd(ekf.covariance(), inv));
+}
+
+TEST_CASE("outlying poses are gated", "[ekf]") {
+  const Drive d;
+  const Sensors s;
+  ErrorStateEkf ekf(params_for(s));
+  run(ekf, d, s, 10.0, 3);
+  const NavState before = ekf.state();
+  const ErrorStateEkf::Covariance P = ekf.covariance();
+  Pose2 wrong = ekf.pose2();
+  wrong.x += 0.5f;
+  float cov[9];
+  s.pose_covariance(cov);
+  double d2 = 0.0;
+  REQUIRE_FALSE(ekf.update_pose2(wrong, cov, &d2));
+  REQUIRE(d2 > ekf.params().pose_gate);
+  REQUIRE(norm(ekf.state().position - before.position) == 0.0);
+  for (int i = 0; i < ErrorStateEkf::kStates * ErrorStateEkf::kStates; ++i) REQUIRE(ekf.covariance().m[i] == P.m[i]);
+  // a heading off by a few degrees is a bad match too
+  Pose2 turned = ekf.pose2();
+  turned.theta = wrap_angle(turned.theta + 0.2f);
+  REQUIRE_FALSE(ekf.update_pose2(turned, cov));
+}
+
+TEST_CASE("wheel velocity bounds dead reckoning", "[ekf]") {
+  // no pose fixes: IMU alone drifts, body velocity from the wheels (forward
+  // speed, no sideways or vertical slip) holds the velocity
+  const Drive d;
+  const Sensors s;
+  std::mt19937 rng(5);
+  const double hz = 100.0;
+  ErrorStateEkf imu_only(params_for(s)), wheels(params_for(s));
+  imu_only.reset(0.0, d.state(0.0), ImuBias{}, 0.01, 0.01, 0.01, 0.01, 0.1);
+  wheels.reset(0.0, d.state(0.0), ImuBias{}, 0.01, 0.01, 0.01, 0.01, 0.1);
+  Matrix<3, 3> cov = Matrix<3, 3>::zero();
+  cov(0, 0) = cov(1, 1) = cov(2, 2) = 0.02 * 0.02;
+  std::normal_distribution<double> vn(0.0, 0.02);
+  for (int k = 0; k <= 2000; ++k) {
+    const double t = k / hz;
+    const IMUData sample = s.imu(d, t, hz, rng);
+    imu_only.predict(sample);
+    wheels.predict(sample);
+    if (k % 5 == 0) {
+      const Vec3 v = transpose_mul(d.rotation(t), d.velocity(t));
+      REQUIRE(wheels.update_body_velocity(v + Vec3{vn(rng), vn(rng), vn(rng)}, cov));
+    }
+  }
+  const double t = 20.0;
+  const double imu_error = norm(imu_only.state().position - d.position(t));
+  const double wheel_error = norm(wheels.state().position - d.position(t));
+  // heading drifts without fixes, so compare in body axes
+  const Vec3 v_body = transpose_mul(wheels.state().rotation, wheels.state().velocity);
+  REQUIRE(norm(v_body - transpose_mul(d.rotation(t), d.velocity(t))) < 0.03);
+  REQUIRE(wheel_error < 0.1 * imu_error);
+  REQUIRE(wheel_error < 0.5);
+}
+
+TEST_CASE("a filter that was never reset starts at its first sample", "[ekf]") {
+  // CoreMotion stamps are seconds since boot; at rest, level
+  const Sensors s;
+  const double t0 = 3600.0;
+  ErrorStateEkf fresh(params_for(s)), started(params_for(s));
+  started.reset(t0, NavState{}, ImuBias{}, ErrorStateEkf::Covariance::identity());
+  for (int k = 0; k <= 100; ++k) {
+    const double t = t0 + k / 100.0;
+    const IMUData sample{t, 0.0, 0.0, -kGravity.z, t, 0.0, 0.0, 0.0};
+    fresh.predict(sample);
+    started.predict(sample);
+    if (k == 0) REQUIRE(fresh.time() == t0);
+  }
+  REQUIRE(fresh.time() == started.time());
+  REQUIRE(norm(fresh.state().position - started.state().position) == 0.0);
+  REQUIRE(norm(fresh.state().position) < 1e-6);
+  for (int i = 0; i < ErrorStateEkf::kStates * ErrorStateEkf::kStates; ++i)
+    REQUIRE(fresh.covariance().m[i] == started.covariance().m[i]);
+}
+
+TEST_CASE("predict and update latency", "[ekf]") {
+  const Drive d;
+  const Sensors s;
+  ErrorStateEkf ekf(params_for(s));
+  run(ekf, d, s, 5.0, 7);
+  std::mt19937 rng(8);
+  const IMUData sample = s.imu(d, 5.0, 100.0, rng);
+  float cov[9];
+  s.pose_covariance(cov);
+
+  double t = ekf.time();
+  BENCHMARK("predict one IMU sample") {
+    IMUData next = sample;
+    next.gyro_timestamp = t += 0.01;
+    ekf.predict(next);
+    return ekf.state().position.x;
+  };
+  BENCHMARK("update from a scan-match pose") {
+    // the filter's own pose: never gated, and P settles
+    ekf.update_pose2(ekf.pose2(), cov);
+    return ekf.covariance().m[0];
+  };
+}
+
+TEST_CASE("error, consistency and latency", "[.][summary]") {
+  const Drive d;
+  std::printf("%22s %12s %12s %8s %9s\n", "setup", "pos rms mm", "yaw rms mrad", "NIS", "rejected");
+  struct Setup {
+    const char *name;
+    double gyro_noise, accel_noise, pose_sigma;
+  } setups[] = {{"default", 2e-3, 2e-2, 0.02}, {"quiet IMU", 2e-4, 2e-3, 0.02}, {"coarse poses", 2e-3, 2e-2, 0.05}};
+  for (const Setup &setup : setups) {
+    Sensors s;
+    s.gyro_noise = setup.gyro_noise;
+    s.accel_noise = setup.accel_noise;
+    s.pose_sigma = setup.pose_sigma;
+    ErrorStateEkf ekf(params_for(s));
+    const RunStats st = run(ekf, d, s, 60.0, 1);
+    std::printf("%22s %12.2f %12.2f %8.2f %9d\n", setup.name, 1e3 * st.position_rms, 1e3 * st.heading_rms, st.nis_mean,
+                st.rejected);
+  }
+
+  const Sensors s;
+  ErrorStateEkf ekf(params_for(s));
+  run(ekf, d, s, 5.0, 7);
+  std::mt19937 rng(8);
+  IMUData sample = s.imu(d, 5.0, 100.0, rng);
+  float cov[9];
+  s.pose_covariance(cov);
+  const int n = 100000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i) {
+    sample.gyro_timestamp += 0.01;
+    ekf.predict(sample);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i) ekf.update_pose2(ekf.pose2(), cov);
+  auto t2 = std::chrono::steady_clock::now();
+  std::printf("predict %.2f us, pose update %.2f us\n", std::chrono::duration<double, std::micro>(t1 - t0).count() / n,
+              std::chrono::duration<double, std::micro>(t2 - t1).count() / n);
+}
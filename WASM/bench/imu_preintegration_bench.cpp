@@ -0,0 +1,285 @@
+// ImuPreintegrator on a synthetic 3D trajectory with closed-form pose,
+// velocity and angular rate, sampled like CoreMotion at 100 Hz. Checks the
+// SO(3) maps, prediction against the true state, the bias Jacobians against
+// integrating again, the covariance against a Monte Carlo run, and the planar
+// motion prior through a rotated phone mount.
+//
+//   bazel run --config=opt //WASM:imu_preintegration_bench
+//   bazel run --config=opt //WASM:imu_preintegration_bench -- "[summary]"   # error and 1-sigma per interval
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "imu_preintegration.h"
+
+namespace {
+
+double max_abs_diff(const Mat3 &a, const Mat3 &b) {
+  double m = 0.0;
+  for (int i = 0; i < 9; ++i) m = std::max(m, std::fabs(a.m[i] - b.m[i]));
+  return m;
+}
+
+double rotation_error(const Mat3 &a, const Mat3 &b) { return norm(so3_log(transpose(a) * b)); }
+
+// Body motion: position and rotation vector are smooth closed-form curves,
+// so velocity, acceleration and body rate are exact.
+struct Trajectory {
+  Vec3 theta(double t) const { return Vec3{0.3 * std::sin(0.9 * t), 0.2 * std::sin(1.1 * t + 0.5), 0.8 * t}; }
+  Vec3 theta_dot(double t) const { return Vec3{0.27 * std::cos(0.9 * t), 0.22 * std::cos(1.1 * t + 0.5), 0.8}; }
+  Mat3 rotation(double t) const { return so3_exp(theta(t)); }
+  // d/dt Exp(theta) = Exp(theta) [Jr(theta) theta']x
+  Vec3 body_rate(double t) const { return so3_right_jacobian(theta(t)) * theta_dot(t); }
+  Vec3 position(double t) const {
+    return Vec3{1.5 * std::sin(0.5 * t), 1.0 - std::cos(0.7 * t), 0.1 * std::sin(1.3 * t)};
+  }
+  Vec3 velocity(double t) const {
+    return Vec3{0.75 * std::cos(0.5 * t), 0.7 * std::sin(0.7 * t), 0.13 * std::cos(1.3 * t)};
+  }
+  Vec3 acceleration(double t) const {
+    return Vec3{-0.375 * std::sin(0.5 * t), 0.49 * std::cos(0.7 * t), -0.169 * std::sin(1.3 * t)};
+  }
+  NavState state(double t) const { return NavState{rotation(t), velocity(t), position(t)}; }
+
+  // what the IMU reads at t: body rate and specific force R^T (a - g)
+  IMUData sample(double t, const ImuBias &bias = ImuBias{}) const {
+    const Vec3 w = body_rate(t) + bias.gyro;
+    const Vec3 f = transpose_mul(rotation(t), acceleration(t) - kGravity) + bias.accel;
+    return IMUData{t, f.x, f.y, f.z, t, w.x, w.y, w.z};
+  }
+};
+
+std::vector<IMUData> samples(const Trajectory &traj, double t0, double t1, double hz, const ImuBias &bias = ImuBias{}) {
+  std::vector<IMUData> out;
+  for (int k = 0;; ++k) {
+    const double t = t0 + k / hz;
+    if (t > t1) break;
+    out.push_back(traj.sample(t, bias));
+  }
+  return out;
+}
+
+// preintegrates [t0, t1] from samples covering it
+void preintegrate(ImuPreintegrator &pre, const std::vector<IMUData> &s, double t0, double t1, const ImuBias &bias = ImuBias{}) {
+  pre.reset(t0, bias);
+  pre.add(s.data(), static_cast<int>(s.size()), t1);
+  pre.integrate_to(t1);
+}
+
+} // namespace
+
+TEST_CASE("so3 maps", "[imu]") {
+  const Vec3 ws[] = {{0.3, -0.2, 0.9}, {1e-6, 2e-6, -1e-6}, {0.0, 0.0, 0.0}, {0.0, 3.14159, 0.0}, {1.2, -1.9, 2.1}};
+  for (const Vec3 &w : ws) {
+    const Mat3 R = so3_exp(w);
+    REQUIRE(max_abs_diff(R * transpose(R), Mat3::identity()) < 1e-12);
+    REQUIRE(norm(so3_log(R) - w) < 1e-9);
+    REQUIRE(max_abs_diff(so3_right_jacobian(w) * so3_right_jacobian_inverse(w), Mat3::identity()) < 1e-9);
+    // Exp(w + d) ~= Exp(w) Exp(Jr(w) d) to second order in d
+    const Vec3 d{1e-5, -2e-5, 1.5e-5};
+    const Mat3 lhs = so3_exp(w + d), rhs = R * so3_exp(so3_right_jacobian(w) * d);
+    REQUIRE(rotation_error(lhs, rhs) < 1e-9);
+  }
+  // just below pi, where sin(t) vanishes
+  const Vec3 flip = Vec3{0.48, -0.6, 0.64} * (3.1415926 / norm(Vec3{0.48, -0.6, 0.64}));
+  REQUIRE(norm(so3_log(so3_exp(flip)) - flip) < 1e-6);
+}
+
+TEST_CASE("prediction follows the trajectory", "[imu]") {
+  const Trajectory traj;
+  ImuPreintegrator pre;
+  // one 30 Hz frame interval, then a whole second, from 100 Hz samples whose
+  // timestamps do not line up with the interval
+  const std::vector<IMUData> s = samples(traj, 2.003, 4.5, 100.0);
+  for (double length : {1.0 / 30.0, 1.0}) {
+    const double t0 = 2.01, t1 = t0 + length;
+    preintegrate(pre, s, t0, t1);
+    REQUIRE(pre.duration() == t1 - t0);
+    const NavState p = pre.predict(traj.state(t0)), truth = traj.state(t1);
+    // the samples are held for 10 ms, so the error is first order in that
+    const double scale = length < 0.1 ? 1.0 : 30.0;
+    REQUIRE(rotation_error(p.rotation, truth.rotation) < 2e-3 * scale);
+    REQUIRE(norm(p.velocity - truth.velocity) < 1e-3 * scale);
+    REQUIRE(norm(p.position - truth.position) < 2e-5 * scale * scale);
+  }
+
+  // ten times the rate, a tenth of the error
+  const std::vector<IMUData> fast = samples(traj, 2.0, 3.5, 1000.0);
+  preintegrate(pre, s, 2.01, 3.01);
+  const double slow_error = norm(pre.predict(traj.state(2.01)).position - traj.position(3.01));
+  preintegrate(pre, fast, 2.01, 3.01);
+  const double fast_error = norm(pre.predict(traj.state(2.01)).position - traj.position(3.01));
+  REQUIRE(fast_error < 0.2 * slow_error);
+}
+
+TEST_CASE("consecutive intervals chain", "[imu]") {
+  const Trajectory traj;
+  const std::vector<IMUData> s = samples(traj, 0.0, 2.0, 100.0);
+  ImuPreintegrator whole, pieces;
+  preintegrate(whole, s, 0.0, 1.5);
+  const NavState start = traj.state(0.0);
+  const NavState a = whole.predict(start);
+
+  // 50 frames, each fed the part of the drained batch up to its timestamp.
+  // They fall on sample times: a frame inside a sample splits it into two
+  // Euler steps, which only agree with one to second order.
+  NavState b = start;
+  pieces.reset(0.0);
+  int used = 0;
+  for (int f = 1; f <= 50; ++f) {
+    const double t = 3 * f / 100.0;
+    used += pieces.add(s.data() + used, static_cast<int>(s.size()) - used, t);
+    pieces.integrate_to(t);
+    REQUIRE(pieces.sample_count() == 3);
+    b = pieces.predict(b);
+    pieces.begin(t);
+  }
+  REQUIRE(rotation_error(a.rotation, b.rotation) < 1e-9);
+  REQUIRE(norm(a.velocity - b.velocity) < 1e-9);
+  REQUIRE(norm(a.position - b.position) < 1e-9);
+}
+
+TEST_CASE("a fresh preintegrator starts at its first sample", "[imu]") {
+  // CoreMotion stamps are seconds since boot
+  const Trajectory traj;
+  const double t0 = 3600.0;
+  const std::vector<IMUData> s = samples(traj, t0, t0 + 1.0, 100.0);
+  ImuPreintegrator fresh, started;
+  fresh.add(s.data(), static_cast<int>(s.size()));
+  preintegrate(started, s, t0, s.back().gyro_timestamp);
+  REQUIRE(fresh.start_time() == t0);
+  REQUIRE(fresh.duration() == started.duration());
+  REQUIRE(fresh.sample_count() == started.sample_count());
+  const NavState a = fresh.predict(traj.state(t0)), b = started.predict(traj.state(t0));
+  REQUIRE(rotation_error(a.rotation, b.rotation) < 1e-12);
+  REQUIRE(norm(a.position - b.position) < 1e-12);
+  REQUIRE(norm(a.position - traj.position(s.back().gyro_timestamp)) < 0.01);
+}
+
+TEST_CASE("bias jacobians", "[imu]") {
+  const Trajectory traj;
+  const ImuBias bias{{0.004, -0.006, 0.003}, {0.04, 0.03, -0.05}};
+  const std::vector<IMUData> s = samples(traj, 0.0, 1.5, 100.0, bias);
+  ImuPreintegrator at_zero, at_bias;
+  preintegrate(at_zero, s, 0.0, 1.0);
+  preintegrate(at_bias, s, 0.0, 1.0, bias);
+
+  // correcting the zero-bias deltas gets most of the way to integrating again
+  const double r0 = rotation_error(at_zero.delta_rotation(), at_bias.delta_rotation());
+  const double r1 = rotation_error(at_zero.delta_rotation(bias), at_bias.delta_rotation());
+  const double v0 = norm(at_zero.delta_velocity() - at_bias.delta_velocity());
+  const double v1 = norm(at_zero.delta_velocity(bias) - at_bias.delta_velocity());
+  const double p0 = norm(at_zero.delta_position() - at_bias.delta_position());
+  const double p1 = norm(at_zero.delta_position(bias) - at_bias.delta_position());
+  REQUIRE(r1 < 0.01 * r0);
+  REQUIRE(v1 < 0.01 * v0);
+  REQUIRE(p1 < 0.01 * p0);
+  // and the bias-corrected prediction tracks the truth
+  const NavState p = at_zero.predict(traj.state(0.0), bias);
+  REQUIRE(norm(p.position - traj.position(1.0)) < 0.01);
+}
+
+TEST_CASE("covariance matches Monte Carlo", "[imu]") {
+  const Trajectory traj;
+  ImuNoiseParams params;
+  params.gyro_noise = 2e-3; // larger than the default so the noise dominates rounding
+  params.accel_noise = 2e-2;
+  const double hz = 100.0, t0 = 0.0, t1 = 0.5;
+  const std::vector<IMUData> clean = samples(traj, t0, t1 + 0.02, hz);
+  ImuPreintegrator ref(params), pre(params);
+  preintegrate(ref, clean, t0, t1);
+
+  // per-sample noise of a density sampled at hz: density * sqrt(hz)
+  std::mt19937 rng(11);
+  std::normal_distribution<double> gn(0.0, params.gyro_noise * std::sqrt(hz)), an(0.0, params.accel_noise * std::sqrt(hz));
+  const int runs = 2000;
+  double sum[9] = {}, sq[9] = {};
+  std::vector<IMUData> noisy = clean;
+  for (int run = 0; run < runs; ++run) {
+    for (size_t i = 0; i < clean.size(); ++i) {
+      noisy[i].gyro_x = clean[i].gyro_x + gn(rng);
+      noisy[i].gyro_y = clean[i].gyro_y + gn(rng);
+      noisy[i].gyro_z = clean[i].gyro_z + gn(rng);
+      noisy[i].acc_x = clean[i].acc_x + an(rng);
+      noisy[i].acc_y = clean[i].acc_y + an(rng);
+      noisy[i].acc_z = clean[i].acc_z + an(rng);
+    }
+    preintegrate(pre, noisy, t0, t1);
+    const Vec3 r = so3_log(transpose(ref.delta_rotation()) * pre.delta_rotation());
+    const Vec3 v = pre.delta_velocity() - ref.delta_velocity(), p = pre.delta_position() - ref.delta_position();
+    const double e[9] = {r.x, r.y, r.z, v.x, v.y, v.z, p.x, p.y, p.z};
+    for (int k = 0; k < 9; ++k) {
+      sum[k] += e[k];
+      sq[k] += e[k] * e[k];
+    }
+  }
+  // variances within 15% (their standard error here is about 3%)
+  for (int k = 0; k < 9; ++k) {
+    const double mean = sum[k] / runs, var = sq[k] / runs - mean * mean;
+    const double predicted = ref.covariance()[10 * k];
+    REQUIRE(var > 0.85 * predicted);
+    REQUIRE(var < 1.15 * predicted);
+  }
+
+  BENCHMARK("0.5 s of 100 Hz samples") {
+    pre.reset(t0);
+    pre.add(clean.data(), static_cast<int>(clean.size()));
+    return pre.delta_position().x;
+  };
+}
+
+TEST_CASE("planar motion prior through a phone mount", "[imu]") {
+  // a robot driving an arc on the floor, the phone upright facing forward:
+  // phone Right-Up-Back is robot (-y, z, -x)
+  const Mat3 imu_to_body{{0, 0, -1, -1, 0, 0, 0, 1, 0}};
+  ImuNoiseParams params;
+  params.imu_to_body = imu_to_body;
+  ImuPreintegrator pre(params);
+  const double speed = 0.5, turn = 0.4; // m/s and rad/s
+  auto pose = [&](double t) {
+    return Pose2{static_cast<float>(speed / turn * std::sin(turn * t)),
+                 static_cast<float>(speed / turn * (1.0 - std::cos(turn * t))), static_cast<float>(turn * t)};
+  };
+  std::vector<IMUData> s;
+  for (int k = 0; k <= 200; ++k) {
+    const double t = k / 100.0;
+    // constant body rate and centripetal force, plus gravity's reaction
+    const Vec3 w = transpose_mul(imu_to_body, Vec3{0, 0, turn});
+    const Vec3 f = transpose_mul(imu_to_body, Vec3{0, speed * turn, 9.80665});
+    s.push_back(IMUData{t, f.x, f.y, f.z, t, w.x, w.y, w.z});
+  }
+  const double t0 = 0.5, t1 = t0 + 0.1;
+  const Pose2 p0 = pose(t0);
+  NavState start;
+  start.rotation = so3_exp(Vec3{0, 0, p0.theta});
+  start.position = Vec3{p0.x, p0.y, 0.0};
+  start.velocity = start.rotation * Vec3{speed, 0, 0};
+  preintegrate(pre, s, t0, t1);
+  // the matched pose differs from the IMU's state; only the increment carries over
+  const Pose2 previous{3.0f, -1.0f, 0.3f};
+  const Pose2 prior = imu_motion_prior(previous, start, pre);
+  const Pose2 expected = compose(previous, between(p0, pose(t1)));
+  REQUIRE(std::fabs(prior.x - expected.x) < 1e-3f);
+  REQUIRE(std::fabs(prior.y - expected.y) < 1e-3f);
+  REQUIRE(std::fabs(wrap_angle(prior.theta - expected.theta)) < 1e-4f);
+}
+
+TEST_CASE("error and covariance per interval", "[.][summary]") {
+  const Trajectory traj;
+  ImuPreintegrator pre;
+  std::printf("%10s %8s %14s %14s %14s %14s\n", "interval s", "samples", "rot err mrad", "pos err mm",
+              "rot 1sig mrad", "pos 1sig mm");
+  const std::vector<IMUData> s = samples(traj, 0.0, 12.0, 100.0);
+  for (double length : {1.0 / 30.0, 0.1, 0.5, 1.0, 5.0, 10.0}) {
+    preintegrate(pre, s, 0.5, 0.5 + length);
+    const NavState p = pre.predict(traj.state(0.5)), truth = traj.state(0.5 + length);
+    const double *c = pre.covariance();
+    std::printf("%10.3f %8d %14.3f %14.3f %14.3f %14.3f\n", length, pre.sample_count(),
+                1e3 * rotation_error(p.rotation, truth.rotation), 1e3 * norm(p.position - truth.position),
+                1e3 * std::sqrt(c[0] + c[10] + c[20]), 1e3 * std::sqrt(c[60] + c[70] + c[80]));
+  }
+}
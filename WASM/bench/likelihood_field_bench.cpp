@@ -0,0 +1,222 @@
+// LikelihoodField on a synthetic room: a 16 m square with pillars and a door
+// that closes halfway through, mapped by 360-beam scans from a loop around
+// it. The field is checked against a brute-force nearest-obstacle search, and
+// the per-scan incremental update against a full rebuild.
+//
+//   bazel run --config=opt //WASM:likelihood_field_bench
+//   bazel run --config=opt //WASM:likelihood_field_bench -- "[summary]"   # update cost and lookup vs search
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "bench/scan_scene.h"
+#include "likelihood_field.h"
+#include "occupancy_grid.h"
+
+namespace {
+
+constexpr int kScans = 240;
+// 360 beams around a full circle, 10 m
+constexpr Lidar2D kLidar = {360, Lidar2D::kFullCircle, 10.0f};
+const OccupancyParams kParams = {218, -102, -512, 896, kLidar.max_range};
+
+void box(std::vector<Segment> &w, float x0, float y0, float x1, float y1) {
+  w.push_back({x0, y0, x1, y0});
+  w.push_back({x1, y0, x1, y1});
+  w.push_back({x1, y1, x0, y1});
+  w.push_back({x0, y1, x0, y0});
+}
+
+// walls at +-8 m, pillars around the loop and, if closed, a door across the
+// gap between two of them
+std::vector<Segment> room(bool door) {
+  std::vector<Segment> w;
+  box(w, -8.0f, -8.0f, 8.0f, 8.0f);
+  box(w, -0.4f, -0.4f, 0.4f, 0.4f);
+  box(w, 5.0f, -1.0f, 5.6f, 1.5f);
+  box(w, -6.2f, 3.0f, -5.0f, 3.4f);
+  box(w, 1.0f, -6.5f, 1.3f, -5.0f);
+  box(w, 1.0f, 5.0f, 1.3f, 6.5f);
+  if (door) w.push_back({1.3f, 6.5f, 1.3f, 8.0f});
+  return w;
+}
+
+struct Scan {
+  float ox, oy;
+  std::vector<float> xy; // world-frame returns, x,y pairs
+};
+
+// a 3.5 m radius loop around the center pillar, 1 cm range noise; the door
+// closes after the first half
+std::vector<Scan> run() {
+  const std::vector<Segment> open = room(false), closed = room(true);
+  std::mt19937 rng(5);
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+  std::vector<Scan> scans(kScans);
+  for (int i = 0; i < kScans; ++i) {
+    Scan &s = scans[i];
+    const float a = 2.0f * 6.2831853f * i / kScans;
+    s.ox = 3.5f * std::cos(a);
+    s.oy = 3.5f * std::sin(a);
+    scan_walls(i < kScans / 2 ? open : closed, Pose2{s.ox, s.oy, 0.0f}, kLidar, rng, noise, [&](float t, float r) {
+      s.xy.push_back(s.ox + r * std::cos(t));
+      s.xy.push_back(s.oy + r * std::sin(t));
+    });
+  }
+  return scans;
+}
+
+void integrate(OccupancyGrid &grid, const Scan &s, std::vector<uint32_t> &keys) {
+  occ_integrate(&grid, &kParams, s.ox, s.oy, s.xy.data(), static_cast<int32_t>(s.xy.size() / 2), keys.data(),
+                static_cast<int32_t>(keys.size()));
+}
+
+// the field's value of cell (cx, cy) by searching its max_distance square
+int16_t brute_force(OccupancyGrid &grid, const LikelihoodField &field, int32_t cx, int32_t cy) {
+  const int16_t threshold = std::max<int16_t>(occ_to_fixed(field.params().min_log_odds), 1);
+  const int32_t r = static_cast<int32_t>(std::ceil(field.far_value() / 256.0f));
+  int32_t best = INT32_MAX;
+  for (int32_t y = -r; y <= r; ++y)
+    for (int32_t x = -r; x <= r; ++x)
+      if (occ_get(&grid, cx + x, cy + y) >= threshold) best = std::min(best, x * x + y * y);
+  const float far = field.far_value() / 256.0f, e = static_cast<float>(best);
+  return best == INT32_MAX || e >= far * far ? field.far_value() : static_cast<int16_t>(std::sqrt(e) * 256.0f + 0.5f);
+}
+
+// cells of the grid's touched box plus the field's reach that disagree with a
+int count_mismatches(OccupancyGrid &grid, const LikelihoodField &a, const LikelihoodField *b) {
+  const int32_t r = static_cast<int32_t>(std::ceil(a.far_value() / 256.0f));
+  int bad = 0;
+  for (int32_t cy = grid.minCY - r; cy <= grid.maxCY + r; ++cy)
+    for (int32_t cx = grid.minCX - r; cx <= grid.maxCX + r; ++cx)
+      bad += a.cell(cx, cy) != (b ? b->cell(cx, cy) : brute_force(grid, a, cx, cy));
+  return bad;
+}
+
+// the nearest obstacle by searching the grid around the point, like a
+// matcher without a field: the baseline for lookup cost
+float search_distance(OccupancyGrid &grid, int16_t threshold, int32_t reach, float x, float y) {
+  int32_t cx, cy;
+  if (!occ_cell(x, grid.invResolution, &cx) || !occ_cell(y, grid.invResolution, &cy)) return INFINITY;
+  float best = INFINITY;
+  for (int32_t j = -reach; j <= reach; ++j) {
+    for (int32_t i = -reach; i <= reach; ++i) {
+      if (occ_get(&grid, cx + i, cy + j) < threshold) continue;
+      const float dx = (cx + i + 0.5f) * grid.resolution - x, dy = (cy + j + 0.5f) * grid.resolution - y;
+      best = std::min(best, dx * dx + dy * dy);
+    }
+  }
+  return std::sqrt(best);
+}
+
+} // namespace
+
+TEST_CASE("field matches a brute-force search", "[likelihood_field]") {
+  const std::vector<Scan> scans = run();
+  auto grid = new_grid(0.05f);
+  std::vector<uint32_t> keys(1 << 11);
+  for (const Scan &s : scans) integrate(*grid, s, keys);
+  LikelihoodField field;
+  field.rebuild(*grid);
+  REQUIRE(field.far_value() == 6 * 256);
+  REQUIRE(count_mismatches(*grid, field, nullptr) == 0);
+
+  // 15 cm in front of the +x wall, whose cells straddle x = 8
+  REQUIRE(std::fabs(field.distance(7.85f, 2.0f) - 0.15f) < 0.05f);
+  float dx, dy;
+  field.distance(7.85f, 2.0f, dx, dy);
+  REQUIRE(dx < -0.9f);
+  REQUIRE(std::fabs(dy) < 0.1f);
+  // nothing within reach, on the map or off it
+  REQUIRE(field.distance(2.0f, 2.0f) == 0.3f);
+  REQUIRE(field.distance(1e9f, 0.0f) == 0.3f);
+}
+
+TEST_CASE("incremental update matches rebuild", "[likelihood_field]") {
+  const std::vector<Scan> scans = run();
+  auto grid = new_grid(0.05f);
+  std::vector<uint32_t> keys(1 << 11);
+  LikelihoodField incremental;
+  int recomputed = 0;
+  for (size_t i = 0; i < scans.size(); ++i) {
+    integrate(*grid, scans[i], keys);
+    recomputed += incremental.update(*grid);
+    if (i == scans.size() / 2 - 1) REQUIRE(count_mismatches(*grid, incremental, nullptr) == 0);
+  }
+  // the door closed: its cells became obstacles after the first half
+  REQUIRE(incremental.distance(1.3f, 7.0f) < 0.05f);
+
+  // rebuild takes the grid's changes itself, so it goes last
+  LikelihoodField full;
+  const int tiles = full.rebuild(*grid);
+  REQUIRE(count_mismatches(*grid, incremental, &full) == 0);
+  // most scans only firm up cells that were obstacles already
+  REQUIRE(recomputed < tiles * static_cast<int>(scans.size()) / 4);
+
+  BENCHMARK("rebuild, 16 m room at 5 cm") { return full.rebuild(*grid); };
+  std::vector<float> qx(1024), qy(1024);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> u(-8.0f, 8.0f);
+  for (size_t i = 0; i < qx.size(); ++i) {
+    qx[i] = u(rng);
+    qy[i] = u(rng);
+  }
+  BENCHMARK("distance + gradient, 1024 points") {
+    float sum = 0.0f, dx, dy;
+    for (size_t i = 0; i < qx.size(); ++i) sum += full.distance(qx[i], qy[i], dx, dy) + dx;
+    return sum;
+  };
+}
+
+TEST_CASE("update cost and lookup vs search", "[.][summary]") {
+  const std::vector<Scan> scans = run();
+  std::printf("%6s %10s %8s %12s %12s %12s %12s %12s\n", "res m", "obstacles", "tiles", "rebuild ms",
+              "update us", "tiles/scan", "lookup ns", "search ns");
+  for (float res : {0.1f, 0.05f, 0.025f}) {
+    using clock = std::chrono::steady_clock;
+    auto grid = new_grid(res);
+    std::vector<uint32_t> keys(1 << 11);
+    LikelihoodField field;
+    double update_us = 0.0;
+    int recomputed = 0;
+    for (const Scan &s : scans) {
+      integrate(*grid, s, keys);
+      const auto t0 = clock::now();
+      recomputed += field.update(*grid);
+      update_us += std::chrono::duration<double, std::micro>(clock::now() - t0).count();
+    }
+    const int16_t threshold = occ_to_fixed(field.params().min_log_odds);
+    int obstacles = 0;
+    for (int32_t cy = grid->minCY; cy <= grid->maxCY; ++cy)
+      for (int32_t cx = grid->minCX; cx <= grid->maxCX; ++cx) obstacles += occ_get(grid.get(), cx, cy) >= threshold;
+
+    LikelihoodField full;
+    const auto t0 = clock::now();
+    full.rebuild(*grid);
+    const double rebuild_ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+    // every return of the last scan, as a matcher would score them
+    const std::vector<float> &xy = scans.back().xy;
+    const int n = static_cast<int>(xy.size() / 2), reps = 200;
+    float sink = 0.0f;
+    const auto t1 = clock::now();
+    for (int k = 0; k < reps; ++k)
+      for (int i = 0; i < n; ++i) sink += full.distance(xy[2 * i], xy[2 * i + 1]);
+    const auto t2 = clock::now();
+    const int32_t reach = static_cast<int32_t>(std::ceil(full.far_value() / 256.0f));
+    for (int k = 0; k < reps; ++k)
+      for (int i = 0; i < n; ++i) sink += search_distance(*grid, threshold, reach, xy[2 * i], xy[2 * i + 1]);
+    const auto t3 = clock::now();
+    const double lookups = static_cast<double>(reps) * n;
+    std::printf("%6.3f %10d %8d %12.2f %12.1f %12.1f %12.1f %12.1f%s\n", res, obstacles, full.tile_count(), rebuild_ms,
+                update_us / scans.size(), static_cast<double>(recomputed) / scans.size(),
+                std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups,
+                std::chrono::duration<double, std::nano>(t3 - t2).count() / lookups, sink == 0.0f ? " " : "");
+  }
+}
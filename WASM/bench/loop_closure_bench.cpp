@@ -0,0 +1,375 @@
+// LoopClosureDetector on a synthetic yard: 120 m square of 3 m wide lanes on
+// a 10 m grid between blocks of crates and pillars of random size and height.
+// A handheld depth camera (67 x 50 degree field of view, 5 m, 1.3 m above
+// the floor) random-walks the lanes with a keyframe every 0.5 m, so lanes
+// are revisited from either direction, off to one side, many times over.
+// Keyframes go in with drifting odometry poses; the closures found are
+// checked against the true relative poses, and query cost is compared
+// between databases of 1k and 20k keyframes.
+//
+//   bazel run --config=opt //WASM:loop_closure_bench
+//   bazel run --config=opt //WASM:loop_closure_bench -- "[summary]"   # passes closed, precision and us/query per size
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "loop_closure.h"
+
+namespace {
+
+constexpr float kCell = 0.1f;         // world raster, meters
+constexpr int kCells = 1200;          // per side
+constexpr float kLaneSpacing = 10.0f; // lane centers at 5, 15, ...
+constexpr float kLaneHalfWidth = 1.5f;
+constexpr float kSensorHeight = 1.3f;
+constexpr float kMaxRange = 5.0f;
+constexpr float kFov = 1.17f;      // horizontal, radians
+constexpr float kVerticalFov = 0.87f;
+constexpr int kBeams = 64;
+constexpr int kRows = 32;
+constexpr float kStep = 0.5f; // meters between keyframes
+
+// obstacle height per cell, 0 for free
+struct World {
+  std::vector<float> height;
+
+  float at(float x, float y) const {
+    const int i = static_cast<int>(std::floor(x / kCell)), j = static_cast<int>(std::floor(y / kCell));
+    if (i < 0 || j < 0 || i >= kCells || j >= kCells) return 3.0f;
+    return height[j * kCells + i];
+  }
+};
+
+bool in_lane(float v) {
+  const float d = std::fmod(v, kLaneSpacing) - 0.5f * kLaneSpacing;
+  return std::fabs(d) < kLaneHalfWidth;
+}
+
+World yard() {
+  World w;
+  w.height.assign(kCells * kCells, 0.0f);
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> pos(0.0f, kCells * kCell), size(0.3f, 2.5f), height(0.4f, 3.0f),
+      angle(0.0f, 3.1415927f);
+  for (int b = 0; b < 6000; ++b) {
+    // a box turned any which way, kept only if it stays off the lanes
+    const float cx = pos(rng), cy = pos(rng), hx = 0.5f * size(rng), hy = 0.5f * size(rng), h = height(rng);
+    const float a = angle(rng), c = std::cos(a), s = std::sin(a);
+    const float rx = std::fabs(c) * hx + std::fabs(s) * hy, ry = std::fabs(s) * hx + std::fabs(c) * hy;
+    if (in_lane(cx - rx) || in_lane(cx + rx) || in_lane(cy - ry) || in_lane(cy + ry) ||
+        std::floor((cx - rx) / kLaneSpacing - 0.5f) != std::floor((cx + rx) / kLaneSpacing - 0.5f) ||
+        std::floor((cy - ry) / kLaneSpacing - 0.5f) != std::floor((cy + ry) / kLaneSpacing - 0.5f))
+      continue;
+    for (int j = static_cast<int>((cy - ry) / kCell); j <= static_cast<int>((cy + ry) / kCell); ++j)
+      for (int i = static_cast<int>((cx - rx) / kCell); i <= static_cast<int>((cx + rx) / kCell); ++i) {
+        if (i < 0 || j < 0 || i >= kCells || j >= kCells) continue;
+        const float dx = (i + 0.5f) * kCell - cx, dy = (j + 0.5f) * kCell - cy;
+        if (std::fabs(c * dx + s * dy) > hx || std::fabs(-s * dx + c * dy) > hy) continue;
+        w.height[j * kCells + i] = std::max(w.height[j * kCells + i], h);
+      }
+  }
+  return w;
+}
+
+// the depth camera's robot-frame cloud (x forward, z up from the sensor):
+// for every beam the first obstacle, every row that reaches it below its
+// top, and the floor short of it
+// appended to cloud, the camera turned pan radians from the robot's heading
+void render(const World &w, const Pose2 &p, std::mt19937 &rng, PointCloud &cloud, float pan = 0.0f) {
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+  cloud.reserve(cloud.size + kBeams * kRows);
+  int n = cloud.size;
+  for (int b = 0; b < kBeams; ++b) {
+    const float a = pan - 0.5f * kFov + kFov * b / (kBeams - 1);
+    const float c = std::cos(p.theta + a), s = std::sin(p.theta + a);
+    float r = 0.2f, h = 0.0f;
+    for (; r < kMaxRange; r += 0.05f)
+      if ((h = w.at(p.x + c * r, p.y + s * r)) > 0.0f) break;
+    for (int row = 0; row < kRows; ++row) {
+      const float e = -0.5f * kVerticalFov + kVerticalFov * row / (kRows - 1);
+      const float t = std::tan(e);
+      float range, z;
+      if (r < kMaxRange && kSensorHeight + r * t >= 0.0f) {
+        if (kSensorHeight + r * t > h) continue; // over the top
+        range = r;
+        z = r * t;
+      } else if (t < 0.0f && -kSensorHeight / t < kMaxRange) {
+        range = -kSensorHeight / t;
+        z = -kSensorHeight;
+      } else {
+        continue;
+      }
+      range += noise(rng);
+      cloud.x[n] = range * std::cos(a);
+      cloud.y[n] = range * std::sin(a);
+      cloud.z[n] = z + noise(rng);
+      ++n;
+    }
+  }
+  cloud.size = n;
+}
+
+// A keyframe's cloud: the frames since the previous one as the hand sweeps
+// the camera +-40 degrees about the walking direction, in the keyframe's frame.
+void render_keyframe(const World &w, const Pose2 &p, std::mt19937 &rng, PointCloud &cloud) {
+  cloud.size = 0;
+  for (float pan : {-0.7f, -0.35f, 0.0f, 0.35f, 0.7f}) render(w, p, rng, cloud, pan);
+}
+
+struct Run {
+  std::vector<Pose2> truth, odometry;
+};
+
+// Lane to lane at random at every crossing (never straight back), weaving
+// up to 0.4 m off the lane center with a new phase on every stretch.
+Run walk(int keyframes, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> turn(0, 2);
+  std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+  std::normal_distribution<float> step_noise(0.0f, 0.01f), turn_noise(0.0f, 0.003f);
+  const int lanes = static_cast<int>(kCells * kCell / kLaneSpacing);
+  int ix = lanes / 2, iy = lanes / 2, dir = 0; // crossing, heading in quarter turns
+  Run run;
+  Pose2 odom{};
+  while (static_cast<int>(run.truth.size()) < keyframes) {
+    int next = (dir + 3 + turn(rng)) % 4; // left, straight or right
+    const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+    for (int tries = 0; tries < 4; ++tries) {
+      const int nx = ix + dx[next], ny = iy + dy[next];
+      if (nx >= 0 && ny >= 0 && nx < lanes && ny < lanes) break;
+      next = (next + 1) % 4;
+    }
+    dir = next;
+    const float ph = phase(rng);
+    const float x0 = (ix + 0.5f) * kLaneSpacing, y0 = (iy + 0.5f) * kLaneSpacing;
+    for (float s = 0.0f; s < kLaneSpacing && static_cast<int>(run.truth.size()) < keyframes; s += kStep) {
+      const float off = 0.4f * std::sin(ph + s * 0.6f), slope = 0.24f * std::cos(ph + s * 0.6f);
+      const float c = static_cast<float>(dx[dir]), sn = static_cast<float>(dy[dir]);
+      const Pose2 t{x0 + c * s - sn * off, y0 + sn * s + c * off, wrap_angle(dir * 1.5707963f + std::atan(slope))};
+      if (run.truth.empty()) {
+        odom = t;
+      } else {
+        const Pose2 d = between(run.truth.back(), t);
+        odom = compose(odom, Pose2{1.02f * d.x + step_noise(rng), d.y + step_noise(rng), d.theta + turn_noise(rng)});
+      }
+      run.truth.push_back(t);
+      run.odometry.push_back(odom);
+    }
+    ix += dx[dir];
+    iy += dy[dir];
+  }
+  return run;
+}
+
+LoopClosureParams yard_params() {
+  LoopClosureParams p;
+  p.min_z = 0.1f - kSensorHeight;
+  p.max_z = 3.0f - kSensorHeight;
+  return p;
+}
+
+// contexts and scans of a whole run, rendered once
+struct Frames {
+  std::vector<ScanContext> contexts;
+  std::vector<Scan2D> scans;
+};
+
+Frames render_run(const World &w, const Run &run, const LoopClosureDetector &det) {
+  Frames f;
+  f.contexts.resize(run.truth.size());
+  f.scans.resize(run.truth.size());
+  std::mt19937 rng(11);
+  PointCloud cloud;
+  for (size_t i = 0; i < run.truth.size(); ++i) {
+    render_keyframe(w, run.truth[i], rng, cloud);
+    det.describe(cloud, f.contexts[i]);
+    slice_scan(cloud, -0.3f, 0.3f, f.scans[i]);
+  }
+  return f;
+}
+
+const World &shared_world() {
+  static const World w = yard();
+  return w;
+}
+
+struct LoopStats {
+  int queries = 0, revisits = 0, found = 0, correct = 0, found_on_revisit = 0;
+  int stretches = 0, closed = 0; // runs of consecutive revisits, and those with a closure
+  double mean_error = 0, query_us = 0;
+};
+
+// queries every keyframe before adding it; a revisit is a query with an
+// older keyframe within 1 m and 0.3 rad of it
+LoopStats detect_loops(const Run &run, const Frames &f, LoopClosureDetector &det) {
+  LoopStats st;
+  const int exclude = det.params().exclude_recent;
+  bool in_stretch = false, stretch_closed = false;
+  for (size_t i = 0; i < run.truth.size(); ++i) {
+    bool revisit = false;
+    for (int j = 0; j + exclude < static_cast<int>(i) && !revisit; ++j) {
+      const Pose2 d = between(run.truth[j], run.truth[i]);
+      revisit = std::hypot(d.x, d.y) < 1.0f && std::fabs(d.theta) < 0.3f;
+    }
+    LoopClosure lc;
+    const auto t0 = std::chrono::steady_clock::now();
+    const bool found = det.query(f.contexts[i], f.scans[i], run.odometry[i], lc);
+    st.query_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    ++st.queries;
+    st.revisits += revisit;
+    if (revisit && !in_stretch) ++st.stretches;
+    if (revisit && found && !stretch_closed) {
+      ++st.closed;
+      stretch_closed = true;
+    }
+    if (!revisit) stretch_closed = false;
+    in_stretch = revisit;
+    if (found) {
+      ++st.found;
+      st.found_on_revisit += revisit;
+      const Pose2 truth = between(run.truth[lc.keyframe], run.truth[i]);
+      const double e = std::hypot(lc.relative.x - truth.x, lc.relative.y - truth.y);
+      if (e < 0.2 && std::fabs(wrap_angle(lc.relative.theta - truth.theta)) < 0.05f) {
+        ++st.correct;
+        st.mean_error += e;
+      }
+    }
+    det.add(static_cast<int>(i), run.odometry[i], f.contexts[i], f.scans[i]);
+  }
+  if (st.correct) st.mean_error /= st.correct;
+  st.query_us /= st.queries;
+  return st;
+}
+
+// a context turned by k sectors: the same points at bearing + k sector widths
+PointCloud turned(const PointCloud &in, float angle) {
+  PointCloud out;
+  out.reserve(in.size);
+  const float c = std::cos(angle), s = std::sin(angle);
+  for (int i = 0; i < in.size; ++i) {
+    out.x[i] = c * in.x[i] - s * in.y[i];
+    out.y[i] = s * in.x[i] + c * in.y[i];
+    out.z[i] = in.z[i];
+  }
+  out.size = in.size;
+  return out;
+}
+
+} // namespace
+
+TEST_CASE("scan context turns with the robot", "[loop_closure]") {
+  LoopClosureDetector det(yard_params());
+  std::mt19937 rng(3);
+  PointCloud cloud;
+  render_keyframe(shared_world(), Pose2{55.0f, 55.0f, 0.3f}, rng, cloud);
+  ScanContext a, b;
+  det.describe(cloud, a);
+  REQUIRE(cloud.size > 1000);
+  const int sectors = det.params().sectors;
+  for (int k : {0, 7, 25, 44}) {
+    const float angle = k * 6.2831853f / sectors;
+    det.describe(turned(cloud, angle), b);
+    int shift = -1;
+    const float d = det.distance(b, a, &shift);
+    INFO("k " << k << " distance " << d);
+    REQUIRE(d < 0.05f);
+    // b's sector j holds a's sector j - k
+    REQUIRE(shift == (sectors - k) % sectors);
+    for (int r = 0; r < det.params().rings; ++r) REQUIRE(std::fabs(a.ring_key[r] - b.ring_key[r]) < 0.02f);
+  }
+  // somewhere else entirely
+  render_keyframe(shared_world(), Pose2{25.0f, 85.0f, 1.8f}, rng, cloud);
+  det.describe(cloud, b);
+  REQUIRE(det.distance(b, a) > 0.3f);
+}
+
+TEST_CASE("loops found on revisits are right", "[loop_closure]") {
+  const Run run = walk(3000, 1);
+  LoopClosureDetector det(yard_params());
+  const Frames f = render_run(shared_world(), run, det);
+  const LoopStats st = detect_loops(run, f, det);
+  INFO("revisits " << st.revisits << " in " << st.stretches << " stretches, " << st.closed << " closed; found "
+                   << st.found << ", " << st.found_on_revisit << " on revisits, " << st.correct << " correct");
+  REQUIRE(st.stretches > 30);
+  // every reported closure is where it says, a false one would bend the map
+  REQUIRE(st.correct == st.found);
+  // A narrow view from a step to the side often looks different enough to
+  // miss, but one closure per pass is all the pose graph needs.
+  REQUIRE(st.closed * 5 >= st.stretches);
+  REQUIRE(st.mean_error < 0.05);
+  // odometry has drifted meters by now; the closures do not care
+  const Pose2 &o = run.odometry.back(), &t = run.truth.back();
+  REQUIRE(std::hypot(o.x - t.x, o.y - t.y) > 5.0f);
+}
+
+TEST_CASE("retrieval cost stays flat as the database grows", "[loop_closure]") {
+  const Run run = walk(20000, 2);
+  LoopClosureDetector det(yard_params());
+  const Frames f = render_run(shared_world(), run, det);
+  std::vector<LoopCandidate> out(det.params().neighbors);
+  auto retrieval_us = [&](int queries, int &checks) {
+    checks = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+      det.candidates(f.contexts[(q * 7919) % f.contexts.size()], out.data(), static_cast<int>(out.size()));
+      checks = std::max(checks, det.last_checks());
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / queries;
+  };
+  int i = 0;
+  for (; i < 1000; ++i) det.add(i, run.odometry[i], f.contexts[i], f.scans[i]);
+  int small_checks, large_checks;
+  const double small = retrieval_us(500, small_checks);
+  for (; i < 20000; ++i) det.add(i, run.odometry[i], f.contexts[i], f.scans[i]);
+  const double large = retrieval_us(500, large_checks);
+  INFO("1k " << small << " us, 20k " << large << " us");
+  const LoopClosureParams &p = det.params();
+  // the budget, one leaf past it and the keyframes since the last rebuild
+  REQUIRE(large_checks <= p.max_checks + 8 + p.rebuild_interval);
+  REQUIRE(large < 2.0 * small);
+}
+
+TEST_CASE("loop closure latency", "[loop_closure][!benchmark]") {
+  const Run run = walk(20000, 2);
+  LoopClosureDetector det(yard_params());
+  const Frames f = render_run(shared_world(), run, det);
+  for (int i = 0; i < 20000; ++i) det.add(i, run.odometry[i], f.contexts[i], f.scans[i]);
+  std::mt19937 rng(7);
+  PointCloud cloud;
+  render_keyframe(shared_world(), run.truth[123], rng, cloud);
+  ScanContext ctx;
+  std::vector<LoopCandidate> out(det.params().neighbors);
+  int q = 0;
+  BENCHMARK("describe") {
+    det.describe(cloud, ctx);
+    return ctx.ring_key[0];
+  };
+  BENCHMARK("candidates, 20k keyframes") {
+    q = (q + 7919) % 20000;
+    return det.candidates(f.contexts[q], out.data(), static_cast<int>(out.size()));
+  };
+  BENCHMARK("query with verification, 20k keyframes") {
+    q = (q + 7919) % 20000;
+    LoopClosure lc;
+    return det.query(f.contexts[q], f.scans[q], run.odometry[q], lc);
+  };
+}
+
+TEST_CASE("recall, precision and query cost", "[.][summary]") {
+  std::printf("%10s %8s %8s %8s %10s %10s %12s %12s\n", "keyframes", "revisits", "passes", "found", "correct",
+              "closed", "query us", "mean err cm");
+  for (int n : {2000, 5000, 20000}) {
+    const Run run = walk(n, 3);
+    LoopClosureDetector det(yard_params());
+    const Frames f = render_run(shared_world(), run, det);
+    const LoopStats st = detect_loops(run, f, det);
+    std::printf("%10d %8d %8d %8d %10d %10.2f %12.1f %12.2f\n", n, st.revisits, st.stretches, st.found, st.correct,
+                st.stretches ? static_cast<double>(st.closed) / st.stretches : 0.0, st.query_us, 100.0 * st.mean_error);
+  }
+}
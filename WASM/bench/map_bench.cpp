@@ -0,0 +1,168 @@
+// Baseline cost of the map.cpp kernels: draw_map over canvas sizes and point
+// counts, per-pixel readout through get_image_pixel_u32, and per-element
+// set_pose/set_point upload.
+//
+//   bazel run --config=opt //WASM:map_bench
+//   bazel run --config=opt //WASM:map_bench -- "[summary]"   # ns/point and ns/pixel only
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "map.h"
+
+namespace {
+
+constexpr int32_t kPoses = 4096;
+constexpr int32_t kMaxPoints = 20000;
+
+// a wandering trajectory with LiDAR returns scattered up to 5 m around it
+void load_scene(int32_t poses, int32_t points) {
+	reset_poses();
+	reset_points();
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> turn(-0.1f, 0.1f);
+	std::uniform_real_distribution<float> range(0.5f, 5.0f);
+	std::uniform_real_distribution<float> bearing(-3.14159f, 3.14159f);
+	float x = 0.0f, y = 0.0f, theta = 0.0f;
+	for (int32_t i = 0; i < poses; ++i) {
+		theta += turn(rng);
+		x += 0.05f * std::cos(theta);
+		y += 0.05f * std::sin(theta);
+		set_pose(i, x, y, theta);
+	}
+	for (int32_t i = 0; i < points; ++i) {
+		const float r = range(rng), b = bearing(rng);
+		const int32_t p = poses > 0 ? i % poses : 0;
+		const float px = x * p / (poses > 0 ? poses : 1);
+		const float py = y * p / (poses > 0 ? poses : 1);
+		set_point(i, px + r * std::cos(b), py + r * std::sin(b));
+	}
+}
+
+template <typename F>
+double time_ns(int reps, F&& f) {
+	const auto t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < reps; ++i) f();
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / reps;
+}
+
+} // namespace
+
+TEST_CASE("draw_map", "[map][draw]") {
+	for (int32_t size : {256, 512}) {
+		for (int32_t points : {0, 1000, 5000, kMaxPoints}) {
+			load_scene(kPoses, points);
+			char name[96];
+			std::snprintf(name, sizeof(name), "draw_map %dx%d, %d poses, %d points", size, size, kPoses, points);
+			BENCHMARK(name) {
+				draw_map(kPoses, points, size, size);
+				return get_image_pixel_u32(0);
+			};
+		}
+	}
+}
+
+TEST_CASE("incremental draw", "[map][incremental]") {
+	// steady state of a long run: one new pose and a handful of returns per frame
+	for (int32_t size : {256, 512}) {
+		load_scene(kPoses - 1024, kMaxPoints - 5000);
+		draw_map_incremental(size, size);
+		int32_t nextPose = kPoses - 1024, nextPoint = kMaxPoints - 5000;
+		char name[96];
+		std::snprintf(name, sizeof(name), "draw_map_incremental %dx%d, +1 pose +5 points", size, size);
+		BENCHMARK(name) {
+			if (nextPose == kPoses) {
+				// wrap around without growing the bounds so no repaint is forced
+				nextPose = kPoses - 1024;
+				nextPoint = kMaxPoints - 5000;
+				commit_poses(nextPose);
+				commit_points(nextPoint);
+				invalidate_map();
+				draw_map_incremental(size, size);
+			}
+			const float* prev = get_poses_buffer() + 3 * (nextPose - 1);
+			set_pose(nextPose++, prev[0], prev[1], prev[2]);
+			for (int k = 0; k < 5; ++k) set_point(nextPoint++, prev[0] + 0.1f * k, prev[1]);
+			return draw_map_incremental(size, size);
+		};
+		std::snprintf(name, sizeof(name), "draw_map %dx%d, full history", size, size);
+		BENCHMARK(name) {
+			draw_map(kPoses, kMaxPoints, size, size);
+			return get_image_pixel_u32(0);
+		};
+	}
+}
+
+TEST_CASE("image readout", "[map][readout]") {
+	load_scene(kPoses, kMaxPoints);
+	for (int32_t size : {256, 512}) {
+		draw_map(kPoses, kMaxPoints, size, size);
+		char name[64];
+		std::snprintf(name, sizeof(name), "get_image_pixel_u32 x %d", size * size);
+		BENCHMARK(name) {
+			uint32_t acc = 0;
+			for (int32_t i = 0; i < size * size; ++i) acc += (uint32_t)get_image_pixel_u32(i);
+			return acc;
+		};
+		// host-side copy of the whole buffer through the descriptor
+		std::vector<uint8_t> out((size_t)size * size * 4);
+		std::snprintf(name, sizeof(name), "memcpy readback %dx%d", size, size);
+		BENCHMARK(name) {
+			const ImageDescriptor* d = get_image_descriptor();
+			const uint8_t* src = get_image_buffer();
+			for (int32_t y = d->dirty_y0; y < d->dirty_y1; ++y)
+				std::memcpy(&out[(size_t)y * d->stride + d->dirty_x0 * 4], src + y * d->stride + d->dirty_x0 * 4,
+				            (size_t)(d->dirty_x1 - d->dirty_x0) * 4);
+			return out[0];
+		};
+	}
+}
+
+TEST_CASE("upload", "[map][upload]") {
+	BENCHMARK("set_pose x 4096") {
+		for (int32_t i = 0; i < kPoses; ++i) set_pose(i, (float)i, (float)-i, 0.1f);
+	};
+	BENCHMARK("set_point x 20000") {
+		for (int32_t i = 0; i < kMaxPoints; ++i) set_point(i, (float)i, (float)-i);
+	};
+
+	// what a host does with the bulk API: one copy into linear memory + commit
+	std::vector<float> poses(3 * kPoses), points(2 * kMaxPoints);
+	for (size_t i = 0; i < poses.size(); ++i) poses[i] = (float)i;
+	for (size_t i = 0; i < points.size(); ++i) points[i] = (float)i;
+	BENCHMARK("bulk poses 4096") {
+		std::memcpy(get_poses_buffer(), poses.data(), poses.size() * sizeof(float));
+		return commit_poses(kPoses);
+	};
+	BENCHMARK("bulk points 20000") {
+		std::memcpy(get_points_buffer(), points.data(), points.size() * sizeof(float));
+		return commit_points(kMaxPoints);
+	};
+}
+
+TEST_CASE("per-element cost", "[.][summary]") {
+	std::printf("%-10s %8s %12s %12s\n", "canvas", "points", "draw us", "ns/point");
+	for (int32_t size : {256, 512}) {
+		load_scene(kPoses, 0);
+		const double base = time_ns(50, [&] { draw_map(kPoses, 0, size, size); });
+		for (int32_t points : {1000, 5000, kMaxPoints}) {
+			load_scene(kPoses, points);
+			const double t = time_ns(50, [&] { draw_map(kPoses, points, size, size); });
+			std::printf("%4dx%-5d %8d %12.1f %12.2f\n", size, size, points, t / 1000.0, (t - base) / points);
+		}
+		volatile uint32_t sink = 0;
+		const double readout = time_ns(20, [&] {
+			uint32_t acc = 0;
+			for (int32_t i = 0; i < size * size; ++i) acc += (uint32_t)get_image_pixel_u32(i);
+			sink = sink + acc;
+		});
+		std::printf("%4dx%-5d readout %.2f ns/pixel, clear + 4096 poses %.2f ns/pixel\n", size, size,
+		            readout / (size * size), base / (size * size));
+	}
+}
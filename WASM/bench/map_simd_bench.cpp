@@ -0,0 +1,89 @@
+// map_simd.h kernels against their scalar references: checks that every SIMD
+// path is bit-exact, then times canvas fill, bounds and projection.
+//
+//   bazel run --config=opt //WASM:map_simd_bench
+//   bazel run --config=opt //WASM:map_simd_bench --copt=-mavx2   # pick another path
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "map_simd.h"
+
+namespace {
+
+constexpr int32_t kPoints = 20000;
+
+std::vector<float> random_xy(int32_t n, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> d(-50.0f, 50.0f);
+	std::vector<float> xy(2 * (size_t)n);
+	for (float& v : xy) v = d(rng);
+	return xy;
+}
+
+} // namespace
+
+TEST_CASE("simd kernels match scalar", "[map][simd]") {
+	std::printf("map_simd path: %s\n", MAP_SIMD_NAME);
+	// odd sizes exercise the scalar tails
+	for (int32_t n : {0, 1, 3, 7, 8, 9, 255, 1001, kPoints}) {
+		const std::vector<float> xy = random_xy(n, 11 + n);
+
+		float a[4] = {1e9f, 1e9f, -1e9f, -1e9f}, b[4] = {1e9f, 1e9f, -1e9f, -1e9f};
+		scalar_bounds_xy(xy.data(), n, &a[0], &a[1], &a[2], &a[3]);
+		simd_bounds_xy(xy.data(), n, &b[0], &b[1], &b[2], &b[3]);
+		REQUIRE(std::memcmp(a, b, sizeof(a)) == 0);
+
+		for (int32_t size : {1, 256, 512}) {
+			std::vector<int32_t> ax(n), ay(n), bx(n), by(n);
+			scalar_project_xy(xy.data(), n, 1.5f, -2.25f, 3.7f, size, size, ax.data(), ay.data());
+			simd_project_xy(xy.data(), n, 1.5f, -2.25f, 3.7f, size, size, bx.data(), by.data());
+			REQUIRE(ax == bx);
+			REQUIRE(ay == by);
+		}
+
+		std::vector<uint32_t> fa(n + 5, 1u), fb(n + 5, 1u);
+		scalar_fill_u32(fa.data() + 1, n + 3, 0xFF000000u);
+		simd_fill_u32(fb.data() + 1, n + 3, 0xFF000000u);
+		REQUIRE(fa == fb);
+	}
+}
+
+TEST_CASE("simd kernel throughput", "[map][simd]") {
+	const std::vector<float> xy = random_xy(kPoints, 5);
+	std::vector<int32_t> ix(kPoints), iy(kPoints);
+	std::vector<uint32_t> canvas(512 * 512);
+
+	BENCHMARK("scalar fill 512x512") {
+		scalar_fill_u32(canvas.data(), 512 * 512, 0xFF000000u);
+		return canvas[0];
+	};
+	BENCHMARK("simd fill 512x512") {
+		simd_fill_u32(canvas.data(), 512 * 512, 0xFF000000u);
+		return canvas[0];
+	};
+
+	BENCHMARK("scalar bounds x 20000") {
+		float b[4] = {1e9f, 1e9f, -1e9f, -1e9f};
+		scalar_bounds_xy(xy.data(), kPoints, &b[0], &b[1], &b[2], &b[3]);
+		return b[0] + b[3];
+	};
+	BENCHMARK("simd bounds x 20000") {
+		float b[4] = {1e9f, 1e9f, -1e9f, -1e9f};
+		simd_bounds_xy(xy.data(), kPoints, &b[0], &b[1], &b[2], &b[3]);
+		return b[0] + b[3];
+	};
+
+	BENCHMARK("scalar project x 20000") {
+		scalar_project_xy(xy.data(), kPoints, 0.0f, 0.0f, 5.0f, 512, 512, ix.data(), iy.data());
+		return ix[0] + iy[0];
+	};
+	BENCHMARK("simd project x 20000") {
+		simd_project_xy(xy.data(), kPoints, 0.0f, 0.0f, 5.0f, 512, 512, ix.data(), iy.data());
+		return ix[0] + iy[0];
+	};
+}
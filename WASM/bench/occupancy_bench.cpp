@@ -0,0 +1,148 @@
+// Cost of integrating LiDAR returns into the occupancy grid: one full
+// 256x192 depth frame (49152 returns, uploaded in points-buffer sized chunks)
+// seen from inside a 10 m x 6 m room, rendering, and tile memory while
+// exploring a long diagonal corridor.
+//
+//   bazel run --config=opt //WASM:occupancy_bench
+//   bazel run --config=opt //WASM:occupancy_bench -- "[summary]"   # ms/frame only
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "map.h"
+
+namespace {
+
+constexpr int32_t kDepthW = 256;
+constexpr int32_t kDepthH = 192;
+constexpr float kHalfX = 5.0f, kHalfY = 3.0f; // room half extents
+
+// distance from (x,y) along bearing b to the room walls
+float wall_range(float x, float y, float b) {
+	const float c = std::cos(b), s = std::sin(b);
+	float t = 1e9f;
+	if (c > 0.0f) t = std::fmin(t, (kHalfX - x) / c);
+	if (c < 0.0f) t = std::fmin(t, (-kHalfX - x) / c);
+	if (s > 0.0f) t = std::fmin(t, (kHalfY - y) / s);
+	if (s < 0.0f) t = std::fmin(t, (-kHalfY - y) / s);
+	return t;
+}
+
+// one depth frame flattened to the floor plane: every image column is a
+// bearing across a 60 degree field of view, every row a noisy return on it
+std::vector<float> depth_frame(float x, float y, float heading, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::normal_distribution<float> noise(0.0f, 0.01f);
+	std::vector<float> xy(2 * (size_t)kDepthW * kDepthH);
+	for (int32_t u = 0; u < kDepthW; ++u) {
+		const float b = heading + (((float)u + 0.5f) / kDepthW - 0.5f) * 1.047f;
+		const float r = wall_range(x, y, b);
+		for (int32_t v = 0; v < kDepthH; ++v) {
+			const float rr = r + noise(rng);
+			float* p = &xy[2 * ((size_t)v * kDepthW + u)];
+			p[0] = x + rr * std::cos(b);
+			p[1] = y + rr * std::sin(b);
+		}
+	}
+	return xy;
+}
+
+// uploads a frame through the bulk buffer and integrates it from pose 0
+int32_t integrate_frame(const std::vector<float>& xy) {
+	const int32_t total = (int32_t)(xy.size() / 2);
+	const int32_t chunk = get_points_capacity();
+	int32_t done = 0;
+	for (int32_t i = 0; i < total; i += chunk) {
+		const int32_t n = total - i < chunk ? total - i : chunk;
+		std::memcpy(get_points_buffer(), &xy[2 * (size_t)i], (size_t)n * 2 * sizeof(float));
+		commit_points(n);
+		done += integrate_points(0, 0, n);
+	}
+	return done;
+}
+
+void setup(float resolution) {
+	reset_poses();
+	reset_points();
+	set_pose(0, -1.0f, 0.5f, 0.3f);
+	occupancy_configure(resolution);
+}
+
+} // namespace
+
+TEST_CASE("integrate depth frame", "[occupancy]") {
+	const std::vector<float> frame = depth_frame(-1.0f, 0.5f, 0.3f, 3);
+	for (float res : {0.1f, 0.05f, 0.025f}) {
+		setup(res);
+		REQUIRE(integrate_frame(frame) == kDepthW * kDepthH);
+		// the wall ahead is occupied, the space in between is free
+		const float wallY = 0.5f + 6.0f * std::tan(0.3f);
+		REQUIRE(std::max(get_occupancy_at(kHalfX - 0.5f * res, wallY), get_occupancy_at(kHalfX + 0.5f * res, wallY)) > 0);
+		REQUIRE(get_occupancy_at(1.0f, 0.5f + 2.0f * std::tan(0.3f)) < 0);
+		char name[64];
+		std::snprintf(name, sizeof(name), "256x192 frame at %.3f m", res);
+		BENCHMARK(name) { return integrate_frame(frame); };
+	}
+	setup(0.05f);
+	integrate_frame(frame);
+	BENCHMARK("draw_occupancy 512x512") {
+		draw_occupancy(512, 512);
+		return get_image_pixel_u32(0);
+	};
+	BENCHMARK("draw_occupancy_view 512x512 at 2 cm/px") {
+		draw_occupancy_view(-1.0f, 0.5f, 0.02f, 512, 512);
+		return get_image_pixel_u32(0);
+	};
+}
+
+// walls 1 m either side of the line y = x, scanned every 0.5 m along it
+void explore_corridor(float length) {
+	std::vector<float> xy;
+	for (float s = 0.0f; s < length; s += 0.5f) {
+		const float x = s * 0.7071f, y = s * 0.7071f;
+		xy.clear();
+		for (int32_t k = 0; k < 720; ++k) {
+			const float along = ((float)k / 360.0f - 1.0f) * 4.0f; // +-4 m
+			const float side = k % 2 ? 1.0f : -1.0f;
+			xy.push_back(x + along * 0.7071f - side * 0.7071f);
+			xy.push_back(y + along * 0.7071f + side * 0.7071f);
+		}
+		set_pose(0, x, y, 0.785f);
+		std::memcpy(get_points_buffer(), xy.data(), xy.size() * sizeof(float));
+		commit_points((int32_t)(xy.size() / 2));
+		integrate_points(0, 0, get_point_count());
+	}
+}
+
+TEST_CASE("memory follows explored area", "[occupancy]") {
+	setup(0.05f);
+	explore_corridor(100.0f);
+	// the corridor's bounding box is ~72 m square; dense int16 cells would need
+	const double dense = (72.0 / 0.05) * (72.0 / 0.05) * 2;
+	REQUIRE(get_occupancy_memory() < dense / 4);
+	REQUIRE(get_occupancy_at(35.0f, 35.0f) < 0);
+	std::printf("100 m corridor: %d tiles, %.1f MiB (dense bounding box %.1f MiB)\n", get_occupancy_tile_count(),
+	            get_occupancy_memory() / 1048576.0, dense / 1048576.0);
+}
+
+TEST_CASE("per-frame cost", "[.][summary]") {
+	std::printf("%-10s %10s %12s\n", "cell m", "ms/frame", "ns/return");
+	for (float res : {0.1f, 0.05f, 0.025f}) {
+		setup(res);
+		// a short sweep so rays do not all retrace identical cells
+		std::vector<std::vector<float>> frames;
+		for (int i = 0; i < 8; ++i) frames.push_back(depth_frame(-1.0f, 0.5f, 0.3f + 0.4f * i, 10 + i));
+		const auto t0 = std::chrono::steady_clock::now();
+		for (int rep = 0; rep < 4; ++rep)
+			for (const auto& f : frames) integrate_frame(f);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / 32;
+		std::printf("%-10.3f %10.2f %12.1f\n", res, ms, ms * 1e6 / (kDepthW * kDepthH));
+	}
+}
@@ -0,0 +1,322 @@
+// PoseGraph on Manhattan-style graphs: a robot walking a grid of 1 m
+// streets with noisy odometry, loop closures wherever it revisits a
+// corner. Checks the sparse block Cholesky against a dense solve, exact
+// recovery without noise, robust kernels against wrong loop closures,
+// incremental against batch optimization and the background worker, and
+// times re-optimizing 5000 nodes with 500 loop closures.
+//
+//   bazel run --config=opt //WASM:pose_graph_bench
+//   bazel run --config=opt //WASM:pose_graph_bench -- "[summary]"   # error, fill and time per graph size
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "pose_graph.h"
+#include "pose_graph_worker.h"
+
+namespace {
+
+struct Dataset {
+  std::vector<Pose2> truth, initial; // initial: odometry chained from node 0
+  std::vector<PoseGraphEdge> odometry, loops;
+};
+
+PoseGraphEdge make_edge(int from, int to, const Pose2 &z, double sigma_xy, double sigma_theta) {
+  PoseGraphEdge e;
+  e.from = from;
+  e.to = to;
+  e.measurement = z;
+  e.information[0] = e.information[4] = static_cast<float>(1.0 / (sigma_xy * sigma_xy));
+  e.information[8] = static_cast<float>(1.0 / (sigma_theta * sigma_theta));
+  return e;
+}
+
+// measurements have 2 cm and 0.3 degree standard deviations, times noise
+Dataset manhattan(int nodes, int loops, unsigned seed, double noise = 1.0) {
+  const double sigma_xy = 0.02, sigma_theta = 0.005;
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  std::normal_distribution<double> nxy(0.0, sigma_xy * noise), nth(0.0, sigma_theta * noise);
+  auto noisy = [&](const Pose2 &p) {
+    return Pose2{static_cast<float>(p.x + nxy(rng)), static_cast<float>(p.y + nxy(rng)),
+                 wrap_angle(static_cast<float>(p.theta + nth(rng)))};
+  };
+  const int half = 12; // streets span [-12, 12]
+  Dataset d;
+  int x = 0, y = 0, heading = 0; // quarter turns
+  const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+  std::map<std::pair<int, int>, std::vector<int>> visits;
+  std::vector<std::pair<int, int>> candidates;
+  for (int i = 0; i < nodes; ++i) {
+    if (i > 0) {
+      const double r = u(rng);
+      if (r < 0.15) heading = (heading + 1) % 4;
+      else if (r < 0.3) heading = (heading + 3) % 4;
+      if (std::abs(x + dx[heading]) > half || std::abs(y + dy[heading]) > half) heading = (heading + 2) % 4;
+      x += dx[heading];
+      y += dy[heading];
+    }
+    d.truth.push_back(Pose2{static_cast<float>(x), static_cast<float>(y), wrap_angle(1.5707963f * heading)});
+    std::vector<int> &seen = visits[std::make_pair(x, y)];
+    for (int j : seen)
+      if (i - j > 20) candidates.push_back(std::make_pair(j, i));
+    seen.push_back(i);
+    if (i > 0) d.odometry.push_back(make_edge(i - 1, i, noisy(between(d.truth[i - 1], d.truth[i])), sigma_xy, sigma_theta));
+  }
+  std::shuffle(candidates.begin(), candidates.end(), rng);
+  if (static_cast<int>(candidates.size()) > loops) candidates.resize(loops);
+  std::sort(candidates.begin(), candidates.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+    return a.second < b.second;
+  });
+  for (const auto &c : candidates)
+    d.loops.push_back(make_edge(c.first, c.second, noisy(between(d.truth[c.first], d.truth[c.second])), sigma_xy, sigma_theta));
+  d.initial.push_back(d.truth[0]);
+  for (const PoseGraphEdge &e : d.odometry) d.initial.push_back(compose(d.initial.back(), e.measurement));
+  return d;
+}
+
+void build(PoseGraph &g, const Dataset &d) {
+  for (const Pose2 &p : d.initial) g.add_node(p);
+  for (const PoseGraphEdge &e : d.odometry) g.add_edge(e);
+  for (const PoseGraphEdge &e : d.loops) g.add_edge(e);
+}
+
+double rms_error(const std::vector<Pose2> &truth, const PoseGraph &g) {
+  double s = 0.0;
+  for (int i = 0; i < g.node_count(); ++i) {
+    const Pose2 p = g.pose(i);
+    s += (p.x - truth[i].x) * (p.x - truth[i].x) + (p.y - truth[i].y) * (p.y - truth[i].y);
+  }
+  return std::sqrt(s / g.node_count());
+}
+
+double max_difference(const PoseGraph &a, const PoseGraph &b) {
+  double m = 0.0;
+  for (int i = 0; i < a.node_count(); ++i) {
+    const Pose2 p = a.pose(i), q = b.pose(i);
+    m = std::max({m, static_cast<double>(std::fabs(p.x - q.x)), static_cast<double>(std::fabs(p.y - q.y)),
+                  static_cast<double>(std::fabs(wrap_angle(p.theta - q.theta)))});
+  }
+  return m;
+}
+
+} // namespace
+
+TEST_CASE("sparse block Cholesky matches a dense solve", "[pose_graph]") {
+  // a ring of 12 blocks with chords, diagonally dominant
+  const int n = 12;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  std::vector<std::pair<int, int>> nz;
+  for (int i = 0; i < n; ++i) nz.push_back(std::make_pair(i, (i + 1) % n));
+  nz.push_back(std::make_pair(0, 6));
+  nz.push_back(std::make_pair(9, 3));
+  nz.push_back(std::make_pair(2, 2)); // diagonal entries are ignored
+  SparseBlockCholesky<3> solver;
+  solver.analyze(n, nz);
+  Matrix<3 * n, 3 * n> dense = Matrix<3 * n, 3 * n>::zero();
+  for (const auto &e : nz) {
+    if (e.first == e.second) continue;
+    Matrix<3, 3> b;
+    for (double &v : b.m) v = u(rng);
+    solver.add(e.first, e.second, b);
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 3; ++c) {
+        dense(3 * e.first + r, 3 * e.second + c) += b(r, c);
+        dense(3 * e.second + c, 3 * e.first + r) += b(r, c);
+      }
+  }
+  for (int i = 0; i < n; ++i) {
+    Matrix<3, 3> b = Matrix<3, 3>::identity() * 12.0;
+    b(0, 1) = b(1, 0) = 0.5;
+    solver.add(i, i, b);
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 3; ++c) dense(3 * i + r, 3 * i + c) += b(r, c);
+  }
+  Vector<3 * n> rhs;
+  for (double &v : rhs.m) v = u(rng);
+  Matrix<3 * n, 3 * n> inv;
+  REQUIRE(invert_spd(dense, inv));
+  const Vector<3 * n> expected = inv * rhs;
+  REQUIRE(solver.factor());
+  std::vector<double> x(3 * n);
+  solver.solve(rhs.m, x.data());
+  for (int i = 0; i < 3 * n; ++i) REQUIRE(std::fabs(x[i] - expected[i]) < 1e-12);
+  // in place, too
+  std::vector<double> y(rhs.m, rhs.m + 3 * n);
+  solver.solve(y.data(), y.data());
+  for (int i = 0; i < 3 * n; ++i) REQUIRE(y[i] == x[i]);
+}
+
+TEST_CASE("noise-free graph is recovered exactly", "[pose_graph]") {
+  Dataset d = manhattan(300, 40, 1, 0.0);
+  PoseGraph g;
+  build(g, d);
+  // start well off the truth
+  std::mt19937 rng(2);
+  std::normal_distribution<double> n(0.0, 0.2);
+  for (int i = 1; i < g.node_count(); ++i) {
+    const Pose2 p = d.truth[i];
+    g.set_pose(i, Pose2{static_cast<float>(p.x + n(rng)), static_cast<float>(p.y + n(rng)),
+                        static_cast<float>(p.theta + 0.3 * n(rng))});
+  }
+  const PoseGraphResult r = g.optimize();
+  REQUIRE(r.converged);
+  REQUIRE(r.final_cost < 1e-6 * r.initial_cost);
+  REQUIRE(rms_error(d.truth, g) < 1e-4);
+}
+
+TEST_CASE("robust kernels reject wrong loop closures", "[pose_graph]") {
+  Dataset d = manhattan(1000, 100, 4);
+  // 20 closures between places 3 m or more apart, claiming they coincide
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> pick(0, 999);
+  std::vector<PoseGraphEdge> wrong;
+  while (wrong.size() < 20) {
+    const int a = pick(rng), b = pick(rng);
+    const Pose2 rel = between(d.truth[a], d.truth[b]);
+    if (std::hypot(rel.x, rel.y) < 3.0f) continue;
+    wrong.push_back(make_edge(std::min(a, b), std::max(a, b), Pose2{0, 0, 0}, 0.02, 0.005));
+  }
+  auto solve = [&](RobustKernel kernel, bool with_wrong) {
+    PoseGraph g;
+    Dataset dd = d;
+    if (with_wrong) dd.loops.insert(dd.loops.end(), wrong.begin(), wrong.end());
+    for (PoseGraphEdge &e : dd.loops) {
+      e.kernel = kernel;
+      e.kernel_width = 3.0f;
+    }
+    build(g, dd);
+    g.optimize();
+    return rms_error(d.truth, g);
+  };
+  const double clean = solve(RobustKernel::kNone, false);
+  REQUIRE(solve(RobustKernel::kNone, true) > 3.0 * clean);
+  // Cauchy all but ignores them; Huber only bounds their pull
+  REQUIRE(solve(RobustKernel::kCauchy, true) < 1.5 * clean);
+  REQUIRE(solve(RobustKernel::kHuber, true) < solve(RobustKernel::kNone, true));
+  // and costs nothing when every closure is right
+  REQUIRE(solve(RobustKernel::kCauchy, false) < 1.1 * clean);
+}
+
+TEST_CASE("incremental optimization agrees with batch", "[pose_graph]") {
+  const Dataset d = manhattan(1500, 150, 6);
+  PoseGraph batch, inc;
+  build(batch, d);
+  batch.optimize();
+
+  // the graph grows 100 nodes at a time with the closures among them
+  size_t next_loop = 0;
+  int steps = 0, relinearized = 0;
+  for (int n = 0; n < 1500; n += 100) {
+    for (int i = n; i < n + 100; ++i) {
+      inc.add_node(i == 0 ? d.truth[0] : compose(inc.pose(i - 1), d.odometry[i - 1].measurement));
+      if (i > 0) inc.add_edge(d.odometry[i - 1]);
+    }
+    for (; next_loop < d.loops.size() && d.loops[next_loop].to < n + 100; ++next_loop) inc.add_edge(d.loops[next_loop]);
+    for (int k = 0; k < 20; ++k) {
+      const PoseGraphResult r = inc.optimize_incremental();
+      if (r.iterations == 0) break;
+      ++steps;
+      relinearized += r.relinearized;
+    }
+  }
+  REQUIRE(max_difference(batch, inc) < 0.01);
+  // most steps touch a fraction of the nodes
+  REQUIRE(relinearized < steps * 1500 / 2);
+  // nothing moved since: nothing to do
+  REQUIRE(inc.optimize_incremental().iterations == 0);
+}
+
+TEST_CASE("background worker serves a growing graph", "[pose_graph]") {
+  const Dataset d = manhattan(1000, 100, 7);
+  PoseGraph batch;
+  build(batch, d);
+  batch.optimize();
+
+  PoseGraphWorker worker;
+  REQUIRE(worker.version() == 0);
+  std::vector<Pose2> poses;
+  size_t next_loop = 0;
+  for (int i = 0; i < 1000; ++i) {
+    // the front-end's own drifting poses
+    REQUIRE(worker.add_node(d.initial[i]) == i);
+    if (i > 0) worker.add_edge(d.odometry[i - 1]);
+    for (; next_loop < d.loops.size() && d.loops[next_loop].to <= i; ++next_loop) worker.add_edge(d.loops[next_loop]);
+    if (i % 50 == 49) worker.request_optimize();
+    // never waits: whatever has been published so far
+    worker.poses(poses);
+    REQUIRE(poses.size() <= static_cast<size_t>(i + 1));
+  }
+  worker.request_optimize();
+  worker.wait_idle();
+  const uint64_t version = worker.poses(poses);
+  REQUIRE(version >= 1);
+  REQUIRE(poses.size() == 1000);
+  double m = 0.0;
+  for (int i = 0; i < 1000; ++i) {
+    const Pose2 q = batch.pose(i);
+    m = std::max({m, static_cast<double>(std::fabs(poses[i].x - q.x)), static_cast<double>(std::fabs(poses[i].y - q.y))});
+  }
+  REQUIRE(m < 0.01);
+}
+
+TEST_CASE("re-optimizing 5000 nodes with 500 loop closures", "[pose_graph]") {
+  const Dataset d = manhattan(5000, 500, 8);
+  PoseGraph g;
+  build(g, d);
+  const PoseGraphResult first = g.optimize();
+  REQUIRE(first.converged);
+  REQUIRE(rms_error(d.truth, g) < 0.1);
+
+  BENCHMARK_ADVANCED("from odometry")(Catch::Benchmark::Chronometer meter) {
+    meter.measure([&] {
+      for (int i = 0; i < g.node_count(); ++i) g.set_pose(i, d.initial[i]);
+      return g.optimize().iterations;
+    });
+  };
+  // a new closure on an optimized graph, the usual case: incremental steps
+  // until nothing moves, the new ordering included
+  const PoseGraphEdge extra = d.loops.back();
+  BENCHMARK_ADVANCED("after one more loop closure, incremental")(Catch::Benchmark::Chronometer meter) {
+    g.optimize();
+    meter.measure([&] {
+      g.add_edge(extra);
+      int steps = 0;
+      while (steps < 20 && g.optimize_incremental().iterations > 0) ++steps;
+      return steps;
+    });
+  };
+}
+
+TEST_CASE("error, fill and time per graph size", "[.][summary]") {
+  std::printf("%7s %7s %11s %11s %11s %7s %10s %10s\n", "nodes", "loops", "odom rms m", "opt rms m", "L blocks", "iters",
+              "batch ms", "incr ms");
+  for (int nodes : {500, 1000, 2000, 5000, 10000}) {
+    const Dataset d = manhattan(nodes, nodes / 10, 8);
+    PoseGraph g;
+    build(g, d);
+    const double before = rms_error(d.truth, g);
+    auto t0 = std::chrono::steady_clock::now();
+    const PoseGraphResult r = g.optimize();
+    auto t1 = std::chrono::steady_clock::now();
+    const double after = rms_error(d.truth, g);
+    // one more closure, served incrementally
+    g.add_edge(d.loops.front());
+    auto t2 = std::chrono::steady_clock::now();
+    for (int k = 0; k < 20 && g.optimize_incremental().iterations > 0; ++k) {
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    std::printf("%7d %7d %11.3f %11.4f %11d %7d %10.1f %10.1f\n", nodes, static_cast<int>(d.loops.size()), before, after,
+                g.factor_blocks(), r.iterations, std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                std::chrono::duration<double, std::milli>(t3 - t2).count());
+  }
+}
@@ -0,0 +1,288 @@
+// ScanMatcher on a synthetic corridor run: 40 m of 2 m wide corridor with door
+// recesses, a 67 degree 256-beam slice at 10 Hz and drifting odometry. The run
+// is generated once and replayed like a recording: each frame is matched
+// against the map built from the previous estimates, then integrated.
+// "[replay]" runs the same loop over a real recording (slam_main <seconds>
+// <path>) read through RecordingReader; it has no ground truth, so it only
+// reports throughput and how many frames matched.
+//
+//   bazel run --config=opt //WASM:scan_matcher_bench
+//   bazel run --config=opt //WASM:scan_matcher_bench -- "[summary]"   # matches/s and accuracy per resolution
+//   ROAMR_REPLAY=$PWD/run.rec bazel run --config=opt //WASM:scan_matcher_bench -- "[replay]"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench/scan_scene.h"
+#include "native/recording_reader.h"
+#include "scan_matcher.h"
+
+namespace {
+
+// corridor along +x, walls at y = +-1 with a 0.9 m wide, 0.3 m deep door
+// recess every 1.5 m, alternating sides, closed at both ends
+std::vector<Segment> corridor(bool recesses = true) {
+  std::vector<Segment> w;
+  const float length = 40.0f;
+  float top = 0.0f, bottom = 0.0f; // where each wall's current straight run starts
+  for (int i = 0; recesses && i * 1.5f + 2.0f < length - 2.0f; ++i) {
+    const float d0 = 2.0f + i * 1.5f, d1 = d0 + 0.9f;
+    const float side = i % 2 ? -1.0f : 1.0f;
+    float &start = i % 2 ? bottom : top;
+    w.push_back({start, side, d0, side});
+    w.push_back({d0, side, d0, side * 1.3f});
+    w.push_back({d0, side * 1.3f, d1, side * 1.3f});
+    w.push_back({d1, side * 1.3f, d1, side});
+    start = d1;
+  }
+  w.push_back({top, 1.0f, length, 1.0f});
+  w.push_back({bottom, -1.0f, length, -1.0f});
+  w.push_back({0.0f, -1.0f, 0.0f, 1.0f});
+  w.push_back({length, -1.0f, length, 1.0f});
+  return w;
+}
+
+// 256 beams over the LiDAR's 67 degree horizontal field of view, 5 m
+constexpr Lidar2D kLidar = {256, 1.17f, 5.0f};
+
+// weaving down the corridor at 0.5 m/s, with a 0.3 deg/s heading bias on
+// the odometry
+std::vector<Frame> corridor_run(bool recesses = true) {
+  std::vector<Pose2> path;
+  for (float s = 1.0f; s < 34.0f; s += 0.05f)
+    path.push_back(Pose2{s, 0.35f * std::sin(s / 2.5f), std::atan(0.14f * std::cos(s / 2.5f)) + 0.15f * std::sin(s / 1.3f)});
+  return drive(corridor(recesses), path, kLidar, 0.0005f, 17);
+}
+
+struct RunStats {
+  double mean_error = 0, max_error = 0, mean_heading_error = 0, odometry_final_error = 0;
+  double match_us = 0, set_map_us = 0; // per frame
+  int failed = 0;
+  std::vector<Pose2> estimates;
+};
+
+// Replays frames through map -> match -> integrate. The grid is owned by the
+// caller so a benchmark can keep matching against the finished map.
+RunStats replay(const std::vector<Frame> &frames, OccupancyGrid &grid, ScanMatcher &matcher) {
+  ScanIntegrator integrator;
+  auto integrate = [&](const Scan2D &scan, const Pose2 &p) { integrator(grid, scan, p); };
+
+  RunStats st;
+  using clock = std::chrono::steady_clock;
+  // the robot starts out standing still for a few frames, which gives the
+  // matcher walls that are sure enough to count as obstacles
+  Pose2 est = frames[0].truth;
+  for (int i = 0; i < 3; ++i) integrate(frames[0].scan, est);
+  st.estimates.push_back(est);
+  for (size_t i = 1; i < frames.size(); ++i) {
+    const Frame &f = frames[i];
+    const Pose2 prior = odometry_prior(est, frames, i);
+    const auto t0 = clock::now();
+    matcher.set_map(grid, prior.x, prior.y, kLidar.max_range + 0.5f);
+    const auto t1 = clock::now();
+    const ScanMatchResult r = matcher.match(f.scan, prior);
+    const auto t2 = clock::now();
+    st.set_map_us += std::chrono::duration<double, std::micro>(t1 - t0).count();
+    st.match_us += std::chrono::duration<double, std::micro>(t2 - t1).count();
+    if (!r.ok) ++st.failed;
+    est = r.pose;
+    integrate(f.scan, est);
+    st.estimates.push_back(est);
+
+    const double e = std::hypot(est.x - f.truth.x, est.y - f.truth.y);
+    st.mean_error += e;
+    st.max_error = std::max(st.max_error, e);
+    st.mean_heading_error += std::fabs(wrap_angle(est.theta - f.truth.theta));
+  }
+  const double n = static_cast<double>(frames.size() - 1);
+  st.mean_error /= n;
+  st.mean_heading_error /= n;
+  st.match_us /= n;
+  st.set_map_us /= n;
+  st.odometry_final_error = std::hypot(frames.back().odometry.x - frames.back().truth.x,
+                                       frames.back().odometry.y - frames.back().truth.y);
+  return st;
+}
+
+} // namespace
+
+TEST_CASE("branch and bound matches exhaustive search", "[scan_matcher]") {
+  const std::vector<Frame> frames = corridor_run();
+  auto grid = new_grid(0.05f);
+  ScanMatcher mapper;
+  replay(frames, *grid, mapper);
+
+  // levels = 1 scores every candidate at full resolution
+  ScanMatchParams p;
+  p.icp_iterations = 0;
+  ScanMatchParams flat = p;
+  flat.levels = 1;
+  ScanMatcher bnb(p), exhaustive(flat);
+  for (size_t i = 40; i < frames.size(); i += 97) {
+    const Frame &f = frames[i];
+    const Pose2 prior = compose(f.truth, Pose2{0.12f, -0.08f, 0.05f});
+    bnb.set_map(*grid, prior.x, prior.y, kLidar.max_range + 0.5f);
+    exhaustive.set_map(*grid, prior.x, prior.y, kLidar.max_range + 0.5f);
+    const ScanMatchResult a = bnb.match(f.scan, prior), b = exhaustive.match(f.scan, prior);
+    REQUIRE(a.ok);
+    REQUIRE(b.ok);
+    REQUIRE(a.score == b.score);
+  }
+}
+
+TEST_CASE("corridor replay", "[scan_matcher]") {
+  const std::vector<Frame> frames = corridor_run();
+  REQUIRE(frames.size() > 600);
+  auto grid = new_grid(0.05f);
+  ScanMatcher matcher;
+  const RunStats st = replay(frames, *grid, matcher);
+  REQUIRE(st.failed == 0);
+  // at 5 cm cells a heading error below about one cell over the 5 m view
+  // cannot be seen on straight walls, so some of it is locked into the map
+  // and shows up as position error further down the corridor
+  REQUIRE(st.mean_error < 0.15);
+  REQUIRE(st.max_error < 0.25);
+  REQUIRE(st.mean_heading_error < 0.01);
+  REQUIRE(st.odometry_final_error > 1.0); // dead reckoning alone is far off by the end
+
+  // relocalize mid-corridor in the finished map from a poor prior
+  const size_t mid = frames.size() / 2;
+  const Frame &f = frames[mid];
+  const Pose2 prior = compose(st.estimates[mid], Pose2{0.15f, 0.1f, -0.08f});
+  matcher.set_map(*grid, prior.x, prior.y, kLidar.max_range + 0.5f);
+  const ScanMatchResult r = matcher.match(f.scan, prior);
+  REQUIRE(r.ok);
+  REQUIRE(std::hypot(r.pose.x - st.estimates[mid].x, r.pose.y - st.estimates[mid].y) < 0.05);
+
+  BENCHMARK("set_map, 11 m window at 5 cm") {
+    matcher.set_map(*grid, prior.x, prior.y, kLidar.max_range + 0.5f);
+    return 0;
+  };
+  char name[64];
+  std::snprintf(name, sizeof(name), "match, %d points, +-0.3 m / +-0.2 rad", f.scan.size);
+  BENCHMARK(name) { return matcher.match(f.scan, prior); };
+}
+
+TEST_CASE("covariance along a featureless corridor", "[scan_matcher]") {
+  // plain walls, mapped from the true poses: nothing fixes x
+  const std::vector<Frame> frames = corridor_run(false);
+  auto grid = new_grid(0.05f);
+  ScanIntegrator integrate;
+  for (size_t i = 0; i < 100; ++i) integrate(*grid, frames[i].scan, frames[i].truth);
+  ScanMatcher matcher;
+  const Frame &f = frames[60];
+  matcher.set_map(*grid, f.truth.x, f.truth.y, kLidar.max_range + 0.5f);
+  const ScanMatchResult r = matcher.match(f.scan, f.truth);
+  REQUIRE(r.ok);
+  REQUIRE(std::fabs(r.pose.y - f.truth.y) < 0.05);
+  // about 1 with the recesses; the cell staircase of the curved walls keeps
+  // the distance field from being flat along x
+  REQUIRE(r.covariance[0] > 2.5f * r.covariance[4]);
+}
+
+TEST_CASE("slice", "[scan_matcher]") {
+  PointCloud cloud;
+  cloud.reserve(4);
+  const float z[4] = {-0.4f, 0.02f, 0.3f, -0.05f};
+  for (int i = 0; i < 4; ++i) {
+    cloud.x[i] = static_cast<float>(i);
+    cloud.y[i] = 0.0f;
+    cloud.z[i] = z[i];
+  }
+  cloud.size = 4;
+  Scan2D scan;
+  REQUIRE(slice_scan(cloud, -0.1f, 0.1f, scan) == 2);
+  REQUIRE(scan.x[0] == 1.0f);
+  REQUIRE(scan.x[1] == 3.0f);
+}
+
+TEST_CASE("replay throughput and accuracy", "[.][summary]") {
+  const std::vector<Frame> frames = corridor_run();
+  std::printf("%6s %10s %10s %10s %10s %10s %10s %12s\n", "res m", "match us", "matches/s", "set_map us",
+              "mean cm", "max cm", "yaw deg", "odom end m");
+  for (float res : {0.1f, 0.05f, 0.025f}) {
+    auto grid = new_grid(res);
+    ScanMatcher matcher;
+    const RunStats st = replay(frames, *grid, matcher);
+    std::printf("%6.3f %10.1f %10.0f %10.1f %10.2f %10.2f %10.3f %12.2f\n", res, st.match_us, 1e6 / st.match_us,
+                st.set_map_us, 100.0 * st.mean_error, 100.0 * st.max_error, st.mean_heading_error * 57.29578,
+                st.odometry_final_error);
+  }
+}
+
+TEST_CASE("recorded replay", "[.][replay]") {
+  const char *path = std::getenv("ROAMR_REPLAY");
+  if (!path) {
+    std::printf("set ROAMR_REPLAY to a recording made with slam_main <seconds> <path>\n");
+    return;
+  }
+  RecordingReader recording;
+  REQUIRE(recording.open(path));
+  const std::vector<RecordedFrame> &frames = recording.frames();
+  REQUIRE(!frames.empty());
+
+  // recordings carry no intrinsics: ARKit's typical 1920x1440 camera
+  // intrinsics rescaled to the depth map. The camera looks along the robot's
+  // +x, level, so the slice is a band around sensor height.
+  const RecordingFrame &first = *frames[0].header;
+  const CameraIntrinsics k =
+      CameraIntrinsics{1445.0f, 1445.0f, 960.0f, 720.0f}.scaled(1920, 1440, first.depth_width, first.depth_height);
+  DepthProjectionParams dp;
+  dp.max_depth = kLidar.max_range;
+  DepthProjector projector(k, dp);
+  const CameraPose camera_to_robot = {{0, 0, 1, -1, 0, 0, 0, -1, 0}, {0, 0, 0}};
+  PointCloud cloud;
+  cloud.reserve(projector.max_points(first.depth_width, first.depth_height));
+  Scan2D scan;
+  scan.reserve(cloud.capacity());
+  auto slice = [&](const RecordedFrame &f) {
+    projector.project(f.depth_map, f.header->depth_width, f.header->depth_height, camera_to_robot, cloud);
+    slice_scan(cloud, -0.05f, 0.05f, scan);
+  };
+
+  auto grid = new_grid(0.05f);
+  ScanMatcher matcher;
+  ScanIntegrator integrate;
+  Pose2 est{0.0f, 0.0f, 0.0f}, previous = est;
+  slice(frames[0]);
+  for (int i = 0; i < 3; ++i) integrate(*grid, scan, est);
+
+  using clock = std::chrono::steady_clock;
+  double match_us = 0.0, score = 0.0, path_m = 0.0;
+  int matched = 0, empty = 0;
+  for (size_t i = 1; i < frames.size(); ++i) {
+    slice(frames[i]);
+    if (scan.size == 0) {
+      ++empty;
+      continue;
+    }
+    // constant velocity in place of odometry
+    const Pose2 prior = compose(est, between(previous, est));
+    const auto t0 = clock::now();
+    matcher.set_map(*grid, prior.x, prior.y, kLidar.max_range + 0.5f);
+    const ScanMatchResult r = matcher.match(scan, prior);
+    match_us += std::chrono::duration<double, std::micro>(clock::now() - t0).count();
+    previous = est;
+    if (r.ok) {
+      ++matched;
+      score += r.score;
+      est = r.pose;
+    } else {
+      est = prior;
+    }
+    path_m += std::hypot(est.x - previous.x, est.y - previous.y);
+    integrate(*grid, scan, est);
+  }
+  const int tried = static_cast<int>(frames.size()) - 1 - empty;
+  std::printf("%zu frames, %.1f s: %d matched, %d failed, %d without points at sensor height\n", frames.size(),
+              frames.back().header->timestamp - first.timestamp, matched, tried - matched, empty);
+  if (tried > 0)
+    std::printf("set_map + match %.1f us (%.0f/s), mean score %.2f, path %.2f m, end (%.2f, %.2f, %.1f deg)\n",
+                match_us / tried, 1e6 * tried / match_us, matched ? score / matched : 0.0, path_m, est.x, est.y,
+                est.theta * 57.29578f);
+}
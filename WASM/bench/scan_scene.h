@@ -0,0 +1,132 @@
+#pragma once
+// Synthetic planar scenes for the 2D scan suites: walls as line segments, a
+// LiDAR slice ray cast against them, and frames driven along a path with
+// drifting odometry. Shared by scan_matcher_bench, likelihood_field_bench and
+// submaps_bench so every suite scans the same way.
+#include <stdint.h>
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "occupancy_grid.h"
+#include "scan_matcher.h"
+
+struct Segment {
+  float x0, y0, x1, y1;
+};
+
+// distance along the ray to the nearest wall, or inf
+inline float cast(const std::vector<Segment> &walls, float ox, float oy, float dx, float dy) {
+  float best = INFINITY;
+  for (const Segment &s : walls) {
+    const float ex = s.x1 - s.x0, ey = s.y1 - s.y0;
+    const float den = dx * ey - dy * ex;
+    if (std::fabs(den) < 1e-9f) continue;
+    const float wx = s.x0 - ox, wy = s.y0 - oy;
+    const float t = (wx * ey - wy * ex) / den, u = (wx * dy - wy * dx) / den;
+    if (t > 0.0f && u >= 0.0f && u <= 1.0f && t < best) best = t;
+  }
+  return best;
+}
+
+// `beams` rays spread over `fov` radians centered on the heading, with the
+// first and last on the edges; a full circle starts at the heading instead
+// and does not repeat its first beam
+struct Lidar2D {
+  static constexpr float kFullCircle = 6.2831853f;
+
+  int beams;
+  float fov;
+  float max_range;
+
+  float angle(int b) const { return fov >= kFullCircle ? fov * b / beams : -0.5f * fov + fov * b / (beams - 1); }
+};
+
+// Ray casts one scan from p with range_noise on every beam, and calls
+// hit(a, r) for each return closer than max_range: a is the beam's angle in
+// the sensor frame, r its range.
+template <typename Hit>
+void scan_walls(const std::vector<Segment> &walls, const Pose2 &p, const Lidar2D &lidar, std::mt19937 &rng,
+                std::normal_distribution<float> &range_noise, Hit &&hit) {
+  for (int b = 0; b < lidar.beams; ++b) {
+    const float a = lidar.angle(b);
+    const float r = cast(walls, p.x, p.y, std::cos(p.theta + a), std::sin(p.theta + a)) + range_noise(rng);
+    if (r < lidar.max_range) hit(a, r);
+  }
+}
+
+struct Frame {
+  Pose2 truth;
+  Pose2 odometry; // dead-reckoned, drifts
+  Scan2D scan;
+};
+
+// One frame per pose of path: a scan from the true pose with 1 cm range
+// noise, and odometry dead-reckoned from the previous frame with a 3% scale
+// error, heading_bias radians per frame and white noise on every step.
+inline std::vector<Frame> drive(const std::vector<Segment> &walls, const std::vector<Pose2> &path,
+                                const Lidar2D &lidar, float heading_bias, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> range_noise(0.0f, 0.01f), step_noise(0.0f, 0.005f), turn_noise(0.0f, 0.004f);
+  std::vector<Frame> frames;
+  frames.reserve(path.size());
+  for (const Pose2 &truth : path) {
+    Frame f;
+    f.truth = truth;
+    if (frames.empty()) {
+      f.odometry = f.truth;
+    } else {
+      const Pose2 d = between(frames.back().truth, f.truth);
+      f.odometry = compose(frames.back().odometry, Pose2{1.03f * d.x + step_noise(rng), d.y + step_noise(rng),
+                                                         d.theta + heading_bias + turn_noise(rng)});
+    }
+    f.scan.reserve(lidar.beams);
+    int n = 0;
+    scan_walls(walls, f.truth, lidar, rng, range_noise, [&](float a, float r) {
+      f.scan.x[n] = r * std::cos(a);
+      f.scan.y[n] = r * std::sin(a);
+      ++n;
+    });
+    f.scan.size = n;
+    frames.push_back(std::move(f));
+  }
+  return frames;
+}
+
+// where frame i starts out for a matcher: est, the estimate of frame i - 1,
+// moved by the odometry between the two
+inline Pose2 odometry_prior(const Pose2 &est, const std::vector<Frame> &frames, size_t i) {
+  return compose(est, between(frames[i - 1].odometry, frames[i].odometry));
+}
+
+// ray casts a robot-frame scan taken at p into the grid
+struct ScanIntegrator {
+  const OccupancyParams params = {218, -102, -512, 896, 10.0f};
+  std::vector<uint32_t> keys = std::vector<uint32_t>(1 << 12);
+  std::vector<float> xy;
+
+  void operator()(OccupancyGrid &grid, const Scan2D &scan, const Pose2 &p) {
+    xy.resize(2 * static_cast<size_t>(scan.size));
+    const float c = std::cos(p.theta), s = std::sin(p.theta);
+    for (int i = 0; i < scan.size; ++i) {
+      xy[2 * i] = p.x + c * scan.x[i] - s * scan.y[i];
+      xy[2 * i + 1] = p.y + s * scan.x[i] + c * scan.y[i];
+    }
+    occ_integrate(&grid, &params, p.x, p.y, xy.data(), scan.size, keys.data(), (int32_t)keys.size());
+  }
+};
+
+struct GridDeleter {
+  void operator()(OccupancyGrid *g) const {
+    occ_release(g);
+    delete g;
+  }
+};
+
+inline std::unique_ptr<OccupancyGrid, GridDeleter> new_grid(float resolution) {
+  std::unique_ptr<OccupancyGrid, GridDeleter> g(new OccupancyGrid);
+  occ_init(g.get(), resolution);
+  return g;
+}
@@ -0,0 +1,65 @@
+// Tick drift of the old sleep_for sensor loop vs. PeriodicTimer from
+// scheduler.h. Both loops do 2 ms of work per 10 ms tick (the IMU thread's
+// period); sleep_for adds the work and the wakeup latency to every period,
+// PeriodicTimer sleeps to absolute deadlines. Also times how long a
+// sleeping timer takes to return once stop is requested.
+//
+//   bazel run --config=opt //WASM:scheduler_bench
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "imu.h"
+#include "scheduler.h"
+
+constexpr int kTicks = 100;
+constexpr auto kWork = std::chrono::milliseconds(2);
+
+static void busy(SchedClock::duration d) {
+    const auto until = SchedClock::now() + d;
+    while (SchedClock::now() < until) {}
+}
+
+static double ms_since(SchedClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(SchedClock::now() - start).count();
+}
+
+int main() {
+    {
+        // the pre-scheduler loop from slam_main.cpp / telemetry.cpp
+        const auto start = SchedClock::now();
+        for (int ticks = 0; ticks < kTicks; ++ticks) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(IMUIntervalMs));
+            busy(kWork);
+        }
+        std::printf("sleep_for:     %d ticks in %.1fms (ideal %dms)\n", kTicks, ms_since(start),
+                    kTicks * IMUIntervalMs);
+    }
+    {
+        StopSignal stop;
+        PeriodicTimer timer(std::chrono::milliseconds(IMUIntervalMs), stop);
+        const auto start = SchedClock::now();
+        int ticks = 0;
+        while (ticks < kTicks && timer.wait()) {
+            ++ticks;
+            busy(kWork);
+        }
+        std::printf("PeriodicTimer: %d ticks in %.1fms (ideal %dms, missed %llu)\n", ticks, ms_since(start),
+                    ticks * IMUIntervalMs, static_cast<unsigned long long>(timer.missed()));
+    }
+    {
+        // a thread parked on a long period must still join promptly
+        StopSignal stop;
+        SchedClock::time_point returned;
+        std::thread sleeper([&] {
+            PeriodicTimer timer(std::chrono::seconds(10), stop);
+            timer.wait();
+            returned = SchedClock::now();
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const auto requested = SchedClock::now();
+        stop.request();
+        sleeper.join();
+        std::printf("stop latency:  %.1fus\n", std::chrono::duration<double, std::micro>(returned - requested).count());
+    }
+}
@@ -0,0 +1,146 @@
+// Reader latency of the Seqlock snapshot vs. the old mutex-held-across-host-call
+// scheme from slam_main.cpp. Also checks that readers never observe a torn
+// IMUData under contention.
+//
+//   bazel test //WASM:seqlock_test                           # torn-read check
+//   bazel run --config=opt //WASM:seqlock_bench -- "[summary]" # latency percentiles
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "imu.h"
+#include "seqlock.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kReaders = 3;
+// stand-in for the WAMR -> Swift round trip inside read_imu
+constexpr auto kHostCallTime = std::chrono::microseconds(50);
+
+// every field carries the same counter so a torn copy is detectable
+IMUData make_sample(uint64_t n) {
+    const double v = static_cast<double>(n);
+    return IMUData{v, v, v, v, v, v, v, v};
+}
+
+bool consistent(const IMUData& d) {
+    const double v = d.acc_timestamp;
+    return d.acc_x == v && d.acc_y == v && d.acc_z == v && d.gyro_timestamp == v &&
+           d.gyro_x == v && d.gyro_y == v && d.gyro_z == v;
+}
+
+void host_call(IMUData& out, uint64_t n) {
+    const auto until = Clock::now() + kHostCallTime;
+    while (Clock::now() < until) {}
+    out = make_sample(n);
+}
+
+struct Result {
+    std::vector<double> latency_ns;
+    uint64_t torn = 0;
+};
+
+uint64_t torn_reads(const std::vector<Result>& results) {
+    uint64_t torn = 0;
+    for (const auto& r : results) torn += r.torn;
+    return torn;
+}
+
+void report(const char* name, std::vector<Result>& results) {
+    std::vector<double> all;
+    for (auto& r : results) all.insert(all.end(), r.latency_ns.begin(), r.latency_ns.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[static_cast<size_t>(p * (all.size() - 1))]; };
+    std::printf("%-8s reads=%-10zu p50=%8.0fns p99=%8.0fns p99.9=%9.0fns max=%9.0fns torn=%llu\n",
+                name, all.size(), pct(0.5), pct(0.99), pct(0.999), all.back(),
+                static_cast<unsigned long long>(torn_reads(results)));
+}
+
+template <typename Writer, typename Reader>
+std::vector<Result> run(Clock::duration run_time, Writer writer, Reader reader) {
+    std::atomic<bool> stop{false};
+    std::vector<Result> results(kReaders);
+    std::thread w([&] {
+        for (uint64_t n = 1; !stop.load(std::memory_order_relaxed); ++n) writer(n);
+    });
+    std::vector<std::thread> readers;
+    for (int i = 0; i < kReaders; ++i) {
+        readers.emplace_back([&, i] {
+            Result& r = results[i];
+            r.latency_ns.reserve(1 << 20);
+            while (!stop.load(std::memory_order_relaxed)) {
+                const auto t0 = Clock::now();
+                const IMUData d = reader();
+                const auto t1 = Clock::now();
+                if (!consistent(d)) ++r.torn;
+                if (r.latency_ns.size() < r.latency_ns.capacity())
+                    r.latency_ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+            }
+        });
+    }
+    std::this_thread::sleep_for(run_time);
+    stop = true;
+    w.join();
+    for (auto& t : readers) t.join();
+    return results;
+}
+
+} // namespace
+
+TEST_CASE("readers never see a torn IMUData", "[seqlock]") {
+    // the writer publishes back to back, the worst case for readers
+    Seqlock<IMUData> snapshot;
+    snapshot.store(make_sample(0));
+    auto results = run(std::chrono::milliseconds(500), [&](uint64_t n) { snapshot.store(make_sample(n)); },
+                       [&] { return snapshot.load(); });
+    for (const auto& r : results) REQUIRE(!r.latency_ns.empty());
+    REQUIRE(torn_reads(results) == 0);
+}
+
+TEST_CASE("reader latency", "[.][summary]") {
+    constexpr auto kRunTime = std::chrono::seconds(2);
+    {
+        std::mutex m;
+        IMUData shared = make_sample(0);
+        auto results = run(
+            kRunTime,
+            [&](uint64_t n) {
+                std::lock_guard<std::mutex> lk(m);
+                host_call(shared, n);
+            },
+            [&] {
+                std::lock_guard<std::mutex> lk(m);
+                return shared;
+            });
+        report("mutex", results);
+    }
+    {
+        Seqlock<IMUData> snapshot;
+        snapshot.store(make_sample(0));
+        auto results = run(
+            kRunTime,
+            [&](uint64_t n) {
+                IMUData local;
+                host_call(local, n);
+                snapshot.store(local);
+            },
+            [&] { return snapshot.load(); });
+        report("seqlock", results);
+    }
+    {
+        // worst case for readers: writer publishes back to back
+        Seqlock<IMUData> snapshot;
+        snapshot.store(make_sample(0));
+        auto results = run(kRunTime, [&](uint64_t n) { snapshot.store(make_sample(n)); },
+                           [&] { return snapshot.load(); });
+        report("seqlock*", results);
+    }
+}
@@ -0,0 +1,277 @@
+// Submaps on a synthetic ring corridor: a 24 x 16 m loop of 2 m wide
+// corridor with door recesses, driven lap after lap with a 67 degree
+// 256-beam slice at 10 Hz and drifting odometry. Each frame is matched
+// against the older active submap and inserted; finished submaps are frozen
+// and placed on the background thread while the run goes on.
+//
+//   bazel run --config=opt //WASM:submaps_bench
+//   bazel run --config=opt //WASM:submaps_bench -- "[summary]"   # insert cost and placement error per run length
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "bench/scan_scene.h"
+#include "submaps.h"
+
+namespace {
+
+// wall from (x0, y0) to (x1, y1) with a 0.9 m wide, 0.3 m deep recess
+// every `every` meters, set back along the outward normal (nx, ny)
+void recessed_wall(std::vector<Segment> &w, float x0, float y0, float x1, float y1, float nx, float ny, float every,
+                   float phase) {
+  const float len = std::hypot(x1 - x0, y1 - y0), ux = (x1 - x0) / len, uy = (y1 - y0) / len;
+  float start = 0.0f;
+  for (float d0 = phase; d0 + 0.9f < len - 0.5f; d0 += every) {
+    const float d1 = d0 + 0.9f;
+    auto at = [&](float d, float out) { return std::make_pair(x0 + ux * d + nx * out, y0 + uy * d + ny * out); };
+    const auto a = at(start, 0), b = at(d0, 0), c = at(d0, 0.3f), e = at(d1, 0.3f), f = at(d1, 0);
+    w.push_back({a.first, a.second, b.first, b.second});
+    w.push_back({b.first, b.second, c.first, c.second});
+    w.push_back({c.first, c.second, e.first, e.second});
+    w.push_back({e.first, e.second, f.first, f.second});
+    start = d1;
+  }
+  const float ex = x0 + ux * start, ey = y0 + uy * start;
+  w.push_back({ex, ey, x1, y1});
+}
+
+// outer walls [0, 24] x [0, 16], inner block [2, 22] x [2, 14]; recesses
+// on both sides at different spacings so no stretch repeats another
+std::vector<Segment> ring() {
+  std::vector<Segment> w;
+  recessed_wall(w, 0, 0, 24, 0, 0, -1, 2.3f, 1.0f);
+  recessed_wall(w, 24, 0, 24, 16, 1, 0, 1.9f, 1.4f);
+  recessed_wall(w, 24, 16, 0, 16, 0, 1, 2.7f, 0.8f);
+  recessed_wall(w, 0, 16, 0, 0, -1, 0, 1.7f, 1.2f);
+  recessed_wall(w, 2, 2, 22, 2, 0, 1, 3.1f, 2.0f);
+  recessed_wall(w, 22, 2, 22, 14, -1, 0, 2.9f, 1.6f);
+  recessed_wall(w, 22, 14, 2, 14, 0, -1, 3.5f, 2.2f);
+  recessed_wall(w, 2, 14, 2, 2, 1, 0, 2.5f, 1.8f);
+  return w;
+}
+
+// the corridor's centerline, a rectangle [1, 23] x [1, 15] with its corners
+// rounded at radius r, counter-clockwise from (1 + r, 1): position and
+// heading at arc length s
+Pose2 centerline(float s) {
+  const float r = 0.8f, a = 22.0f - 2 * r, b = 14.0f - 2 * r, q = 1.5707963f * r;
+  const float lap = 2 * a + 2 * b + 4 * q;
+  s = std::fmod(s, lap);
+  const float lengths[8] = {a, q, b, q, a, q, b, q};
+  // corner centers, and the heading each straight runs at
+  const float cx[4] = {23 - r, 23 - r, 1 + r, 1 + r}, cy[4] = {1 + r, 15 - r, 15 - r, 1 + r};
+  for (int k = 0; k < 8; ++k) {
+    if (s > lengths[k] && k < 7) {
+      s -= lengths[k];
+      continue;
+    }
+    const int side = k / 2;
+    const float heading = side * 1.5707963f;
+    if (k % 2 == 0) {
+      // straight: from the end of the previous corner
+      const int prev = (side + 3) % 4;
+      const float sx = cx[prev] + r * std::cos(heading - 1.5707963f), sy = cy[prev] + r * std::sin(heading - 1.5707963f);
+      return Pose2{sx + s * std::cos(heading), sy + s * std::sin(heading), wrap_angle(heading)};
+    }
+    const float phi = heading - 1.5707963f + s / r;
+    return Pose2{cx[side] + r * std::cos(phi), cy[side] + r * std::sin(phi), wrap_angle(phi + 1.5707963f)};
+  }
+  return Pose2{1 + r, 1, 0};
+}
+
+// 256 beams over the LiDAR's 67 degree horizontal field of view, 5 m
+constexpr Lidar2D kLidar = {256, 1.17f, 5.0f};
+constexpr float kStep = 0.1f; // meters per frame, 1 m/s at 10 Hz
+
+float lap_length() {
+  const float r = 0.8f;
+  return 2 * (22.0f - 2 * r) + 2 * (14.0f - 2 * r) + 4 * 1.5707963f * r;
+}
+
+// a gentle weave across the corridor, with a 0.6 deg/s heading bias on the
+// odometry
+std::vector<Frame> ring_run(float laps) {
+  std::vector<Pose2> path;
+  for (float s = 0.0f; s < laps * lap_length(); s += kStep) {
+    const Pose2 c = centerline(s);
+    const float off = 0.3f * std::sin(s / 3.0f);
+    path.push_back(Pose2{c.x - off * std::sin(c.theta), c.y + off * std::cos(c.theta),
+                         wrap_angle(c.theta + 0.1f * std::cos(s / 3.0f))});
+  }
+  return drive(ring(), path, kLidar, 0.001f, 23);
+}
+
+struct RunStats {
+  int submaps = 0, failed = 0, max_active_tiles = 0;
+  double first_lap_insert_us = 0, last_lap_insert_us = 0, match_us = 0;
+  double frontend_error = 0, placed_error = 0; // mean over the last lap's submaps, meters
+  double max_placed_error = 0;
+  std::vector<Pose2> truth, frontend; // per submap, at its first scan
+  SubmapStats stats;
+};
+
+// CPU time of the calling thread, so the front-end's timings leave out the
+// background thread's work even when they share a core
+double thread_us() {
+  timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return 1e6 * static_cast<double>(t.tv_sec) + 1e-3 * static_cast<double>(t.tv_nsec);
+}
+
+// Replays frames through match -> insert, then waits for the background
+// thread and compares the submap origins with the truth.
+RunStats replay(const std::vector<Frame> &frames, Submaps &sm) {
+  RunStats st;
+  std::vector<Pose2> &frontend = st.frontend;
+  const size_t lap = static_cast<size_t>(lap_length() / kStep);
+  int first_n = 0, last_n = 0;
+  // the robot starts out standing still for a few frames, which gives the
+  // matcher walls that are sure enough to count as obstacles
+  Pose2 est = frames[0].truth;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const Frame &f = frames[i];
+    const int repeat = i == 0 ? 3 : 1;
+    if (i > 0) {
+      const Pose2 prior = odometry_prior(est, frames, i);
+      const double t0 = thread_us();
+      const ScanMatchResult r = sm.match(f.scan, prior);
+      st.match_us += thread_us() - t0;
+      if (!r.ok) ++st.failed;
+      est = r.pose;
+    }
+    for (int k = 0; k < repeat; ++k) {
+      const int before = sm.submap_count();
+      const double t0 = thread_us();
+      sm.insert(est, f.scan);
+      const double us = thread_us() - t0;
+      if (i < lap) {
+        st.first_lap_insert_us += us;
+        ++first_n;
+      } else if (i + lap >= frames.size()) {
+        st.last_lap_insert_us += us;
+        ++last_n;
+      }
+      if (sm.submap_count() > before) {
+        st.truth.push_back(f.truth);
+        frontend.push_back(est);
+      }
+    }
+    st.max_active_tiles = std::max(st.max_active_tiles, sm.active_tiles());
+  }
+  sm.flush();
+  sm.wait_idle();
+
+  st.match_us /= static_cast<double>(frames.size() - 1);
+  st.first_lap_insert_us /= std::max(first_n, 1);
+  st.last_lap_insert_us /= std::max(last_n, 1);
+  st.submaps = sm.submap_count();
+  st.stats = sm.stats();
+  std::vector<Pose2> placed;
+  sm.placements(placed);
+  // the last lap's worth of submaps
+  const size_t per_lap = static_cast<size_t>(st.submaps * lap / frames.size());
+  const size_t from = st.truth.size() > per_lap ? st.truth.size() - per_lap : 0;
+  for (size_t i = from; i < st.truth.size(); ++i) {
+    const double pe = std::hypot(placed[i].x - st.truth[i].x, placed[i].y - st.truth[i].y);
+    st.frontend_error += std::hypot(frontend[i].x - st.truth[i].x, frontend[i].y - st.truth[i].y);
+    st.placed_error += pe;
+    st.max_placed_error = std::max(st.max_placed_error, pe);
+  }
+  st.frontend_error /= static_cast<double>(st.truth.size() - from);
+  st.placed_error /= static_cast<double>(st.truth.size() - from);
+  return st;
+}
+
+} // namespace
+
+TEST_CASE("frozen submaps keep their cells", "[submaps]") {
+  const std::vector<Frame> frames = ring_run(0.1f);
+  auto grid = new_grid(0.05f);
+  ScanIntegrator integrate;
+  for (const Frame &f : frames) integrate(*grid, f.scan, f.truth);
+  const OccupancyParams &params = integrate.params;
+  FrozenSubmap s;
+  freeze_submap(*grid, params, s);
+  REQUIRE(s.width == grid->maxCX - grid->minCX + 1);
+  // one quantization step of the clamp range, in Q8.8
+  const int step = (params.maxLogOdds - params.minLogOdds + 253) / 254;
+  int known = 0, wrong = 0;
+  for (int32_t cy = grid->minCY - 2; cy <= grid->maxCY + 2; ++cy)
+    for (int32_t cx = grid->minCX - 2; cx <= grid->maxCX + 2; ++cx) {
+      const int32_t v = occ_get(grid.get(), cx, cy), q = s.log_odds(cx, cy);
+      wrong += (v == 0) != (q == 0) || std::abs(q - v) > step / 2 + 1;
+      known += v != 0;
+    }
+  REQUIRE(known > 1000);
+  REQUIRE(wrong == 0);
+  // a byte per cell of the box instead of two per cell of every tile
+  REQUIRE(s.bytes() < static_cast<size_t>(grid->tiles.count) * TILE_CELLS * sizeof(int16_t));
+}
+
+TEST_CASE("ring corridor laps", "[submaps]") {
+  const std::vector<Frame> frames = ring_run(3.0f);
+  Submaps sm;
+  const RunStats st = replay(frames, sm);
+  // a frame or two after each corner sees walls neither active submap has
+  // had in view for long; those keep the odometry prior
+  REQUIRE(st.failed <= static_cast<int>(frames.size()) / 200);
+  REQUIRE(st.submaps > 60);
+  REQUIRE(st.stats.frozen == st.submaps);
+  // two active grids plus the ones in flight to the background thread
+  REQUIRE(sm.grids_allocated() <= 4);
+  REQUIRE(st.stats.constraints > st.submaps / 4);
+  // the front-end alone has drifted by the third lap; placement pulls the
+  // submaps back onto the first lap's, to within the heading noise of the
+  // match edges over a 70 m loop (which moves with the compiler's float
+  // contraction, hence the margins)
+  const Frame &last = frames.back();
+  REQUIRE(std::hypot(last.odometry.x - last.truth.x, last.odometry.y - last.truth.y) > 3.0);
+  REQUIRE(st.placed_error < 0.6 * st.frontend_error);
+  REQUIRE(st.placed_error < 0.3);
+  REQUIRE(st.max_placed_error < 0.6);
+
+  // frozen submaps stay with their data and their frame
+  const std::shared_ptr<const FrozenSubmap> s = sm.frozen(st.submaps / 2);
+  REQUIRE(s);
+  REQUIRE(s->id == st.submaps / 2);
+  REQUIRE(s->cells.size() == static_cast<size_t>(s->width) * s->height);
+  REQUIRE(!sm.frozen(st.submaps));
+}
+
+TEST_CASE("insertion cost does not grow with the map", "[submaps]") {
+  const std::vector<Frame> frames = ring_run(4.0f);
+  Submaps sm;
+  const RunStats st = replay(frames, sm);
+  // the active grids span a submap's worth of corridor however much has
+  // been mapped
+  REQUIRE(st.max_active_tiles < 2 * 40);
+  REQUIRE(st.last_lap_insert_us < 1.5 * st.first_lap_insert_us);
+
+  Submaps bench;
+  for (size_t i = 0; i < 200; ++i) bench.insert(frames[i].truth, frames[i].scan);
+  BENCHMARK("insert, 256 beams into 2 submaps") { return bench.insert(frames[150].truth, frames[150].scan); };
+  BENCHMARK("match against the older submap") { return bench.match(frames[150].scan, frames[150].truth); };
+}
+
+TEST_CASE("insert and placement cost per run length", "[.][summary]") {
+  std::printf("%5s %7s %8s %11s %11s %11s %8s %10s %10s %10s %12s %12s\n", "laps", "scans", "submaps",
+              "constraints", "ins us 1st", "ins us last", "match us", "freeze us", "place ms", "frozen KB",
+              "frontend cm", "placed cm");
+  for (float laps : {1.0f, 3.0f, 6.0f}) {
+    const std::vector<Frame> frames = ring_run(laps);
+    Submaps sm;
+    const RunStats st = replay(frames, sm);
+    double frozen = 0;
+    for (int i = 0; i < st.submaps; ++i) frozen += static_cast<double>(sm.frozen(i)->bytes());
+    std::printf("%5.0f %7zu %8d %11d %11.1f %11.1f %8.1f %10.1f %10.2f %10.1f %12.2f %12.2f\n", laps, frames.size(),
+                st.submaps, st.stats.constraints, st.first_lap_insert_us, st.last_lap_insert_us, st.match_us,
+                st.stats.freeze_us, st.stats.place_us / 1000.0, frozen / st.submaps / 1024.0,
+                100.0 * st.frontend_error, 100.0 * st.placed_error);
+  }
+}
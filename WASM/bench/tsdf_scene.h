@@ -0,0 +1,109 @@
+#pragma once
+// Synthetic room for the TSDF suites: an 8 x 6 x 3 m box with a ball and a
+// pillar, its true distance field, and 256x192 depth maps of it (5 mm noise,
+// 5 m range) from a level camera 1.2 m up that circles the room at 30 Hz.
+// Shared by tsdf_volume_bench and tsdf_mesher_bench so both fuse the same
+// frames.
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "depth_projection.h"
+
+constexpr int kWidth = 256;
+constexpr int kHeight = 192;
+constexpr float kRoom[3] = {8.0f, 6.0f, 3.0f}; // from the origin
+constexpr float kBall[4] = {6.5f, 1.2f, 0.8f, 0.6f}; // center, radius
+constexpr float kPillar[6] = {1.0f, 4.4f, 0.0f, 1.6f, 5.0f, 3.0f}; // min, max corner
+constexpr float kCameraHeight = 1.2f;
+constexpr float kFrameDt = 1.0f / 30.0f;
+
+const CameraIntrinsics kIntrinsics = CameraIntrinsics{1450.0f, 1450.0f, 959.5f, 719.5f}.scaled(1920, 1440, kWidth, kHeight);
+
+// the robot at time t, as it would go to set_pose: a 1.5 m circle around
+// the room's middle, looking outward and swinging +-0.6 rad, so every wall,
+// the ball and the pillar come into view within a lap (about 8 s)
+inline Pose2 orbit(float t) {
+  const float a = 0.8f * t;
+  return Pose2{4.0f + 1.5f * std::cos(a), 3.0f + 1.5f * std::sin(a), a + 0.6f * std::sin(1.7f * t)};
+}
+
+// camera looking along heading, level: x right, y down, z forward
+inline CameraPose camera(float x, float y, float heading) {
+  const float c = std::cos(heading), s = std::sin(heading);
+  // columns are the camera axes in the world
+  return CameraPose{{s, 0, c, -c, 0, s, 0, -1, 0}, {x, y, kCameraHeight}};
+}
+
+inline float box_distance(const float *lo, const float *hi, const float *p) {
+  float out = 0.0f, in = -1e9f;
+  for (int a = 0; a < 3; ++a) {
+    const float c = 0.5f * (lo[a] + hi[a]), h = 0.5f * (hi[a] - lo[a]);
+    const float d = std::fabs(p[a] - c) - h;
+    out += std::max(d, 0.0f) * std::max(d, 0.0f);
+    in = std::max(in, d);
+  }
+  return out > 0.0f ? std::sqrt(out) : in;
+}
+
+// true distance to the nearest surface: positive in the room's free space
+inline float scene_distance(const float *p) {
+  float d = std::min({p[0], kRoom[0] - p[0], p[1], kRoom[1] - p[1], p[2], kRoom[2] - p[2]});
+  d = std::min(d, std::sqrt((p[0] - kBall[0]) * (p[0] - kBall[0]) + (p[1] - kBall[1]) * (p[1] - kBall[1]) +
+                            (p[2] - kBall[2]) * (p[2] - kBall[2])) -
+                      kBall[3]);
+  return std::min(d, box_distance(kPillar, kPillar + 3, p));
+}
+
+// ray o + t dir against the scene; the depth is t when dir has unit
+// camera-z, as a depth map's rays do
+inline float cast(const float *o, const float *dir) {
+  float best = 1e9f;
+  // walls, from the inside
+  for (int a = 0; a < 3; ++a) {
+    if (dir[a] > 1e-9f) best = std::min(best, (kRoom[a] - o[a]) / dir[a]);
+    if (dir[a] < -1e-9f) best = std::min(best, -o[a] / dir[a]);
+  }
+  // ball
+  float oc[3], b = 0.0f, c = -kBall[3] * kBall[3], aa = 0.0f;
+  for (int a = 0; a < 3; ++a) {
+    oc[a] = o[a] - kBall[a];
+    aa += dir[a] * dir[a];
+    b += oc[a] * dir[a];
+    c += oc[a] * oc[a];
+  }
+  const float disc = b * b - aa * c;
+  if (disc >= 0.0f) {
+    const float t = (-b - std::sqrt(disc)) / aa;
+    if (t > 0.0f) best = std::min(best, t);
+  }
+  // pillar, slabs
+  float t0 = 0.0f, t1 = 1e9f;
+  for (int a = 0; a < 3; ++a) {
+    if (std::fabs(dir[a]) < 1e-9f) {
+      if (o[a] < kPillar[a] || o[a] > kPillar[a + 3]) t0 = 2e9f;
+      continue;
+    }
+    float ta = (kPillar[a] - o[a]) / dir[a], tb = (kPillar[a + 3] - o[a]) / dir[a];
+    if (ta > tb) std::swap(ta, tb);
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+  }
+  if (t0 <= t1 && t0 > 0.0f) best = std::min(best, t0);
+  return best;
+}
+
+inline void render(const CameraPose &pose, std::mt19937 &rng, std::vector<float> &depth) {
+  std::normal_distribution<float> noise(0.0f, 0.005f);
+  depth.resize(kWidth * kHeight);
+  for (int v = 0; v < kHeight; ++v) {
+    for (int u = 0; u < kWidth; ++u) {
+      const float c[3] = {(u - kIntrinsics.cx) / kIntrinsics.fx, (v - kIntrinsics.cy) / kIntrinsics.fy, 1.0f};
+      float dir[3];
+      for (int a = 0; a < 3; ++a) dir[a] = pose.r[3 * a] * c[0] + pose.r[3 * a + 1] * c[1] + pose.r[3 * a + 2] * c[2];
+      const float z = cast(pose.t, dir);
+      depth[v * kWidth + u] = z <= 5.0f ? z + noise(rng) : 0.0f; // out of range reads as no return
+    }
+  }
+}
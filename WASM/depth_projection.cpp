@@ -0,0 +1,140 @@
+#include "depth_projection.h"
+
+#include <string.h> // memcpy
+
+// 4-wide GCC/Clang vector extensions: lowered to wasm simd128 (-msimd128),
+// SSE or NEON, or to scalar code on targets without SIMD
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef int32_t i32x4 __attribute__((vector_size(16)));
+
+static inline f32x4 load4(const float *p) {
+  f32x4 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline f32x4 splat4(float s) { return f32x4{s, s, s, s}; }
+
+CameraIntrinsics CameraIntrinsics::scaled(int from_width, int from_height, int to_width, int to_height) const {
+  const float sx = static_cast<float>(to_width) / static_cast<float>(from_width);
+  const float sy = static_cast<float>(to_height) / static_cast<float>(from_height);
+  // pixel centers stay aligned: (c + 0.5) scales, not c
+  return CameraIntrinsics{fx * sx, fy * sy, (cx + 0.5f) * sx - 0.5f, (cy + 0.5f) * sy - 0.5f};
+}
+
+CameraPose CameraPose::identity() { return CameraPose{{1, 0, 0, 0, 1, 0, 0, 0, 1}, {0, 0, 0}}; }
+
+CameraPose camera_pose(const Pose2 &robot, const CameraMount &mount) {
+  const float c = cosf(robot.theta), s = sinf(robot.theta);
+  const float cp = cosf(mount.pitch), sp = sinf(mount.pitch);
+  // camera axes in the world: right, down (forward x right), forward
+  const float x[3] = {s, -c, 0.0f};
+  const float z[3] = {c * cp, s * cp, -sp};
+  const float y[3] = {z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0]};
+  return CameraPose{{x[0], y[0], z[0], x[1], y[1], z[1], x[2], y[2], z[2]},
+                    {robot.x + c * mount.forward - s * mount.left, robot.y + s * mount.forward + c * mount.left,
+                     mount.height}};
+}
+
+DepthProjector::DepthProjector(const CameraIntrinsics &k, const DepthProjectionParams &params)
+    : k_(k), params_(params) {
+  if (params_.stride_x < 1) params_.stride_x = 1;
+  if (params_.stride_y < 1) params_.stride_y = 1;
+}
+
+DepthProjector::Span DepthProjector::span(int width, int height) const {
+  const DepthRoi &r = params_.roi;
+  Span s{r.x0 > 0 ? r.x0 : 0, r.x1 > 0 && r.x1 < width ? r.x1 : width, r.y0 > 0 ? r.y0 : 0,
+         r.y1 > 0 && r.y1 < height ? r.y1 : height};
+  if (s.x1 < s.x0) s.x1 = s.x0;
+  if (s.y1 < s.y0) s.y1 = s.y0;
+  return s;
+}
+
+int DepthProjector::max_points(int width, int height) const {
+  const Span s = span(width, height);
+  const int cols = (s.x1 - s.x0 + params_.stride_x - 1) / params_.stride_x;
+  const int rows = (s.y1 - s.y0 + params_.stride_y - 1) / params_.stride_y;
+  return cols * rows;
+}
+
+int DepthProjector::project(const float *depth, int width, int height, const CameraPose &pose, PointCloud &out) {
+  out.size = 0;
+  if (!depth || width <= 0 || height <= 0) return 0;
+  const Span s = span(width, height);
+
+  if (width != table_width_) {
+    col_u_.clear();
+    col_dir_.clear();
+    for (int u = s.x0; u < s.x1; u += params_.stride_x) {
+      col_u_.push_back(u);
+      col_dir_.push_back((static_cast<float>(u) - k_.cx) / k_.fx);
+    }
+    // pad so the vector loop never reads past the table
+    while (col_dir_.size() % 4) col_dir_.push_back(0.0f);
+    row_depth_.assign(col_dir_.size(), 0.0f);
+    table_width_ = width;
+  }
+
+  const int ncols = static_cast<int>(col_u_.size());
+  const bool contiguous = params_.stride_x == 1;
+  const float *R = pose.r;
+  const f32x4 r0 = splat4(R[0]), r3 = splat4(R[3]), r6 = splat4(R[6]);
+  const f32x4 t0 = splat4(pose.t[0]), t1 = splat4(pose.t[1]), t2 = splat4(pose.t[2]);
+  const f32x4 zmin = splat4(params_.min_depth), zmax = splat4(params_.max_depth);
+  const int cap = out.capacity();
+  float *ox = out.x.data(), *oy = out.y.data(), *oz = out.z.data();
+  uint32_t *op = out.pixel.data();
+  int n = 0;
+
+  for (int v = s.y0; v < s.y1; v += params_.stride_y) {
+    const float *row = depth + static_cast<size_t>(v) * width;
+    const float *zs = row + s.x0;
+    if (!contiguous) {
+      for (int i = 0; i < ncols; ++i) row_depth_[i] = row[col_u_[i]];
+      zs = row_depth_.data();
+    }
+    // world direction of column c on this row is R * (col_dir[c], ry, 1), so
+    // p_world = z * (R[0] * col_dir[c] + (R[1] * ry + R[2])) + t, per axis
+    const float ry = (static_cast<float>(v) - k_.cy) / k_.fy;
+    const f32x4 bx = splat4(R[1] * ry + R[2]), by = splat4(R[4] * ry + R[5]), bz = splat4(R[7] * ry + R[8]);
+    const uint32_t pix0 = static_cast<uint32_t>(v) * static_cast<uint32_t>(width);
+    const bool room = n + ncols + 4 <= cap;
+
+    int c = 0;
+    // contiguous rows are read in place, so stop at the last full group of 4;
+    // the gathered row is padded and can run to the end
+    const int vec_end = room ? (contiguous ? (ncols & ~3) : static_cast<int>(col_dir_.size())) : 0;
+    for (; c < vec_end; c += 4) {
+      const f32x4 z = load4(zs + c);
+      const f32x4 a = load4(col_dir_.data() + c);
+      const f32x4 wx = z * (r0 * a + bx) + t0;
+      const f32x4 wy = z * (r3 * a + by) + t1;
+      const f32x4 wz = z * (r6 * a + bz) + t2;
+      // NaN compares false, so it is rejected along with out-of-range depths
+      const i32x4 ok = (z >= zmin) & (z <= zmax);
+      for (int l = 0; l < 4 && c + l < ncols; ++l) {
+        // branchless compaction: always write, advance only for valid lanes
+        ox[n] = wx[l];
+        oy[n] = wy[l];
+        oz[n] = wz[l];
+        op[n] = pix0 + static_cast<uint32_t>(col_u_[c + l]);
+        n += ok[l] & 1;
+      }
+    }
+    // scalar tail, and the whole row once the cloud is nearly full
+    for (; c < ncols; ++c) {
+      const float z = zs[c];
+      if (!(z >= params_.min_depth && z <= params_.max_depth)) continue;
+      if (n == cap) break;
+      const float a = col_dir_[c];
+      ox[n] = z * (R[0] * a + (R[1] * ry + R[2])) + pose.t[0];
+      oy[n] = z * (R[3] * a + (R[4] * ry + R[5])) + pose.t[1];
+      oz[n] = z * (R[6] * a + (R[7] * ry + R[8])) + pose.t[2];
+      op[n] = pix0 + static_cast<uint32_t>(col_u_[c]);
+      ++n;
+    }
+  }
+  out.size = n;
+  return n;
+}
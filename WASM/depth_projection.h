@@ -0,0 +1,96 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "pose2.h"
+
+// Depth map -> world-frame point cloud.
+//
+// Pinhole model in depth-map pixels: pixel (u, v) with depth z (meters along
+// the optical axis, as in ARKit sceneDepth) is the camera point
+//   ((u - cx) * z / fx, (v - cy) * z / fy, z)   x right, y down, z forward
+// which the pose moves into the world: p_world = R * p_cam + t.
+
+struct CameraIntrinsics {
+  float fx, fy, cx, cy;
+
+  // same camera seen at another resolution, e.g. ARKit's camera-image
+  // intrinsics rescaled to the 256x192 depth map
+  CameraIntrinsics scaled(int from_width, int from_height, int to_width, int to_height) const;
+};
+
+struct CameraPose {
+  float r[9]; // camera -> world rotation, row-major
+  float t[3]; // camera position in the world
+
+  static CameraPose identity();
+};
+
+// where the depth camera sits on a planar robot: forward and left of the
+// robot's origin, height above the floor, looking along the heading and
+// pitched down by pitch radians, x axis to the robot's right
+struct CameraMount {
+  float forward = 0.0f, left = 0.0f, height = 0.0f;
+  float pitch = 0.0f;
+};
+
+// camera pose of the robot at a Pose2, e.g. the x,y,theta given to set_pose
+CameraPose camera_pose(const Pose2 &robot, const CameraMount &mount);
+
+// half-open pixel box [x0, x1) x [y0, y1); x1/y1 <= 0 mean the full width/height
+struct DepthRoi {
+  int x0, y0, x1, y1;
+};
+
+struct DepthProjectionParams {
+  int stride_x = 1; // keep every stride_x-th column / stride_y-th row of the ROI
+  int stride_y = 1;
+  DepthRoi roi{0, 0, 0, 0};
+  // depths outside [min_depth, max_depth], NaN and inf are rejected
+  float min_depth = 0.1f;
+  float max_depth = 5.0f;
+};
+
+// structure-of-arrays point cloud. project() only ever writes into the
+// storage reserve() set up, so a reused cloud never allocates per frame.
+struct PointCloud {
+  std::vector<float> x, y, z;
+  std::vector<uint32_t> pixel; // source index v * depth_width + u, e.g. for color lookup
+  int size = 0;
+
+  void reserve(int n) {
+    if (n <= capacity()) return;
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    pixel.resize(n);
+  }
+  int capacity() const { return static_cast<int>(x.size()); }
+  void clear() { size = 0; }
+};
+
+class DepthProjector {
+public:
+  DepthProjector(const CameraIntrinsics &k, const DepthProjectionParams &params);
+
+  // most points one width x height frame can produce; reserve the cloud for this
+  int max_points(int width, int height) const;
+
+  // overwrites out with the valid samples of depth (row-major, width x height
+  // floats) and returns their count. Points beyond out.capacity() are dropped.
+  // Only a change of frame width reallocates (the per-column table).
+  int project(const float *depth, int width, int height, const CameraPose &pose, PointCloud &out);
+
+private:
+  struct Span {
+    int x0, x1, y0, y1;
+  };
+  Span span(int width, int height) const;
+
+  CameraIntrinsics k_;
+  DepthProjectionParams params_;
+  int table_width_ = -1;
+  std::vector<float> col_dir_; // (u - cx) / fx for every sampled column, padded to a multiple of 4
+  std::vector<int> col_u_;     // u of every sampled column
+  std::vector<float> row_depth_; // gathered depths of one row when stride_x > 1
+};
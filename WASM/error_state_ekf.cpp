@@ -0,0 +1,224 @@
+#include "error_state_ekf.h"
+
+// The nonzero blocks of the transition matrix F in propagate(); the rest
+// of F is the identity.
+struct Transition {
+  Mat3 rr, rbg; // rotation row
+  Mat3 vr, vba; // velocity row
+  Mat3 pr, pba; // position row
+  double pv;    // position-velocity, dt times the identity
+};
+
+// out (3 x 15) += b (3 x 3) * rows (3 x 15)
+static void mul_add_rows(const Mat3 &b, const double *rows, double *out) {
+  constexpr int n = ErrorStateEkf::kStates;
+  for (int i = 0; i < 3; ++i)
+    for (int k = 0; k < 3; ++k) {
+      const double v = b.m[3 * i + k];
+      for (int j = 0; j < n; ++j) out[n * i + j] += v * rows[n * k + j];
+    }
+}
+
+// a <- F a, touching only the rows F changes. Row blocks are rewritten from
+// the bottom up, so each one still reads the old rotation and velocity rows.
+static void apply_transition(const Transition &F, ErrorStateEkf::Covariance &a) {
+  constexpr int n = ErrorStateEkf::kStates;
+  double *rot = &a(ErrorStateEkf::kRotation, 0), *vel = &a(ErrorStateEkf::kVelocity, 0);
+  double *pos = &a(ErrorStateEkf::kPosition, 0);
+  const double *bg = &a(ErrorStateEkf::kGyroBias, 0), *ba = &a(ErrorStateEkf::kAccelBias, 0);
+  for (int j = 0; j < 3 * n; ++j) pos[j] += F.pv * vel[j];
+  mul_add_rows(F.pr, rot, pos);
+  mul_add_rows(F.pba, ba, pos);
+  mul_add_rows(F.vr, rot, vel);
+  mul_add_rows(F.vba, ba, vel);
+  double r[3 * n] = {};
+  mul_add_rows(F.rr, rot, r);
+  mul_add_rows(F.rbg, bg, r);
+  for (int j = 0; j < 3 * n; ++j) rot[j] = r[j];
+}
+
+ErrorStateEkf::ErrorStateEkf(const EkfParams &params) : params_(params), P_(Covariance::identity()) {}
+
+void ErrorStateEkf::reset(double t, const NavState &state, const ImuBias &bias, const Covariance &covariance) {
+  started_ = true;
+  time_ = t;
+  state_ = state;
+  bias_gyro_ = params_.imu.imu_to_body * bias.gyro;
+  bias_accel_ = params_.imu.imu_to_body * bias.accel;
+  P_ = covariance;
+  have_last_ = false;
+  last_time_ = 0.0;
+}
+
+void ErrorStateEkf::reset(double t, const NavState &state, const ImuBias &bias, double sigma_rotation,
+                          double sigma_velocity, double sigma_position, double sigma_gyro_bias,
+                          double sigma_accel_bias) {
+  const double sigma[5] = {sigma_rotation, sigma_velocity, sigma_position, sigma_gyro_bias, sigma_accel_bias};
+  Covariance P = Covariance::zero();
+  for (int i = 0; i < kStates; ++i) P(i, i) = sigma[i / 3] * sigma[i / 3];
+  reset(t, state, bias, P);
+}
+
+ImuBias ErrorStateEkf::bias() const {
+  ImuBias b;
+  b.gyro = transpose_mul(params_.imu.imu_to_body, bias_gyro_);
+  b.accel = transpose_mul(params_.imu.imu_to_body, bias_accel_);
+  return b;
+}
+
+void ErrorStateEkf::predict(const IMUData &sample) {
+  const double t = sample.gyro_timestamp;
+  if (have_last_ && !(t > last_time_)) return;
+  // host timestamps count from boot, so a filter nobody reset starts here
+  // rather than at 0
+  if (!started_) {
+    started_ = true;
+    time_ = t;
+  }
+  const ImuNoiseParams &imu = params_.imu;
+  const Vec3 gyro = imu.imu_to_body * Vec3{sample.gyro_x, sample.gyro_y, sample.gyro_z};
+  const Vec3 accel = imu.imu_to_body * (Vec3{sample.acc_x, sample.acc_y, sample.acc_z} * imu.accel_scale);
+  if (!have_last_) {
+    // the first sample also stands for the time before it
+    have_last_ = true;
+    last_gyro_ = gyro;
+    last_accel_ = accel;
+  }
+  predict_to(t);
+  last_time_ = t;
+  last_gyro_ = gyro;
+  last_accel_ = accel;
+}
+
+void ErrorStateEkf::predict_to(double t) {
+  if (!have_last_ || !(t > time_)) return;
+  propagate(last_gyro_, last_accel_, t - time_);
+  time_ = t;
+}
+
+// One zero-order-hold step of the nominal state and the error covariance,
+// P' = F P F^T + Q with (Sola eq. 269, right perturbation, in 3x3 blocks)
+//   F = [Exp(w dt)^T     0  0  -Jr dt  0
+//        -R[a]x dt       I  0  0       -R dt
+//        -R[a]x dt^2/2   dt I  0       -R dt^2/2
+//        0               0  0  I       0
+//        0               0  0  0       I]
+// where w and a are the bias-corrected rates; the position rows carry the
+// second-order terms so the covariance matches the nominal integration.
+void ErrorStateEkf::propagate(const Vec3 &gyro, const Vec3 &accel, double dt) {
+  const double dt2 = dt * dt;
+  const Vec3 w = gyro - bias_gyro_;
+  const Vec3 a = accel - bias_accel_;
+  const Mat3 &R = state_.rotation;
+  const Vec3 phi = w * dt;
+  const Mat3 dR = so3_exp(phi);
+  const Mat3 Ra = R * skew(a);
+
+  Transition F;
+  F.rr = transpose(dR);
+  F.rbg = so3_right_jacobian(phi) * -dt;
+  F.vr = Ra * -dt;
+  F.vba = R * -dt;
+  F.pr = Ra * (-0.5 * dt2);
+  F.pv = dt;
+  F.pba = R * (-0.5 * dt2);
+  // F P F^T = F (F P)^T for symmetric P; F is sparse enough that applying
+  // it by blocks does a third of the work of the dense products
+  apply_transition(F, P_);
+  P_ = transpose(P_);
+  apply_transition(F, P_);
+
+  // white noise of the held sample and the bias random walks; R R^T = I
+  // and Jr Jr^T ~ I at these step sizes
+  const double qg = params_.imu.gyro_noise * params_.imu.gyro_noise * dt;
+  const double qa = params_.imu.accel_noise * params_.imu.accel_noise * dt;
+  const double qbg = params_.gyro_bias_walk * params_.gyro_bias_walk * dt;
+  const double qba = params_.accel_bias_walk * params_.accel_bias_walk * dt;
+  for (int i = 0; i < 3; ++i) {
+    P_(kRotation + i, kRotation + i) += qg;
+    P_(kVelocity + i, kVelocity + i) += qa;
+    P_(kVelocity + i, kPosition + i) += 0.5 * qa * dt;
+    P_(kPosition + i, kVelocity + i) += 0.5 * qa * dt;
+    P_(kPosition + i, kPosition + i) += 0.25 * qa * dt2;
+    P_(kGyroBias + i, kGyroBias + i) += qbg;
+    P_(kAccelBias + i, kAccelBias + i) += qba;
+  }
+  symmetrize(P_);
+
+  const Vec3 acc = R * a + params_.gravity;
+  state_.position += state_.velocity * dt + acc * (0.5 * dt2);
+  state_.velocity += acc * dt;
+  state_.rotation = so3_normalize(R * dR);
+}
+
+// Folds the error estimate into the nominal state and resets it to zero.
+// The rotation error is now measured from the corrected rotation, which
+// transforms its covariance by G = I - [dtheta/2]x (Sola eq. 287).
+void ErrorStateEkf::inject(const Vector<kStates> &dx) {
+  const Vec3 dtheta{dx[kRotation], dx[kRotation + 1], dx[kRotation + 2]};
+  state_.rotation = so3_normalize(state_.rotation * so3_exp(dtheta));
+  state_.velocity += Vec3{dx[kVelocity], dx[kVelocity + 1], dx[kVelocity + 2]};
+  state_.position += Vec3{dx[kPosition], dx[kPosition + 1], dx[kPosition + 2]};
+  bias_gyro_ += Vec3{dx[kGyroBias], dx[kGyroBias + 1], dx[kGyroBias + 2]};
+  bias_accel_ += Vec3{dx[kAccelBias], dx[kAccelBias + 1], dx[kAccelBias + 2]};
+
+  // only the rotation rows and columns change: P <- G P G^T
+  const Mat3 G = Mat3::identity() - skew(dtheta * 0.5);
+  for (int c = 0; c < kStates; ++c) {
+    double col[3];
+    for (int i = 0; i < 3; ++i)
+      col[i] = G.m[3 * i] * P_(0, c) + G.m[3 * i + 1] * P_(1, c) + G.m[3 * i + 2] * P_(2, c);
+    for (int i = 0; i < 3; ++i) P_(i, c) = col[i];
+  }
+  for (int r = 0; r < kStates; ++r) {
+    double row[3];
+    for (int i = 0; i < 3; ++i)
+      row[i] = P_(r, 0) * G.m[3 * i] + P_(r, 1) * G.m[3 * i + 1] + P_(r, 2) * G.m[3 * i + 2];
+    for (int i = 0; i < 3; ++i) P_(r, i) = row[i];
+  }
+  symmetrize(P_);
+}
+
+// The measured heading is that of the body's x axis projected on the xy
+// plane, atan2(R10, R00) as in planar_pose. Under R <- R Exp(dtheta) the
+// first column of R moves by R [dtheta]x e_x = R (0, dz, -dy), so x rotation
+// leaves it alone and
+//   d yaw / d dtheta = (0, R10 R02 - R00 R12, R00 R11 - R10 R01) / (R00^2 + R10^2).
+bool ErrorStateEkf::update_pose2(const Pose2 &pose, const float covariance[9], double *mahalanobis) {
+  const Mat3 &R = state_.rotation;
+  const double n2 = R.m[0] * R.m[0] + R.m[3] * R.m[3];
+  // body x axis vertical: heading undefined
+  if (!(n2 > 1e-6)) return false;
+  Vector<3> r;
+  r[0] = pose.x - state_.position.x;
+  r[1] = pose.y - state_.position.y;
+  r[2] = wrap_angle(static_cast<float>(pose.theta - atan2(R.m[3], R.m[0])));
+  Matrix<3, kStates> H = Matrix<3, kStates>::zero();
+  H(0, kPosition) = 1.0;
+  H(1, kPosition + 1) = 1.0;
+  H(2, kRotation + 1) = (R.m[3] * R.m[2] - R.m[0] * R.m[5]) / n2;
+  H(2, kRotation + 2) = (R.m[0] * R.m[4] - R.m[3] * R.m[1]) / n2;
+  Matrix<3, 3> C;
+  for (int i = 0; i < 9; ++i) C.m[i] = covariance[i];
+  return update(r, H, C, params_.pose_gate, mahalanobis);
+}
+
+// v_body = R^T v; under the error state d(R^T v)/d dtheta = [R^T v]x and
+// d(R^T v)/d dv = R^T.
+bool ErrorStateEkf::update_body_velocity(const Vec3 &velocity, const Matrix<3, 3> &covariance, double *mahalanobis) {
+  const Vec3 predicted = transpose_mul(state_.rotation, state_.velocity);
+  const Vec3 e = velocity - predicted;
+  Vector<3> r;
+  r[0] = e.x;
+  r[1] = e.y;
+  r[2] = e.z;
+  const Mat3 Jtheta = skew(predicted);
+  const Mat3 Jv = transpose(state_.rotation);
+  Matrix<3, kStates> H = Matrix<3, kStates>::zero();
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j) {
+      H(i, kRotation + j) = Jtheta.m[3 * i + j];
+      H(i, kVelocity + j) = Jv.m[3 * i + j];
+    }
+  return update(r, H, covariance, INFINITY, mahalanobis);
+}
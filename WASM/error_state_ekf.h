@@ -0,0 +1,113 @@
+#pragma once
+#include "imu.h"
+#include "imu_preintegration.h"
+#include "pose2.h"
+#include "small_matrix.h"
+#include "so3.h"
+
+// Error-state Kalman filter fusing the IMU with pose and velocity fixes
+// (Sola, "Quaternion kinematics for the error-state Kalman filter"). The
+// nominal state (NavState plus IMU biases) is integrated from every IMU
+// sample; the filter tracks the covariance of a 15-dof error around it,
+//   [rotation (right perturbation), velocity, position, gyro bias, accel bias],
+// and each update folds its estimate of that error back into the nominal
+// state. Measurements are scan-match poses (update_pose2), body velocities
+// such as wheel odometry (update_body_velocity), or any linearized model via
+// update().
+//
+// All matrices are compile-time sized (small_matrix.h) and live in the
+// object, so predict and update never allocate.
+
+struct EkfParams {
+  // noise densities, mount rotation and accelerometer sign, as for
+  // preintegration
+  ImuNoiseParams imu;
+  double gyro_bias_walk = 2e-5;  // rad/s^2/sqrt(Hz)
+  double accel_bias_walk = 2e-4; // m/s^3/sqrt(Hz)
+  Vec3 gravity = kGravity;
+  // chi-square gate on the normalized innovation of pose updates (3 dof,
+  // 99.9%); poses beyond it are rejected as bad matches
+  double pose_gate = 16.27;
+};
+
+class ErrorStateEkf {
+public:
+  static constexpr int kStates = 15;
+  // offsets of each part in the error state
+  static constexpr int kRotation = 0, kVelocity = 3, kPosition = 6, kGyroBias = 9, kAccelBias = 12;
+  using Covariance = Matrix<kStates, kStates>;
+
+  explicit ErrorStateEkf(const EkfParams &params = EkfParams{});
+
+  const EkfParams &params() const { return params_; }
+
+  // starts over at time t from a state, IMU biases (in IMU axes like
+  // ImuBias everywhere) and the covariance of its error
+  void reset(double t, const NavState &state, const ImuBias &bias, const Covariance &covariance);
+  // same with independent per-part standard deviations
+  void reset(double t, const NavState &state, const ImuBias &bias, double sigma_rotation, double sigma_velocity,
+             double sigma_position, double sigma_gyro_bias, double sigma_accel_bias);
+
+  // integrates the previous sample's rates up to this sample's time, then
+  // holds this one; samples not newer than the previous are dropped. A
+  // filter that was never reset starts at its first sample's time.
+  void predict(const IMUData &sample);
+  // integrates the held sample up to time t, e.g. a frame timestamp, before
+  // an update from that frame
+  void predict_to(double t);
+
+  // Kalman update with residual z - h(x) and its Jacobian H with respect to
+  // the error state, measurement noise R. Returns false, changing nothing,
+  // if H P H^T + R is not positive definite or the innovation's squared
+  // Mahalanobis distance exceeds gate; mahalanobis, if given, gets that
+  // distance either way.
+  template <int M>
+  bool update(const Vector<M> &residual, const Matrix<M, kStates> &H, const Matrix<M, M> &R,
+              double gate = INFINITY, double *mahalanobis = nullptr);
+
+  // planar pose fix (ScanMatchResult's pose and covariance, x, y, theta);
+  // false if rejected by pose_gate
+  bool update_pose2(const Pose2 &pose, const float covariance[9], double *mahalanobis = nullptr);
+  // velocity in body axes, e.g. wheel odometry's forward speed with zero
+  // sideways and vertical speed
+  bool update_body_velocity(const Vec3 &velocity, const Matrix<3, 3> &covariance, double *mahalanobis = nullptr);
+
+  double time() const { return time_; }
+  const NavState &state() const { return state_; }
+  ImuBias bias() const;
+  const Covariance &covariance() const { return P_; }
+  Pose2 pose2() const { return planar_pose(state_); }
+
+private:
+  void propagate(const Vec3 &gyro, const Vec3 &accel, double dt);
+  void inject(const Vector<kStates> &dx);
+
+  EkfParams params_;
+  bool started_ = false; // reset or fed a sample
+  double time_ = 0.0;
+  NavState state_;
+  Vec3 bias_gyro_{0, 0, 0}, bias_accel_{0, 0, 0}; // body axes
+  Covariance P_;
+  // the newest sample in body axes
+  bool have_last_ = false;
+  double last_time_ = 0.0;
+  Vec3 last_gyro_{0, 0, 0}, last_accel_{0, 0, 0};
+};
+
+template <int M>
+bool ErrorStateEkf::update(const Vector<M> &residual, const Matrix<M, kStates> &H, const Matrix<M, M> &R,
+                           double gate, double *mahalanobis) {
+  const Matrix<M, kStates> HP = H * P_;
+  Matrix<M, M> Sinv;
+  if (!invert_spd(mul_transpose(HP, H) + R, Sinv)) return false;
+  const double d2 = (transpose(residual) * (Sinv * residual))[0];
+  if (mahalanobis) *mahalanobis = d2;
+  if (!(d2 <= gate)) return false;
+  // P H^T = (H P)^T as P is symmetric
+  const Matrix<kStates, M> K = transpose(HP) * Sinv;
+  // Joseph form keeps P positive definite despite rounding
+  const Covariance IKH = Covariance::identity() - K * H;
+  P_ = mul_transpose(IKH * P_, IKH) + mul_transpose(K * R, K);
+  inject(K * residual);
+  return true;
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include "wasm_utils.h"
+#include "lidar_camera.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Preallocated LiDAR/camera frame slots living in WASM linear memory.
+// The host writes depth + RGB straight into a slot and publishes it;
+// consumers borrow the latest published slot in place (no memcpy).
+//
+// Contract:
+// - exactly one producer (the host) calls acquire_write()/publish()
+// - any number of consumers call borrow_latest(); a borrowed slot is never
+//   overwritten until every FrameRef on it has been released
+// - the latest published slot is never handed to the producer, so a consumer
+//   can always get the newest complete frame
+// - acquire_write() returns nullptr if every other slot is still borrowed,
+//   in which case the host drops that frame
+
+constexpr int FramePoolSlots = 3;
+// iPhone LiDAR depth is 256x192, the camera image is downscaled by the host
+constexpr int MaxDepthWidth = 256;
+constexpr int MaxDepthHeight = 192;
+constexpr int MaxImageWidth = 640;
+constexpr int MaxImageHeight = 480;
+constexpr int MaxImageChannels = 4;
+
+enum FrameSlotState : uint32_t {
+  FRAME_FREE = 0,
+  FRAME_WRITING = 1,
+  FRAME_READY = 2,
+};
+
+struct FrameSlot {
+  std::atomic<uint32_t> state;
+  std::atomic<uint32_t> readers;
+  uint32_t generation; // frame counter assigned on publish, starts at 1
+  double timestamp;
+
+  int32_t depth_width;
+  int32_t depth_height;
+  int32_t image_width;
+  int32_t image_height;
+  int32_t image_channels;
+
+  float depth_map[MaxDepthWidth * MaxDepthHeight];
+  uint8_t image[MaxImageWidth * MaxImageHeight * MaxImageChannels];
+};
+
+class FramePool;
+
+// borrowed, read-only view of one slot; released on destruction
+class FrameRef {
+public:
+  FrameRef() = default;
+  FrameRef(FrameRef &&other) noexcept : slot_(other.slot_) { other.slot_ = nullptr; }
+  FrameRef &operator=(FrameRef &&other) noexcept {
+    if (this != &other) {
+      release();
+      slot_ = other.slot_;
+      other.slot_ = nullptr;
+    }
+    return *this;
+  }
+  FrameRef(const FrameRef &) = delete;
+  FrameRef &operator=(const FrameRef &) = delete;
+  ~FrameRef() { release(); }
+
+  explicit operator bool() const { return slot_ != nullptr; }
+  const FrameSlot *operator->() const { return slot_; }
+  const FrameSlot &operator*() const { return *slot_; }
+
+  // legacy header view; pointers are only valid while this ref is held
+  LidarCameraData view() const {
+    LidarCameraData d{};
+    if (!slot_) return d;
+    d.timestamp = slot_->timestamp;
+    d.depth_map = slot_->depth_map;
+    d.depth_width = slot_->depth_width;
+    d.depth_height = slot_->depth_height;
+    d.image = slot_->image;
+    d.image_width = slot_->image_width;
+    d.image_height = slot_->image_height;
+    d.image_channels = slot_->image_channels;
+    return d;
+  }
+
+  void release() {
+    if (slot_) slot_->readers.fetch_sub(1, std::memory_order_release);
+    slot_ = nullptr;
+  }
+
+private:
+  friend class FramePool;
+  explicit FrameRef(FrameSlot *slot) : slot_(slot) {}
+  FrameSlot *slot_ = nullptr;
+};
+
+class FramePool {
+public:
+  FramePool() {
+    for (auto &s : slots_) {
+      s.state.store(FRAME_FREE, std::memory_order_relaxed);
+      s.readers.store(0, std::memory_order_relaxed);
+      s.generation = 0;
+      s.timestamp = 0.0;
+      s.depth_width = s.depth_height = 0;
+      s.image_width = s.image_height = s.image_channels = 0;
+    }
+  }
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  // producer side
+
+  FrameSlot *acquire_write() {
+    const int32_t latest = latest_.load(std::memory_order_acquire);
+    for (int32_t i = 0; i < FramePoolSlots; ++i) {
+      if (i == latest) continue;
+      FrameSlot &s = slots_[i];
+      uint32_t expected = s.state.load(std::memory_order_relaxed);
+      if (expected == FRAME_WRITING) continue;
+      // claim first, then check for readers; borrow_latest() does the
+      // opposite so one of the two always observes the other
+      if (!s.state.compare_exchange_strong(expected, FRAME_WRITING, std::memory_order_seq_cst)) continue;
+      if (s.readers.load(std::memory_order_seq_cst) != 0) {
+        s.state.store(expected, std::memory_order_release);
+        continue;
+      }
+      return &s;
+    }
+    return nullptr;
+  }
+
+  void publish(FrameSlot *slot, double timestamp) {
+    slot->timestamp = timestamp;
+    slot->generation = published_.load(std::memory_order_relaxed) + 1;
+    slot->state.store(FRAME_READY, std::memory_order_release);
+    latest_.store(static_cast<int32_t>(slot - slots_), std::memory_order_release);
+    published_.store(slot->generation, std::memory_order_release);
+  }
+
+  // consumer side
+
+  // empty ref if nothing has been published yet
+  FrameRef borrow_latest() {
+    for (;;) {
+      const int32_t latest = latest_.load(std::memory_order_acquire);
+      if (latest < 0) return FrameRef();
+      FrameSlot &s = slots_[latest];
+      s.readers.fetch_add(1, std::memory_order_seq_cst);
+      if (s.state.load(std::memory_order_seq_cst) == FRAME_READY) return FrameRef(&s);
+      s.readers.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  // generation of the newest published frame, 0 if none
+  uint32_t latest_generation() const { return published_.load(std::memory_order_acquire); }
+
+private:
+  FrameSlot slots_[FramePoolSlots];
+  std::atomic<int32_t> latest_{-1};
+  std::atomic<uint32_t> published_{0};
+};
+
+// iOS/roamr/FramePoolHost.h fills slots from Swift by these byte offsets
+static_assert(offsetof(FrameSlot, readers) == 4 && offsetof(FrameSlot, generation) == 8 &&
+                  offsetof(FrameSlot, timestamp) == 16 && offsetof(FrameSlot, depth_width) == 24 &&
+                  offsetof(FrameSlot, image_channels) == 40 && offsetof(FrameSlot, depth_map) == 44 &&
+                  offsetof(FrameSlot, image) == 196652 && sizeof(FrameSlot) == 1425456,
+              "FrameSlot layout changed, update iOS/roamr/FramePoolHost.h");
+static_assert(sizeof(FramePool) == FramePoolSlots * sizeof(FrameSlot) + 8,
+              "FramePool layout changed, update iOS/roamr/FramePoolHost.h");
+
+// hands the pool's linear-memory address to the host, which starts filling it
+WASM_IMPORT("host", "attach_frame_pool") void attach_frame_pool(FramePool *pool);
+
+// blocks in the host until a frame newer than after_generation is published
+// or timeout_ms elapses; returns the latest generation either way
+WASM_IMPORT("host", "wait_frame") uint32_t wait_frame(uint32_t after_generation, int32_t timeout_ms);
+
+// returned by wait_frame when the host has no more frames (e.g. a replay ended)
+constexpr uint32_t FrameStreamEnded = 0xFFFFFFFFu;
@@ -11,5 +11,13 @@ struct IMUData {
 
 WASM_IMPORT("host", "read_imu") void read_imu(IMUData* data);
 
+// drains every sample the host buffered since the last call (oldest first),
+// returns how many were written to out (at most max)
+WASM_IMPORT("host", "read_imu_batch") int read_imu_batch(IMUData* out, int max);
+
 constexpr double IMURefreshHz = 100.0;
 constexpr int IMUIntervalMs = static_cast<int>(1000.0 / IMURefreshHz);
+
+// host-side ring holds ~2.5 s at 100 Hz, IMUBatchMax bounds a single drain
+constexpr int IMUHostRingSize = 256;
+constexpr int IMUBatchMax = 32;
@@ -0,0 +1,149 @@
+#include "imu_preintegration.h"
+
+ImuPreintegrator::ImuPreintegrator(const ImuNoiseParams &params) : params_(params) {}
+
+void ImuPreintegrator::reset(double t, const ImuBias &b) {
+  have_last_ = false;
+  last_time_ = 0.0;
+  begin(t, b);
+}
+
+void ImuPreintegrator::begin(double t, const ImuBias &b) {
+  started_ = true;
+  t0_ = t1_ = t;
+  samples_ = 0;
+  bias_ = b;
+  bias_gyro_body_ = params_.imu_to_body * b.gyro;
+  bias_accel_body_ = params_.imu_to_body * b.accel;
+  dR_ = Mat3::identity();
+  dv_ = dp_ = Vec3{0, 0, 0};
+  dR_dbg_ = dv_dbg_ = dv_dba_ = dp_dbg_ = dp_dba_ = Mat3::zero();
+  for (double &c : cov_) c = 0.0;
+}
+
+void ImuPreintegrator::add(const IMUData &sample) {
+  const double t = sample.gyro_timestamp;
+  if (have_last_ && !(t > last_time_)) return;
+  const Vec3 gyro = params_.imu_to_body * Vec3{sample.gyro_x, sample.gyro_y, sample.gyro_z};
+  const Vec3 accel = params_.imu_to_body * (Vec3{sample.acc_x, sample.acc_y, sample.acc_z} * params_.accel_scale);
+  // host timestamps count from boot, so an interval nobody started begins
+  // here rather than at 0
+  if (!started_) begin(t);
+  if (!have_last_) {
+    // the first sample also stands for the time before it
+    have_last_ = true;
+    last_gyro_ = gyro;
+    last_accel_ = accel;
+  }
+  integrate_to(t);
+  last_time_ = t;
+  last_gyro_ = gyro;
+  last_accel_ = accel;
+  if (t > t0_) ++samples_;
+}
+
+int ImuPreintegrator::add(const IMUData *samples, int n, double until) {
+  int i = 0;
+  for (; i < n && !(samples[i].gyro_timestamp > until); ++i) add(samples[i]);
+  return i;
+}
+
+void ImuPreintegrator::integrate_to(double t) {
+  if (!have_last_ || !(t > t1_)) return;
+  integrate(last_gyro_ - bias_gyro_body_, last_accel_ - bias_accel_body_, t - t1_);
+  t1_ = t;
+}
+
+// One zero-order-hold step of Forster et al.'s recursions (their eqs. 35,
+// 63 and appendix B). Everything on the right-hand side is the state before
+// the step, so the Jacobians and covariance are updated before the deltas.
+void ImuPreintegrator::integrate(const Vec3 &w, const Vec3 &a, double dt) {
+  const double dt2 = dt * dt;
+  const Vec3 phi = w * dt;
+  const Mat3 dRinc = so3_exp(phi);
+  const Mat3 dRinc_t = transpose(dRinc);
+  const Mat3 Jr = so3_right_jacobian(phi);
+  const Mat3 Ra = dR_ * skew(a);
+
+  // covariance: S' = A S A^T + B Qg B^T + C Qa C^T with
+  //   A = [dRinc^T 0 0; -Ra dt I 0; -Ra dt^2/2 I dt I],
+  //   B = [Jr dt; 0; 0], C = [0; dR dt; dR dt^2/2]
+  // in 3x3 blocks, row-major (dR, dv, dp)
+  Mat3 S[3][3], T[3][3];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c) S[i][j].m[3 * r + c] = cov_[9 * (3 * i + r) + 3 * j + c];
+  const Mat3 A10 = Ra * -dt, A20 = Ra * (-0.5 * dt2);
+  for (int j = 0; j < 3; ++j) {
+    T[0][j] = dRinc_t * S[0][j];
+    T[1][j] = A10 * S[0][j] + S[1][j];
+    T[2][j] = A20 * S[0][j] + S[1][j] * dt + S[2][j];
+  }
+  const Mat3 A10_t = transpose(A10), A20_t = transpose(A20);
+  for (int i = 0; i < 3; ++i) {
+    S[i][0] = T[i][0] * dRinc;
+    S[i][1] = T[i][0] * A10_t + T[i][1];
+    S[i][2] = T[i][0] * A20_t + T[i][1] * dt + T[i][2];
+  }
+  // discrete noise of the held sample: density^2 / dt
+  const double qg = params_.gyro_noise * params_.gyro_noise / dt;
+  const double qa = params_.accel_noise * params_.accel_noise / dt;
+  S[0][0] += Jr * transpose(Jr) * (qg * dt2);
+  // dR dR^T = I
+  S[1][1] += Mat3::diagonal(qa * dt2);
+  S[1][2] += Mat3::diagonal(qa * 0.5 * dt2 * dt);
+  S[2][1] += Mat3::diagonal(qa * 0.5 * dt2 * dt);
+  S[2][2] += Mat3::diagonal(qa * 0.25 * dt2 * dt2);
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c) cov_[9 * (3 * i + r) + 3 * j + c] = S[i][j].m[3 * r + c];
+
+  // bias Jacobians
+  const Mat3 Ra_dbg = Ra * dR_dbg_;
+  dp_dba_ += dv_dba_ * dt - dR_ * (0.5 * dt2);
+  dp_dbg_ += dv_dbg_ * dt - Ra_dbg * (0.5 * dt2);
+  dv_dba_ -= dR_ * dt;
+  dv_dbg_ -= Ra_dbg * dt;
+  dR_dbg_ = dRinc_t * dR_dbg_ - Jr * dt;
+
+  // deltas
+  const Vec3 acc = dR_ * a;
+  dp_ += dv_ * dt + acc * (0.5 * dt2);
+  dv_ += acc * dt;
+  dR_ = so3_normalize(dR_ * dRinc);
+}
+
+Mat3 ImuPreintegrator::delta_rotation(const ImuBias &b) const {
+  const Vec3 dbg = params_.imu_to_body * b.gyro - bias_gyro_body_;
+  return dR_ * so3_exp(dR_dbg_ * dbg);
+}
+
+Vec3 ImuPreintegrator::delta_velocity(const ImuBias &b) const {
+  const Vec3 dbg = params_.imu_to_body * b.gyro - bias_gyro_body_;
+  const Vec3 dba = params_.imu_to_body * b.accel - bias_accel_body_;
+  return dv_ + dv_dbg_ * dbg + dv_dba_ * dba;
+}
+
+Vec3 ImuPreintegrator::delta_position(const ImuBias &b) const {
+  const Vec3 dbg = params_.imu_to_body * b.gyro - bias_gyro_body_;
+  const Vec3 dba = params_.imu_to_body * b.accel - bias_accel_body_;
+  return dp_ + dp_dbg_ * dbg + dp_dba_ * dba;
+}
+
+static NavState apply(const NavState &s, const Mat3 &dR, const Vec3 &dv, const Vec3 &dp, double T, const Vec3 &g) {
+  NavState out;
+  out.rotation = so3_normalize(s.rotation * dR);
+  out.velocity = s.velocity + g * T + s.rotation * dv;
+  out.position = s.position + s.velocity * T + g * (0.5 * T * T) + s.rotation * dp;
+  return out;
+}
+
+NavState ImuPreintegrator::predict(const NavState &start, const Vec3 &gravity) const {
+  return apply(start, dR_, dv_, dp_, duration(), gravity);
+}
+
+NavState ImuPreintegrator::predict(const NavState &start, const ImuBias &b, const Vec3 &gravity) const {
+  return apply(start, delta_rotation(b), delta_velocity(b), delta_position(b), duration(), gravity);
+}
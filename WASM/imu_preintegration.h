@@ -0,0 +1,143 @@
+#pragma once
+#include "imu.h"
+#include "pose2.h"
+#include "so3.h"
+
+// IMU preintegration on the manifold (Forster et al., "On-Manifold
+// Preintegration for Real-Time Visual-Inertial Odometry"): the gyro and
+// accelerometer samples between two frames are summed, in the body frame at
+// the first one, into a rotation dR, velocity dv and position dp that do not
+// depend on the starting state. A filter or optimizer applies them to any
+// estimate of that state with predict(), and corrects them to first order
+// for a new bias estimate through the bias Jacobians instead of integrating
+// the samples again. The 9x9 covariance of (dR, dv, dp) is propagated with
+// them.
+//
+// Each sample's rates are held from its timestamp until the next sample
+// (gyro_timestamp orders them; the host pushes one per gyro update). A frame
+// boundary splits the sample that straddles it, so consecutive intervals
+// tile time exactly. Everything lives in the object: O(1) work per sample,
+// no heap.
+
+struct ImuNoiseParams {
+  // continuous-time white noise densities, typical of phone MEMS parts
+  double gyro_noise = 2e-4;  // rad/s/sqrt(Hz)
+  double accel_noise = 2e-3; // m/s^2/sqrt(Hz)
+  // IMU axes to body axes, e.g. the phone's Right-Up-Back frame to the
+  // robot's x forward, z up; samples are rotated by it before integrating
+  Mat3 imu_to_body = Mat3::identity();
+  // multiplies accelerometer readings to get specific force (+g up at rest,
+  // what sim_host produces); -1 for raw CoreMotion acceleration, which
+  // points along gravity instead
+  double accel_scale = 1.0;
+};
+
+// in IMU axes like the samples; accel after accel_scale
+struct ImuBias {
+  Vec3 gyro{0, 0, 0};  // rad/s
+  Vec3 accel{0, 0, 0}; // m/s^2
+};
+
+// body pose and velocity in the world frame
+struct NavState {
+  Mat3 rotation = Mat3::identity(); // body to world
+  Vec3 velocity{0, 0, 0};
+  Vec3 position{0, 0, 0};
+};
+
+// world gravity for a z-up world frame
+static const Vec3 kGravity{0.0, 0.0, -9.80665};
+
+class ImuPreintegrator {
+public:
+  // the first interval starts at the first sample added, unless begin() or
+  // reset() starts it before that
+  explicit ImuPreintegrator(const ImuNoiseParams &params = ImuNoiseParams{});
+
+  const ImuNoiseParams &params() const { return params_; }
+
+  // starts the next interval at time t (the end of the last one, normally),
+  // integrating with bias b. The last sample added so far keeps applying
+  // from t until the next one.
+  void begin(double t, const ImuBias &b);
+  void begin(double t) { begin(t, bias_); }
+  // same but also forgets the samples, e.g. after a gap in the stream
+  void reset(double t, const ImuBias &b = ImuBias{});
+
+  // samples in time order; ones not newer than the previous are dropped
+  void add(const IMUData &sample);
+  // adds samples[0..n) up to the first one after time until (e.g. the next
+  // frame's timestamp, so a drained batch can straddle frames); returns how
+  // many were consumed
+  int add(const IMUData *samples, int n, double until = INFINITY);
+  // extends the interval up to time t (a frame timestamp) with the last
+  // sample's rates; nothing happens before the first sample
+  void integrate_to(double t);
+
+  double start_time() const { return t0_; }
+  double end_time() const { return t1_; }
+  double duration() const { return t1_ - t0_; }
+  int sample_count() const { return samples_; } // added within the interval
+  const ImuBias &bias() const { return bias_; }
+
+  // deltas at the integration bias
+  const Mat3 &delta_rotation() const { return dR_; }
+  const Vec3 &delta_velocity() const { return dv_; }
+  const Vec3 &delta_position() const { return dp_; }
+  // covariance of (dR, dv, dp), 9x9 row-major, dR as a right perturbation
+  const double *covariance() const { return cov_; }
+
+  // d(delta)/d(bias) at the integration bias; gyro and accel biases here
+  // are in body axes (imu_to_body * b)
+  const Mat3 &rotation_gyro_jacobian() const { return dR_dbg_; }
+  const Mat3 &velocity_gyro_jacobian() const { return dv_dbg_; }
+  const Mat3 &velocity_accel_jacobian() const { return dv_dba_; }
+  const Mat3 &position_gyro_jacobian() const { return dp_dbg_; }
+  const Mat3 &position_accel_jacobian() const { return dp_dba_; }
+
+  // deltas corrected to first order for bias b instead of bias()
+  Mat3 delta_rotation(const ImuBias &b) const;
+  Vec3 delta_velocity(const ImuBias &b) const;
+  Vec3 delta_position(const ImuBias &b) const;
+
+  // state at end_time() from the state at start_time()
+  NavState predict(const NavState &start, const Vec3 &gravity = kGravity) const;
+  NavState predict(const NavState &start, const ImuBias &b, const Vec3 &gravity = kGravity) const;
+
+private:
+  void integrate(const Vec3 &gyro, const Vec3 &accel, double dt);
+
+  ImuNoiseParams params_;
+  ImuBias bias_;
+  Vec3 bias_gyro_body_{0, 0, 0}, bias_accel_body_{0, 0, 0};
+
+  bool started_ = false; // an interval has begun
+  double t0_ = 0.0, t1_ = 0.0;
+  int samples_ = 0;
+  // the newest sample in body axes, applied from last_time_ onwards
+  bool have_last_ = false;
+  double last_time_ = 0.0;
+  Vec3 last_gyro_{0, 0, 0}, last_accel_{0, 0, 0};
+
+  Mat3 dR_ = Mat3::identity();
+  Vec3 dv_{0, 0, 0}, dp_{0, 0, 0};
+  Mat3 dR_dbg_ = Mat3::zero();
+  Mat3 dv_dbg_ = Mat3::zero(), dv_dba_ = Mat3::zero();
+  Mat3 dp_dbg_ = Mat3::zero(), dp_dba_ = Mat3::zero();
+  double cov_[81] = {};
+};
+
+// Planar pose of a body for the scan matcher: position x, y and the heading
+// of the body's x axis projected on the world's xy plane.
+inline Pose2 planar_pose(const NavState &s) {
+  return Pose2{static_cast<float>(s.position.x), static_cast<float>(s.position.y),
+               static_cast<float>(atan2(s.rotation.m[3], s.rotation.m[0]))};
+}
+
+// Motion prior for ScanMatcher::match: the planar increment the IMU saw
+// between the previous frame (state start) and this one, applied to the
+// previous matched pose.
+inline Pose2 imu_motion_prior(const Pose2 &previous, const NavState &start, const ImuPreintegrator &pre,
+                              const Vec3 &gravity = kGravity) {
+  return compose(previous, between(planar_pose(start), planar_pose(pre.predict(start, gravity))));
+}
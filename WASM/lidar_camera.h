@@ -4,7 +4,8 @@
 #include <stdint.h> // uint8_t
 
 // synchronized LiDAR points and camera image
-// todo: double buffering
+// depth_map/image are borrowed from the host (or a FramePool slot, see
+// frame_pool.h) and are only valid until the next read or release
 struct LidarCameraData {
   double timestamp;
 
@@ -0,0 +1,285 @@
+#include "likelihood_field.h"
+
+#include <algorithm>
+#include <math.h>
+
+static constexpr float kInf = 1e20f;
+
+// floor without a floorf call (libm on baseline x86-64); v must be in int32 range
+static inline int32_t floor_int(float v) {
+  const int32_t i = static_cast<int32_t>(v);
+  return i - (static_cast<float>(i) > v);
+}
+
+static inline uint64_t tile_key(int32_t tx, int32_t ty) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(tx)) << 32) | static_cast<uint32_t>(ty);
+}
+
+// 1D squared distance transform of f (Felzenszwalb & Huttenlocher): d[q] =
+// min over p of (q - p)^2 + f[p], from the lower envelope of the parabolas
+// rooted at every p. v and z hold n and n + 1 entries.
+static void dt1d(const float *f, int n, float *d, int32_t *v, float *z) {
+  int k = 0;
+  v[0] = 0;
+  z[0] = -kInf;
+  z[1] = kInf;
+  for (int q = 1; q < n; ++q) {
+    // kInf is finite, so s stays above z[0] = -kInf and k never drops below 0
+    const float fq = f[q] + static_cast<float>(q) * q;
+    float s;
+    for (;;) {
+      const int p = v[k];
+      s = (fq - (f[p] + static_cast<float>(p) * p)) / (2.0f * (q - p));
+      if (s > z[k]) break;
+      --k;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = kInf;
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (z[k + 1] < q) ++k;
+    const float e = static_cast<float>(q - v[k]);
+    d[q] = e * e + f[v[k]];
+  }
+}
+
+LikelihoodField::LikelihoodField(const LikelihoodFieldParams &params) : params_(params), tiles_(new TileMap) {
+  tile_init(tiles_.get());
+  threshold_ = occ_to_fixed(params_.min_log_odds);
+  if (threshold_ < 1) threshold_ = 1; // unknown cells are never obstacles
+}
+
+LikelihoodField::~LikelihoodField() { tile_release(tiles_.get()); }
+
+void LikelihoodField::set_resolution(float resolution) {
+  if (resolution == resolution_) return;
+  clear();
+  resolution_ = resolution;
+  inv_resolution_ = 1.0f / resolution;
+  // one tile of apron at most, so only the 8 neighbors of a tile can see its cells
+  float cells = params_.max_distance * inv_resolution_;
+  cells = cells < 1.0f ? 1.0f : (cells > TILE_SIZE ? TILE_SIZE : cells);
+  far_ = static_cast<int16_t>(cells * 256.0f + 0.5f);
+  apron_ = static_cast<int32_t>(ceilf(cells));
+}
+
+void LikelihoodField::clear() { tile_reset(tiles_.get()); }
+
+int LikelihoodField::tile_count() const { return tiles_->count; }
+
+int16_t LikelihoodField::cell(int32_t cx, int32_t cy) const {
+  const int16_t *t = tile_get(tiles_.get(), cx >> TILE_SHIFT, cy >> TILE_SHIFT, false);
+  return t ? t[((cy & TILE_MASK) << TILE_SHIFT) | (cx & TILE_MASK)] : far_;
+}
+
+// True if tile (tx, ty) of the grid has other obstacles than the field was
+// computed from (zero cells); box gets the tile-local bounds of the changes.
+bool LikelihoodField::obstacle_changed(OccupancyGrid &grid, int32_t tx, int32_t ty, int32_t box[4]) {
+  const int16_t *occ = tile_get(&grid.tiles, tx, ty, false);
+  const int16_t *d = tile_get(tiles_.get(), tx, ty, false);
+  if (!occ && !d) return false;
+  box[0] = box[1] = TILE_SIZE;
+  box[2] = box[3] = -1;
+  for (int32_t y = 0; y < TILE_SIZE; ++y) {
+    for (int32_t x = 0; x < TILE_SIZE; ++x) {
+      const int32_t i = (y << TILE_SHIFT) | x;
+      const bool now = occ && occ[i] >= threshold_;
+      const bool was = d && d[i] == 0;
+      if (now == was) continue;
+      box[0] = std::min(box[0], x);
+      box[1] = std::min(box[1], y);
+      box[2] = std::max(box[2], x);
+      box[3] = std::max(box[3], y);
+    }
+  }
+  return box[2] >= 0;
+}
+
+void LikelihoodField::add_pending(int32_t tx, int32_t ty, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, TILE_MASK);
+  y1 = std::min(y1, TILE_MASK);
+  if (x0 <= x1 && y0 <= y1) pending_.push_back(Pending{tile_key(tx, ty), x0, y0, x1, y1});
+}
+
+// Recomputes the pending boxes, merging those of the same tile into their
+// bounding box; returns the tiles touched.
+int LikelihoodField::run_pending(OccupancyGrid &grid) {
+  std::sort(pending_.begin(), pending_.end(), [](const Pending &a, const Pending &b) { return a.key < b.key; });
+  int tiles = 0;
+  for (size_t i = 0; i < pending_.size();) {
+    Pending p = pending_[i];
+    for (++i; i < pending_.size() && pending_[i].key == p.key; ++i) {
+      p.x0 = std::min(p.x0, pending_[i].x0);
+      p.y0 = std::min(p.y0, pending_[i].y0);
+      p.x1 = std::max(p.x1, pending_[i].x1);
+      p.y1 = std::max(p.y1, pending_[i].y1);
+    }
+    recompute(grid, static_cast<int32_t>(p.key >> 32), static_cast<int32_t>(static_cast<uint32_t>(p.key)), p.x0, p.y0,
+              p.x1, p.y1);
+    ++tiles;
+  }
+  pending_.clear();
+  return tiles;
+}
+
+int LikelihoodField::update(OccupancyGrid &grid) {
+  if (&grid != source_) return rebuild(grid);
+  set_resolution(grid.resolution);
+  int32_t x0, y0, x1, y1;
+  if (!occ_take_dirty(&grid, &x0, &y0, &x1, &y1)) return 0;
+  pending_.clear();
+  for (int32_t ty = y0 >> TILE_SHIFT; ty <= y1 >> TILE_SHIFT; ++ty) {
+    for (int32_t tx = x0 >> TILE_SHIFT; tx <= x1 >> TILE_SHIFT; ++tx) {
+      int32_t b[4];
+      if (!obstacle_changed(grid, tx, ty, b)) continue;
+      // the cells within max_distance of a change, in this tile and its
+      // neighbors (add_pending drops empty boxes)
+      for (int32_t ny = -1; ny <= 1; ++ny) {
+        for (int32_t nx = -1; nx <= 1; ++nx) {
+          const int32_t ox = nx * TILE_SIZE, oy = ny * TILE_SIZE;
+          add_pending(tx + nx, ty + ny, b[0] - apron_ - ox, b[1] - apron_ - oy, b[2] + apron_ - ox, b[3] + apron_ - oy);
+        }
+      }
+    }
+  }
+  return run_pending(grid);
+}
+
+int LikelihoodField::rebuild(OccupancyGrid &grid) {
+  source_ = &grid;
+  set_resolution(grid.resolution);
+  clear();
+  int32_t x0, y0, x1, y1;
+  occ_take_dirty(&grid, &x0, &y0, &x1, &y1);
+  pending_.clear();
+  for (int32_t i = 0; i < TILE_INDEX_SLOTS; ++i) {
+    const TileSlot &s = grid.tiles.slots[i];
+    if (!s.cells) continue;
+    for (int32_t ny = -1; ny <= 1; ++ny)
+      for (int32_t nx = -1; nx <= 1; ++nx) add_pending(s.tx + nx, s.ty + ny, 0, 0, TILE_MASK, TILE_MASK);
+  }
+  return run_pending(grid);
+}
+
+// Exact truncated EDT of the box (x0, y0)-(x1, y1) of one tile from the
+// obstacles in it and its apron: columns first (the input is stored
+// column-major so they are contiguous), then the box's rows. Columns and
+// rows without obstacles within reach are skipped.
+void LikelihoodField::recompute(OccupancyGrid &grid, int32_t tx, int32_t ty, int32_t x0, int32_t y0, int32_t x1,
+                                int32_t y1) {
+  const int32_t a = apron_;
+  const int32_t w = x1 - x0 + 1 + 2 * a, h = y1 - y0 + 1 + 2 * a;
+  const size_t cells = static_cast<size_t>(w) * h;
+  if (f_.size() < cells) {
+    f_.resize(cells);
+    g_.resize(cells);
+  }
+  const int32_t n = std::max(w, h);
+  v_.resize(n);
+  z_.resize(n + 1);
+
+  const int16_t *src[3][3];
+  for (int32_t j = 0; j < 3; ++j)
+    for (int32_t i = 0; i < 3; ++i) src[j][i] = tile_get(&grid.tiles, tx + i - 1, ty + j - 1, false);
+
+  const int32_t cx0 = tx * TILE_SIZE + x0 - a, cy0 = ty * TILE_SIZE + y0 - a;
+  bool any = false;
+  uint8_t column_has[3 * TILE_SIZE] = {}; // w <= 3 * TILE_SIZE
+  for (int32_t xx = 0; xx < w; ++xx) {
+    const int32_t cx = cx0 + xx;
+    const int32_t ti = (cx >> TILE_SHIFT) - tx + 1, lx = cx & TILE_MASK;
+    float *col = f_.data() + static_cast<size_t>(xx) * h;
+    for (int32_t yy = 0; yy < h; ++yy) {
+      const int32_t cy = cy0 + yy;
+      const int16_t *t = src[(cy >> TILE_SHIFT) - ty + 1][ti];
+      const bool o = t && t[((cy & TILE_MASK) << TILE_SHIFT) | lx] >= threshold_;
+      col[yy] = o ? 0.0f : kInf;
+      column_has[xx] |= o;
+    }
+    any |= column_has[xx] != 0;
+  }
+
+  int16_t *out = tile_get(tiles_.get(), tx, ty, false);
+  if (!any) {
+    // nothing within reach: back to the far value, implicit if not stored
+    if (out)
+      for (int32_t y = y0; y <= y1; ++y) std::fill(out + (y << TILE_SHIFT) + x0, out + (y << TILE_SHIFT) + x1 + 1, far_);
+    return;
+  }
+  if (!out) {
+    out = tile_get(tiles_.get(), tx, ty, true);
+    if (!out) return; // tile limit
+    // an unstored tile had nothing within reach anywhere
+    std::fill(out, out + TILE_CELLS, far_);
+  }
+
+  for (int32_t xx = 0; xx < w; ++xx) {
+    float *g = g_.data() + static_cast<size_t>(xx) * h;
+    if (!column_has[xx]) {
+      std::fill(g, g + h, kInf);
+      continue;
+    }
+    dt1d(f_.data() + static_cast<size_t>(xx) * h, h, g, v_.data(), z_.data());
+  }
+
+  const float far2 = (far_ / 256.0f) * (far_ / 256.0f);
+  float *row = f_.data(); // the input is no longer needed
+  float *d = row + w;
+  for (int32_t y = y0; y <= y1; ++y) {
+    float lo = kInf;
+    for (int32_t xx = 0; xx < w; ++xx) {
+      row[xx] = g_[static_cast<size_t>(xx) * h + a + y - y0];
+      lo = std::min(lo, row[xx]);
+    }
+    int16_t *o = out + (y << TILE_SHIFT);
+    if (lo >= far2) {
+      std::fill(o + x0, o + x1 + 1, far_);
+      continue;
+    }
+    dt1d(row, w, d, v_.data(), z_.data());
+    for (int32_t x = x0; x <= x1; ++x) {
+      const float e = d[a + x - x0];
+      o[x] = e >= far2 ? far_ : static_cast<int16_t>(sqrtf(e) * 256.0f + 0.5f);
+    }
+  }
+}
+
+float LikelihoodField::distance(float x, float y) const {
+  float dx, dy;
+  return distance(x, y, dx, dy);
+}
+
+float LikelihoodField::distance(float x, float y, float &dx, float &dy) const {
+  dx = dy = 0.0f;
+  const float u = x * inv_resolution_ - 0.5f, w = y * inv_resolution_ - 0.5f;
+  if (!(u > (float)-OCC_MAX_CELL && u < (float)OCC_MAX_CELL && w > (float)-OCC_MAX_CELL && w < (float)OCC_MAX_CELL))
+    return far_ * resolution_ / 256.0f;
+  const int32_t i = floor_int(u), j = floor_int(w);
+  const float fa = u - i, fb = w - j;
+  int32_t d00, d10, d01, d11;
+  if ((i & TILE_MASK) != TILE_MASK && (j & TILE_MASK) != TILE_MASK) {
+    // all four in one tile
+    const int16_t *t = tile_get(tiles_.get(), i >> TILE_SHIFT, j >> TILE_SHIFT, false);
+    if (!t) return far_ * resolution_ / 256.0f;
+    const int16_t *p = t + (((j & TILE_MASK) << TILE_SHIFT) | (i & TILE_MASK));
+    d00 = p[0];
+    d10 = p[1];
+    d01 = p[TILE_SIZE];
+    d11 = p[TILE_SIZE + 1];
+  } else {
+    d00 = cell(i, j);
+    d10 = cell(i + 1, j);
+    d01 = cell(i, j + 1);
+    d11 = cell(i + 1, j + 1);
+  }
+  const float scale = resolution_ / 256.0f; // Q8.8 cells -> meters
+  const float top = d00 + (d10 - d00) * fa, bottom = d01 + (d11 - d01) * fa;
+  dx = ((d10 - d00) * (1.0f - fb) + (d11 - d01) * fb) * (1.0f / 256.0f);
+  dy = (bottom - top) * (1.0f / 256.0f);
+  return (top + (bottom - top) * fb) * scale;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "occupancy_grid.h"
+
+// Distance from every cell of an OccupancyGrid to the nearest obstacle cell,
+// so scan scoring is a bilinear lookup instead of a nearest-neighbor search.
+//
+// Obstacles are cells with log-odds >= min_log_odds. Distances are exact
+// Euclidean (Felzenszwalb and Huttenlocher's two-pass transform) between cell
+// centers, truncated at max_distance. The truncation keeps updates local: a
+// changed cell only affects cells within max_distance, so each tile is
+// computed from itself plus a max_distance apron, and an update recomputes
+// only the cells within max_distance of a change. The field is stored in its
+// own tiles, aligned with the grid's, as int16 cells in Q8.8 fixed point
+// (1.0 == one cell); tiles never reached by an obstacle are not stored.
+
+struct LikelihoodFieldParams {
+  float max_distance = 0.3f; // meters, at most one tile (64 cells); farther reads as max_distance
+  float min_log_odds = 2.0f; // natural log-odds for a cell to count as an obstacle
+};
+
+class LikelihoodField {
+public:
+  explicit LikelihoodField(const LikelihoodFieldParams &params = LikelihoodFieldParams{});
+  ~LikelihoodField();
+  LikelihoodField(const LikelihoodField &) = delete;
+  LikelihoodField &operator=(const LikelihoodField &) = delete;
+
+  const LikelihoodFieldParams &params() const { return params_; }
+  float resolution() const { return resolution_; }
+  // max_distance in Q8.8 cells, the value of cells with nothing nearby
+  int16_t far_value() const { return far_; }
+
+  // Brings the field up to date with the cells the grid changed since the
+  // last update (occ_take_dirty, so the field must be the grid's only dirty
+  // consumer). Only tiles whose obstacle set changed, and their neighbors
+  // within max_distance, are recomputed; returns their count. The first
+  // update from a grid rebuilds the whole field. Call rebuild() after
+  // occ_clear().
+  int update(OccupancyGrid &grid);
+
+  // recomputes every tile of the grid, e.g. after loading one
+  int rebuild(OccupancyGrid &grid);
+
+  void clear();
+
+  // distance in Q8.8 cells of cell (cx, cy)
+  int16_t cell(int32_t cx, int32_t cy) const;
+  // cells of tile (tx, ty) like TileMap's, nullptr where everything is far_value()
+  const int16_t *tile(int32_t tx, int32_t ty) const { return tile_get(tiles_.get(), tx, ty, false); }
+
+  // distance in meters at world point (x, y), bilinear between cell centers
+  float distance(float x, float y) const;
+  // same plus its gradient (unit length near obstacles, 0 beyond max_distance)
+  float distance(float x, float y, float &dx, float &dy) const;
+
+  int tile_count() const;
+
+private:
+  // a tile and the inclusive tile-local box of its cells to recompute
+  struct Pending {
+    uint64_t key;
+    int32_t x0, y0, x1, y1;
+  };
+
+  bool obstacle_changed(OccupancyGrid &grid, int32_t tx, int32_t ty, int32_t box[4]);
+  void add_pending(int32_t tx, int32_t ty, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+  int run_pending(OccupancyGrid &grid);
+  void recompute(OccupancyGrid &grid, int32_t tx, int32_t ty, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+  void set_resolution(float resolution);
+
+  LikelihoodFieldParams params_;
+  float resolution_ = 0.0f, inv_resolution_ = 0.0f;
+  int32_t apron_ = 0;  // max_distance in whole cells
+  int16_t far_ = 0;
+  int16_t threshold_ = 0; // min_log_odds in Q8.8
+  const OccupancyGrid *source_ = nullptr;
+  std::unique_ptr<TileMap> tiles_;
+
+  // scratch for recompute: the input (at most (TILE_SIZE + 2 * apron)^2),
+  // column pass output, and the 1D transform's envelope
+  std::vector<float> f_, g_;
+  std::vector<int32_t> v_;
+  std::vector<float> z_;
+  std::vector<Pending> pending_;
+};
@@ -0,0 +1,356 @@
+#include "loop_closure.h"
+
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <stdlib.h>
+
+static const int kLeafSize = 8;
+
+// A verification grid holds each scan once, and neighboring keyframes' rays
+// cross each other's walls: a hit outweighs several misses so those stay.
+static const OccupancyParams kVerifyOccupancy = {256, -32, -512, 896, 100.0f};
+
+LoopClosureDetector::LoopClosureDetector(const LoopClosureParams &params)
+    : params_(params), matcher_(params.match), grid_(new OccupancyGrid) {
+  params_.rings = std::max(params_.rings, 1);
+  params_.sectors = std::max(params_.sectors, 1);
+  params_.neighbors = std::max(params_.neighbors, 1);
+  params_.scan_points = std::min(std::max(params_.scan_points, 3), 65535);
+  cells_ = params_.rings * params_.sectors;
+  query_stats_.resize(2 * params_.sectors);
+  stats_.resize(2 * params_.sectors);
+  occ_init(grid_.get(), params_.resolution);
+  // occ_integrate's ray table: twice the stored points, a power of two
+  size_t keys = 16;
+  while (keys < 2 * static_cast<size_t>(params_.scan_points)) keys *= 2;
+  keys_.resize(keys);
+  xy_.resize(2 * params_.scan_points);
+}
+
+LoopClosureDetector::~LoopClosureDetector() { occ_release(grid_.get()); }
+
+void LoopClosureDetector::describe(const PointCloud &cloud, ScanContext &out) const {
+  const int R = params_.rings, S = params_.sectors;
+  out.cells.assign(cells_, 0);
+  out.ring_key.assign(R, 0.0f);
+  const float max_r2 = params_.max_radius * params_.max_radius;
+  const float ring_scale = R / params_.max_radius;
+  const float sector_scale = S / 6.283185307f;
+  const float z_scale = 255.0f / (params_.max_z - params_.min_z);
+  uint8_t *cells = out.cells.data();
+  for (int i = 0; i < cloud.size; ++i) {
+    const float x = cloud.x[i], y = cloud.y[i];
+    const float r2 = x * x + y * y;
+    if (!(r2 < max_r2)) continue;
+    const float h = (cloud.z[i] - params_.min_z) * z_scale;
+    if (!(h >= 0.5f)) continue;
+    const int ring = std::min(static_cast<int>(sqrtf(r2) * ring_scale), R - 1);
+    const int sector = std::min(static_cast<int>((atan2f(y, x) + 3.141592654f) * sector_scale), S - 1);
+    const uint8_t q = h >= 255.0f ? 255 : static_cast<uint8_t>(h + 0.5f);
+    uint8_t &c = cells[sector * R + ring];
+    if (q > c) c = q;
+  }
+  // Each cell takes the highest of its 3 x 3 neighborhood (sectors wrap
+  // around). At a few meters' range a step to the side moves a wall by a
+  // ring or a sector, and columns of a cell or two would no longer overlap.
+  blur_.assign(cells, cells + cells_);
+  for (int s = 0; s < S; ++s) {
+    const uint8_t *prev = blur_.data() + (s == 0 ? S - 1 : s - 1) * R, *cur = blur_.data() + s * R;
+    const uint8_t *next = blur_.data() + (s + 1 == S ? 0 : s + 1) * R;
+    for (int r = 0; r < R; ++r) {
+      uint8_t m = 0;
+      for (int k = std::max(r - 1, 0); k <= std::min(r + 1, R - 1); ++k) m = std::max(m, std::max(cur[k], std::max(prev[k], next[k])));
+      cells[s * R + r] = m;
+    }
+  }
+  for (int s = 0; s < S; ++s)
+    for (int r = 0; r < R; ++r) out.ring_key[r] += cells[s * R + r];
+  for (float &k : out.ring_key) k /= 255.0f * S;
+}
+
+// per sector, the column's norm and (after all of them) its sum
+void LoopClosureDetector::column_stats(const uint8_t *cells, float *stats) const {
+  const int R = params_.rings, S = params_.sectors;
+  for (int s = 0; s < S; ++s) {
+    const uint8_t *col = cells + s * R;
+    int32_t sum = 0, sq = 0;
+    for (int r = 0; r < R; ++r) {
+      sum += col[r];
+      sq += col[r] * col[r];
+    }
+    stats[s] = sqrtf(static_cast<float>(sq));
+    stats[S + s] = static_cast<float>(sum);
+  }
+}
+
+// Kim and Kim's distance: one minus the mean cosine between corresponding
+// columns. The mean is over the columns either context has, so a shift
+// that overlaps only a few of them is no shortcut (a depth camera's field
+// of view fills a fraction of the sectors). The sector sums, compared at
+// every shift, find the alignment; the full distance is taken around it.
+float LoopClosureDetector::aligned_distance(const uint8_t *q, const float *q_stats, const uint8_t *c,
+                                            const float *c_stats, int *shift) const {
+  const int R = params_.rings, S = params_.sectors;
+  const float *q_sum = q_stats + S, *c_sum = c_stats + S;
+  int coarse = 0;
+  float coarse_cost = INFINITY;
+  for (int sh = 0; sh < S; ++sh) {
+    float cost = 0.0f;
+    for (int j = 0, k = sh; j < S; ++j, k = k + 1 == S ? 0 : k + 1) cost += fabsf(q_sum[j] - c_sum[k]);
+    if (cost < coarse_cost) {
+      coarse_cost = cost;
+      coarse = sh;
+    }
+  }
+  int nq = 0, nc = 0;
+  for (int j = 0; j < S; ++j) {
+    nq += q_stats[j] > 0.0f;
+    nc += c_stats[j] > 0.0f;
+  }
+  if (shift) *shift = coarse;
+  if (nq == 0 || nc == 0) return 1.0f;
+  const float inv_columns = 1.0f / std::max(nq, nc);
+
+  float best = INFINITY;
+  const int yaw = std::min(params_.yaw_search, (S - 1) / 2);
+  for (int d = -yaw; d <= yaw; ++d) {
+    const int sh = ((coarse + d) % S + S) % S;
+    float sum = 0.0f;
+    for (int j = 0, k = sh; j < S; ++j, k = k + 1 == S ? 0 : k + 1) {
+      if (q_stats[j] == 0.0f || c_stats[k] == 0.0f) continue;
+      const uint8_t *a = q + j * R, *b = c + k * R;
+      int32_t dot = 0;
+      for (int r = 0; r < R; ++r) dot += a[r] * b[r];
+      sum += dot / (q_stats[j] * c_stats[k]);
+    }
+    const float dist = 1.0f - sum * inv_columns;
+    if (dist < best) {
+      best = dist;
+      if (shift) *shift = sh;
+    }
+  }
+  return std::max(best, 0.0f);
+}
+
+float LoopClosureDetector::distance(const ScanContext &a, const ScanContext &b, int *shift) const {
+  std::vector<float> sa(2 * params_.sectors), sb(2 * params_.sectors);
+  column_stats(a.cells.data(), sa.data());
+  column_stats(b.cells.data(), sb.data());
+  return aligned_distance(a.cells.data(), sa.data(), b.cells.data(), sb.data(), shift);
+}
+
+int LoopClosureDetector::add(int id, const Pose2 &pose, const ScanContext &context, const Scan2D &scan) {
+  Keyframe k;
+  k.id = id;
+  k.pose = pose;
+  k.scan_begin = static_cast<uint32_t>(scan_xy_.size() / 2);
+  // an even spread over the scan, in centimeters
+  const int n = std::min(scan.size, params_.scan_points);
+  k.scan_size = static_cast<uint16_t>(n);
+  k.occupied = static_cast<uint16_t>(cells_ - std::count(context.cells.begin(), context.cells.end(), 0));
+  for (int i = 0; i < n; ++i) {
+    const int j = static_cast<int>(static_cast<int64_t>(i) * scan.size / n);
+    const float x = std::min(std::max(scan.x[j] * 100.0f, -32767.0f), 32767.0f);
+    const float y = std::min(std::max(scan.y[j] * 100.0f, -32767.0f), 32767.0f);
+    scan_xy_.push_back(static_cast<int16_t>(lrintf(x)));
+    scan_xy_.push_back(static_cast<int16_t>(lrintf(y)));
+  }
+  keyframes_.push_back(k);
+  contexts_.insert(contexts_.end(), context.cells.begin(), context.cells.end());
+  ring_keys_.insert(ring_keys_.end(), context.ring_key.begin(), context.ring_key.end());
+  if (size() - indexed_ >= params_.rebuild_interval) rebuild_tree();
+  return size() - 1;
+}
+
+// Median splits on the dimension with the widest spread, down to small leaves.
+void LoopClosureDetector::rebuild_tree() {
+  const int R = params_.rings;
+  indexed_ = size();
+  order_.resize(indexed_);
+  for (int i = 0; i < indexed_; ++i) order_[i] = i;
+  nodes_.clear();
+  nodes_.push_back(KdNode{0, 0.0f, -1, 0, indexed_});
+  std::vector<int> stack(1, 0);
+  const float *keys = ring_keys_.data();
+  while (!stack.empty()) {
+    const int index = stack.back();
+    stack.pop_back();
+    const int begin = nodes_[index].begin, end = nodes_[index].end;
+    if (end - begin <= kLeafSize) continue;
+    int dim = 0;
+    float spread = -1.0f;
+    for (int d = 0; d < R; ++d) {
+      float lo = INFINITY, hi = -INFINITY;
+      for (int i = begin; i < end; ++i) {
+        const float v = keys[order_[i] * R + d];
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+      }
+      if (hi - lo > spread) {
+        spread = hi - lo;
+        dim = d;
+      }
+    }
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                     [keys, R, dim](int a, int b) { return keys[a * R + dim] < keys[b * R + dim]; });
+    const int child = static_cast<int>(nodes_.size());
+    KdNode &n = nodes_[index];
+    n.dim = dim;
+    n.split = keys[order_[mid] * R + dim];
+    n.child = child;
+    nodes_.push_back(KdNode{0, 0.0f, -1, begin, mid});
+    nodes_.push_back(KdNode{0, 0.0f, -1, mid, end});
+    stack.push_back(child);
+    stack.push_back(child + 1);
+  }
+}
+
+// keeps nearest_ the neighbors closest keys so far, ascending
+void LoopClosureDetector::consider(int keyframe, const float *key) {
+  const int R = params_.rings;
+  const float *k = ring_keys_.data() + static_cast<size_t>(keyframe) * R;
+  float d2 = 0.0f;
+  for (int r = 0; r < R; ++r) d2 += (key[r] - k[r]) * (key[r] - k[r]);
+  const std::pair<float, int> e(d2, keyframe);
+  if (static_cast<int>(nearest_.size()) < params_.neighbors) {
+    nearest_.insert(std::upper_bound(nearest_.begin(), nearest_.end(), e), e);
+  } else if (d2 < nearest_.back().first) {
+    nearest_.pop_back();
+    nearest_.insert(std::upper_bound(nearest_.begin(), nearest_.end(), e), e);
+  }
+}
+
+// Best-bin first: the nearest leaf, then the other branches by their
+// distance from the query along the splits that separate them, until
+// max_checks keys were compared or no branch can hold a closer one.
+int LoopClosureDetector::rank(const ScanContext &context) {
+  ranked_.clear();
+  nearest_.clear();
+  last_checks_ = 0;
+  limit_ = size() - params_.exclude_recent;
+  if (limit_ <= 0 || cells_ - std::count(context.cells.begin(), context.cells.end(), 0) < params_.min_cells) return 0;
+  const float *q = context.ring_key.data();
+  typedef std::pair<float, int> Entry;
+  if (!nodes_.empty()) {
+    heap_.clear();
+    heap_.push_back(Entry(0.0f, 0));
+    while (!heap_.empty() && last_checks_ < params_.max_checks) {
+      std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+      const Entry top = heap_.back();
+      heap_.pop_back();
+      if (static_cast<int>(nearest_.size()) == params_.neighbors && top.first >= nearest_.back().first) break;
+      int node = top.second;
+      while (nodes_[node].child >= 0) {
+        const KdNode &n = nodes_[node];
+        const float diff = q[n.dim] - n.split;
+        heap_.push_back(Entry(std::max(top.first, diff * diff), n.child + (diff < 0.0f ? 1 : 0)));
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+        node = n.child + (diff < 0.0f ? 0 : 1);
+      }
+      for (int i = nodes_[node].begin; i < nodes_[node].end; ++i) {
+        if (order_[i] >= limit_) continue;
+        consider(order_[i], q);
+        ++last_checks_;
+      }
+    }
+  }
+  // keyframes since the last rebuild
+  for (int k = indexed_; k < limit_; ++k, ++last_checks_) consider(k, q);
+
+  column_stats(context.cells.data(), query_stats_.data());
+  for (const Entry &e : nearest_) {
+    if (keyframes_[e.second].occupied < params_.min_cells) continue;
+    const uint8_t *c = contexts_.data() + static_cast<size_t>(e.second) * cells_;
+    column_stats(c, stats_.data());
+    LoopCandidate cand;
+    cand.keyframe = e.second;
+    cand.distance = aligned_distance(context.cells.data(), query_stats_.data(), c, stats_.data(), &cand.shift);
+    if (cand.distance < params_.max_distance) ranked_.push_back(cand);
+  }
+  std::sort(ranked_.begin(), ranked_.end(),
+            [](const LoopCandidate &a, const LoopCandidate &b) { return a.distance < b.distance; });
+  return static_cast<int>(ranked_.size());
+}
+
+int LoopClosureDetector::candidates(const ScanContext &context, LoopCandidate *out, int max) {
+  const int n = std::min(rank(context), max);
+  std::copy(ranked_.begin(), ranked_.begin() + n, out);
+  return n;
+}
+
+bool LoopClosureDetector::query(const ScanContext &context, const Scan2D &scan, const Pose2 &pose,
+                                LoopClosure &out) {
+  bool matched = false;
+  if (scan.size >= params_.min_scan_points) {
+    const int n = std::min(rank(context), params_.verify);
+    for (int i = 0; i < n && !matched; ++i) matched = verify(ranked_[i], scan, out);
+  }
+  if (!matched) {
+    streak_ = 0;
+    return false;
+  }
+  // A lookalike rarely fools the match twice in a row the same way: count
+  // consecutive keyframes (one added between queries) whose matches agree
+  // with the odometry between them. Going from the previous query to its
+  // keyframe, over to this one's keyframe and back to this query should be
+  // the step the odometry took.
+  bool follows = streak_ > 0 && size() == streak_size_ + 1 &&
+                 std::abs(out.keyframe - streak_keyframe_) <= params_.consistency_window;
+  if (follows) {
+    const Pose2 across = between(keyframes_[streak_keyframe_].pose, keyframes_[out.keyframe].pose);
+    const Pose2 step = compose(compose(inverse(streak_relative_), across), out.relative);
+    const Pose2 odometry = between(streak_pose_, pose);
+    follows = hypotf(step.x - odometry.x, step.y - odometry.y) <= params_.consistency_xy &&
+              fabsf(wrap_angle(step.theta - odometry.theta)) <= params_.consistency_theta;
+  }
+  streak_ = follows ? streak_ + 1 : 1;
+  streak_size_ = size();
+  streak_keyframe_ = out.keyframe;
+  streak_relative_ = out.relative;
+  streak_pose_ = pose;
+  return streak_ > params_.confirmations;
+}
+
+// The candidate's scan and its neighbors', placed by the keyframe poses
+// relative to it, make a small grid in its frame; the query scan is matched
+// there from the candidate's origin at the heading the sector shift gives.
+bool LoopClosureDetector::verify(const LoopCandidate &c, const Scan2D &scan, LoopClosure &out) {
+  const Keyframe &k = keyframes_[c.keyframe];
+  occ_clear(grid_.get());
+  const int first = std::max(c.keyframe - params_.context_frames, 0);
+  const int last = std::min(c.keyframe + params_.context_frames, size() - 1);
+  for (int j = first; j <= last; ++j) {
+    const Keyframe &f = keyframes_[j];
+    const Pose2 rel = between(k.pose, f.pose);
+    const float cs = cosf(rel.theta), sn = sinf(rel.theta);
+    const int16_t *p = scan_xy_.data() + 2 * static_cast<size_t>(f.scan_begin);
+    for (int i = 0; i < f.scan_size; ++i) {
+      const float x = 0.01f * p[2 * i], y = 0.01f * p[2 * i + 1];
+      xy_[2 * i] = rel.x + cs * x - sn * y;
+      xy_[2 * i + 1] = rel.y + sn * x + cs * y;
+    }
+    occ_integrate(grid_.get(), &kVerifyOccupancy, rel.x, rel.y, xy_.data(), f.scan_size, keys_.data(),
+                  static_cast<int32_t>(keys_.size()));
+  }
+  matcher_.reset_map(*grid_, 0.0f, 0.0f, params_.max_radius + params_.match.linear_window);
+  const float theta = wrap_angle(c.shift * 6.283185307f / params_.sectors);
+  const ScanMatchResult r = matcher_.match(scan, Pose2{0.0f, 0.0f, theta});
+  if (!r.ok || r.inliers < params_.min_inliers * scan.size) return false;
+  // the window bounds the correlative search, not ICP, which can slide off
+  // along a wall
+  const float window = params_.match.linear_window;
+  if (fabsf(r.pose.x) > window || fabsf(r.pose.y) > window) return false;
+  // larger eigenvalue of the position covariance
+  const float a = r.covariance[0], b = r.covariance[1], d = r.covariance[4];
+  const float worst = 0.5f * (a + d) + sqrtf(0.25f * (a - d) * (a - d) + b * b);
+  if (!(worst <= params_.max_sigma * params_.max_sigma)) return false;
+  out.keyframe = c.keyframe;
+  out.id = k.id;
+  out.relative = r.pose;
+  std::copy(r.covariance, r.covariance + 9, out.covariance);
+  out.distance = c.distance;
+  out.score = r.score;
+  return true;
+}
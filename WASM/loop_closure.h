@@ -0,0 +1,194 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "depth_projection.h"
+#include "occupancy_grid.h"
+#include "pose2.h"
+#include "scan_matcher.h"
+
+// Place recognition for loop closure: has the robot been here before, and
+// where is it relative to that earlier keyframe?
+//
+// A keyframe is summarized by its scan context (Kim and Kim, 2018): the
+// robot-frame cloud binned into a polar grid of rings (range) by sectors
+// (bearing), each cell holding the height of its highest point, then dilated
+// by a 3 x 3 max so a view a little off the keyframe's still lands on its
+// cells. Turning the robot only rotates the sectors, so
+//   - the ring key, every ring's mean over its sectors, ignores heading and
+//     indexes the keyframes in a k-d tree;
+//   - two contexts are compared at the sector shift that lines them up best,
+//     which is also the heading between them.
+// A query takes the keyframes with the nearest ring keys from the tree
+// (best-bin first with a bounded number of checks, so its cost stays put as
+// the database grows), ranks them by context distance and verifies the best
+// few by matching the query scan against a grid of the candidate's stored
+// scans (ScanMatcher). A verified match is one that most of the scan fits
+// and that pins the pose down in every direction (a corridor or a lone wall
+// fits anywhere along itself); it is only reported once the keyframes just
+// before matched the same stretch of the old trajectory and agree with
+// odometry about where. Its relative pose and covariance make a
+// PoseGraphEdge.
+//
+// A depth camera sees a narrow wedge, which makes for a thin context; a
+// keyframe's cloud is best the frames since the previous keyframe merged
+// into its robot frame.
+//
+// The tree is rebuilt every rebuild_interval keyframes and the newer ones
+// are scanned linearly until then. A keyframe takes about 1.8 KB with the
+// defaults: the context as bytes, the ring key and up to 128 scan points in
+// centimeters.
+
+// ScanMatcher settings for verification grids, which hold a handful of scans
+// integrated once each: a single hit makes an obstacle, and the window covers
+// revisits up to a meter off the keyframe and a sector's worth of heading.
+// There is no odometry between the two, so the prior barely pulls.
+inline ScanMatchParams loop_match_params() {
+  ScanMatchParams p;
+  p.linear_window = 1.0f;
+  p.angular_window = 0.15f;
+  p.min_score = 0.85f;
+  p.prior_sigma_xy = 10.0f;
+  p.prior_sigma_theta = 1.0f;
+  p.field.min_log_odds = 0.5f;
+  return p;
+}
+
+struct LoopClosureParams {
+  // scan context
+  int rings = 10;
+  int sectors = 60;
+  float max_radius = 5.0f; // meters; the depth cloud's reach
+  // robot-frame heights mapped onto a cell's 1..255; min_z just above the
+  // floor leaves cells with only ground returns empty
+  float min_z = -1.2f;
+  float max_z = 1.8f;
+  // retrieval
+  int exclude_recent = 50;    // the newest keyframes are the current place, not a loop
+  int neighbors = 50;         // nearest ring keys ranked by context distance
+  int max_checks = 512;       // ring keys the tree search compares per query
+  int rebuild_interval = 256; // keyframes added between tree rebuilds
+  float max_distance = 0.25f; // context distance in [0, 1] a candidate must be under
+  int min_cells = 40;         // occupied cells a context needs; sparse views all look alike
+  int yaw_search = 2;         // sectors tried either side of the sector-key alignment
+  // verification
+  int verify = 3;            // best candidates matched at most
+  int context_frames = 2;    // keyframes either side of a candidate in its grid
+  int scan_points = 128;     // stored per keyframe
+  int min_scan_points = 100; // query scan points needed to verify at all
+  float min_inliers = 0.8f;  // share of them on the candidate's obstacles after the match
+  float max_sigma = 0.1f;    // meters, position uncertainty of the match along its worst direction
+  float resolution = 0.05f;  // verification grid, meters per cell
+  ScanMatchParams match = loop_match_params();
+  // consistency
+  int confirmations = 1;         // consistent matches of the keyframes just before a query to report it
+  int consistency_window = 3;    // keyframes apart their matches may be
+  float consistency_xy = 0.1f;   // meters and radians their relative poses may disagree with odometry
+  float consistency_theta = 0.05f;
+};
+
+// sector-major (sectors x rings) cell heights and the ring key
+struct ScanContext {
+  std::vector<uint8_t> cells;
+  std::vector<float> ring_key;
+};
+
+struct LoopCandidate {
+  int keyframe;   // index in add order
+  float distance; // context distance in [0, 1]
+  int shift;      // query sector j lines up with keyframe sector j + shift
+};
+
+struct LoopClosure {
+  int keyframe;        // index in add order
+  int id;              // the id it was added with, e.g. its pose-graph node
+  Pose2 relative;      // query pose in the keyframe's frame, the edge keyframe -> query
+  float covariance[9]; // of relative, x, y, theta row-major, from the scan match
+  float distance;      // context distance
+  float score;         // scan match score
+};
+
+class LoopClosureDetector {
+public:
+  explicit LoopClosureDetector(const LoopClosureParams &params = LoopClosureParams{});
+  ~LoopClosureDetector();
+  LoopClosureDetector(const LoopClosureDetector &) = delete;
+  LoopClosureDetector &operator=(const LoopClosureDetector &) = delete;
+
+  const LoopClosureParams &params() const { return params_; }
+  int size() const { return static_cast<int>(keyframes_.size()); }
+
+  // scan context of a robot-frame cloud; reuses out's storage
+  void describe(const PointCloud &cloud, ScanContext &out) const;
+  // context distance in [0, 1] between a and b at their best sector shift
+  float distance(const ScanContext &a, const ScanContext &b, int *shift = nullptr) const;
+
+  // stores a keyframe (its pose only places its neighbors' scans relative to
+  // it, so odometry will do); returns its index
+  int add(int id, const Pose2 &pose, const ScanContext &context, const Scan2D &scan);
+
+  // up to max keyframes under max_distance, closest first; returns the count
+  int candidates(const ScanContext &context, LoopCandidate *out, int max);
+  // verifies the best candidates in order and sets out to the first the
+  // query scan matches; true if the queries of the confirmations keyframes
+  // added just before matched consistently with it. Query each keyframe
+  // before adding it, with the pose it will be added with.
+  bool query(const ScanContext &context, const Scan2D &scan, const Pose2 &pose, LoopClosure &out);
+
+  // ring keys the last candidates() compared, tree and linear tail
+  int last_checks() const { return last_checks_; }
+
+private:
+  struct Keyframe {
+    int id;
+    Pose2 pose;
+    uint32_t scan_begin; // into scan_xy_, pairs
+    uint16_t scan_size;
+    uint16_t occupied; // context cells
+  };
+  // a leaf when child < 0, over order_[begin, end); else children child and child + 1
+  struct KdNode {
+    int dim;
+    float split;
+    int child;
+    int begin, end;
+  };
+
+  void rebuild_tree();
+  int rank(const ScanContext &context);
+  void consider(int keyframe, const float *key);
+  void column_stats(const uint8_t *cells, float *stats) const;
+  float aligned_distance(const uint8_t *q, const float *q_stats, const uint8_t *c, const float *c_stats,
+                         int *shift) const;
+  bool verify(const LoopCandidate &c, const Scan2D &scan, LoopClosure &out);
+
+  LoopClosureParams params_;
+  int cells_ = 0; // rings * sectors
+
+  std::vector<Keyframe> keyframes_;
+  std::vector<uint8_t> contexts_; // cells_ per keyframe
+  std::vector<float> ring_keys_;  // rings per keyframe
+  std::vector<int16_t> scan_xy_;  // centimeters, x, y pairs
+
+  std::vector<KdNode> nodes_;
+  std::vector<int> order_;
+  int indexed_ = 0; // keyframes in the tree
+
+  // query scratch
+  std::vector<std::pair<float, int>> heap_; // bound, node
+  std::vector<std::pair<float, int>> nearest_; // squared ring-key distance, keyframe, ascending
+  int limit_ = 0, last_checks_ = 0;
+  // the run of consistent matches so far and the last of them, see query()
+  int streak_ = 0, streak_size_ = 0, streak_keyframe_ = 0;
+  Pose2 streak_relative_{}, streak_pose_{};
+  std::vector<float> query_stats_, stats_; // per sector: column norm, then column sum
+  std::vector<LoopCandidate> ranked_;
+  mutable std::vector<uint8_t> blur_; // describe()'s unblurred cells
+
+  ScanMatcher matcher_;
+  std::unique_ptr<OccupancyGrid> grid_;
+  std::vector<float> xy_;
+  std::vector<uint32_t> keys_;
+};
@@ -2,6 +2,9 @@
 // Coordinate space: inputs are (x, y, theta) in meters; we autoscale to fit.
 #include <stdint.h>
 #include <float.h>
+#include "map.h"
+#include "map_simd.h"
+#include "occupancy_grid.h"
 
 extern "C" {
 
@@ -13,23 +16,51 @@ void log_pose_f32(float x, float y, float theta) {
 // Pose storage
 static const int32_t MAX_POSES = 4096;
 static float POSES[3 * MAX_POSES]; // x,y,theta triples
+static int32_t POSES_COUNT = 0;
 
 // Image buffer (RGBA8888)
 static const int32_t MAX_W = 512;
 static const int32_t MAX_H = 512;
-static uint8_t IMAGE[MAX_W * MAX_H * 4];
+alignas(16) static uint8_t IMAGE[MAX_W * MAX_H * 4];
 static int32_t CUR_W = 256;
 static int32_t CUR_H = 256;
 
+// see ImageDescriptor in map.h
+static ImageDescriptor IMAGE_DESC = {256, 256, 256 * 4, IMAGE_FORMAT_RGBA8888, 0, 0, 0, 0, 0};
+
+static void mark_dirty(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+	ImageDescriptor& d = IMAGE_DESC;
+	if (d.dirty_x0 >= d.dirty_x1) {
+		d.dirty_x0 = x0; d.dirty_y0 = y0; d.dirty_x1 = x1; d.dirty_y1 = y1;
+		return;
+	}
+	if (x0 < d.dirty_x0) d.dirty_x0 = x0;
+	if (y0 < d.dirty_y0) d.dirty_y0 = y0;
+	if (x1 > d.dirty_x1) d.dirty_x1 = x1;
+	if (y1 > d.dirty_y1) d.dirty_y1 = y1;
+}
+
 // LiDAR points storage (2D projection x,y)
 static const int32_t MAX_POINTS = 20000;
 static float POINTS[2 * MAX_POINTS];
 static int32_t POINTS_COUNT = 0;
 
+// Incremental renderer state: what is already on the canvas and the data box
+// the current transform was fitted to (before padding).
+static bool INC_VALID = false;
+static int32_t INC_POSES = 0;
+static int32_t INC_POINTS = 0;
+static float INC_MINX, INC_MINY, INC_MAXX, INC_MAXY;
+// Extra room added on every side on a full redraw, as a fraction of the data
+// extent, so steady exploration does not force a redraw per frame.
+static const float INC_GROW_MARGIN = 0.25f;
+
 void reset_poses() {
 	for (int32_t i = 0; i < 3 * MAX_POSES; ++i) {
 		POSES[i] = 0.0f;
 	}
+	POSES_COUNT = 0;
+	INC_VALID = false;
 }
 
 void reset_points() {
@@ -37,6 +68,7 @@ void reset_points() {
 		POINTS[i] = 0.0f;
 	}
 	POINTS_COUNT = 0;
+	INC_VALID = false;
 }
 
 // Set a single pose at index (0-based). Extra indices are ignored.
@@ -46,6 +78,8 @@ void set_pose(int32_t idx, float x, float y, float theta) {
 	POSES[base + 0] = x;
 	POSES[base + 1] = y;
 	POSES[base + 2] = theta;
+	if (idx < INC_POSES) INC_VALID = false; // already on the canvas
+	if (idx + 1 > POSES_COUNT) POSES_COUNT = idx + 1;
 }
 
 // Set a single LiDAR point at index (0-based).
@@ -54,110 +88,128 @@ void set_point(int32_t idx, float x, float y) {
 	int32_t base = idx * 2;
 	POINTS[base + 0] = x;
 	POINTS[base + 1] = y;
+	if (idx < INC_POINTS) INC_VALID = false; // already on the canvas
 	if (idx + 1 > POINTS_COUNT) POINTS_COUNT = idx + 1;
 }
 
+// Bulk upload: the host memcpys a whole trajectory/scan into linear memory at
+// these addresses (x,y,theta triples / x,y pairs, up to the capacity) and then
+// commits the element count, instead of one set_pose/set_point call per element.
+float* get_poses_buffer() { return POSES; }
+float* get_points_buffer() { return POINTS; }
+int32_t get_poses_capacity() { return MAX_POSES; }
+int32_t get_points_capacity() { return MAX_POINTS; }
+
+// Returns the clamped count actually committed.
+int32_t commit_poses(int32_t count) {
+	if (count < 0) count = 0;
+	if (count > MAX_POSES) count = MAX_POSES;
+	POSES_COUNT = count;
+	return count;
+}
+
+int32_t commit_points(int32_t count) {
+	if (count < 0) count = 0;
+	if (count > MAX_POINTS) count = MAX_POINTS;
+	POINTS_COUNT = count;
+	return count;
+}
+
+int32_t get_pose_count() { return POSES_COUNT; }
+int32_t get_point_count() { return POINTS_COUNT; }
+
 static inline int32_t clampi(int32_t v, int32_t lo, int32_t hi) {
 	return v < lo ? lo : (v > hi ? hi : v);
 }
 
-// Very simple nearest-neighbor mapping: autoscale poses to fit into WxH canvas,
-// center them, and plot white pixels. Theta is currently unused for rendering.
-void draw_map(int32_t poseCount, int32_t pointCount, int32_t width, int32_t height) {
-	if (poseCount < 0) poseCount = 0;
-	if (poseCount > MAX_POSES) poseCount = MAX_POSES;
-	if (pointCount < 0) pointCount = 0;
-	if (pointCount > MAX_POINTS) pointCount = MAX_POINTS;
-	if (width <= 0) width = 256;
-	if (height <= 0) height = 256;
-	if (width > MAX_W) width = MAX_W;
-	if (height > MAX_H) height = MAX_H;
-	CUR_W = width;
-	CUR_H = height;
-	const int32_t stride = CUR_W * 4;
-
-	// Clear to black
-	for (int32_t y = 0; y < CUR_H; ++y) {
-		for (int32_t x = 0; x < CUR_W; ++x) {
-			int32_t o = y * stride + x * 4;
-			IMAGE[o + 0] = 0; // R
-			IMAGE[o + 1] = 0; // G
-			IMAGE[o + 2] = 0; // B
-			IMAGE[o + 3] = 255; // A
-		}
-	}
+// World -> pixel transform shared by the full and incremental renderers.
+static float VIEW_CX = 0.0f, VIEW_CY = 0.0f, VIEW_SCALE = 1.0f;
 
-	// Compute bounds
-	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+// Bounds over poses [p0, p1) and points [q0, q1). Returns false if empty.
+static bool compute_bounds(int32_t p0, int32_t p1, int32_t q0, int32_t q1,
+                           float* minX, float* minY, float* maxX, float* maxY) {
 	bool any = false;
-	for (int32_t i = 0; i < poseCount; ++i) {
+	for (int32_t i = p0; i < p1; ++i) {
 		int32_t base = i * 3;
 		float px = POSES[base + 0];
 		float py = POSES[base + 1];
 		if (px == 0.0f && py == 0.0f && POSES[base + 2] == 0.0f) continue; // treat zeroed as empty
-		if (px < minX) minX = px;
-		if (py < minY) minY = py;
-		if (px > maxX) maxX = px;
-		if (py > maxY) maxY = py;
+		if (px < *minX) *minX = px;
+		if (py < *minY) *minY = py;
+		if (px > *maxX) *maxX = px;
+		if (py > *maxY) *maxY = py;
 		any = true;
 	}
-	for (int32_t i = 0; i < pointCount; ++i) {
-		int32_t base = i * 2;
-		float px = POINTS[base + 0];
-		float py = POINTS[base + 1];
-		if (px < minX) minX = px;
-		if (py < minY) minY = py;
-		if (px > maxX) maxX = px;
-		if (py > maxY) maxY = py;
+	if (q1 > q0) {
+		simd_bounds_xy(POINTS + 2 * q0, q1 - q0, minX, minY, maxX, maxY);
 		any = true;
 	}
-	if (!any) return;
+	return any;
+}
 
-	// Pad bounds a bit
-	const float pad = 0.05f;
-	float dx = maxX - minX;
-	float dy = maxY - minY;
+// Pads the bounds by `pad` of their extent on each side and fits them into
+// the canvas, keeping aspect ratio. Bounds are updated to the padded box.
+static void set_view(float* minX, float* minY, float* maxX, float* maxY, float pad) {
+	float dx = *maxX - *minX;
+	float dy = *maxY - *minY;
 	if (dx <= 0.0f) dx = 1.0f;
 	if (dy <= 0.0f) dy = 1.0f;
-	minX -= dx * pad; maxX += dx * pad;
-	minY -= dy * pad; maxY += dy * pad;
-	dx = maxX - minX; dy = maxY - minY;
+	*minX -= dx * pad; *maxX += dx * pad;
+	*minY -= dy * pad; *maxY += dy * pad;
+	dx = *maxX - *minX; dy = *maxY - *minY;
 
 	// Maintain aspect ratio
 	float scaleX = (float)(CUR_W - 1) / dx;
 	float scaleY = (float)(CUR_H - 1) / dy;
-	float scale = scaleX < scaleY ? scaleX : scaleY;
+	VIEW_SCALE = scaleX < scaleY ? scaleX : scaleY;
 
 	// Centering offsets
-	float cx = (minX + maxX) * 0.5f;
-	float cy = (minY + maxY) * 0.5f;
-
-	// Draw points as red pixels
-	for (int32_t i = 0; i < pointCount; ++i) {
-		int32_t base = i * 2;
-		float px = POINTS[base + 0];
-		float py = POINTS[base + 1];
-		int32_t ix = (int32_t)((px - cx) * scale + (float)CUR_W * 0.5f);
-		int32_t iy = (int32_t)((cy - py) * scale + (float)CUR_H * 0.5f);
-		ix = clampi(ix, 0, CUR_W - 1);
-		iy = clampi(iy, 0, CUR_H - 1);
-		const int32_t o = iy * stride + ix * 4;
-		IMAGE[o + 0] = 255; // R
-		IMAGE[o + 1] = 0;   // G
-		IMAGE[o + 2] = 0;   // B
-		IMAGE[o + 3] = 255;
+	VIEW_CX = (*minX + *maxX) * 0.5f;
+	VIEW_CY = (*minY + *maxY) * 0.5f;
+}
+
+// Clear to opaque black. Rows are contiguous (stride == CUR_W * 4), so this is
+// one fill of packed RGBA 0,0,0,255.
+static void clear_canvas() {
+	simd_fill_u32((uint32_t*)IMAGE, CUR_W * CUR_H, 0xFF000000u);
+	mark_dirty(0, 0, CUR_W, CUR_H);
+}
+
+// Map to image coordinates (origin top-left)
+static inline void project(float px, float py, int32_t* ix, int32_t* iy) {
+	*ix = clampi((int32_t)((px - VIEW_CX) * VIEW_SCALE + (float)CUR_W * 0.5f), 0, CUR_W - 1);
+	*iy = clampi((int32_t)((VIEW_CY - py) * VIEW_SCALE + (float)CUR_H * 0.5f), 0, CUR_H - 1);
+}
+
+// Points as red pixels. keepPoses leaves white pose pixels alone so points
+// added after the poses they surround still render underneath them.
+static void plot_points(int32_t q0, int32_t q1, bool keepPoses, bool trackDirty) {
+	const int32_t stride = CUR_W * 4;
+	// project in chunks with the SIMD kernel, then scatter
+	int32_t ixs[256], iys[256];
+	for (int32_t c = q0; c < q1; c += 256) {
+		const int32_t n = q1 - c < 256 ? q1 - c : 256;
+		simd_project_xy(POINTS + 2 * c, n, VIEW_CX, VIEW_CY, VIEW_SCALE, CUR_W, CUR_H, ixs, iys);
+		for (int32_t k = 0; k < n; ++k) {
+			const int32_t ix = ixs[k], iy = iys[k];
+			const int32_t o = iy * stride + ix * 4;
+			if (keepPoses && IMAGE[o + 1] == 255) continue;
+			IMAGE[o + 0] = 255; // R
+			IMAGE[o + 1] = 0;   // G
+			IMAGE[o + 2] = 0;   // B
+			IMAGE[o + 3] = 255;
+			if (trackDirty) mark_dirty(ix, iy, ix + 1, iy + 1);
+		}
 	}
+}
 
-	// Draw poses as 3x3 white dots on top
-	for (int32_t i = 0; i < poseCount; ++i) {
+// Poses as 3x3 white dots on top
+static void plot_poses(int32_t p0, int32_t p1, bool trackDirty) {
+	const int32_t stride = CUR_W * 4;
+	for (int32_t i = p0; i < p1; ++i) {
 		int32_t base = i * 3;
-		float px = POSES[base + 0];
-		float py = POSES[base + 1];
-		// Map to image coordinates (origin top-left)
-		int32_t ix = (int32_t)((px - cx) * scale + (float)CUR_W * 0.5f);
-		int32_t iy = (int32_t)((cy - py) * scale + (float)CUR_H * 0.5f);
-		ix = clampi(ix, 0, CUR_W - 1);
-		iy = clampi(iy, 0, CUR_H - 1);
+		int32_t ix, iy;
+		project(POSES[base + 0], POSES[base + 1], &ix, &iy);
 		// Draw a 3x3 white dot
 		for (int dy = -1; dy <= 1; ++dy) {
 			for (int dx = -1; dx <= 1; ++dx) {
@@ -170,7 +222,258 @@ void draw_map(int32_t poseCount, int32_t pointCount, int32_t width, int32_t heig
 				IMAGE[o + 3] = 255;
 			}
 		}
+		if (trackDirty) mark_dirty(clampi(ix - 1, 0, CUR_W - 1), clampi(iy - 1, 0, CUR_H - 1),
+		                           clampi(ix + 2, 1, CUR_W), clampi(iy + 2, 1, CUR_H));
+	}
+}
+
+// Forces the next draw_map_incremental to repaint everything, e.g. after the
+// host rewrote already-committed elements through the bulk buffers.
+void invalidate_map() { INC_VALID = false; }
+
+static void set_canvas_size(int32_t width, int32_t height) {
+	if (width <= 0) width = 256;
+	if (height <= 0) height = 256;
+	if (width > MAX_W) width = MAX_W;
+	if (height > MAX_H) height = MAX_H;
+	if (width != CUR_W || height != CUR_H) {
+		INC_VALID = false;
+		// the old rect is in the old size's pixels and could run past the new rows
+		IMAGE_DESC.dirty_x0 = IMAGE_DESC.dirty_y0 = 0;
+		IMAGE_DESC.dirty_x1 = IMAGE_DESC.dirty_y1 = 0;
+	}
+	CUR_W = width;
+	CUR_H = height;
+	IMAGE_DESC.width = CUR_W;
+	IMAGE_DESC.height = CUR_H;
+	IMAGE_DESC.stride = CUR_W * 4;
+	IMAGE_DESC.version++;
+}
+
+// Very simple nearest-neighbor mapping: autoscale poses to fit into WxH canvas,
+// center them, and plot white pixels. Theta is currently unused for rendering.
+void draw_map(int32_t poseCount, int32_t pointCount, int32_t width, int32_t height) {
+	if (poseCount < 0) poseCount = 0;
+	if (poseCount > MAX_POSES) poseCount = MAX_POSES;
+	if (pointCount < 0) pointCount = 0;
+	if (pointCount > MAX_POINTS) pointCount = MAX_POINTS;
+	set_canvas_size(width, height);
+	INC_VALID = false; // different transform than the incremental view
+
+	clear_canvas();
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	if (!compute_bounds(0, poseCount, 0, pointCount, &minX, &minY, &maxX, &maxY)) return;
+
+	// Pad bounds a bit
+	set_view(&minX, &minY, &maxX, &maxY, 0.05f);
+
+	plot_points(0, pointCount, false, false);
+	plot_poses(0, poseCount, false);
+}
+
+// Draws the committed poses/points (see commit_poses/commit_points or the
+// set_* calls) onto a persistent canvas. Only elements added since the last
+// call are rasterized and marked dirty; the canvas is repainted only when the
+// data leaves the current view (which then grows by INC_GROW_MARGIN), the
+// canvas size changes, elements were removed or rewritten, or after draw_map.
+// Returns 1 if it did a full repaint, 0 otherwise.
+int32_t draw_map_incremental(int32_t width, int32_t height) {
+	set_canvas_size(width, height);
+	if (POSES_COUNT < INC_POSES || POINTS_COUNT < INC_POINTS) INC_VALID = false;
+
+	if (INC_VALID) {
+		float minX = INC_MINX, minY = INC_MINY, maxX = INC_MAXX, maxY = INC_MAXY;
+		compute_bounds(INC_POSES, POSES_COUNT, INC_POINTS, POINTS_COUNT, &minX, &minY, &maxX, &maxY);
+		if (minX >= INC_MINX && minY >= INC_MINY && maxX <= INC_MAXX && maxY <= INC_MAXY) {
+			plot_points(INC_POINTS, POINTS_COUNT, true, true);
+			plot_poses(INC_POSES, POSES_COUNT, true);
+			INC_POSES = POSES_COUNT;
+			INC_POINTS = POINTS_COUNT;
+			return 0;
+		}
+	}
+
+	clear_canvas();
+	INC_POSES = POSES_COUNT;
+	INC_POINTS = POINTS_COUNT;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	if (!compute_bounds(0, POSES_COUNT, 0, POINTS_COUNT, &minX, &minY, &maxX, &maxY)) {
+		INC_VALID = false;
+		return 1;
+	}
+	float dx = maxX - minX, dy = maxY - minY;
+	if (dx <= 0.0f) dx = 1.0f;
+	if (dy <= 0.0f) dy = 1.0f;
+	minX -= dx * INC_GROW_MARGIN; maxX += dx * INC_GROW_MARGIN;
+	minY -= dy * INC_GROW_MARGIN; maxY += dy * INC_GROW_MARGIN;
+	INC_MINX = minX; INC_MINY = minY; INC_MAXX = maxX; INC_MAXY = maxY;
+	set_view(&minX, &minY, &maxX, &maxY, 0.05f);
+	plot_points(0, POINTS_COUNT, false, false);
+	plot_poses(0, POSES_COUNT, false);
+	INC_VALID = true;
+	return 1;
+}
+
+// Occupancy grid (see occupancy_grid.h): fixed resolution, unbounded extent,
+// tiles allocated as the robot explores.
+// scratch for occ_integrate's per-call ray dedup
+static const int32_t OCC_RAY_KEYS = 65536;
+static uint32_t OCC_KEYS[OCC_RAY_KEYS];
+// 5 cm cells, no tiles yet, at most TILE_MAX_TILES of them
+static OccupancyGrid OCC = {{{}, 0, TILE_MAX_TILES, 0, nullptr, nullptr, 0, nullptr}, 0.05f, 20.0f, false, 0, 0, 0, 0, false, 0, 0, 0, 0};
+// hit +0.85, miss -0.4, clamped to [-2, 3.5], 10 m range; constant-initialized
+// because map.wasm has no static constructors
+static OccupancyParams OCC_PARAMS = {218, -102, -512, 896, 10.0f};
+
+// Clears the grid and sets the cell size in meters. Returns 0 (and leaves the
+// grid alone) if the resolution is not positive.
+int32_t occupancy_configure(float resolution) {
+	if (!(resolution > 0.0f)) return 0;
+	OCC.resolution = resolution;
+	OCC.invResolution = 1.0f / resolution;
+	occ_clear(&OCC);
+	return 1;
+}
+
+// Log-odds increments and clamps (natural log-odds, not fixed point), and
+// the range beyond which returns only clear space.
+void occupancy_set_params(float hit, float miss, float minLogOdds, float maxLogOdds, float maxRange) {
+	OCC_PARAMS.hit = occ_to_fixed(hit);
+	OCC_PARAMS.miss = occ_to_fixed(miss);
+	OCC_PARAMS.minLogOdds = occ_to_fixed(minLogOdds);
+	OCC_PARAMS.maxLogOdds = occ_to_fixed(maxLogOdds);
+	OCC_PARAMS.maxRange = maxRange > 0.0f ? maxRange : 0.0f;
+}
+
+// Caps how many tiles may exist (each is TILE_CELLS int16 cells); rays into
+// further unexplored tiles are dropped there. Returns the clamped limit.
+int32_t occupancy_set_tile_limit(int32_t maxTiles) {
+	if (maxTiles < 0) maxTiles = 0;
+	if (maxTiles > TILE_MAX_TILES) maxTiles = TILE_MAX_TILES;
+	OCC.tiles.limit = maxTiles;
+	return maxTiles;
+}
+
+// Drops all tiles; their memory is kept for reuse.
+void occupancy_reset() { occ_clear(&OCC); }
+
+// Ray casts points [first, first + count) from the position of pose poseIdx,
+// as one scan: returns landing in the same cell update the grid once. Returns
+// the number of points consumed after clamping to the committed range, 0 if
+// the pose is not committed.
+int32_t integrate_points(int32_t poseIdx, int32_t first, int32_t count) {
+	if (poseIdx < 0 || poseIdx >= POSES_COUNT) return 0;
+	if (first < 0) first = 0;
+	if (count > POINTS_COUNT - first) count = POINTS_COUNT - first;
+	if (count <= 0) return 0;
+	occ_integrate(&OCC, &OCC_PARAMS, POSES[3 * poseIdx + 0], POSES[3 * poseIdx + 1], POINTS + 2 * first, count,
+	              OCC_KEYS, OCC_RAY_KEYS);
+	return count;
+}
+
+float get_occupancy_resolution() { return OCC.resolution; }
+int32_t get_occupancy_tile_size() { return TILE_SIZE; }
+int32_t get_occupancy_tile_count() { return OCC.tiles.count; }
+// bytes taken by tiles, including recycled ones
+int32_t get_occupancy_memory() { return OCC.tiles.reserved * TILE_CELLS * (int32_t)sizeof(int16_t); }
+
+// Cells of tile (tx, ty), covering cells [tx, tx + 1) * get_occupancy_tile_size()
+// on x and likewise on y, row-major from the lowest y; null if unexplored.
+const int16_t* get_occupancy_tile(int32_t tx, int32_t ty) { return tile_get(&OCC.tiles, tx, ty, false); }
+
+// Log-odds of the cell containing (x, y) in Q8.8, 0 if unknown.
+int32_t get_occupancy_at(float x, float y) {
+	int32_t cx, cy;
+	if (!occ_cell(x, OCC.invResolution, &cx) || !occ_cell(y, OCC.invResolution, &cy)) return 0;
+	return occ_get(&OCC, cx, cy);
+}
+
+// Log-odds -> packed RGBA: unknown black, free dark gray, occupied red,
+// brighter with confidence. Rebuilt per draw for values in +-OCC_LUT_HALF.
+static const int32_t OCC_LUT_HALF = 2048;
+static uint32_t OCC_LUT[2 * OCC_LUT_HALF];
+
+static void build_occ_lut() {
+	const int32_t lo = OCC_PARAMS.minLogOdds < 0 ? -OCC_PARAMS.minLogOdds : 1;
+	const int32_t hi = OCC_PARAMS.maxLogOdds > 0 ? OCC_PARAMS.maxLogOdds : 1;
+	for (int32_t i = 0; i < 2 * OCC_LUT_HALF; ++i) {
+		const int32_t v = i - OCC_LUT_HALF;
+		uint32_t c = 0xFF000000u;
+		if (v < 0) {
+			int32_t m = -v * 96 / lo;
+			uint32_t g = (uint32_t)(m > 96 ? 96 : m);
+			c |= (g << 16) | (g << 8) | g;
+		} else if (v > 0) {
+			int32_t m = 64 + v * 191 / hi;
+			c |= (uint32_t)(m > 255 ? 255 : m);
+		}
+		OCC_LUT[i] = c;
+	}
+}
+
+// Renders the grid around world point (centerX, centerY) at a fixed
+// metersPerPixel into IMAGE, with the poses on top as in draw_map.
+static void render_occupancy(float centerX, float centerY, float metersPerPixel) {
+	clear_canvas();
+	build_occ_lut();
+	// global cell column under each pixel center, ascending
+	int32_t cols[MAX_W];
+	bool colOk[MAX_W];
+	for (int32_t x = 0; x < CUR_W; ++x)
+		colOk[x] = occ_cell(centerX + ((float)x + 0.5f - (float)CUR_W * 0.5f) * metersPerPixel, OCC.invResolution, &cols[x]);
+	uint32_t* out = (uint32_t*)IMAGE;
+	for (int32_t y = 0; y < CUR_H; ++y) {
+		// image rows go down, grid rows go up
+		int32_t cy;
+		if (!occ_cell(centerY - ((float)y + 0.5f - (float)CUR_H * 0.5f) * metersPerPixel, OCC.invResolution, &cy)) continue;
+		const int32_t rowOff = (cy & TILE_MASK) << TILE_SHIFT;
+		// one index lookup per tile crossed along the row
+		int32_t tx = 0;
+		const int16_t* t = nullptr;
+		bool haveTile = false;
+		for (int32_t x = 0; x < CUR_W; ++x) {
+			if (!colOk[x]) continue;
+			const int32_t cx = cols[x];
+			if (!haveTile || (cx >> TILE_SHIFT) != tx) {
+				tx = cx >> TILE_SHIFT;
+				t = tile_get(&OCC.tiles, tx, cy >> TILE_SHIFT, false);
+				haveTile = true;
+			}
+			if (!t) continue;
+			const int32_t v = clampi(t[rowOff | (cx & TILE_MASK)], -OCC_LUT_HALF, OCC_LUT_HALF - 1);
+			out[y * CUR_W + x] = OCC_LUT[v + OCC_LUT_HALF];
+		}
+	}
+
+	VIEW_SCALE = 1.0f / metersPerPixel;
+	VIEW_CX = centerX;
+	VIEW_CY = centerY;
+	plot_poses(0, POSES_COUNT, false);
+}
+
+// Viewport at a fixed metric scale, e.g. following the robot; resolution does
+// not degrade as the map grows.
+void draw_occupancy_view(float centerX, float centerY, float metersPerPixel, int32_t width, int32_t height) {
+	set_canvas_size(width, height);
+	INC_VALID = false;
+	if (!(metersPerPixel > 0.0f)) metersPerPixel = OCC.resolution;
+	render_occupancy(centerX, centerY, metersPerPixel);
+}
+
+// Fits everything updated so far into the canvas, aspect kept.
+void draw_occupancy(int32_t width, int32_t height) {
+	set_canvas_size(width, height);
+	INC_VALID = false;
+	if (!OCC.touched) {
+		clear_canvas();
+		return;
 	}
+	const float w = (float)(OCC.maxCX - OCC.minCX + 1) * OCC.resolution;
+	const float h = (float)(OCC.maxCY - OCC.minCY + 1) * OCC.resolution;
+	const float mx = w / (float)CUR_W, my = h / (float)CUR_H;
+	render_occupancy((float)OCC.minCX * OCC.resolution + w * 0.5f, (float)OCC.minCY * OCC.resolution + h * 0.5f,
+	                 mx > my ? mx : my);
 }
 
 // Back-compat: draw only poses
@@ -182,6 +485,22 @@ void draw_pose_map(int32_t count, int32_t width, int32_t height) {
 int32_t get_image_width() { return CUR_W; }
 int32_t get_image_height() { return CUR_H; }
 
+// Zero-copy readback: the host wraps memory + get_image_buffer() as a
+// width x height image with get_image_stride() bytes per row (e.g. a CGImage
+// or texture upload), or copies just the dirty rect, then acks it.
+uint8_t* get_image_buffer() { return IMAGE; }
+int32_t get_image_stride() { return CUR_W * 4; }
+int32_t get_image_format() { return IMAGE_FORMAT_RGBA8888; }
+
+// Address of the ImageDescriptor so one memory read gets size, stride, format,
+// dirty rect and version together.
+const ImageDescriptor* get_image_descriptor() { return &IMAGE_DESC; }
+
+void ack_image_dirty() {
+	IMAGE_DESC.dirty_x0 = IMAGE_DESC.dirty_y0 = 0;
+	IMAGE_DESC.dirty_x1 = IMAGE_DESC.dirty_y1 = 0;
+}
+
 // Read a pixel as little-endian RGBA packed into a 32-bit value.
 // index = y * width + x
 int32_t get_image_pixel_u32(int32_t index) {
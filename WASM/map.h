@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+
+// Exports of map.cpp (built standalone as map.wasm, or natively via //WASM:map).
+
+extern "C" {
+
+// Describes IMAGE for hosts that read linear memory directly. The dirty rect
+// is the half-open pixel box [dirty_x0, dirty_x1) x [dirty_y0, dirty_y1)
+// touched since the last ack_image_dirty(); empty when dirty_x0 >= dirty_x1.
+static const int32_t IMAGE_FORMAT_RGBA8888 = 1; // R,G,B,A bytes, R at the lowest address
+struct ImageDescriptor {
+	int32_t width;
+	int32_t height;
+	int32_t stride; // bytes per row
+	int32_t format;
+	int32_t dirty_x0, dirty_y0, dirty_x1, dirty_y1;
+	uint32_t version; // bumped by every draw
+};
+
+void log_pose_f32(float x, float y, float theta);
+
+void reset_poses();
+void reset_points();
+void set_pose(int32_t idx, float x, float y, float theta);
+void set_point(int32_t idx, float x, float y);
+
+// bulk upload: write into the buffers, then commit the element count
+float* get_poses_buffer();
+float* get_points_buffer();
+int32_t get_poses_capacity();
+int32_t get_points_capacity();
+int32_t commit_poses(int32_t count);
+int32_t commit_points(int32_t count);
+int32_t get_pose_count();
+int32_t get_point_count();
+
+void draw_map(int32_t poseCount, int32_t pointCount, int32_t width, int32_t height);
+void draw_pose_map(int32_t count, int32_t width, int32_t height);
+
+// persistent canvas, rasterizes only what was added since the last call
+int32_t draw_map_incremental(int32_t width, int32_t height);
+void invalidate_map();
+
+// log-odds occupancy grid in sparse tiles, see occupancy_grid.h; cells are int16 Q8.8
+int32_t occupancy_configure(float resolution);
+void occupancy_set_params(float hit, float miss, float minLogOdds, float maxLogOdds, float maxRange);
+int32_t occupancy_set_tile_limit(int32_t maxTiles);
+void occupancy_reset();
+int32_t integrate_points(int32_t poseIdx, int32_t first, int32_t count);
+float get_occupancy_resolution();
+int32_t get_occupancy_tile_size();
+int32_t get_occupancy_tile_count();
+int32_t get_occupancy_memory();
+const int16_t* get_occupancy_tile(int32_t tx, int32_t ty);
+int32_t get_occupancy_at(float x, float y);
+void draw_occupancy(int32_t width, int32_t height);
+void draw_occupancy_view(float centerX, float centerY, float metersPerPixel, int32_t width, int32_t height);
+
+int32_t get_image_width();
+int32_t get_image_height();
+int32_t get_image_pixel_u32(int32_t index);
+
+// zero-copy readback, see map.cpp for the descriptor layout
+uint8_t* get_image_buffer();
+int32_t get_image_stride();
+int32_t get_image_format();
+const ImageDescriptor* get_image_descriptor();
+void ack_image_dirty();
+
+} // extern "C"
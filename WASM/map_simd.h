@@ -0,0 +1,221 @@
+// Vectorized inner loops for map.cpp, selected at compile time:
+// wasm simd128 (-msimd128), AVX2, SSE4.1, NEON, else the scalar reference.
+// Every SIMD path performs the same float operations in the same order as the
+// scalar one (no FMA, truncating conversion), so results are bit-exact for
+// finite inputs. Header-only and libc-free so map.wasm can stay -nostdlib.
+#pragma once
+#include <stdint.h>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define MAP_SIMD_NAME "wasm-simd128"
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define MAP_SIMD_NAME "avx2"
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define MAP_SIMD_NAME "sse4.1"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MAP_SIMD_NAME "neon"
+#else
+#define MAP_SIMD_NAME "scalar"
+#endif
+
+#if defined(__clang__)
+// keep a*b+c as two roundings in the scalar paths too
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+// Canvas fill with one packed RGBA value (little-endian, R in the low byte).
+
+static inline void scalar_fill_u32(uint32_t* dst, int32_t count, uint32_t rgba) {
+	for (int32_t i = 0; i < count; ++i) dst[i] = rgba;
+}
+
+static inline void simd_fill_u32(uint32_t* dst, int32_t count, uint32_t rgba) {
+	int32_t i = 0;
+#if defined(__wasm_simd128__)
+	const v128_t v = wasm_i32x4_splat((int32_t)rgba);
+	for (; i + 4 <= count; i += 4) wasm_v128_store(dst + i, v);
+#elif defined(__AVX2__)
+	const __m256i v = _mm256_set1_epi32((int32_t)rgba);
+	for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), v);
+#elif defined(__SSE4_1__)
+	const __m128i v = _mm_set1_epi32((int32_t)rgba);
+	for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), v);
+#elif defined(__ARM_NEON)
+	const uint32x4_t v = vdupq_n_u32(rgba);
+	for (; i + 4 <= count; i += 4) vst1q_u32(dst + i, v);
+#endif
+	scalar_fill_u32(dst + i, count - i, rgba);
+}
+
+// Min/max over n interleaved x,y pairs, folded into the running bounds.
+// Uses "p < m ? p : m" semantics like the scalar loop.
+
+static inline void scalar_bounds_xy(const float* xy, int32_t n, float* minX, float* minY, float* maxX, float* maxY) {
+	for (int32_t i = 0; i < n; ++i) {
+		float px = xy[2 * i + 0];
+		float py = xy[2 * i + 1];
+		if (px < *minX) *minX = px;
+		if (py < *minY) *minY = py;
+		if (px > *maxX) *maxX = px;
+		if (py > *maxY) *maxY = py;
+	}
+}
+
+static inline void simd_bounds_xy(const float* xy, int32_t n, float* minX, float* minY, float* maxX, float* maxY) {
+	int32_t i = 0;
+#if defined(__wasm_simd128__)
+	// lanes are x,y,x,y
+	v128_t lo = wasm_f32x4_make(*minX, *minY, *minX, *minY);
+	v128_t hi = wasm_f32x4_make(*maxX, *maxY, *maxX, *maxY);
+	for (; i + 2 <= n; i += 2) {
+		const v128_t p = wasm_v128_load(xy + 2 * i);
+		lo = wasm_f32x4_pmin(lo, p); // p < lo ? p : lo
+		hi = wasm_f32x4_pmax(hi, p); // hi < p ? p : hi
+	}
+	float l[4], h[4];
+	wasm_v128_store(l, lo);
+	wasm_v128_store(h, hi);
+#elif defined(__AVX2__)
+	__m256 lo = _mm256_setr_ps(*minX, *minY, *minX, *minY, *minX, *minY, *minX, *minY);
+	__m256 hi = _mm256_setr_ps(*maxX, *maxY, *maxX, *maxY, *maxX, *maxY, *maxX, *maxY);
+	for (; i + 4 <= n; i += 4) {
+		const __m256 p = _mm256_loadu_ps(xy + 2 * i);
+		lo = _mm256_min_ps(p, lo); // p < lo ? p : lo
+		hi = _mm256_max_ps(p, hi); // p > hi ? p : hi
+	}
+	const __m128 lo4 = _mm_min_ps(_mm256_extractf128_ps(lo, 1), _mm256_castps256_ps128(lo));
+	const __m128 hi4 = _mm_max_ps(_mm256_extractf128_ps(hi, 1), _mm256_castps256_ps128(hi));
+	float l[4], h[4];
+	_mm_storeu_ps(l, lo4);
+	_mm_storeu_ps(h, hi4);
+#elif defined(__SSE4_1__)
+	__m128 lo = _mm_setr_ps(*minX, *minY, *minX, *minY);
+	__m128 hi = _mm_setr_ps(*maxX, *maxY, *maxX, *maxY);
+	for (; i + 2 <= n; i += 2) {
+		const __m128 p = _mm_loadu_ps(xy + 2 * i);
+		lo = _mm_min_ps(p, lo);
+		hi = _mm_max_ps(p, hi);
+	}
+	float l[4], h[4];
+	_mm_storeu_ps(l, lo);
+	_mm_storeu_ps(h, hi);
+#elif defined(__ARM_NEON)
+	float32x4_t lo = {*minX, *minY, *minX, *minY};
+	float32x4_t hi = {*maxX, *maxY, *maxX, *maxY};
+	for (; i + 2 <= n; i += 2) {
+		const float32x4_t p = vld1q_f32(xy + 2 * i);
+		lo = vbslq_f32(vcltq_f32(p, lo), p, lo);
+		hi = vbslq_f32(vcgtq_f32(p, hi), p, hi);
+	}
+	float l[4], h[4];
+	vst1q_f32(l, lo);
+	vst1q_f32(h, hi);
+#endif
+#if defined(__wasm_simd128__) || defined(__AVX2__) || defined(__SSE4_1__) || defined(__ARM_NEON)
+	*minX = l[2] < l[0] ? l[2] : l[0];
+	*minY = l[3] < l[1] ? l[3] : l[1];
+	*maxX = h[2] > h[0] ? h[2] : h[0];
+	*maxY = h[3] > h[1] ? h[3] : h[1];
+#endif
+	scalar_bounds_xy(xy + 2 * i, n - i, minX, minY, maxX, maxY);
+}
+
+// Projects n interleaved x,y pairs to clamped pixel coordinates:
+//   ix = clamp((int)((x - cx) * scale + w * 0.5f), 0, w - 1)
+//   iy = clamp((int)((cy - y) * scale + h * 0.5f), 0, h - 1)
+
+static inline int32_t map_simd_clampi(int32_t v, int32_t lo, int32_t hi) {
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static inline void scalar_project_xy(const float* xy, int32_t n, float cx, float cy, float scale,
+                                     int32_t w, int32_t h, int32_t* ix, int32_t* iy) {
+	const float hw = (float)w * 0.5f;
+	const float hh = (float)h * 0.5f;
+	for (int32_t i = 0; i < n; ++i) {
+		float tx = (xy[2 * i + 0] - cx) * scale;
+		float ty = (cy - xy[2 * i + 1]) * scale;
+		ix[i] = map_simd_clampi((int32_t)(tx + hw), 0, w - 1);
+		iy[i] = map_simd_clampi((int32_t)(ty + hh), 0, h - 1);
+	}
+}
+
+static inline void simd_project_xy(const float* xy, int32_t n, float cx, float cy, float scale,
+                                   int32_t w, int32_t h, int32_t* ix, int32_t* iy) {
+	int32_t i = 0;
+	const float hw = (float)w * 0.5f;
+	const float hh = (float)h * 0.5f;
+#if defined(__wasm_simd128__)
+	const v128_t vcx = wasm_f32x4_splat(cx), vcy = wasm_f32x4_splat(cy), vs = wasm_f32x4_splat(scale);
+	const v128_t vhw = wasm_f32x4_splat(hw), vhh = wasm_f32x4_splat(hh);
+	const v128_t zero = wasm_i32x4_splat(0), wmax = wasm_i32x4_splat(w - 1), hmax = wasm_i32x4_splat(h - 1);
+	for (; i + 4 <= n; i += 4) {
+		const v128_t a = wasm_v128_load(xy + 2 * i);
+		const v128_t b = wasm_v128_load(xy + 2 * i + 4);
+		const v128_t x = wasm_i32x4_shuffle(a, b, 0, 2, 4, 6);
+		const v128_t y = wasm_i32x4_shuffle(a, b, 1, 3, 5, 7);
+		v128_t px = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_add(wasm_f32x4_mul(wasm_f32x4_sub(x, vcx), vs), vhw));
+		v128_t py = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_add(wasm_f32x4_mul(wasm_f32x4_sub(vcy, y), vs), vhh));
+		px = wasm_i32x4_min(wasm_i32x4_max(px, zero), wmax);
+		py = wasm_i32x4_min(wasm_i32x4_max(py, zero), hmax);
+		wasm_v128_store(ix + i, px);
+		wasm_v128_store(iy + i, py);
+	}
+#elif defined(__AVX2__)
+	const __m256 vcx = _mm256_set1_ps(cx), vcy = _mm256_set1_ps(cy), vs = _mm256_set1_ps(scale);
+	const __m256 vhw = _mm256_set1_ps(hw), vhh = _mm256_set1_ps(hh);
+	const __m256i zero = _mm256_setzero_si256(), wmax = _mm256_set1_epi32(w - 1), hmax = _mm256_set1_epi32(h - 1);
+	for (; i + 8 <= n; i += 8) {
+		const __m256 a = _mm256_loadu_ps(xy + 2 * i);     // x0 y0 x1 y1 | x2 y2 x3 y3
+		const __m256 b = _mm256_loadu_ps(xy + 2 * i + 8); // x4 y4 x5 y5 | x6 y6 x7 y7
+		// per-128-bit-lane shuffle gives x0 x1 x4 x5 | x2 x3 x6 x7, then fix the order
+		__m256 x = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 y = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		x = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(x), _MM_SHUFFLE(3, 1, 2, 0)));
+		y = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(y), _MM_SHUFFLE(3, 1, 2, 0)));
+		__m256i px = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(x, vcx), vs), vhw));
+		__m256i py = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vcy, y), vs), vhh));
+		px = _mm256_min_epi32(_mm256_max_epi32(px, zero), wmax);
+		py = _mm256_min_epi32(_mm256_max_epi32(py, zero), hmax);
+		_mm256_storeu_si256((__m256i*)(ix + i), px);
+		_mm256_storeu_si256((__m256i*)(iy + i), py);
+	}
+#elif defined(__SSE4_1__)
+	const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy), vs = _mm_set1_ps(scale);
+	const __m128 vhw = _mm_set1_ps(hw), vhh = _mm_set1_ps(hh);
+	const __m128i zero = _mm_setzero_si128(), wmax = _mm_set1_epi32(w - 1), hmax = _mm_set1_epi32(h - 1);
+	for (; i + 4 <= n; i += 4) {
+		const __m128 a = _mm_loadu_ps(xy + 2 * i);
+		const __m128 b = _mm_loadu_ps(xy + 2 * i + 4);
+		const __m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128i px = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, vcx), vs), vhw));
+		__m128i py = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(vcy, y), vs), vhh));
+		px = _mm_min_epi32(_mm_max_epi32(px, zero), wmax);
+		py = _mm_min_epi32(_mm_max_epi32(py, zero), hmax);
+		_mm_storeu_si128((__m128i*)(ix + i), px);
+		_mm_storeu_si128((__m128i*)(iy + i), py);
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t vcx = vdupq_n_f32(cx), vcy = vdupq_n_f32(cy), vs = vdupq_n_f32(scale);
+	const float32x4_t vhw = vdupq_n_f32(hw), vhh = vdupq_n_f32(hh);
+	const int32x4_t zero = vdupq_n_s32(0), wmax = vdupq_n_s32(w - 1), hmax = vdupq_n_s32(h - 1);
+	for (; i + 4 <= n; i += 4) {
+		const float32x4x2_t p = vld2q_f32(xy + 2 * i); // deinterleaves x and y
+		int32x4_t px = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vsubq_f32(p.val[0], vcx), vs), vhw));
+		int32x4_t py = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vsubq_f32(vcy, p.val[1]), vs), vhh));
+		px = vminq_s32(vmaxq_s32(px, zero), wmax);
+		py = vminq_s32(vmaxq_s32(py, zero), hmax);
+		vst1q_s32(ix + i, px);
+		vst1q_s32(iy + i, py);
+	}
+#else
+	(void)hw;
+	(void)hh;
+#endif
+	scalar_project_xy(xy + 2 * i, n - i, cx, cy, scale, w, h, ix + i, iy + i);
+}
@@ -0,0 +1,80 @@
+#include "native/recording_reader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RecordingReader::~RecordingReader() {
+    if (data_) munmap(data_, size_);
+}
+
+bool RecordingReader::open(const char* path) {
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(RecordingHeader))) {
+        std::fprintf(stderr, "%s: not a recording\n", path);
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        std::perror(path);
+        return false;
+    }
+    madvise(data_, size_, MADV_SEQUENTIAL);
+
+    const uint8_t* base = static_cast<const uint8_t*>(data_);
+    const RecordingHeader* h = reinterpret_cast<const RecordingHeader*>(base);
+    if (std::memcmp(h->magic, "ROAMRREC", sizeof(h->magic)) != 0 || h->version != RecordingVersion) {
+        std::fprintf(stderr, "%s: not a version %u recording\n", path, RecordingVersion);
+        return false;
+    }
+
+    size_t off = sizeof(RecordingHeader);
+    while (off + sizeof(RecordingChunk) <= size_) {
+        const RecordingChunk* c = reinterpret_cast<const RecordingChunk*>(base + off);
+        const size_t payload = off + sizeof(RecordingChunk);
+        if (payload + c->bytes > size_) break; // truncated tail from an interrupted recording
+        if (c->type == RECORDING_IMU && c->bytes >= sizeof(IMUData)) {
+            imu_.push_back(reinterpret_cast<const IMUData*>(base + payload));
+        } else if (c->type == RECORDING_FRAME && c->bytes >= sizeof(RecordingFrame)) {
+            const RecordingFrame* f = reinterpret_cast<const RecordingFrame*>(base + payload);
+            const size_t depth_bytes = sizeof(float) * f->depth_width * f->depth_height;
+            const size_t image_bytes = static_cast<size_t>(f->image_width) * f->image_height * f->image_channels;
+            if (sizeof(RecordingFrame) + depth_bytes + image_bytes <= c->bytes) {
+                const uint8_t* p = base + payload + sizeof(RecordingFrame);
+                frames_.push_back(RecordedFrame{f, reinterpret_cast<const float*>(p), p + depth_bytes});
+            }
+        }
+        off = payload + c->bytes;
+    }
+
+    std::stable_sort(imu_.begin(), imu_.end(),
+                     [](const IMUData* a, const IMUData* b) { return a->acc_timestamp < b->acc_timestamp; });
+    std::stable_sort(frames_.begin(), frames_.end(), [](const RecordedFrame& a, const RecordedFrame& b) {
+        return a.header->timestamp < b.header->timestamp;
+    });
+    return true;
+}
+
+double RecordingReader::start_time() const {
+    double t = 0.0;
+    bool any = false;
+    if (!imu_.empty()) {
+        t = imu_.front()->acc_timestamp;
+        any = true;
+    }
+    if (!frames_.empty() && (!any || frames_.front().header->timestamp < t)) t = frames_.front().header->timestamp;
+    return t;
+}
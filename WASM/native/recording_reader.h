@@ -0,0 +1,36 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+#include "recording.h"
+
+// read-only, memory-mapped view of a recording; IMU samples and frames point
+// straight into the mapping and are ordered by timestamp
+struct RecordedFrame {
+    const RecordingFrame* header;
+    const float* depth_map;
+    const uint8_t* image;
+};
+
+class RecordingReader {
+public:
+    RecordingReader() = default;
+    ~RecordingReader();
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    // false (with a message on stderr) if the file is missing or malformed
+    bool open(const char* path);
+
+    const std::vector<const IMUData*>& imu() const { return imu_; }
+    const std::vector<RecordedFrame>& frames() const { return frames_; }
+
+    // earliest timestamp across both streams
+    double start_time() const;
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<const IMUData*> imu_;
+    std::vector<RecordedFrame> frames_;
+};
@@ -0,0 +1,195 @@
+// Native host that replays a sensor recording (see recording.h) through the
+// same imports the iOS host provides, for deterministic offline runs.
+//
+//   ROAMR_REPLAY=$PWD/run.rec ROAMR_REPLAY_SPEED=4 bazel run //WASM:slam_main_replay
+//
+// ROAMR_REPLAY_SPEED: 1 = real time (default), N = N times real time,
+// 0 = as fast as possible. At speed 0 the replay runs in lockstep with the
+// consumer: the IMU ring never overflows and a frame is only published after
+// the previous one was picked up through wait_frame, so every sample and
+// frame is delivered exactly once regardless of machine load.
+// Playback starts when the frame pool is attached; when the recording is
+// exhausted wait_frame returns FrameStreamEnded.
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "frame_pool.h"
+#include "imu.h"
+#include "lidar_camera.h"
+#include "native/recording_reader.h"
+#include "spsc_ring.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Replay {
+    RecordingReader reader;
+    double speed = 1.0;
+
+    SpscRing<IMUData, IMUHostRingSize> imu_ring;
+    IMUData latest_imu{};
+
+    FramePool* pool = nullptr;
+    size_t next_frame = 0; // legacy read_lidar_camera cursor
+
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t generation = 0;     // last frame published into the pool
+    uint32_t consumer_seen = 0;  // largest after_generation passed to wait_frame
+    bool ended = false;
+    uint64_t dropped_frames = 0;
+};
+
+Replay& replay() {
+    static Replay* r = [] {
+        Replay* r = new Replay();
+        const char* path = std::getenv("ROAMR_REPLAY");
+        if (!path || !r->reader.open(path)) {
+            std::fprintf(stderr, "replay: set ROAMR_REPLAY to a recording\n");
+            std::exit(1);
+        }
+        if (const char* speed = std::getenv("ROAMR_REPLAY_SPEED")) r->speed = std::atof(speed);
+        std::fprintf(stderr, "replay: %zu IMU samples, %zu frames at %s\n", r->reader.imu().size(),
+                     r->reader.frames().size(), r->speed > 0.0 ? "real-time x speed" : "max speed (lockstep)");
+        return r;
+    }();
+    return *r;
+}
+
+void publish_frame(Replay& r, const RecordedFrame& f) {
+    const bool lockstep = r.speed <= 0.0;
+    if (lockstep) {
+        std::unique_lock<std::mutex> lk(r.m);
+        r.cv.wait(lk, [&] { return r.consumer_seen >= r.generation; });
+    }
+    FrameSlot* slot = r.pool->acquire_write();
+    while (!slot && lockstep) {
+        std::this_thread::yield();
+        slot = r.pool->acquire_write();
+    }
+    if (!slot) {
+        ++r.dropped_frames;
+        return;
+    }
+    const RecordingFrame& h = *f.header;
+    const int depth_w = h.depth_width < MaxDepthWidth ? h.depth_width : MaxDepthWidth;
+    const int depth_h = h.depth_height < MaxDepthHeight ? h.depth_height : MaxDepthHeight;
+    for (int y = 0; y < depth_h; ++y)
+        std::memcpy(slot->depth_map + y * depth_w, f.depth_map + y * h.depth_width, sizeof(float) * depth_w);
+    const int image_w = h.image_width < MaxImageWidth ? h.image_width : MaxImageWidth;
+    const int image_h = h.image_height < MaxImageHeight ? h.image_height : MaxImageHeight;
+    const int channels = h.image_channels < MaxImageChannels ? h.image_channels : MaxImageChannels;
+    if (channels == h.image_channels) {
+        for (int y = 0; y < image_h; ++y)
+            std::memcpy(slot->image + y * image_w * channels, f.image + y * h.image_width * channels, image_w * channels);
+    }
+    slot->depth_width = depth_w;
+    slot->depth_height = depth_h;
+    slot->image_width = channels == h.image_channels ? image_w : 0;
+    slot->image_height = channels == h.image_channels ? image_h : 0;
+    slot->image_channels = channels;
+    r.pool->publish(slot, h.timestamp);
+    {
+        std::lock_guard<std::mutex> lk(r.m);
+        r.generation = r.pool->latest_generation();
+    }
+    r.cv.notify_all();
+}
+
+void run_replay() {
+    Replay& r = replay();
+    const auto& imu = r.reader.imu();
+    const auto& frames = r.reader.frames();
+    const double t0 = r.reader.start_time();
+    const auto wall0 = Clock::now();
+    size_t i = 0, f = 0;
+    while (i < imu.size() || (r.pool && f < frames.size())) {
+        const bool take_imu = i < imu.size() && (!r.pool || f >= frames.size() ||
+                                                 imu[i]->acc_timestamp <= frames[f].header->timestamp);
+        const double t = take_imu ? imu[i]->acc_timestamp : frames[f].header->timestamp;
+        if (r.speed > 0.0) {
+            std::this_thread::sleep_until(wall0 + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>((t - t0) / r.speed)));
+        }
+        if (take_imu) {
+            while (!r.imu_ring.push(*imu[i]) && r.speed <= 0.0) std::this_thread::yield();
+            ++i;
+        } else {
+            publish_frame(r, frames[f++]);
+        }
+    }
+    const double wall = std::chrono::duration<double>(Clock::now() - wall0).count();
+    const double span = (imu.empty() && frames.empty()) ? 0.0 : (imu.empty() ? frames.back().header->timestamp
+                        : frames.empty() ? imu.back()->acc_timestamp
+                        : std::max(imu.back()->acc_timestamp, frames.back().header->timestamp)) - t0;
+    std::fprintf(stderr, "replay: finished %.2fs of data in %.2fs (%.1fx), %llu IMU and %llu frames dropped\n", span,
+                 wall, wall > 0.0 ? span / wall : 0.0, static_cast<unsigned long long>(r.imu_ring.dropped()),
+                 static_cast<unsigned long long>(r.dropped_frames));
+    {
+        std::lock_guard<std::mutex> lk(r.m);
+        r.ended = true;
+    }
+    r.cv.notify_all();
+}
+
+std::once_flag replay_once;
+
+void start_replay() {
+    std::call_once(replay_once, [] { std::thread(run_replay).detach(); });
+}
+
+} // namespace
+
+// legacy path: latest sample, consumes whatever is buffered for read_imu_batch
+void read_imu(IMUData* data) {
+    Replay& r = replay();
+    IMUData batch[IMUBatchMax];
+    size_t n;
+    while ((n = r.imu_ring.pop_batch(batch, IMUBatchMax)) > 0) r.latest_imu = batch[n - 1];
+    *data = r.latest_imu;
+}
+
+int read_imu_batch(IMUData* out, int max) {
+    if (!out || max <= 0) return 0;
+    return static_cast<int>(replay().imu_ring.pop_batch(out, static_cast<size_t>(max)));
+}
+
+// legacy path: hands out the next recorded frame straight from the mapping
+void read_lidar_camera(LidarCameraData* data) {
+    Replay& r = replay();
+    const auto& frames = r.reader.frames();
+    if (frames.empty()) return;
+    const RecordedFrame& f = frames[r.next_frame < frames.size() ? r.next_frame++ : frames.size() - 1];
+    data->timestamp = f.header->timestamp;
+    data->depth_map = f.depth_map;
+    data->depth_width = f.header->depth_width;
+    data->depth_height = f.header->depth_height;
+    data->image = f.image;
+    data->image_width = f.header->image_width;
+    data->image_height = f.header->image_height;
+    data->image_channels = f.header->image_channels;
+}
+
+void attach_frame_pool(FramePool* pool) {
+    replay().pool = pool;
+    start_replay();
+}
+
+uint32_t wait_frame(uint32_t after_generation, int32_t timeout_ms) {
+    Replay& r = replay();
+    std::unique_lock<std::mutex> lk(r.m);
+    if (after_generation != FrameStreamEnded && after_generation > r.consumer_seen) {
+        r.consumer_seen = after_generation;
+        r.cv.notify_all();
+    }
+    r.cv.wait_for(lk, std::chrono::milliseconds(timeout_ms),
+                  [&] { return r.generation != after_generation || r.ended; });
+    if (r.generation == after_generation && r.ended) return FrameStreamEnded;
+    return r.generation;
+}
@@ -0,0 +1,157 @@
+// Native stand-in for the iOS host: implements the "host" imports with
+// synthetic sensor data so the WASM sources can run on Linux.
+//
+//   bazel run //WASM:slam_main_sim
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "frame_pool.h"
+#include "imu.h"
+#include "lidar_camera.h"
+#include "spsc_ring.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int SimDepthWidth = MaxDepthWidth;
+constexpr int SimDepthHeight = MaxDepthHeight;
+constexpr int SimImageWidth = MaxImageWidth;
+constexpr int SimImageHeight = MaxImageHeight;
+constexpr int SimImageChannels = 4;
+
+const Clock::time_point start_time = Clock::now();
+
+double now_s() {
+    return std::chrono::duration<double>(Clock::now() - start_time).count();
+}
+
+IMUData synth_imu(double t) {
+    IMUData d;
+    d.acc_timestamp = t;
+    d.acc_x = 0.2 * std::sin(t);
+    d.acc_y = 0.2 * std::cos(t);
+    d.acc_z = 9.80665;
+    d.gyro_timestamp = t;
+    d.gyro_x = 0.0;
+    d.gyro_y = 0.0;
+    d.gyro_z = 0.1 * std::sin(t * 0.25);
+    return d;
+}
+
+// stands in for CoreMotion callbacks: every sample lands in the ring
+SpscRing<IMUData, IMUHostRingSize> imu_ring;
+std::once_flag imu_once;
+
+void imu_producer() {
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / IMURefreshHz));
+    auto next = Clock::now();
+    while (true) {
+        next += period;
+        std::this_thread::sleep_until(next);
+        imu_ring.push(synth_imu(now_s()));
+    }
+}
+
+// a wall slowly approaching and receding, with a tilted floor
+void fill_depth(float* depth, int w, int h, double t) {
+    const float wall = 2.0f + 0.5f * static_cast<float>(std::sin(t * 0.5));
+    for (int y = 0; y < h; ++y) {
+        const float floor_d = y > h / 2 ? 0.5f + 3.0f * (h - y) / h : wall;
+        for (int x = 0; x < w; ++x) {
+            depth[y * w + x] = floor_d < wall ? floor_d : wall;
+        }
+    }
+}
+
+void fill_image(uint8_t* image, int w, int h, int c, uint32_t frame) {
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            uint8_t* px = image + (y * w + x) * c;
+            px[0] = static_cast<uint8_t>(x + frame);
+            px[1] = static_cast<uint8_t>(y);
+            px[2] = static_cast<uint8_t>(frame);
+            if (c > 3) px[3] = 255;
+        }
+    }
+}
+
+// lets wait_frame block until frame_producer publishes. The producer threads
+// are detached and outlive main(), so this state is never destroyed
+std::mutex& frame_mutex = *new std::mutex;
+std::condition_variable& frame_cv = *new std::condition_variable;
+uint32_t frame_generation = 0;
+
+void frame_producer(FramePool* pool) {
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / LidarCameraRefreshHz));
+    auto next = Clock::now();
+    for (uint32_t frame = 0;; ++frame) {
+        next += period;
+        std::this_thread::sleep_until(next);
+        FrameSlot* slot = pool->acquire_write();
+        if (!slot) continue; // every spare slot is borrowed, drop this frame
+        const double t = now_s();
+        slot->depth_width = SimDepthWidth;
+        slot->depth_height = SimDepthHeight;
+        slot->image_width = SimImageWidth;
+        slot->image_height = SimImageHeight;
+        slot->image_channels = SimImageChannels;
+        fill_depth(slot->depth_map, SimDepthWidth, SimDepthHeight, t);
+        fill_image(slot->image, SimImageWidth, SimImageHeight, SimImageChannels, frame);
+        pool->publish(slot, t);
+        {
+            std::lock_guard<std::mutex> lk(frame_mutex);
+            frame_generation = pool->latest_generation();
+        }
+        frame_cv.notify_all();
+    }
+}
+
+// legacy read_lidar_camera path serves from a single host-owned buffer
+std::mutex legacy_mutex;
+float legacy_depth[SimDepthWidth * SimDepthHeight];
+uint8_t legacy_image[SimImageWidth * SimImageHeight * SimImageChannels];
+uint32_t legacy_frame = 0;
+
+} // namespace
+
+void read_imu(IMUData* data) {
+    *data = synth_imu(now_s());
+}
+
+int read_imu_batch(IMUData* out, int max) {
+    std::call_once(imu_once, [] { std::thread(imu_producer).detach(); });
+    if (!out || max <= 0) return 0;
+    return static_cast<int>(imu_ring.pop_batch(out, static_cast<size_t>(max)));
+}
+
+void read_lidar_camera(LidarCameraData* data) {
+    std::lock_guard<std::mutex> lk(legacy_mutex);
+    const double t = now_s();
+    fill_depth(legacy_depth, SimDepthWidth, SimDepthHeight, t);
+    fill_image(legacy_image, SimImageWidth, SimImageHeight, SimImageChannels, legacy_frame++);
+    data->timestamp = t;
+    data->depth_map = legacy_depth;
+    data->depth_width = SimDepthWidth;
+    data->depth_height = SimDepthHeight;
+    data->image = legacy_image;
+    data->image_width = SimImageWidth;
+    data->image_height = SimImageHeight;
+    data->image_channels = SimImageChannels;
+}
+
+void attach_frame_pool(FramePool* pool) {
+    std::thread(frame_producer, pool).detach();
+}
+
+uint32_t wait_frame(uint32_t after_generation, int32_t timeout_ms) {
+    std::unique_lock<std::mutex> lk(frame_mutex);
+    frame_cv.wait_for(lk, std::chrono::milliseconds(timeout_ms),
+                      [&] { return frame_generation != after_generation; });
+    return frame_generation;
+}
@@ -0,0 +1,35 @@
+// Weak no-op definitions of every "host" import, so any native target links
+// without the iOS app. native/sim_host.cpp and native/replay_host.cpp provide
+// strong definitions that take precedence when linked in.
+#include <chrono>
+#include <thread>
+
+#include "frame_pool.h"
+#include "imu.h"
+#include "lidar_camera.h"
+
+#define STUB_HOST __attribute__((weak))
+
+STUB_HOST void read_imu(IMUData* data) {
+    *data = IMUData{};
+}
+
+STUB_HOST int read_imu_batch(IMUData* out, int max) {
+    (void)out;
+    (void)max;
+    return 0;
+}
+
+STUB_HOST void read_lidar_camera(LidarCameraData* data) {
+    *data = LidarCameraData{};
+}
+
+STUB_HOST void attach_frame_pool(FramePool* pool) {
+    (void)pool;
+}
+
+// no frames ever arrive; behaves like a host that times out
+STUB_HOST uint32_t wait_frame(uint32_t after_generation, int32_t timeout_ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+    return after_generation;
+}
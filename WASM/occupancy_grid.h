@@ -0,0 +1,216 @@
+// Log-odds occupancy grid used by map.cpp.
+// Cells are int16 log-odds in Q8.8 fixed point (OCC_ONE == 1.0); 0 is unknown.
+// The grid is unbounded at a fixed metric resolution: cells live in sparse
+// tiles (tile_map.h) created as rays reach them. Each range return is ray cast
+// with integer Bresenham from the sensor cell: cells the ray passes through
+// get the miss update, the end cell gets the hit update, both clamped.
+// Header-only and libc-free so map.wasm can stay -nostdlib.
+#pragma once
+#include <stdint.h>
+#include "tile_map.h"
+
+static const int32_t OCC_ONE = 256;
+// cell coordinates are kept within +-OCC_MAX_CELL so int32 math cannot overflow
+static const int32_t OCC_MAX_CELL = 1 << 28;
+
+struct OccupancyParams {
+	int16_t hit;    // added to the cell a return lands in
+	int16_t miss;   // added to every cell a ray passes through (negative)
+	int16_t minLogOdds, maxLogOdds;
+	float maxRange; // returns farther than this only clear space up to maxRange
+};
+
+struct OccupancyGrid {
+	TileMap tiles;
+	float resolution; // meters per cell; cell (i, j) covers [i, i+1) x [j, j+1) * resolution
+	float invResolution;
+	// inclusive box of cells updated since the last clear, valid if touched
+	bool touched;
+	int32_t minCX, minCY, maxCX, maxCY;
+	// same since the last occ_take_dirty, for one consumer that follows changes
+	bool dirty;
+	int32_t dirtyMinCX, dirtyMinCY, dirtyMaxCX, dirtyMaxCY;
+};
+
+static inline int16_t occ_to_fixed(float logOdds) {
+	float v = logOdds * (float)OCC_ONE;
+	v += v < 0.0f ? -0.5f : 0.5f;
+	if (v < -32767.0f) v = -32767.0f;
+	if (v > 32767.0f) v = 32767.0f;
+	return (int16_t)v;
+}
+
+static inline void occ_clear(OccupancyGrid* g) {
+	tile_reset(&g->tiles);
+	g->touched = false;
+	g->minCX = g->minCY = g->maxCX = g->maxCY = 0;
+	g->dirty = false;
+	g->dirtyMinCX = g->dirtyMinCY = g->dirtyMaxCX = g->dirtyMaxCY = 0;
+}
+
+// Inclusive box of cells updated since the previous call; false if none.
+static inline bool occ_take_dirty(OccupancyGrid* g, int32_t* x0, int32_t* y0, int32_t* x1, int32_t* y1) {
+	if (!g->dirty) return false;
+	*x0 = g->dirtyMinCX;
+	*y0 = g->dirtyMinCY;
+	*x1 = g->dirtyMaxCX;
+	*y1 = g->dirtyMaxCY;
+	g->dirty = false;
+	return true;
+}
+
+// Sets up an uninitialized grid (map.cpp constant-initializes its own).
+static inline void occ_init(OccupancyGrid* g, float resolution) {
+	tile_init(&g->tiles);
+	g->resolution = resolution;
+	g->invResolution = 1.0f / resolution;
+	occ_clear(g);
+}
+
+#if defined(TILE_USE_MALLOC)
+// Frees the tiles of a grid set up with occ_init; it is empty afterwards.
+static inline void occ_release(OccupancyGrid* g) {
+	tile_release(&g->tiles);
+	occ_clear(g);
+}
+#endif
+
+// World coordinate -> cell index; false if outside +-OCC_MAX_CELL (or NaN).
+static inline bool occ_cell(float v, float invResolution, int32_t* cell) {
+	const float c = v * invResolution;
+	if (!(c > (float)-OCC_MAX_CELL && c < (float)OCC_MAX_CELL)) return false;
+	// floor without libm (floorf is a call on baseline x86-64)
+	const int32_t i = (int32_t)c;
+	*cell = (float)i > c ? i - 1 : i;
+	return true;
+}
+
+// Log-odds of cell (cx, cy), 0 if its tile was never created.
+static inline int32_t occ_get(OccupancyGrid* g, int32_t cx, int32_t cy) {
+	const int16_t* t = tile_get(&g->tiles, cx >> TILE_SHIFT, cy >> TILE_SHIFT, false);
+	return t ? t[((cy & TILE_MASK) << TILE_SHIFT) | (cx & TILE_MASK)] : 0;
+}
+
+// One ray in cell coordinates, ready to rasterize.
+struct OccupancyRay {
+	int32_t x0, y0, x1, y1;
+	bool hit; // false if the end was cut by maxRange
+};
+
+// Range-limits the return at (px,py) seen from (ox,oy), world meters.
+// Returns false if either end is out of the representable cell range.
+static inline bool occ_make_ray(const OccupancyGrid* g, const OccupancyParams* p, float ox, float oy,
+                                float px, float py, OccupancyRay* r) {
+	float dx = px - ox, dy = py - oy;
+	r->hit = true;
+	const float d2 = dx * dx + dy * dy;
+	if (d2 > p->maxRange * p->maxRange) {
+		const float s = p->maxRange / __builtin_sqrtf(d2);
+		dx *= s;
+		dy *= s;
+		r->hit = false;
+	}
+	const float inv = g->invResolution;
+	return occ_cell(ox, inv, &r->x0) && occ_cell(oy, inv, &r->y0) &&
+	       occ_cell(ox + dx, inv, &r->x1) && occ_cell(oy + dy, inv, &r->y1);
+}
+
+static inline void occ_trace_ray(OccupancyGrid* g, const OccupancyParams* p, const OccupancyRay& r) {
+	// Bresenham in global cell coordinates; the tile is looked up again only
+	// when the ray crosses into another one
+	const int32_t adx = r.x1 > r.x0 ? r.x1 - r.x0 : r.x0 - r.x1;
+	const int32_t ady = r.y1 > r.y0 ? r.y0 - r.y1 : r.y1 - r.y0; // <= 0
+	const int32_t sx = r.x0 < r.x1 ? 1 : -1;
+	const int32_t sy = r.y0 < r.y1 ? 1 : -1;
+	const int32_t miss = p->miss, lo = p->minLogOdds;
+	int32_t err = adx + ady;
+	int32_t x = r.x0, y = r.y0;
+	int32_t tx = x >> TILE_SHIFT, ty = y >> TILE_SHIFT;
+	int16_t* t = tile_get(&g->tiles, tx, ty, true);
+	for (;;) {
+		if ((x >> TILE_SHIFT) != tx || (y >> TILE_SHIFT) != ty) {
+			tx = x >> TILE_SHIFT;
+			ty = y >> TILE_SHIFT;
+			t = tile_get(&g->tiles, tx, ty, true);
+		}
+		const bool last = x == r.x1 && y == r.y1;
+		if (t) { // null once the tile limit is reached
+			int16_t& c = t[((y & TILE_MASK) << TILE_SHIFT) | (x & TILE_MASK)];
+			if (last && r.hit) {
+				const int32_t v = c + p->hit;
+				c = (int16_t)(v > p->maxLogOdds ? p->maxLogOdds : v);
+			} else {
+				const int32_t v = c + miss;
+				c = (int16_t)(v < lo ? lo : v);
+			}
+		}
+		if (last) break;
+		const int32_t e2 = 2 * err;
+		if (e2 >= ady) { err += ady; x += sx; }
+		if (e2 <= adx) { err += adx; y += sy; }
+	}
+
+	const int32_t minX = r.x0 < r.x1 ? r.x0 : r.x1, maxX = r.x0 < r.x1 ? r.x1 : r.x0;
+	const int32_t minY = r.y0 < r.y1 ? r.y0 : r.y1, maxY = r.y0 < r.y1 ? r.y1 : r.y0;
+	if (!g->dirty) {
+		g->dirty = true;
+		g->dirtyMinCX = minX; g->dirtyMinCY = minY; g->dirtyMaxCX = maxX; g->dirtyMaxCY = maxY;
+	} else {
+		if (minX < g->dirtyMinCX) g->dirtyMinCX = minX;
+		if (minY < g->dirtyMinCY) g->dirtyMinCY = minY;
+		if (maxX > g->dirtyMaxCX) g->dirtyMaxCX = maxX;
+		if (maxY > g->dirtyMaxCY) g->dirtyMaxCY = maxY;
+	}
+	if (!g->touched) {
+		g->touched = true;
+		g->minCX = minX; g->minCY = minY; g->maxCX = maxX; g->maxCY = maxY;
+		return;
+	}
+	if (minX < g->minCX) g->minCX = minX;
+	if (minY < g->minCY) g->minCY = minY;
+	if (maxX > g->maxCX) g->maxCX = maxX;
+	if (maxY > g->maxCY) g->maxCY = maxY;
+}
+
+// Integrates one return at (px,py) seen from (ox,oy), world meters.
+static inline void occ_trace(OccupancyGrid* g, const OccupancyParams* p, float ox, float oy, float px, float py) {
+	OccupancyRay r;
+	if (occ_make_ray(g, p, ox, oy, px, py, &r)) occ_trace_ray(g, p, r);
+}
+
+// Integrates n returns stored as interleaved x,y pairs, all seen from (ox,oy),
+// as one scan. A depth frame flattened to the plane has many returns landing
+// in the same cell, and from one origin those rays cover identical cells, so
+// each distinct ray (end cell + hit flag) is applied once per call. keys is
+// scratch for that: keyCap entries, a power of two. Returns the rays traced.
+static inline int32_t occ_integrate(OccupancyGrid* g, const OccupancyParams* p, float ox, float oy,
+                                    const float* xy, int32_t n, uint32_t* keys, int32_t keyCap) {
+	// table at least twice the distinct rays so probes stay short; 0 is an empty slot
+	int32_t table = 16, bits = 4;
+	while (table < 2 * n && table < keyCap) {
+		table *= 2;
+		++bits;
+	}
+	if (table > keyCap) table = 0;
+	for (int32_t i = 0; i < table; ++i) keys[i] = 0;
+	const uint32_t mask = (uint32_t)(table - 1);
+	int32_t used = 0, traced = 0;
+	for (int32_t i = 0; i < n; ++i) {
+		OccupancyRay r;
+		if (!occ_make_ray(g, p, ox, oy, xy[2 * i + 0], xy[2 * i + 1], &r)) continue;
+		// every ray starts in the origin cell, so the end offset identifies it
+		const int32_t ex = r.x1 - r.x0 + 16384, ey = r.y1 - r.y0 + 16384;
+		if (2 * used < table && ex >= 0 && ex < 32768 && ey >= 0 && ey < 32768) {
+			const uint32_t key = (((uint32_t)ex << 16) | ((uint32_t)ey << 1) | (r.hit ? 1u : 0u)) + 1u;
+			// Fibonacci hashing: take the well-mixed top bits of the product
+			uint32_t h = (key * 2654435761u) >> (32 - bits);
+			while (keys[h] != 0 && keys[h] != key) h = (h + 1) & mask;
+			if (keys[h] == key) continue;
+			keys[h] = key;
+			++used;
+		}
+		occ_trace_ray(g, p, r);
+		++traced;
+	}
+	return traced;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <math.h>
+
+// Planar robot pose: position in meters and heading in radians,
+// counter-clockwise from +x. Same convention as the x,y,theta triples
+// map.wasm takes in set_pose/commit_poses.
+
+struct Pose2 {
+  float x, y, theta;
+};
+
+// angle wrapped to [-pi, pi)
+inline float wrap_angle(float a) {
+  const float two_pi = 6.283185307f;
+  a = fmodf(a + 3.141592654f, two_pi);
+  if (a < 0.0f) a += two_pi;
+  return a - 3.141592654f;
+}
+
+// a then b, b expressed in a's frame
+inline Pose2 compose(const Pose2 &a, const Pose2 &b) {
+  const float c = cosf(a.theta), s = sinf(a.theta);
+  return Pose2{a.x + c * b.x - s * b.y, a.y + s * b.x + c * b.y, wrap_angle(a.theta + b.theta)};
+}
+
+inline Pose2 inverse(const Pose2 &a) {
+  const float c = cosf(a.theta), s = sinf(a.theta);
+  return Pose2{-c * a.x - s * a.y, s * a.x - c * a.y, wrap_angle(-a.theta)};
+}
+
+// b expressed in a's frame, e.g. an odometry increment
+inline Pose2 between(const Pose2 &a, const Pose2 &b) { return compose(inverse(a), b); }
@@ -0,0 +1,256 @@
+#include "pose_graph.h"
+
+#include <math.h>
+
+static double wrap(double a) { return a - 2.0 * M_PI * floor((a + M_PI) / (2.0 * M_PI)); }
+
+PoseGraph::PoseGraph(const PoseGraphParams &params) : params_(params) {}
+
+int PoseGraph::add_node(const Pose2 &initial) {
+  Node n;
+  n.pose[0] = initial.x;
+  n.pose[1] = initial.y;
+  n.pose[2] = initial.theta;
+  n.linearized = n.pose;
+  n.fixed = nodes_.empty();
+  nodes_.push_back(n);
+  structure_dirty_ = true;
+  return node_count() - 1;
+}
+
+int PoseGraph::add_edge(const PoseGraphEdge &edge) {
+  if (edge.from < 0 || edge.from >= node_count() || edge.to < 0 || edge.to >= node_count() || edge.from == edge.to)
+    return -1;
+  Edge e;
+  e.edge = edge;
+  for (int i = 0; i < 9; ++i) e.omega.m[i] = edge.information[i];
+  edges_.push_back(e);
+  structure_dirty_ = true;
+  return edge_count() - 1;
+}
+
+void PoseGraph::set_fixed(int node, bool fixed) {
+  if (nodes_[node].fixed == fixed) return;
+  nodes_[node].fixed = fixed;
+  structure_dirty_ = true;
+}
+
+void PoseGraph::set_pose(int node, const Pose2 &pose) {
+  Node &n = nodes_[node];
+  n.pose[0] = pose.x;
+  n.pose[1] = pose.y;
+  n.pose[2] = pose.theta;
+}
+
+Pose2 PoseGraph::pose(int node) const {
+  const Vector<3> &p = nodes_[node].pose;
+  return Pose2{static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(wrap(p[2]))};
+}
+
+// r = t2v(Z^-1 (A^-1 B)): the measurement's error expressed in its own
+// frame. With l = R_a^T (t_b - t_a), the translation part is R_z^T (l - t_z)
+// and dl/dtheta_a = (l_y, -l_x).
+Vector<3> PoseGraph::residual(const Edge &e, const Vector<3> &a, const Vector<3> &b, Matrix<3, 3> *A,
+                              Matrix<3, 3> *B) {
+  const Pose2 &z = e.edge.measurement;
+  const double ca = cos(a[2]), sa = sin(a[2]), cz = cos(z.theta), sz = sin(z.theta);
+  const double dx = b[0] - a[0], dy = b[1] - a[1];
+  const double lx = ca * dx + sa * dy, ly = -sa * dx + ca * dy;
+  const double ex = lx - z.x, ey = ly - z.y;
+  Vector<3> r;
+  r[0] = cz * ex + sz * ey;
+  r[1] = -sz * ex + cz * ey;
+  r[2] = wrap(b[2] - a[2] - z.theta);
+  if (A && B) {
+    // rows of R_z^T applied to dl
+    const double c0 = cz * ca - sz * sa, s0 = cz * sa + sz * ca; // R_z^T R_a^T, first row
+    *B = Matrix<3, 3>::zero();
+    (*B)(0, 0) = c0;
+    (*B)(0, 1) = s0;
+    (*B)(1, 0) = -s0;
+    (*B)(1, 1) = c0;
+    (*B)(2, 2) = 1.0;
+    *A = Matrix<3, 3>::zero();
+    (*A)(0, 0) = -c0;
+    (*A)(0, 1) = -s0;
+    (*A)(1, 0) = s0;
+    (*A)(1, 1) = -c0;
+    (*A)(0, 2) = cz * ly - sz * lx;
+    (*A)(1, 2) = -sz * ly - cz * lx;
+    (*A)(2, 2) = -1.0;
+  }
+  return r;
+}
+
+double PoseGraph::robust_cost(const Edge &e, const Vector<3> &r, double *weight) {
+  const double s = (transpose(r) * (e.omega * r))[0];
+  const double d2 = static_cast<double>(e.edge.kernel_width) * e.edge.kernel_width;
+  double rho = s, w = 1.0;
+  switch (e.edge.kernel) {
+  case RobustKernel::kNone:
+    break;
+  case RobustKernel::kHuber:
+    if (s > d2) {
+      const double root = sqrt(s), d = sqrt(d2);
+      rho = 2.0 * d * root - d2;
+      w = d / root;
+    }
+    break;
+  case RobustKernel::kCauchy:
+    rho = d2 * log1p(s / d2);
+    w = 1.0 / (1.0 + s / d2);
+    break;
+  }
+  if (weight) *weight = w;
+  return rho;
+}
+
+double PoseGraph::cost() const {
+  double c = 0.0;
+  for (const Edge &e : edges_)
+    c += robust_cost(e, residual(e, nodes_[e.edge.from].pose, nodes_[e.edge.to].pose));
+  return c;
+}
+
+void PoseGraph::linearize(Edge &e, bool at_linearization_point) {
+  const Node &a = nodes_[e.edge.from], &b = nodes_[e.edge.to];
+  e.e = at_linearization_point ? residual(e, a.linearized, b.linearized, &e.A, &e.B)
+                               : residual(e, a.pose, b.pose, &e.A, &e.B);
+  e.fresh = false;
+}
+
+void PoseGraph::structure() {
+  vars_ = 0;
+  for (Node &n : nodes_) n.var = n.fixed ? -1 : vars_++;
+  std::vector<std::pair<int, int>> nonzeros;
+  nonzeros.reserve(edges_.size());
+  for (const Edge &e : edges_) {
+    const int i = nodes_[e.edge.from].var, j = nodes_[e.edge.to].var;
+    if (i >= 0 && j >= 0) nonzeros.push_back(std::make_pair(i, j));
+  }
+  solver_.analyze(vars_, nonzeros);
+  rhs_.assign(static_cast<size_t>(vars_) * 3, 0.0);
+  step_.assign(static_cast<size_t>(vars_) * 3, 0.0);
+  structure_dirty_ = false;
+}
+
+// H = sum w J^T Omega J and g = sum w J^T Omega e over edges, J = [A B]
+// on the from and to blocks; rhs_ gets -g
+void PoseGraph::assemble() {
+  solver_.clear();
+  for (double &v : rhs_) v = 0.0;
+  for (const Edge &e : edges_) {
+    double w;
+    robust_cost(e, e.e, &w);
+    const Matrix<3, 3> W = e.omega * w;
+    const int i = nodes_[e.edge.from].var, j = nodes_[e.edge.to].var;
+    const Vector<3> We = W * e.e;
+    if (i >= 0) {
+      const Matrix<3, 3> AtW = transpose(e.A) * W;
+      solver_.add(i, i, AtW * e.A);
+      const Vector<3> g = transpose(e.A) * We;
+      for (int k = 0; k < 3; ++k) rhs_[3 * i + k] -= g[k];
+      if (j >= 0) solver_.add(i, j, AtW * e.B);
+    }
+    if (j >= 0) {
+      solver_.add(j, j, transpose(e.B) * W * e.B);
+      const Vector<3> g = transpose(e.B) * We;
+      for (int k = 0; k < 3; ++k) rhs_[3 * j + k] -= g[k];
+    }
+  }
+}
+
+// Levenberg-Marquardt with Marquardt's diagonal scaling: a rejected step
+// raises the damping and solves the same linearization again.
+PoseGraphResult PoseGraph::optimize() {
+  PoseGraphResult result;
+  if (structure_dirty_) structure();
+  double current = result.initial_cost = cost();
+  double lambda = params_.initial_damping;
+  std::vector<Vector<3>> saved(nodes_.size());
+  while (result.iterations < params_.max_iterations && vars_ > 0) {
+    ++result.iterations;
+    for (Edge &e : edges_) linearize(e, false);
+    assemble();
+    bool accepted = false;
+    while (!accepted && lambda < 1e10) {
+      if (!solver_.factor(lambda)) {
+        lambda *= 10.0;
+        continue;
+      }
+      solver_.solve(rhs_.data(), step_.data());
+      for (size_t k = 0; k < nodes_.size(); ++k) {
+        Node &n = nodes_[k];
+        saved[k] = n.pose;
+        if (n.var < 0) continue;
+        for (int d = 0; d < 3; ++d) n.pose[d] += step_[3 * n.var + d];
+      }
+      const double next = cost();
+      if (next < current) {
+        accepted = true;
+        lambda = lambda / 10.0 > 1e-12 ? lambda / 10.0 : 1e-12;
+        const double drop = current - next;
+        current = next;
+        if (drop < params_.relative_tolerance * current) result.converged = true;
+      } else {
+        for (size_t k = 0; k < nodes_.size(); ++k) nodes_[k].pose = saved[k];
+        lambda *= 10.0;
+      }
+    }
+    // no step lowers the cost: at a minimum as far as rounding can tell
+    if (!accepted) result.converged = true;
+    if (result.converged) break;
+  }
+  for (Node &n : nodes_) {
+    n.pose[2] = wrap(n.pose[2]);
+    n.linearized = n.pose;
+    n.fresh = false;
+  }
+  // the cached linearizations are at the old poses
+  for (Edge &e : edges_) e.fresh = true;
+  result.final_cost = current;
+  return result;
+}
+
+// Fluid relinearization (Kaess et al., iSAM2): the normal equations are
+// those of the edges linearized at their nodes' linearization points, so the
+// solution is the offset of every node from its own linearization point.
+// Only nodes that drifted past the threshold move their point, and only the
+// edges on them are linearized again.
+PoseGraphResult PoseGraph::optimize_incremental() {
+  PoseGraphResult result;
+  if (structure_dirty_) structure();
+  result.initial_cost = cost();
+  const double threshold = params_.relinearize_threshold;
+  for (Node &n : nodes_) {
+    bool moved = n.fresh;
+    for (int d = 0; d < 3 && !moved; ++d) moved = fabs(n.pose[d] - n.linearized[d]) > threshold;
+    if (!moved) continue;
+    n.linearized = n.pose;
+    n.fresh = true;
+    ++result.relinearized;
+  }
+  int linearized = 0;
+  for (Edge &e : edges_)
+    if (e.fresh || nodes_[e.edge.from].fresh || nodes_[e.edge.to].fresh) {
+      linearize(e, true);
+      ++linearized;
+    }
+  for (Node &n : nodes_) n.fresh = false;
+  // same linear system as last time: the poses are its solution already
+  if (vars_ > 0 && linearized > 0) {
+    assemble();
+    // a whisker of damping keeps nodes no edge constrains solvable
+    if (solver_.factor(1e-9)) {
+      solver_.solve(rhs_.data(), step_.data());
+      for (Node &n : nodes_) {
+        if (n.var < 0) continue;
+        for (int d = 0; d < 3; ++d) n.pose[d] = n.linearized[d] + step_[3 * n.var + d];
+      }
+      result.iterations = 1;
+      result.converged = true;
+    }
+  }
+  result.final_cost = cost();
+  return result;
+}
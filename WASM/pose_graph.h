@@ -0,0 +1,117 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+#include "pose2.h"
+#include "sparse_block_cholesky.h"
+
+// SE(2) pose graph: nodes are robot poses, edges relative-pose measurements
+// between them (odometry between consecutive scans, loop closures between
+// revisits). optimize() finds the poses that best agree with every edge by
+// Levenberg-Marquardt on the sparse normal equations (sparse_block_cholesky.h);
+// robust kernels keep a few wrong loop closures from bending the map.
+//
+// optimize_incremental() is for a graph that grows while it is being
+// optimized: edges stay linearized at their nodes' linearization points, and
+// only nodes that moved more than relinearize_threshold since (plus new
+// ones) are linearized again; the ordering is only recomputed when edges
+// were added. The solver itself is independent of the pose type, so SE(3)
+// takes the same shape with 6x6 blocks.
+
+enum class RobustKernel {
+  kNone,
+  kHuber,  // quadratic up to width, linear beyond
+  kCauchy, // log(1 + (e/width)^2), for outliers far from the inliers
+};
+
+struct PoseGraphEdge {
+  int from = 0, to = 0;
+  Pose2 measurement{0, 0, 0}; // to in from's frame, between(from, to)
+  // inverse covariance of (x, y, theta), row-major
+  float information[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  RobustKernel kernel = RobustKernel::kNone;
+  float kernel_width = 1.0f; // in Mahalanobis units, sqrt of the chi-square
+};
+
+struct PoseGraphParams {
+  int max_iterations = 20;
+  // stop once an iteration lowers the cost by less than this fraction
+  double relative_tolerance = 1e-6;
+  double initial_damping = 1e-4; // Levenberg-Marquardt lambda
+  // incremental mode relinearizes a node once its estimate is this far from
+  // where its edges were linearized (m, and rad for theta)
+  double relinearize_threshold = 1e-3;
+};
+
+struct PoseGraphResult {
+  int iterations = 0;
+  double initial_cost = 0.0, final_cost = 0.0; // sum of robust chi-squares
+  int relinearized = 0;                        // nodes, incremental mode
+  bool converged = false;
+};
+
+class PoseGraph {
+public:
+  explicit PoseGraph(const PoseGraphParams &params = PoseGraphParams{});
+
+  const PoseGraphParams &params() const { return params_; }
+
+  // returns the node id, consecutive from 0
+  int add_node(const Pose2 &initial);
+  // returns the edge index, or -1 if either node does not exist
+  int add_edge(const PoseGraphEdge &edge);
+  // fixed nodes anchor the graph; node 0 is fixed when created
+  void set_fixed(int node, bool fixed);
+  void set_pose(int node, const Pose2 &pose);
+
+  int node_count() const { return static_cast<int>(nodes_.size()); }
+  int edge_count() const { return static_cast<int>(edges_.size()); }
+  Pose2 pose(int node) const;
+  const PoseGraphEdge &edge(int i) const { return edges_[i].edge; }
+  // sum over edges of the robust chi-square at the current poses
+  double cost() const;
+  // nonzero 3x3 blocks of the last factorization, fill-in included
+  int factor_blocks() const { return solver_.factor_blocks(); }
+
+  // Levenberg-Marquardt from the current poses to convergence
+  PoseGraphResult optimize();
+  // one Gauss-Newton step with cached linearizations, see above; does
+  // nothing (0 iterations) when no node or edge needs linearizing
+  PoseGraphResult optimize_incremental();
+
+private:
+  struct Node {
+    Vector<3> pose;       // x, y, theta
+    Vector<3> linearized; // linearization point, incremental mode
+    bool fixed = false;
+    bool fresh = true; // not linearized yet
+    int var = -1;      // block row in the solver, -1 if fixed
+  };
+  struct Edge {
+    PoseGraphEdge edge;
+    Matrix<3, 3> omega;
+    // linearization: residual and Jacobians with respect to from and to
+    Vector<3> e;
+    Matrix<3, 3> A, B;
+    bool fresh = true;
+  };
+
+  // residual of e between poses a (from) and b (to), and its Jacobians if
+  // A and B are given
+  static Vector<3> residual(const Edge &e, const Vector<3> &a, const Vector<3> &b, Matrix<3, 3> *A = nullptr,
+                            Matrix<3, 3> *B = nullptr);
+  // robust chi-square of a residual, and the IRLS weight d rho / d chi2
+  static double robust_cost(const Edge &e, const Vector<3> &r, double *weight = nullptr);
+  void linearize(Edge &e, bool at_linearization_point);
+  void structure();
+  // assembles the normal equations from the cached linearizations
+  void assemble();
+
+  PoseGraphParams params_;
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;
+  bool structure_dirty_ = true;
+  int vars_ = 0;
+  SparseBlockCholesky<3> solver_;
+  std::vector<double> rhs_, step_;
+};
@@ -0,0 +1,84 @@
+#include "pose_graph_worker.h"
+
+PoseGraphWorker::PoseGraphWorker(const PoseGraphParams &params) : graph_(params) {
+  thread_ = std::thread(&PoseGraphWorker::run, this);
+}
+
+PoseGraphWorker::~PoseGraphWorker() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+int PoseGraphWorker::add_node(const Pose2 &frontend_pose) {
+  std::lock_guard<std::mutex> lk(m_);
+  queued_nodes_.push_back(frontend_pose);
+  return next_node_++;
+}
+
+void PoseGraphWorker::add_edge(const PoseGraphEdge &edge) {
+  std::lock_guard<std::mutex> lk(m_);
+  queued_edges_.push_back(edge);
+}
+
+void PoseGraphWorker::request_optimize() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    ++requested_;
+  }
+  wake_.notify_one();
+}
+
+uint64_t PoseGraphWorker::poses(std::vector<Pose2> &out) const {
+  std::lock_guard<std::mutex> lk(m_);
+  out = published_;
+  return version_.load(std::memory_order_relaxed);
+}
+
+void PoseGraphWorker::wait_idle() {
+  std::unique_lock<std::mutex> lk(m_);
+  idle_.wait(lk, [this] { return served_ == requested_ || stop_; });
+}
+
+void PoseGraphWorker::run() {
+  std::vector<Pose2> nodes, out;
+  std::vector<PoseGraphEdge> edges;
+  for (;;) {
+    uint64_t request;
+    {
+      std::unique_lock<std::mutex> lk(m_);
+      wake_.wait(lk, [this] { return stop_ || requested_ != served_; });
+      if (stop_) break;
+      request = requested_;
+      nodes.swap(queued_nodes_);
+      edges.swap(queued_edges_);
+    }
+
+    for (const Pose2 &p : nodes) {
+      const int n = graph_.node_count();
+      graph_.add_node(n == 0 ? p : compose(graph_.pose(n - 1), between(frontend_[n - 1], p)));
+      frontend_.push_back(p);
+    }
+    // edges may name nodes of the same batch, so they go in after them
+    for (const PoseGraphEdge &e : edges) graph_.add_edge(e);
+    nodes.clear();
+    edges.clear();
+    // until the step moves no node past the relinearization threshold
+    for (int step = 0; step < graph_.params().max_iterations; ++step)
+      if (graph_.optimize_incremental().iterations == 0) break;
+
+    out.resize(graph_.node_count());
+    for (int i = 0; i < graph_.node_count(); ++i) out[i] = graph_.pose(i);
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      published_.swap(out);
+      version_.fetch_add(1, std::memory_order_release);
+      served_ = request;
+    }
+    idle_.notify_all();
+  }
+  idle_.notify_all();
+}
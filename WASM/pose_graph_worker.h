@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "pose_graph.h"
+
+// A PoseGraph optimized on its own thread, so the front-end never waits on
+// it. The front-end queues nodes and edges (a short critical section, no
+// solver work) and asks for an optimization; the thread folds the queue
+// into its graph, runs incremental steps until no node needs relinearizing,
+// and publishes the poses under a version number. The front-end copies them
+// whenever it likes, e.g. into map.cpp's pose buffer with commit_poses.
+//
+// Nodes carry the front-end's own pose. A new node starts from the last
+// optimized pose of the node before it plus the front-end's motion between
+// the two, so the correction carries over to poses added since.
+
+class PoseGraphWorker {
+public:
+  explicit PoseGraphWorker(const PoseGraphParams &params = PoseGraphParams{});
+  ~PoseGraphWorker();
+  PoseGraphWorker(const PoseGraphWorker &) = delete;
+  PoseGraphWorker &operator=(const PoseGraphWorker &) = delete;
+
+  // returns the node id, consecutive from 0 like PoseGraph
+  int add_node(const Pose2 &frontend_pose);
+  void add_edge(const PoseGraphEdge &edge);
+  // wakes the thread to optimize everything queued so far
+  void request_optimize();
+
+  // copies the newest optimized poses (nodes queued since are missing) and
+  // returns their version, 0 before the first optimization
+  uint64_t poses(std::vector<Pose2> &out) const;
+  uint64_t version() const { return version_.load(std::memory_order_acquire); }
+  // blocks until every request so far has been served; for tests and
+  // shutdown, not the front-end
+  void wait_idle();
+
+private:
+  void run();
+
+  PoseGraph graph_; // the thread's alone
+  std::vector<Pose2> frontend_; // front-end pose of every node in graph_
+
+  mutable std::mutex m_;
+  std::condition_variable wake_, idle_;
+  std::vector<Pose2> queued_nodes_;
+  std::vector<PoseGraphEdge> queued_edges_;
+  int next_node_ = 0;
+  uint64_t requested_ = 0, served_ = 0;
+  bool stop_ = false;
+  std::vector<Pose2> published_;
+  std::atomic<uint64_t> version_{0};
+  std::thread thread_;
+};
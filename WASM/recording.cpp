@@ -0,0 +1,61 @@
+#include "recording.h"
+#include <string.h>
+
+namespace {
+
+constexpr uint8_t zero_pad[8] = {};
+
+size_t padded(size_t bytes) { return (bytes + 7) & ~static_cast<size_t>(7); }
+
+} // namespace
+
+bool RecordingWriter::open(const char *path) {
+  std::lock_guard<std::mutex> lk(m_);
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    fprintf(stderr, "recording: cannot open %s\n", path);
+    return false;
+  }
+  RecordingHeader h{};
+  memcpy(h.magic, "ROAMRREC", sizeof(h.magic));
+  h.version = RecordingVersion;
+  fwrite(&h, sizeof(h), 1, file_);
+  return true;
+}
+
+void RecordingWriter::close() {
+  std::lock_guard<std::mutex> lk(m_);
+  if (file_) fclose(file_);
+  file_ = nullptr;
+}
+
+void RecordingWriter::write_imu(const IMUData &d) {
+  std::lock_guard<std::mutex> lk(m_);
+  if (!file_) return;
+  const RecordingChunk c{RECORDING_IMU, static_cast<uint32_t>(padded(sizeof(IMUData)))};
+  fwrite(&c, sizeof(c), 1, file_);
+  fwrite(&d, sizeof(d), 1, file_);
+  fwrite(zero_pad, 1, c.bytes - sizeof(IMUData), file_);
+}
+
+void RecordingWriter::write_frame(const FrameSlot &frame) {
+  RecordingFrame f{};
+  f.timestamp = frame.timestamp;
+  f.depth_width = frame.depth_width;
+  f.depth_height = frame.depth_height;
+  f.image_width = frame.image_width;
+  f.image_height = frame.image_height;
+  f.image_channels = frame.image_channels;
+  const size_t depth_bytes = sizeof(float) * f.depth_width * f.depth_height;
+  const size_t image_bytes = static_cast<size_t>(f.image_width) * f.image_height * f.image_channels;
+  const size_t payload = sizeof(f) + depth_bytes + image_bytes;
+
+  std::lock_guard<std::mutex> lk(m_);
+  if (!file_) return;
+  const RecordingChunk c{RECORDING_FRAME, static_cast<uint32_t>(padded(payload))};
+  fwrite(&c, sizeof(c), 1, file_);
+  fwrite(&f, sizeof(f), 1, file_);
+  fwrite(frame.depth_map, 1, depth_bytes, file_);
+  fwrite(frame.image, 1, image_bytes, file_);
+  fwrite(zero_pad, 1, c.bytes - payload, file_);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "imu.h"
+#include "frame_pool.h"
+
+// Sensor recording format, replayed on Linux by native/replay_host.cpp.
+//
+// File layout (little-endian, every chunk 8-byte aligned):
+//   RecordingHeader
+//   { RecordingChunk, payload } * N, in roughly arrival order
+//     RECORDING_IMU:   IMUData
+//     RECORDING_FRAME: RecordingFrame, float depth[w*h], uint8_t image[w*h*c], padding
+// Readers order chunks by timestamp, so IMU and frame threads may append
+// independently.
+
+constexpr uint32_t RecordingVersion = 1;
+
+enum RecordingChunkType : uint32_t {
+  RECORDING_IMU = 1,
+  RECORDING_FRAME = 2,
+};
+
+struct RecordingHeader {
+  char magic[8]; // "ROAMRREC"
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct RecordingChunk {
+  uint32_t type;
+  uint32_t bytes; // payload size including padding
+};
+
+struct RecordingFrame {
+  double timestamp;
+  int32_t depth_width;
+  int32_t depth_height;
+  int32_t image_width;
+  int32_t image_height;
+  int32_t image_channels;
+  int32_t reserved;
+};
+
+static_assert(sizeof(RecordingHeader) == 16 && sizeof(RecordingChunk) == 8 && sizeof(RecordingFrame) == 32,
+              "recording structs are part of the file format");
+
+// appends sensor data as it arrives; safe to call from several threads
+class RecordingWriter {
+public:
+  RecordingWriter() = default;
+  ~RecordingWriter() { close(); }
+  RecordingWriter(const RecordingWriter &) = delete;
+  RecordingWriter &operator=(const RecordingWriter &) = delete;
+
+  bool open(const char *path);
+  void close();
+  bool is_open() const { return file_ != nullptr; }
+
+  void write_imu(const IMUData &d);
+  void write_frame(const FrameSlot &frame);
+
+private:
+  std::mutex m_;
+  FILE *file_ = nullptr;
+};
@@ -0,0 +1,306 @@
+#include "scan_matcher.h"
+
+#include <algorithm>
+#include <math.h>
+
+// floor without a floorf call (libm on baseline x86-64); v is clamped so
+// points far outside the window cannot overflow
+static inline int32_t floor_cell(float v) {
+  v = v < -1e6f ? -1e6f : (v > 1e6f ? 1e6f : v);
+  const int32_t i = static_cast<int32_t>(v);
+  return i - (static_cast<float>(i) > v);
+}
+
+// inverse of a symmetric 3x3 matrix; false if it is (nearly) singular
+static bool invert3(const double a[9], double out[9]) {
+  const double c0 = a[4] * a[8] - a[5] * a[7];
+  const double c1 = a[5] * a[6] - a[3] * a[8];
+  const double c2 = a[3] * a[7] - a[4] * a[6];
+  const double det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+  if (!(fabs(det) > 1e-30)) return false;
+  const double inv = 1.0 / det;
+  out[0] = c0 * inv;
+  out[1] = (a[2] * a[7] - a[1] * a[8]) * inv;
+  out[2] = (a[1] * a[5] - a[2] * a[4]) * inv;
+  out[3] = c1 * inv;
+  out[4] = (a[0] * a[8] - a[2] * a[6]) * inv;
+  out[5] = (a[2] * a[3] - a[0] * a[5]) * inv;
+  out[6] = c2 * inv;
+  out[7] = (a[1] * a[6] - a[0] * a[7]) * inv;
+  out[8] = (a[0] * a[4] - a[1] * a[3]) * inv;
+  return true;
+}
+
+int slice_scan(const PointCloud &cloud, float min_z, float max_z, Scan2D &out) {
+  out.reserve(cloud.size);
+  int n = 0;
+  for (int i = 0; i < cloud.size; ++i) {
+    const float z = cloud.z[i];
+    if (!(z >= min_z && z <= max_z)) continue;
+    out.x[n] = cloud.x[i];
+    out.y[n] = cloud.y[i];
+    ++n;
+  }
+  out.size = n;
+  return n;
+}
+
+ScanMatcher::ScanMatcher(const ScanMatchParams &params) : params_(params), field_(params.field) {
+  if (params_.levels < 1) params_.levels = 1;
+  if (params_.levels > 8) params_.levels = 8;
+}
+
+void ScanMatcher::set_map(OccupancyGrid &grid, float cx, float cy, float half_extent) {
+  field_.update(grid);
+  resolution_ = grid.resolution;
+  inv_resolution_ = grid.invResolution;
+  width_ = height_ = 0;
+  int32_t x0, y0, x1, y1;
+  if (!occ_cell(cx - half_extent, inv_resolution_, &x0) || !occ_cell(cy - half_extent, inv_resolution_, &y0) ||
+      !occ_cell(cx + half_extent, inv_resolution_, &x1) || !occ_cell(cy + half_extent, inv_resolution_, &y1))
+    return;
+  // a margin of the coarsest block keeps every block of an in-window scan inside
+  const int32_t pad = 1 << (params_.levels - 1);
+  x0 -= pad;
+  y0 -= pad;
+  x1 += pad;
+  y1 += pad;
+  width_ = x1 - x0 + 1;
+  height_ = y1 - y0 + 1;
+  origin_x_ = x0 * resolution_;
+  origin_y_ = y0 * resolution_;
+  const size_t cells = static_cast<size_t>(width_) * height_;
+  const int16_t far = field_.far_value();
+  distance_.assign(cells, far);
+  pyramid_.resize(params_.levels);
+  for (auto &level : pyramid_) level.assign(cells, 0);
+
+  // score by distance, exp(-d^2 / 2 sigma^2) scaled to 0..255
+  if (lut_resolution_ != resolution_) {
+    lut_resolution_ = resolution_;
+    score_lut_.resize(far + 1);
+    const float k = resolution_ / 256.0f / params_.sigma;
+    for (int d = 0; d <= far; ++d) score_lut_[d] = static_cast<uint8_t>(255.0f * expf(-0.5f * (d * k) * (d * k)) + 0.5f);
+    score_lut_[far] = 0; // nothing within reach
+  }
+
+  // copy tile by tile; missing tiles have nothing within reach
+  uint8_t *base = pyramid_[0].data();
+  for (int32_t ty = y0 >> TILE_SHIFT; ty <= y1 >> TILE_SHIFT; ++ty) {
+    for (int32_t tx = x0 >> TILE_SHIFT; tx <= x1 >> TILE_SHIFT; ++tx) {
+      const int16_t *t = field_.tile(tx, ty);
+      if (!t) continue;
+      const int32_t cy0 = std::max(ty * TILE_SIZE, y0), cy1 = std::min(ty * TILE_SIZE + TILE_MASK, y1);
+      const int32_t cx0 = std::max(tx * TILE_SIZE, x0), cx1 = std::min(tx * TILE_SIZE + TILE_MASK, x1);
+      for (int32_t y = cy0; y <= cy1; ++y) {
+        const int16_t *row = t + ((y & TILE_MASK) << TILE_SHIFT);
+        const size_t out = static_cast<size_t>(y - y0) * width_ - x0;
+        for (int32_t x = cx0; x <= cx1; ++x) {
+          const int16_t d = row[x & TILE_MASK];
+          distance_[out + x] = d;
+          base[out + x] = score_lut_[d];
+        }
+      }
+    }
+  }
+
+  // level k from level k - 1: the max of the four half-size blocks
+  for (int k = 1; k < params_.levels; ++k) {
+    const int h = 1 << (k - 1);
+    const uint8_t *src = pyramid_[k - 1].data();
+    uint8_t *dst = pyramid_[k].data();
+    for (int y = 0; y < height_; ++y) {
+      const uint8_t *r0 = src + static_cast<size_t>(y) * width_;
+      const uint8_t *r1 = y + h < height_ ? r0 + static_cast<size_t>(h) * width_ : nullptr;
+      uint8_t *d = dst + static_cast<size_t>(y) * width_;
+      for (int x = 0; x < width_; ++x) {
+        uint8_t m = r0[x];
+        if (x + h < width_) m = std::max(m, r0[x + h]);
+        if (r1) {
+          m = std::max(m, r1[x]);
+          if (x + h < width_) m = std::max(m, r1[x + h]);
+        }
+        d[x] = m;
+      }
+    }
+  }
+}
+
+void ScanMatcher::reset_map(OccupancyGrid &grid, float cx, float cy, float half_extent) {
+  field_.rebuild(grid);
+  set_map(grid, cx, cy, half_extent);
+}
+
+float ScanMatcher::score(int level, int angle, int dx, int dy) const {
+  const uint8_t *g = pyramid_[level].data();
+  const int32_t *c = cells_.data() + static_cast<size_t>(angle) * points_ * 2;
+  const uint32_t w = static_cast<uint32_t>(width_), h = static_cast<uint32_t>(height_);
+  uint32_t sum = 0;
+  for (int i = 0; i < points_; ++i) {
+    const uint32_t x = static_cast<uint32_t>(c[2 * i] + dx), y = static_cast<uint32_t>(c[2 * i + 1] + dy);
+    if (x < w && y < h) sum += g[y * w + x];
+  }
+  return sum * (1.0f / 255.0f) / points_;
+}
+
+// Depth-first branch and bound. A candidate at level k stands for the
+// 2^k x 2^k offsets starting at (dx, dy), and its level-k score bounds all
+// of theirs, so subtrees that cannot beat the best leaf so far are cut.
+void ScanMatcher::search(int level, Candidate *candidates, int count, Candidate &best) const {
+  std::sort(candidates, candidates + count, [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+  for (int i = 0; i < count; ++i) {
+    const Candidate &c = candidates[i];
+    if (c.score <= best.score) return;
+    if (level == 0) {
+      best = c; // sorted, so the rest are no better
+      return;
+    }
+    const int h = 1 << (level - 1);
+    Candidate kids[4];
+    int n = 0;
+    for (int oy = 0; oy <= h; oy += h) {
+      for (int ox = 0; ox <= h; ox += h) {
+        const int dx = c.dx + ox, dy = c.dy + oy;
+        if (dx > window_cells_ || dy > window_cells_) continue;
+        kids[n++] = Candidate{c.angle, dx, dy, score(level - 1, c.angle, dx, dy)};
+      }
+    }
+    search(level - 1, kids, n, best);
+  }
+}
+
+// Bilinear distance (meters) and gradient at world point q from the window;
+// false outside it or where all four cells are beyond max_distance.
+bool ScanMatcher::distance(float qx, float qy, float &d, float &dx, float &dy) const {
+  const float u = (qx - origin_x_) * inv_resolution_ - 0.5f, w = (qy - origin_y_) * inv_resolution_ - 0.5f;
+  const int32_t i = floor_cell(u), j = floor_cell(w);
+  if (i < 0 || j < 0 || i + 1 >= width_ || j + 1 >= height_) return false;
+  const int16_t *p = distance_.data() + static_cast<size_t>(j) * width_ + i;
+  const int32_t d00 = p[0], d10 = p[1], d01 = p[width_], d11 = p[width_ + 1];
+  const int32_t far = field_.far_value();
+  if (d00 == far && d10 == far && d01 == far && d11 == far) return false;
+  const float fa = u - i, fb = w - j;
+  const float top = d00 + (d10 - d00) * fa, bottom = d01 + (d11 - d01) * fa;
+  d = (top + (bottom - top) * fb) * (resolution_ / 256.0f);
+  dx = ((d10 - d00) * (1.0f - fb) + (d11 - d01) * fb) * (1.0f / 256.0f);
+  dy = (bottom - top) * (1.0f / 256.0f);
+  return true;
+}
+
+// Gauss-Newton on (x, y, theta) with Huber-weighted point distances plus
+// the prior; the covariance is sigma^2 * H^-1 of the scan terms alone.
+void ScanMatcher::refine(const Scan2D &scan, const Pose2 &prior, ScanMatchResult &result) const {
+  double x = result.pose.x, y = result.pose.y, th = result.pose.theta;
+  const double huber = resolution_;
+  const double w_xy = 1.0 / (params_.prior_sigma_xy * params_.prior_sigma_xy);
+  const double w_th = 1.0 / (params_.prior_sigma_theta * params_.prior_sigma_theta);
+  // nominal point noise, only scales the scan terms against the prior
+  const double point_var = 0.25 * resolution_ * resolution_;
+  double H[9], sse = 0.0;
+  int inliers = 0;
+  for (int it = 0; it < params_.icp_iterations; ++it) {
+    double g[3] = {0, 0, 0};
+    for (double &v : H) v = 0.0;
+    sse = 0.0;
+    inliers = 0;
+    const float c = cosf(static_cast<float>(th)), s = sinf(static_cast<float>(th));
+    for (int i = 0; i < scan.size; ++i) {
+      const float px = scan.x[i], py = scan.y[i];
+      const float qx = static_cast<float>(x) + c * px - s * py, qy = static_cast<float>(y) + s * px + c * py;
+      float d, nx, ny;
+      if (!distance(qx, qy, d, nx, ny) || d > params_.max_correspondence) continue;
+      const double r = d;
+      const double J[3] = {nx, ny, nx * (-s * px - c * py) + ny * (c * px - s * py)};
+      const double w = fabs(r) <= huber ? 1.0 : huber / fabs(r);
+      for (int a = 0; a < 3; ++a) {
+        g[a] += w * J[a] * r;
+        for (int b = 0; b < 3; ++b) H[3 * a + b] += w * J[a] * J[b];
+      }
+      sse += w * r * r;
+      ++inliers;
+    }
+    if (inliers < 3) break;
+    double A[9], b[3], step[3];
+    for (int k = 0; k < 9; ++k) A[k] = H[k] / point_var;
+    A[0] += w_xy;
+    A[4] += w_xy;
+    A[8] += w_th;
+    b[0] = -(g[0] / point_var + w_xy * (x - prior.x));
+    b[1] = -(g[1] / point_var + w_xy * (y - prior.y));
+    b[2] = -(g[2] / point_var + w_th * wrap_angle(static_cast<float>(th - prior.theta)));
+    double Ainv[9];
+    if (!invert3(A, Ainv)) break;
+    for (int k = 0; k < 3; ++k) step[k] = Ainv[3 * k] * b[0] + Ainv[3 * k + 1] * b[1] + Ainv[3 * k + 2] * b[2];
+    x += step[0];
+    y += step[1];
+    th += step[2];
+    if (fabs(step[0]) + fabs(step[1]) < 1e-4 * resolution_ && fabs(step[2]) < 1e-5) break;
+  }
+  result.pose = Pose2{static_cast<float>(x), static_cast<float>(y), wrap_angle(static_cast<float>(th))};
+  result.inliers = inliers;
+  if (inliers < 3) return; // keep the correlative covariance
+
+  // residual variance, floored at a quarter cell so a perfect fit is not overconfident
+  double var = inliers > 3 ? sse / (inliers - 3) : point_var;
+  var = std::max(var, 0.0625 * resolution_ * resolution_);
+  // a tiny ridge keeps directions the scan does not constrain finite (and huge)
+  const double ridge = 1e-9 * (H[0] + H[4] + H[8] + 1.0);
+  H[0] += ridge;
+  H[4] += ridge;
+  H[8] += ridge;
+  double cov[9];
+  if (!invert3(H, cov)) return;
+  for (int k = 0; k < 9; ++k) result.covariance[k] = static_cast<float>(var * cov[k]);
+}
+
+ScanMatchResult ScanMatcher::match(const Scan2D &scan, const Pose2 &prior) {
+  ScanMatchResult result{};
+  result.pose = prior;
+  if (scan.size < 3 || width_ == 0) return result;
+
+  // angle step that moves the farthest point by about one cell
+  float range2 = 0.0f;
+  for (int i = 0; i < scan.size; ++i) range2 = std::max(range2, scan.x[i] * scan.x[i] + scan.y[i] * scan.y[i]);
+  const float res = resolution_;
+  float step = params_.angular_window;
+  if (range2 > res * res) step = acosf(1.0f - res * res / (2.0f * range2));
+  const int half = step > 0.0f ? static_cast<int>(ceilf(params_.angular_window / step)) : 0;
+  const int angles = 2 * half + 1;
+  window_cells_ = static_cast<int>(ceilf(params_.linear_window * inv_resolution_));
+
+  points_ = scan.size;
+  angles_.resize(angles);
+  cells_.resize(static_cast<size_t>(angles) * points_ * 2);
+  const float ox = (prior.x - origin_x_) * inv_resolution_, oy = (prior.y - origin_y_) * inv_resolution_;
+  for (int a = 0; a < angles; ++a) {
+    const float th = prior.theta + (a - half) * step;
+    angles_[a] = th;
+    const float c = cosf(th) * inv_resolution_, s = sinf(th) * inv_resolution_;
+    int32_t *out = cells_.data() + static_cast<size_t>(a) * points_ * 2;
+    for (int i = 0; i < points_; ++i) {
+      const float px = scan.x[i], py = scan.y[i];
+      out[2 * i] = floor_cell(ox + c * px - s * py);
+      out[2 * i + 1] = floor_cell(oy + s * px + c * py);
+    }
+  }
+
+  // the coarsest level tiles the window with its blocks
+  const int top = params_.levels - 1, block = 1 << top;
+  top_.clear();
+  for (int a = 0; a < angles; ++a)
+    for (int dy = -window_cells_; dy <= window_cells_; dy += block)
+      for (int dx = -window_cells_; dx <= window_cells_; dx += block)
+        top_.push_back(Candidate{a, dx, dy, score(top, a, dx, dy)});
+  Candidate best{-1, 0, 0, params_.min_score - 1e-6f};
+  search(top, top_.data(), static_cast<int>(top_.size()), best);
+  if (best.angle < 0) return result;
+
+  result.ok = true;
+  result.score = best.score;
+  result.pose = Pose2{prior.x + best.dx * res, prior.y + best.dy * res, wrap_angle(angles_[best.angle])};
+  // until ICP says otherwise: uniform over one search cell
+  result.covariance[0] = result.covariance[4] = res * res / 12.0f;
+  result.covariance[8] = step * step / 12.0f;
+  if (params_.icp_iterations > 0) refine(scan, prior, result);
+  return result;
+}
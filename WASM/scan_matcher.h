@@ -0,0 +1,119 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "depth_projection.h"
+#include "likelihood_field.h"
+#include "occupancy_grid.h"
+#include "pose2.h"
+
+// 2D scan-to-map matching against an OccupancyGrid, through its likelihood
+// field (distance to the nearest obstacle, likelihood_field.h).
+//
+// A scan is a horizontal slice of the depth cloud in the robot frame. It is
+// aligned in two stages:
+//   1. correlative search: every pose in a window around the odometry prior
+//      (a grid of x, y offsets at cell size times an angle step that moves
+//      the farthest point by about one cell) is scored by
+//      exp(-d^2 / 2 sigma^2) at each point's cell, d its obstacle distance.
+//      Branch and bound over max-pooled copies of that score skips most
+//      poses but returns the same best pose as an exhaustive search.
+//   2. ICP on the distance field: Gauss-Newton from that pose on the
+//      bilinearly interpolated distance of every point (whose gradient is
+//      the normal of the nearest wall, so this is point-to-line), with a
+//      weak pull towards the prior.
+// The result feeds set_pose; its covariance says how well the scan
+// constrained it (large along a featureless corridor).
+
+struct ScanMatchParams {
+  float linear_window = 0.3f;   // +- meters around the prior for the correlative search
+  float angular_window = 0.2f;  // +- radians
+  int levels = 5;               // branch and bound pyramid depth
+  float min_score = 0.35f;      // mean point score in [0, 1] needed to accept a match
+  float sigma = 0.05f;          // meters, width of the correlative score
+  int icp_iterations = 10;
+  float max_correspondence = 0.1f; // meters; points farther from any obstacle are left out of ICP
+  float prior_sigma_xy = 0.1f;  // odometry prior, meters and radians
+  float prior_sigma_theta = 0.05f;
+  // Obstacles default to cells hit three times with map.cpp's increments:
+  // cells hit once or twice sit mostly behind walls, where no ray clears
+  // them again, and matching to them would let the map drift along with the
+  // odometry. field.max_distance bounds max_correspondence.
+  LikelihoodFieldParams field;
+};
+
+// scan points in the robot frame, structure of arrays like PointCloud
+struct Scan2D {
+  std::vector<float> x, y;
+  int size = 0;
+
+  void reserve(int n) {
+    if (n <= static_cast<int>(x.size())) return;
+    x.resize(n);
+    y.resize(n);
+  }
+};
+
+// keeps the points of a robot-frame cloud with min_z <= z <= max_z (e.g. a
+// band around sensor height), dropping their z; returns the count
+int slice_scan(const PointCloud &cloud, float min_z, float max_z, Scan2D &out);
+
+struct ScanMatchResult {
+  Pose2 pose;          // the prior if !ok
+  float covariance[9]; // x, y, theta, row-major; from the scan alone, the prior is not counted
+  float score;         // correlative score in [0, 1]
+  int inliers;         // points within max_correspondence of an obstacle in ICP
+  bool ok;             // false if no pose in the window reached min_score
+};
+
+class ScanMatcher {
+public:
+  explicit ScanMatcher(const ScanMatchParams &params = ScanMatchParams{});
+
+  const ScanMatchParams &params() const { return params_; }
+
+  // updates the likelihood field from the grid's changes (so the matcher
+  // must be the grid's only occ_take_dirty consumer), then copies the square
+  // of it within half_extent meters of (cx, cy) into the search grids.
+  // match() only sees this snapshot, so call it again after integrating. The
+  // square should hold the scan's range plus the linear window around the
+  // prior. Reuses storage of the same size.
+  void set_map(OccupancyGrid &grid, float cx, float cy, float half_extent);
+  // same after occ_clear() or loading the grid, changes the field cannot
+  // follow from the dirty box: rebuilds it from the whole grid first
+  void reset_map(OccupancyGrid &grid, float cx, float cy, float half_extent);
+
+  const LikelihoodField &field() const { return field_; }
+
+  ScanMatchResult match(const Scan2D &scan, const Pose2 &prior);
+
+private:
+  struct Candidate {
+    int angle, dx, dy; // angle index and cell offsets from the prior
+    float score;
+  };
+
+  float score(int level, int angle, int dx, int dy) const;
+  void search(int level, Candidate *candidates, int count, Candidate &best) const;
+  bool distance(float qx, float qy, float &d, float &dx, float &dy) const;
+  void refine(const Scan2D &scan, const Pose2 &prior, ScanMatchResult &result) const;
+
+  ScanMatchParams params_;
+  LikelihoodField field_;
+  float resolution_ = 0.05f;
+  float inv_resolution_ = 20.0f;
+  float origin_x_ = 0.0f, origin_y_ = 0.0f; // world position of the window's lower-left corner
+  int width_ = 0, height_ = 0;
+  // pyramid_[k]: per cell, the highest score in the 2^k x 2^k block starting there, 0..255
+  std::vector<std::vector<uint8_t>> pyramid_;
+  std::vector<int16_t> distance_; // the field's Q8.8 distances over the window, for ICP
+  std::vector<uint8_t> score_lut_; // Q8.8 distance -> level 0 score
+  float lut_resolution_ = 0.0f;
+
+  // per match: scan cells at each candidate angle, with the prior's translation
+  int points_ = 0;
+  int window_cells_ = 0; // linear window in cells
+  std::vector<float> angles_;
+  std::vector<int32_t> cells_; // angle-major x, y pairs
+  std::vector<Candidate> top_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+
+// Small scheduling primitives for the sensor threads. Everything blocks on a
+// condition variable (futex-backed memory.atomic.wait on wasm32-wasip1-threads)
+// instead of sleep_for, and every wait returns early once stop is requested so
+// threads can be joined.
+
+using SchedClock = std::chrono::steady_clock;
+
+// shared shutdown flag; request() wakes every sleeper
+class StopSignal {
+public:
+    void request() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    bool requested() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return stop_;
+    }
+
+    // false if stop was requested before the deadline
+    bool sleep_until(SchedClock::time_point deadline) {
+        std::unique_lock<std::mutex> lk(m_);
+        return !cv_.wait_until(lk, deadline, [this] { return stop_; });
+    }
+
+    bool sleep_for(SchedClock::duration d) { return sleep_until(SchedClock::now() + d); }
+
+private:
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// fixed-rate timer on absolute deadlines, so per-iteration work and wakeup
+// latency do not accumulate as drift. If the caller falls more than a full
+// period behind, missed ticks are skipped (and counted) instead of bursting.
+class PeriodicTimer {
+public:
+    PeriodicTimer(SchedClock::duration period, StopSignal& stop)
+        : period_(period), next_(SchedClock::now() + period), stop_(stop) {}
+
+    // false once stop is requested
+    bool wait() {
+        if (!stop_.sleep_until(next_)) return false;
+        next_ += period_;
+        const auto now = SchedClock::now();
+        if (now >= next_) {
+            const auto behind = (now - next_) / period_ + 1;
+            missed_ += static_cast<uint64_t>(behind);
+            next_ += behind * period_;
+        }
+        return true;
+    }
+
+    uint64_t missed() const { return missed_; }
+
+private:
+    SchedClock::duration period_;
+    SchedClock::time_point next_;
+    StopSignal& stop_;
+    uint64_t missed_ = 0;
+};
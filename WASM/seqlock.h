@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h> // memcpy
+#include <thread>
+#include <type_traits>
+
+// single-writer / multi-reader snapshot channel.
+// the writer publishes without ever blocking, readers retry if they raced a
+// publish. the payload is stored as relaxed atomic words so concurrent
+// copies are well defined (no data race on T itself).
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+
+public:
+    Seqlock() {
+        T zero{};
+        write_words(zero);
+    }
+
+    // only one thread may call store()
+    void store(const T& value) {
+        const uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed); // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        write_words(value);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    // returns false if a publish was in progress or raced the copy
+    bool try_load(T& out) const {
+        const uint32_t before = seq_.load(std::memory_order_acquire);
+        if (before & 1u) return false;
+        read_words(out);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq_.load(std::memory_order_relaxed) == before;
+    }
+
+    T load() const {
+        T out;
+        for (int spins = 0; !try_load(out); ++spins) {
+            if (spins > 64) std::this_thread::yield();
+        }
+        return out;
+    }
+
+    // 2 * completed publishes (odd while one is in flight), useful to detect new data
+    uint32_t sequence() const { return seq_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void write_words(const T& value) {
+        uint64_t buf[kWords] = {};
+        memcpy(buf, &value, sizeof(T));
+        for (size_t i = 0; i < kWords; ++i) words_[i].store(buf[i], std::memory_order_relaxed);
+    }
+
+    void read_words(T& out) const {
+        uint64_t buf[kWords];
+        for (size_t i = 0; i < kWords; ++i) buf[i] = words_[i].load(std::memory_order_relaxed);
+        memcpy(&out, buf, sizeof(T));
+    }
+
+    alignas(64) std::atomic<uint32_t> seq_{0};
+    std::atomic<uint64_t> words_[kWords];
+};
@@ -1,34 +1,87 @@
-#include <mutex>
-#include <thread>
 #include <chrono>
+#include <stdlib.h>
+#include <thread>
 
 #include "imu.h"
-#include "lidar_camera.h"
+#include "frame_pool.h"
+#include "recording.h"
+#include "scheduler.h"
+#include "seqlock.h"
 #include "telemetry.h"
 
-int main(){
-    std::mutex m_imu;
-    IMUData imu_data;
-    std::mutex m_lc;
-    LidarCameraData lc_data;
-
-    std::thread imu_thread([&m_imu, &imu_data](){
-        while(true){
-            std::this_thread::sleep_for(std::chrono::milliseconds(IMUIntervalMs));
-            std::lock_guard<std::mutex> lk(m_imu);
-            read_imu(&imu_data);
-        }
+// lives in linear memory so the host can write frames in place
+static FramePool frame_pool;
+
+// usage: slam_main [run_seconds [record_path]]
+// runs until the host ends the frame stream when run_seconds is omitted or 0;
+// record_path captures every IMU sample and frame for native/replay_host.cpp
+int main(int argc, char** argv){
+    StopSignal stop;
+    RecordingWriter recorder;
+    if(argc > 2) recorder.open(argv[2]);
+
+    TelemetryLog telemetry;
+    telemetry.open(telemetry_log_path);
+    TelemetryProducer* imu_log = telemetry.add_producer();
+    TelemetryProducer* frame_log = telemetry.add_producer();
+
+    // newest IMU sample, for the frame thread; the IMU thread never waits
+    // on its readers
+    Seqlock<IMUData> imu_snapshot;
+
+    // every buffered sample comes back in one crossing, so timer jitter no
+    // longer drops samples. read_imu_batch has no host wakeup, so this one
+    // stays on a timer
+    std::thread imu_thread([&](){
+        IMUData batch[IMUBatchMax];
+        auto drain = [&](){
+            int n;
+            while((n = read_imu_batch(batch, IMUBatchMax)) > 0){
+                for(int i = 0; i < n; ++i){
+                    imu_log->log_imu(batch[i]);
+                    if(recorder.is_open()) recorder.write_imu(batch[i]);
+                }
+                imu_snapshot.store(batch[n - 1]);
+            }
+        };
+        PeriodicTimer timer(std::chrono::milliseconds(IMUIntervalMs), stop);
+        while(timer.wait()) drain();
+        drain(); // whatever the host buffered before stop
     });
-    std::thread lidar_camera_thread([&m_lc, &lc_data](){
-        while(true){
-            std::this_thread::sleep_for(std::chrono::milliseconds(LidarCameraIntervalMs));
-            std::lock_guard<std::mutex> lk(m_lc);
-            read_lidar_camera(&lc_data);
+
+    // the host publishes LiDAR/camera frames into the pool at LidarCameraRefreshHz
+    // and wakes us from wait_frame as soon as one lands; each frame is handled
+    // on arrival instead of on the next telemetry tick
+    attach_frame_pool(&frame_pool);
+    std::thread lidar_camera_thread([&](){
+        uint32_t generation = 0;
+        while(!stop.requested()){
+            const uint32_t latest = wait_frame(generation, 2 * LidarCameraIntervalMs);
+            if(latest == FrameStreamEnded){
+                stop.request();
+                break;
+            }
+            if(latest != generation){
+                generation = latest;
+                if(FrameRef frame = frame_pool.borrow_latest()){
+                    frame_log->log_frame(*frame, imu_snapshot.load());
+                    if(recorder.is_open()) recorder.write_frame(*frame);
+                }
+            }
         }
     });
-    std::thread telemetry_thread(log_sensors, std::ref(m_imu), std::cref(imu_data), std::ref(m_lc), std::cref(lc_data));
+
+    // stopped separately so it drains after the sensor threads are done
+    StopSignal telemetry_stop;
+    std::thread telemetry_thread(log_sensors, std::ref(telemetry), std::ref(telemetry_stop));
+
+    if(argc > 1 && atof(argv[1]) > 0.0){
+        stop.sleep_for(std::chrono::duration_cast<SchedClock::duration>(std::chrono::duration<double>(atof(argv[1]))));
+        stop.request();
+    }
 
     imu_thread.join();
     lidar_camera_thread.join();
+    telemetry_stop.request();
     telemetry_thread.join();
 }
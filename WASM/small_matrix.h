@@ -0,0 +1,144 @@
+#pragma once
+#include <math.h>
+
+// Compile-time-sized dense matrices for filters: row-major, held by value,
+// no heap. Every loop has constant trip counts, so the compiler unrolls and
+// vectorizes them (wasm simd128 with -msimd128). Only what the filters need.
+
+template <int R, int C>
+struct Matrix {
+  static constexpr int kRows = R, kCols = C;
+  alignas(16) double m[R * C];
+
+  double &operator()(int r, int c) { return m[r * C + c]; }
+  double operator()(int r, int c) const { return m[r * C + c]; }
+  // vectors are R x 1
+  double &operator[](int i) { return m[i]; }
+  double operator[](int i) const { return m[i]; }
+
+  static Matrix zero() {
+    Matrix a;
+    for (int i = 0; i < R * C; ++i) a.m[i] = 0.0;
+    return a;
+  }
+  static Matrix identity() {
+    Matrix a = zero();
+    for (int i = 0; i < (R < C ? R : C); ++i) a.m[i * C + i] = 1.0;
+    return a;
+  }
+
+  // the BR x BC block at (r, c)
+  template <int BR, int BC>
+  Matrix<BR, BC> block(int r, int c) const {
+    Matrix<BR, BC> b;
+    for (int i = 0; i < BR; ++i)
+      for (int j = 0; j < BC; ++j) b.m[i * BC + j] = m[(r + i) * C + c + j];
+    return b;
+  }
+  template <int BR, int BC>
+  void set_block(int r, int c, const Matrix<BR, BC> &b) {
+    for (int i = 0; i < BR; ++i)
+      for (int j = 0; j < BC; ++j) m[(r + i) * C + c + j] = b.m[i * BC + j];
+  }
+};
+
+template <int N>
+using Vector = Matrix<N, 1>;
+
+template <int R, int C>
+inline Matrix<R, C> operator+(const Matrix<R, C> &a, const Matrix<R, C> &b) {
+  Matrix<R, C> out;
+  for (int i = 0; i < R * C; ++i) out.m[i] = a.m[i] + b.m[i];
+  return out;
+}
+
+template <int R, int C>
+inline Matrix<R, C> operator-(const Matrix<R, C> &a, const Matrix<R, C> &b) {
+  Matrix<R, C> out;
+  for (int i = 0; i < R * C; ++i) out.m[i] = a.m[i] - b.m[i];
+  return out;
+}
+
+template <int R, int C>
+inline Matrix<R, C> operator*(const Matrix<R, C> &a, double s) {
+  Matrix<R, C> out;
+  for (int i = 0; i < R * C; ++i) out.m[i] = a.m[i] * s;
+  return out;
+}
+
+// a b; the inner loop runs along rows of b and out so it vectorizes
+template <int R, int K, int C>
+inline Matrix<R, C> operator*(const Matrix<R, K> &a, const Matrix<K, C> &b) {
+  Matrix<R, C> out = Matrix<R, C>::zero();
+  for (int i = 0; i < R; ++i)
+    for (int k = 0; k < K; ++k) {
+      const double v = a.m[i * K + k];
+      for (int j = 0; j < C; ++j) out.m[i * C + j] += v * b.m[k * C + j];
+    }
+  return out;
+}
+
+// a b^T, dot products of rows
+template <int R, int K, int C>
+inline Matrix<R, C> mul_transpose(const Matrix<R, K> &a, const Matrix<C, K> &b) {
+  Matrix<R, C> out;
+  for (int i = 0; i < R; ++i)
+    for (int j = 0; j < C; ++j) {
+      double s = 0.0;
+      for (int k = 0; k < K; ++k) s += a.m[i * K + k] * b.m[j * K + k];
+      out.m[i * C + j] = s;
+    }
+  return out;
+}
+
+template <int R, int C>
+inline Matrix<C, R> transpose(const Matrix<R, C> &a) {
+  Matrix<C, R> out;
+  for (int i = 0; i < R; ++i)
+    for (int j = 0; j < C; ++j) out.m[j * R + i] = a.m[i * C + j];
+  return out;
+}
+
+// (a + a^T) / 2, against the asymmetry rounding leaves in covariances
+template <int N>
+inline void symmetrize(Matrix<N, N> &a) {
+  for (int i = 0; i < N; ++i)
+    for (int j = i + 1; j < N; ++j) a.m[i * N + j] = a.m[j * N + i] = 0.5 * (a.m[i * N + j] + a.m[j * N + i]);
+}
+
+// Inverse of a symmetric positive definite matrix through its Cholesky
+// factor; false if a is not positive definite.
+template <int N>
+inline bool invert_spd(const Matrix<N, N> &a, Matrix<N, N> &out) {
+  // a = L L^T, L lower triangular
+  double L[N * N] = {};
+  for (int j = 0; j < N; ++j) {
+    double d = a.m[j * N + j];
+    for (int k = 0; k < j; ++k) d -= L[j * N + k] * L[j * N + k];
+    if (!(d > 0.0)) return false;
+    L[j * N + j] = sqrt(d);
+    const double inv = 1.0 / L[j * N + j];
+    for (int i = j + 1; i < N; ++i) {
+      double s = a.m[i * N + j];
+      for (int k = 0; k < j; ++k) s -= L[i * N + k] * L[j * N + k];
+      L[i * N + j] = s * inv;
+    }
+  }
+  // columns of L^-1, then a^-1 = L^-T L^-1
+  double Li[N * N] = {};
+  for (int j = 0; j < N; ++j) {
+    Li[j * N + j] = 1.0 / L[j * N + j];
+    for (int i = j + 1; i < N; ++i) {
+      double s = 0.0;
+      for (int k = j; k < i; ++k) s -= L[i * N + k] * Li[k * N + j];
+      Li[i * N + j] = s / L[i * N + i];
+    }
+  }
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j <= i; ++j) {
+      double s = 0.0;
+      for (int k = i; k < N; ++k) s += Li[k * N + i] * Li[k * N + j];
+      out.m[i * N + j] = out.m[j * N + i] = s;
+    }
+  return true;
+}
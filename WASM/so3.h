@@ -0,0 +1,166 @@
+#pragma once
+#include <math.h>
+
+// Fixed-size 3D vectors, 3x3 matrices and the SO(3) maps the IMU code needs:
+// header-only, no heap, libm only, so it builds for wasm32 as well as
+// natively. Double precision like IMUData.
+//
+// Rotations act on column vectors; Mat3 is row-major. Exp/Log follow the
+// usual convention R = Exp(w), w the rotation vector (axis * angle), and the
+// right Jacobian Jr satisfies Exp(w + d) ~= Exp(w) Exp(Jr(w) d).
+
+struct Vec3 {
+  double x, y, z;
+};
+
+inline Vec3 operator+(const Vec3 &a, const Vec3 &b) { return Vec3{a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline Vec3 operator-(const Vec3 &a, const Vec3 &b) { return Vec3{a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Vec3 operator-(const Vec3 &a) { return Vec3{-a.x, -a.y, -a.z}; }
+inline Vec3 operator*(const Vec3 &a, double s) { return Vec3{a.x * s, a.y * s, a.z * s}; }
+inline Vec3 operator*(double s, const Vec3 &a) { return a * s; }
+inline Vec3 &operator+=(Vec3 &a, const Vec3 &b) { return a = a + b; }
+inline Vec3 &operator-=(Vec3 &a, const Vec3 &b) { return a = a - b; }
+
+inline double dot(const Vec3 &a, const Vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(const Vec3 &a, const Vec3 &b) {
+  return Vec3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+inline double norm(const Vec3 &a) { return sqrt(dot(a, a)); }
+
+struct Mat3 {
+  double m[9]; // row-major
+
+  double &operator()(int r, int c) { return m[3 * r + c]; }
+  double operator()(int r, int c) const { return m[3 * r + c]; }
+
+  static Mat3 identity() { return Mat3{{1, 0, 0, 0, 1, 0, 0, 0, 1}}; }
+  static Mat3 zero() { return Mat3{{0, 0, 0, 0, 0, 0, 0, 0, 0}}; }
+  static Mat3 diagonal(double d) { return Mat3{{d, 0, 0, 0, d, 0, 0, 0, d}}; }
+};
+
+inline Mat3 operator+(const Mat3 &a, const Mat3 &b) {
+  Mat3 r;
+  for (int i = 0; i < 9; ++i) r.m[i] = a.m[i] + b.m[i];
+  return r;
+}
+inline Mat3 operator-(const Mat3 &a, const Mat3 &b) {
+  Mat3 r;
+  for (int i = 0; i < 9; ++i) r.m[i] = a.m[i] - b.m[i];
+  return r;
+}
+inline Mat3 operator*(const Mat3 &a, double s) {
+  Mat3 r;
+  for (int i = 0; i < 9; ++i) r.m[i] = a.m[i] * s;
+  return r;
+}
+inline Mat3 operator*(double s, const Mat3 &a) { return a * s; }
+inline Mat3 &operator+=(Mat3 &a, const Mat3 &b) { return a = a + b; }
+inline Mat3 &operator-=(Mat3 &a, const Mat3 &b) { return a = a - b; }
+
+inline Mat3 operator*(const Mat3 &a, const Mat3 &b) {
+  Mat3 r;
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j) r.m[3 * i + j] = a.m[3 * i] * b.m[j] + a.m[3 * i + 1] * b.m[3 + j] + a.m[3 * i + 2] * b.m[6 + j];
+  return r;
+}
+
+inline Vec3 operator*(const Mat3 &a, const Vec3 &v) {
+  return Vec3{a.m[0] * v.x + a.m[1] * v.y + a.m[2] * v.z, a.m[3] * v.x + a.m[4] * v.y + a.m[5] * v.z,
+              a.m[6] * v.x + a.m[7] * v.y + a.m[8] * v.z};
+}
+
+inline Mat3 transpose(const Mat3 &a) { return Mat3{{a.m[0], a.m[3], a.m[6], a.m[1], a.m[4], a.m[7], a.m[2], a.m[5], a.m[8]}}; }
+
+// a^T b without forming the transpose
+inline Vec3 transpose_mul(const Mat3 &a, const Vec3 &v) {
+  return Vec3{a.m[0] * v.x + a.m[3] * v.y + a.m[6] * v.z, a.m[1] * v.x + a.m[4] * v.y + a.m[7] * v.z,
+              a.m[2] * v.x + a.m[5] * v.y + a.m[8] * v.z};
+}
+
+// [v]x, the matrix with skew(v) * u == cross(v, u)
+inline Mat3 skew(const Vec3 &v) { return Mat3{{0, -v.z, v.y, v.z, 0, -v.x, -v.y, v.x, 0}}; }
+
+// Below this angle the closed forms lose precision and their Taylor series
+// are used instead; the series' next terms are below double epsilon there.
+static const double kSO3SmallAngle = 1e-4;
+
+// Rodrigues: I + sin(t)/t [w]x + (1 - cos(t))/t^2 [w]x^2, t = |w|
+inline Mat3 so3_exp(const Vec3 &w) {
+  const double t2 = dot(w, w), t = sqrt(t2);
+  double a, b;
+  if (t < kSO3SmallAngle) {
+    a = 1.0 - t2 / 6.0;
+    b = 0.5 - t2 / 24.0;
+  } else {
+    a = sin(t) / t;
+    b = (1.0 - cos(t)) / t2;
+  }
+  const Mat3 k = skew(w);
+  return Mat3::identity() + a * k + b * (k * k);
+}
+
+// rotation vector of R, angle in [0, pi]
+inline Vec3 so3_log(const Mat3 &R) {
+  const double c = 0.5 * (R.m[0] + R.m[4] + R.m[8] - 1.0);
+  // (R - R^T) / 2 = sin(t) [axis]x
+  const Vec3 s = Vec3{0.5 * (R.m[7] - R.m[5]), 0.5 * (R.m[2] - R.m[6]), 0.5 * (R.m[3] - R.m[1])};
+  if (c > 1.0 - 1e-9) return s * (1.0 + dot(s, s) / 6.0); // t ~= sin(t)
+  if (c > -0.99) {
+    const double t = acos(c);
+    return s * (t / sin(t));
+  }
+  // near pi sin(t) vanishes: take the axis from the symmetric part,
+  // R + R^T = 2 cos(t) I + 2 (1 - cos(t)) axis axis^T, and its sign from s
+  const double t = acos(c < -1.0 ? -1.0 : c), k = 1.0 / (1.0 - c);
+  const double d[3] = {R.m[0] - c, R.m[4] - c, R.m[8] - c};
+  Vec3 axis;
+  if (d[0] >= d[1] && d[0] >= d[2]) {
+    axis.x = sqrt(d[0] * k);
+    axis.y = 0.5 * (R.m[1] + R.m[3]) * k / axis.x;
+    axis.z = 0.5 * (R.m[2] + R.m[6]) * k / axis.x;
+  } else if (d[1] >= d[2]) {
+    axis.y = sqrt(d[1] * k);
+    axis.x = 0.5 * (R.m[1] + R.m[3]) * k / axis.y;
+    axis.z = 0.5 * (R.m[5] + R.m[7]) * k / axis.y;
+  } else {
+    axis.z = sqrt(d[2] * k);
+    axis.x = 0.5 * (R.m[2] + R.m[6]) * k / axis.z;
+    axis.y = 0.5 * (R.m[5] + R.m[7]) * k / axis.z;
+  }
+  if (dot(axis, s) < 0.0) axis = -axis;
+  return axis * (t / norm(axis));
+}
+
+// right Jacobian: I - (1 - cos(t))/t^2 [w]x + (t - sin(t))/t^3 [w]x^2
+inline Mat3 so3_right_jacobian(const Vec3 &w) {
+  const double t2 = dot(w, w), t = sqrt(t2);
+  double a, b;
+  if (t < kSO3SmallAngle) {
+    a = 0.5 - t2 / 24.0;
+    b = 1.0 / 6.0 - t2 / 120.0;
+  } else {
+    a = (1.0 - cos(t)) / t2;
+    b = (t - sin(t)) / (t2 * t);
+  }
+  const Mat3 k = skew(w);
+  return Mat3::identity() - a * k + b * (k * k);
+}
+
+// its inverse: I + [w]x / 2 + (1/t^2 - (1 + cos(t)) / (2 t sin(t))) [w]x^2
+inline Mat3 so3_right_jacobian_inverse(const Vec3 &w) {
+  const double t2 = dot(w, w), t = sqrt(t2);
+  const double b = t < kSO3SmallAngle ? 1.0 / 12.0 + t2 / 720.0 : 1.0 / t2 - (1.0 + cos(t)) / (2.0 * t * sin(t));
+  const Mat3 k = skew(w);
+  return Mat3::identity() + 0.5 * k + b * (k * k);
+}
+
+// nearest rotation to a matrix that drifted from orthonormal through many
+// products: Gram-Schmidt on the rows
+inline Mat3 so3_normalize(const Mat3 &R) {
+  Vec3 x{R.m[0], R.m[1], R.m[2]}, y{R.m[3], R.m[4], R.m[5]};
+  x = x * (1.0 / norm(x));
+  y = y - x * dot(x, y);
+  y = y * (1.0 / norm(y));
+  const Vec3 z = cross(x, y);
+  return Mat3{{x.x, x.y, x.z, y.x, y.y, y.z, z.x, z.y, z.z}};
+}
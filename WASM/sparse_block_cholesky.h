@@ -0,0 +1,265 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "small_matrix.h"
+
+// Sparse Cholesky factorization of a symmetric positive definite matrix made
+// of D x D blocks: the normal equations of a pose graph, one block row per
+// pose (D = 3 for SE(2), 6 for SE(3)).
+//
+// analyze() orders the block columns by minimum degree and reads the
+// factor's sparsity off the same elimination (the neighbours a column has
+// when it is eliminated are exactly its nonzeros in L). That is done once
+// per graph structure; the matrix is then assembled into fixed slots with
+// add(), and factor() and solve() run over flat arrays without allocating.
+template <int D>
+class SparseBlockCholesky {
+public:
+  using Block = Matrix<D, D>;
+
+  // n block rows and the off-diagonal nonzeros (i, j), i != j, in any order
+  // and orientation; duplicates are fine
+  void analyze(int n, const std::vector<std::pair<int, int>> &nonzeros);
+
+  int size() const { return n_; }
+  // nonzero blocks below the diagonal of L, fill-in included
+  int factor_blocks() const { return static_cast<int>(rows_.size()); }
+
+  // zeroes the matrix, keeping the structure
+  void clear();
+  // adds b to block (i, j) of the matrix, and b^T to (j, i); (i, j) must be
+  // on the diagonal or among the analyzed nonzeros
+  void add(int i, int j, const Block &b);
+  const Block &diagonal(int i) const { return a_diag_[perm_[i]]; }
+
+  // factors the matrix with its diagonal scaled by 1 + damping (Marquardt's
+  // damping); false if that is not positive definite
+  bool factor(double damping = 0.0);
+  // x = A^-1 b for the last factorization, n * D entries each; x may alias b
+  void solve(const double *b, double *x) const;
+
+private:
+  static bool cholesky(Block &a);
+  static void sub_mul_transpose(Block &c, const Block &a, const Block &b);
+  int find(int col, int row) const;
+
+  int n_ = 0;
+  std::vector<int> perm_, iperm_; // matrix index -> elimination position and back
+  // column p of L below the diagonal: rows_[start_[p] .. start_[p + 1]),
+  // ascending positions, with blocks in the same slots
+  std::vector<int> start_, rows_;
+  std::vector<Block> a_diag_, a_off_; // the matrix, same layout as L
+  std::vector<Block> l_diag_, l_off_;
+  mutable std::vector<double> work_;
+};
+
+template <int D>
+void SparseBlockCholesky<D>::analyze(int n, const std::vector<std::pair<int, int>> &nonzeros) {
+  n_ = n;
+  std::vector<std::vector<int>> adj(n);
+  for (const auto &e : nonzeros) {
+    if (e.first == e.second) continue;
+    adj[e.first].push_back(e.second);
+    adj[e.second].push_back(e.first);
+  }
+  for (auto &a : adj) {
+    std::sort(a.begin(), a.end());
+    a.erase(std::unique(a.begin(), a.end()), a.end());
+  }
+
+  // Minimum degree on the elimination graph: eliminating v joins its
+  // remaining neighbours into a clique. A heap with stale entries skipped
+  // stands in for degree lists; graphs here are sparse enough for exact
+  // degrees.
+  using Entry = std::pair<int, int>; // degree, vertex
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+  for (int v = 0; v < n; ++v) heap.push(Entry(static_cast<int>(adj[v].size()), v));
+  std::vector<std::vector<int>> cols(n);
+  std::vector<char> done(n, 0);
+  perm_.assign(n, 0);
+  iperm_.assign(n, 0);
+  std::vector<int> merged;
+  int next = 0;
+  while (!heap.empty()) {
+    const Entry top = heap.top();
+    heap.pop();
+    const int v = top.second;
+    if (done[v] || top.first != static_cast<int>(adj[v].size())) continue;
+    done[v] = 1;
+    perm_[v] = next;
+    iperm_[next++] = v;
+    std::vector<int> &nb = adj[v];
+    for (int u : nb) {
+      // adj[u] minus v, plus v's other neighbours
+      merged.clear();
+      std::vector<int> &au = adj[u];
+      size_t a = 0, b = 0;
+      while (a < au.size() || b < nb.size()) {
+        int x;
+        if (b == nb.size() || (a < au.size() && au[a] < nb[b])) x = au[a++];
+        else if (a == au.size() || nb[b] < au[a]) x = nb[b++];
+        else x = au[a++], ++b;
+        if (x != v && x != u) merged.push_back(x);
+      }
+      au.swap(merged);
+      heap.push(Entry(static_cast<int>(au.size()), u));
+    }
+    cols[v].swap(nb);
+  }
+
+  start_.assign(n + 1, 0);
+  rows_.clear();
+  for (int p = 0; p < n; ++p) {
+    const size_t first = rows_.size();
+    for (int u : cols[iperm_[p]]) rows_.push_back(perm_[u]);
+    std::sort(rows_.begin() + first, rows_.end());
+    start_[p + 1] = static_cast<int>(rows_.size());
+  }
+  a_diag_.assign(n, Block::zero());
+  a_off_.assign(rows_.size(), Block::zero());
+  l_diag_.assign(n, Block::zero());
+  l_off_.assign(rows_.size(), Block::zero());
+  work_.assign(static_cast<size_t>(n) * D, 0.0);
+}
+
+template <int D>
+void SparseBlockCholesky<D>::clear() {
+  for (Block &b : a_diag_) b = Block::zero();
+  for (Block &b : a_off_) b = Block::zero();
+}
+
+template <int D>
+int SparseBlockCholesky<D>::find(int col, int row) const {
+  const int *first = rows_.data() + start_[col], *last = rows_.data() + start_[col + 1];
+  const int *it = std::lower_bound(first, last, row);
+  return it != last && *it == row ? static_cast<int>(it - rows_.data()) : -1;
+}
+
+template <int D>
+void SparseBlockCholesky<D>::add(int i, int j, const Block &b) {
+  const int pi = perm_[i], pj = perm_[j];
+  if (pi == pj) {
+    a_diag_[pi] = a_diag_[pi] + b;
+  } else if (pi > pj) {
+    const int s = find(pj, pi);
+    if (s >= 0) a_off_[s] = a_off_[s] + b;
+  } else {
+    const int s = find(pi, pj);
+    if (s >= 0) a_off_[s] = a_off_[s] + transpose(b);
+  }
+}
+
+// in-place lower Cholesky factor of a D x D block, upper triangle zeroed
+template <int D>
+bool SparseBlockCholesky<D>::cholesky(Block &a) {
+  for (int j = 0; j < D; ++j) {
+    double d = a(j, j);
+    for (int k = 0; k < j; ++k) d -= a(j, k) * a(j, k);
+    if (!(d > 0.0)) return false;
+    a(j, j) = sqrt(d);
+    const double inv = 1.0 / a(j, j);
+    for (int i = j + 1; i < D; ++i) {
+      double s = a(i, j);
+      for (int k = 0; k < j; ++k) s -= a(i, k) * a(j, k);
+      a(i, j) = s * inv;
+      a(j, i) = 0.0;
+    }
+  }
+  return true;
+}
+
+// c -= a b^T in place, the update every factor step is made of
+template <int D>
+void SparseBlockCholesky<D>::sub_mul_transpose(Block &c, const Block &a, const Block &b) {
+  for (int i = 0; i < D; ++i)
+    for (int j = 0; j < D; ++j) {
+      double s = 0.0;
+      for (int k = 0; k < D; ++k) s += a.m[i * D + k] * b.m[j * D + k];
+      c.m[i * D + j] -= s;
+    }
+}
+
+// Right-looking: each column, once factored, updates the blocks of later
+// columns in its row set. Those rows are a clique of the elimination, so
+// column ra holds every row rb > ra of column p and one forward walk finds
+// their slots.
+template <int D>
+bool SparseBlockCholesky<D>::factor(double damping) {
+  for (int p = 0; p < n_; ++p) {
+    l_diag_[p] = a_diag_[p];
+    for (int k = 0; k < D; ++k) l_diag_[p](k, k) *= 1.0 + damping;
+  }
+  std::copy(a_off_.begin(), a_off_.end(), l_off_.begin());
+  for (int p = 0; p < n_; ++p) {
+    Block &Lpp = l_diag_[p];
+    if (!cholesky(Lpp)) return false;
+    const int s0 = start_[p], s1 = start_[p + 1];
+    // L_rp = A_rp Lpp^-T: solve X Lpp^T = A_rp row by row
+    for (int s = s0; s < s1; ++s) {
+      Block &B = l_off_[s];
+      for (int r = 0; r < D; ++r)
+        for (int c = 0; c < D; ++c) {
+          double v = B(r, c);
+          for (int k = 0; k < c; ++k) v -= B(r, k) * Lpp(c, k);
+          B(r, c) = v / Lpp(c, c);
+        }
+    }
+    for (int sa = s0; sa < s1; ++sa) {
+      const int ra = rows_[sa];
+      const Block &La = l_off_[sa];
+      sub_mul_transpose(l_diag_[ra], La, La);
+      int t = start_[ra];
+      for (int sb = sa + 1; sb < s1; ++sb) {
+        const int rb = rows_[sb];
+        while (rows_[t] != rb) ++t;
+        sub_mul_transpose(l_off_[t], l_off_[sb], La);
+      }
+    }
+  }
+  return true;
+}
+
+template <int D>
+void SparseBlockCholesky<D>::solve(const double *b, double *x) const {
+  double *y = work_.data();
+  for (int i = 0; i < n_; ++i)
+    for (int k = 0; k < D; ++k) y[perm_[i] * D + k] = b[i * D + k];
+  // L z = y, column by column
+  for (int p = 0; p < n_; ++p) {
+    const Block &Lpp = l_diag_[p];
+    double *yp = y + p * D;
+    for (int r = 0; r < D; ++r) {
+      double v = yp[r];
+      for (int k = 0; k < r; ++k) v -= Lpp(r, k) * yp[k];
+      yp[r] = v / Lpp(r, r);
+    }
+    for (int s = start_[p]; s < start_[p + 1]; ++s) {
+      const Block &L = l_off_[s];
+      double *yr = y + rows_[s] * D;
+      for (int r = 0; r < D; ++r)
+        for (int k = 0; k < D; ++k) yr[r] -= L(r, k) * yp[k];
+    }
+  }
+  // L^T x = z, backwards
+  for (int p = n_ - 1; p >= 0; --p) {
+    double *yp = y + p * D;
+    for (int s = start_[p]; s < start_[p + 1]; ++s) {
+      const Block &L = l_off_[s];
+      const double *yr = y + rows_[s] * D;
+      for (int k = 0; k < D; ++k)
+        for (int r = 0; r < D; ++r) yp[k] -= L(r, k) * yr[r];
+    }
+    const Block &Lpp = l_diag_[p];
+    for (int r = D - 1; r >= 0; --r) {
+      double v = yp[r];
+      for (int k = r + 1; k < D; ++k) v -= Lpp(k, r) * yp[k];
+      yp[r] = v / Lpp(r, r);
+    }
+  }
+  for (int i = 0; i < n_; ++i)
+    for (int k = 0; k < D; ++k) x[i * D + k] = y[perm_[i] * D + k];
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <type_traits>
+
+// lock-free single-producer / single-consumer ring.
+// Capacity must be a power of two; push() fails (and counts a drop) when full
+// so the producer never waits on the consumer.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing payload must be trivially copyable");
+
+public:
+    // producer only
+    bool push(const T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_cache_ == Capacity) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head - tail_cache_ == Capacity) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        buf_[head & (Capacity - 1)] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only: copies up to max pending items in FIFO order
+    size_t pop_batch(T* out, size_t max) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t avail = head_cache_ - tail;
+        if (avail < max) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            avail = head_cache_ - tail;
+        }
+        const size_t n = avail < max ? avail : max;
+        for (size_t i = 0; i < n; ++i) out[i] = buf_[(tail + i) & (Capacity - 1)];
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    bool pop(T& out) { return pop_batch(&out, 1) == 1; }
+
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    // items rejected because the consumer fell a full ring behind
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    // producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+    T buf_[Capacity];
+};
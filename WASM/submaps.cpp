@@ -0,0 +1,386 @@
+#include "submaps.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+// fewer obstacle cells than this in a finished submap (a few scans of open
+// space) match anywhere
+static const int kMinObstacles = 50;
+
+// added to a submap match's covariance: the scan matcher's own is from the
+// points alone and far too sure of itself with hundreds of them, while both
+// submaps carry a few meters of the front-end's drift
+static const float kMatchFloorXY = 0.05f, kMatchFloorTheta = 0.02f;
+
+int16_t FrozenSubmap::log_odds(int32_t cx, int32_t cy) const {
+  const int32_t x = cx - min_cx, y = cy - min_cy;
+  if (x < 0 || y < 0 || x >= width || y >= height) return 0;
+  const int32_t q = cells[static_cast<size_t>(y) * width + x];
+  if (q == 0) return 0;
+  const int32_t span = max_log_odds - min_log_odds;
+  return static_cast<int16_t>(min_log_odds + ((q - 1) * span + 127) / 254);
+}
+
+void freeze_submap(OccupancyGrid &grid, const OccupancyParams &params, FrozenSubmap &out) {
+  out.resolution = grid.resolution;
+  out.min_log_odds = params.minLogOdds;
+  out.max_log_odds = params.maxLogOdds;
+  out.min_cx = out.min_cy = 0;
+  out.width = out.height = 0;
+  out.cells.clear();
+  if (!grid.touched) return;
+  out.min_cx = grid.minCX;
+  out.min_cy = grid.minCY;
+  out.width = grid.maxCX - grid.minCX + 1;
+  out.height = grid.maxCY - grid.minCY + 1;
+  out.cells.assign(static_cast<size_t>(out.width) * out.height, 0);
+  const int32_t lo = params.minLogOdds, span = std::max(params.maxLogOdds - lo, 1);
+  // tile by tile, like ScanMatcher::set_map; every cell ever updated lies in
+  // the touched box
+  for (int32_t i = 0; i < TILE_INDEX_SLOTS; ++i) {
+    const TileSlot &s = grid.tiles.slots[i];
+    if (!s.cells) continue;
+    const int32_t x0 = std::max(s.tx * TILE_SIZE, grid.minCX), x1 = std::min(s.tx * TILE_SIZE + TILE_MASK, grid.maxCX);
+    const int32_t y0 = std::max(s.ty * TILE_SIZE, grid.minCY), y1 = std::min(s.ty * TILE_SIZE + TILE_MASK, grid.maxCY);
+    for (int32_t y = y0; y <= y1; ++y) {
+      const int16_t *row = s.cells + ((y & TILE_MASK) << TILE_SHIFT);
+      uint8_t *o = out.cells.data() + static_cast<size_t>(y - out.min_cy) * out.width - out.min_cx;
+      for (int32_t x = x0; x <= x1; ++x) {
+        const int32_t v = row[x & TILE_MASK];
+        if (v == 0) continue;
+        const int32_t q = 1 + ((v - lo) * 254 + span / 2) / span;
+        o[x] = static_cast<uint8_t>(std::min(std::max(q, 1), 255));
+      }
+    }
+  }
+}
+
+void Submaps::GridDeleter::operator()(OccupancyGrid *g) const {
+  occ_release(g);
+  delete g;
+}
+
+Submaps::Submaps(const SubmapParams &params)
+    : params_(params), matcher_(params.match), graph_(params.graph), global_matcher_(params.global_match),
+      target_(new OccupancyGrid) {
+  params_.scans_per_submap = std::max(params_.scans_per_submap, 2);
+  params_.max_matches = std::max(params_.max_matches, 0);
+  occ_init(target_.get(), params_.resolution);
+  thread_ = std::thread(&Submaps::run, this);
+}
+
+Submaps::~Submaps() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+Submaps::GridPtr Submaps::take_grid() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    if (!pool_.empty()) {
+      GridPtr g = std::move(pool_.back());
+      pool_.pop_back();
+      return g;
+    }
+  }
+  GridPtr g(new OccupancyGrid);
+  occ_init(g.get(), params_.resolution);
+  ++grids_;
+  return g;
+}
+
+int Submaps::active_tiles() const {
+  int n = 0;
+  for (const Active &a : active_) n += a.grid->tiles.count;
+  return n;
+}
+
+ScanMatchResult Submaps::match(const Scan2D &scan, const Pose2 &prior) {
+  if (active_.empty()) {
+    ScanMatchResult r{};
+    r.pose = prior;
+    return r;
+  }
+  Active &a = active_.front();
+  const Pose2 local = between(a.origin, prior);
+  if (a.id != matched_id_) {
+    matcher_.reset_map(*a.grid, local.x, local.y, params_.match_half_extent);
+    matched_id_ = a.id;
+  } else {
+    matcher_.set_map(*a.grid, local.x, local.y, params_.match_half_extent);
+  }
+  ScanMatchResult r = matcher_.match(scan, local);
+  r.pose = compose(a.origin, r.pose);
+  // covariance from the submap's frame to the front-end's: R C R^T with R
+  // the origin's rotation about z
+  const float c = cosf(a.origin.theta), s = sinf(a.origin.theta);
+  const float R[9] = {c, -s, 0.0f, s, c, 0.0f, 0.0f, 0.0f, 1.0f};
+  float rc[9], out[9];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j) {
+      float v = 0.0f;
+      for (int k = 0; k < 3; ++k) v += R[3 * i + k] * r.covariance[3 * k + j];
+      rc[3 * i + j] = v;
+    }
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j) {
+      float v = 0.0f;
+      for (int k = 0; k < 3; ++k) v += rc[3 * i + k] * R[3 * j + k];
+      out[3 * i + j] = v;
+    }
+  std::copy(out, out + 9, r.covariance);
+  return r;
+}
+
+int Submaps::insert(const Pose2 &pose, const Scan2D &scan) {
+  if (active_.empty() || active_.back().scans == params_.scans_per_submap / 2)
+    active_.push_back(Active{next_id_++, pose, 0, take_grid()});
+
+  xy_.resize(2 * static_cast<size_t>(scan.size));
+  // occ_integrate's ray table: twice the points, a power of two
+  size_t keys = 16;
+  while (keys < 2 * static_cast<size_t>(scan.size)) keys *= 2;
+  if (keys_.size() < keys) keys_.resize(keys);
+  for (Active &a : active_) {
+    const Pose2 p = between(a.origin, pose);
+    const float c = cosf(p.theta), s = sinf(p.theta);
+    for (int i = 0; i < scan.size; ++i) {
+      xy_[2 * i] = p.x + c * scan.x[i] - s * scan.y[i];
+      xy_[2 * i + 1] = p.y + s * scan.x[i] + c * scan.y[i];
+    }
+    occ_integrate(a.grid.get(), &params_.occupancy, p.x, p.y, xy_.data(), scan.size, keys_.data(),
+                  static_cast<int32_t>(keys_.size()));
+    ++a.scans;
+  }
+
+  if (active_.front().scans < params_.scans_per_submap) return -1;
+  const int id = active_.front().id;
+  finish_oldest();
+  return id;
+}
+
+void Submaps::flush() {
+  while (!active_.empty()) finish_oldest();
+}
+
+void Submaps::finish_oldest() {
+  if (active_.front().id == matched_id_) matched_id_ = -1;
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    queue_.push_back(std::move(active_.front()));
+  }
+  active_.erase(active_.begin());
+  wake_.notify_one();
+}
+
+uint64_t Submaps::placements(std::vector<Pose2> &out) const {
+  std::lock_guard<std::mutex> lk(m_);
+  out = published_;
+  return version_.load(std::memory_order_relaxed);
+}
+
+Pose2 Submaps::global_pose(const Pose2 &frontend) const {
+  std::lock_guard<std::mutex> lk(m_);
+  if (published_.empty()) return frontend;
+  const size_t k = published_.size() - 1;
+  return compose(published_[k], between(frozen_[k]->origin, frontend));
+}
+
+std::shared_ptr<const FrozenSubmap> Submaps::frozen(int id) const {
+  std::lock_guard<std::mutex> lk(m_);
+  if (id < 0 || id >= static_cast<int>(frozen_.size())) return nullptr;
+  return frozen_[id];
+}
+
+SubmapStats Submaps::stats() const {
+  std::lock_guard<std::mutex> lk(m_);
+  return stats_;
+}
+
+void Submaps::wait_idle() {
+  std::unique_lock<std::mutex> lk(m_);
+  idle_.wait(lk, [this] { return (queue_.empty() && !busy_) || stop_; });
+}
+
+void Submaps::run() {
+  using clock = std::chrono::steady_clock;
+  for (;;) {
+    Active job;
+    {
+      std::unique_lock<std::mutex> lk(m_);
+      wake_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) break;
+      job = std::move(queue_.front());
+      queue_.erase(queue_.begin());
+      busy_ = true;
+    }
+
+    const auto t0 = clock::now();
+    std::shared_ptr<FrozenSubmap> s = std::make_shared<FrozenSubmap>();
+    s->id = job.id;
+    s->origin = job.origin;
+    s->scans = job.scans;
+    freeze_submap(*job.grid, params_.occupancy, *s);
+    occ_clear(job.grid.get());
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      pool_.push_back(std::move(job.grid));
+      frozen_.push_back(s);
+    }
+    const auto t1 = clock::now();
+    place(*s);
+    const auto t2 = clock::now();
+
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      const double n = ++stats_.frozen;
+      stats_.freeze_us += (std::chrono::duration<double, std::micro>(t1 - t0).count() - stats_.freeze_us) / n;
+      stats_.place_us += (std::chrono::duration<double, std::micro>(t2 - t1).count() - stats_.place_us) / n;
+      busy_ = false;
+    }
+    idle_.notify_all();
+  }
+  idle_.notify_all();
+}
+
+// information of a 3 x 3 covariance; false if it is singular
+static bool invert3(const float *c, float *out) {
+  const double a = c[0], b = c[1], d = c[2], e = c[3], f = c[4], g = c[5], h = c[6], k = c[7], l = c[8];
+  const double A = f * l - g * k, B = g * h - e * l, C = e * k - f * h;
+  const double det = a * A + b * B + d * C;
+  if (!(fabs(det) > 1e-30)) return false;
+  const double inv = 1.0 / det;
+  out[0] = static_cast<float>(A * inv);
+  out[1] = static_cast<float>((d * k - b * l) * inv);
+  out[2] = static_cast<float>((b * g - d * f) * inv);
+  out[3] = static_cast<float>(B * inv);
+  out[4] = static_cast<float>((a * l - d * h) * inv);
+  out[5] = static_cast<float>((d * e - a * g) * inv);
+  out[6] = static_cast<float>(C * inv);
+  out[7] = static_cast<float>((b * h - a * k) * inv);
+  out[8] = static_cast<float>((a * f - b * e) * inv);
+  return true;
+}
+
+// The new submap becomes a node placed by the front-end's motion from the
+// one before, then older submaps near where that puts it are matched.
+// Submaps arrive in id order, so node ids are submap ids.
+void Submaps::place(const FrozenSubmap &s) {
+  const int n = graph_.node_count();
+  Pose2 initial = s.origin;
+  if (n > 0) {
+    const Pose2 d = between(frozen_[n - 1]->origin, s.origin);
+    initial = compose(graph_.pose(n - 1), d);
+    graph_.add_node(initial);
+    PoseGraphEdge e;
+    e.from = n - 1;
+    e.to = n;
+    e.measurement = d;
+    e.information[0] = e.information[4] = 1.0f / (params_.chain_sigma_xy * params_.chain_sigma_xy);
+    e.information[8] = 1.0f / (params_.chain_sigma_theta * params_.chain_sigma_theta);
+    graph_.add_edge(e);
+  } else {
+    graph_.add_node(initial);
+  }
+
+  // the new submap's obstacle cells in its frame, evenly thinned
+  const int16_t threshold = occ_to_fixed(params_.global_match.field.min_log_odds);
+  int obstacles = 0;
+  for (int32_t y = 0; y < s.height; ++y)
+    for (int32_t x = 0; x < s.width; ++x) obstacles += s.log_odds(s.min_cx + x, s.min_cy + y) >= threshold;
+  const int keep = std::min(obstacles, params_.match_points);
+  obstacles_.reserve(keep);
+  obstacles_.size = 0;
+  float radius = 0.0f;
+  if (keep >= kMinObstacles) {
+    int seen = 0;
+    for (int32_t y = 0; y < s.height; ++y)
+      for (int32_t x = 0; x < s.width; ++x) {
+        if (s.log_odds(s.min_cx + x, s.min_cy + y) < threshold) continue;
+        // keep of the obstacles cells, spread evenly
+        const int64_t k = seen++;
+        if ((k + 1) * keep / obstacles == k * keep / obstacles) continue;
+        const float px = (s.min_cx + x + 0.5f) * s.resolution, py = (s.min_cy + y + 0.5f) * s.resolution;
+        obstacles_.x[obstacles_.size] = px;
+        obstacles_.y[obstacles_.size] = py;
+        ++obstacles_.size;
+        radius = std::max(radius, sqrtf(px * px + py * py));
+      }
+  }
+
+  // candidates: older submaps whose placed origin is within match_radius
+  nearby_.clear();
+  if (obstacles_.size >= kMinObstacles) {
+    const float r2 = params_.match_radius * params_.match_radius;
+    for (int i = 0; i + params_.exclude_recent < n; ++i) {
+      const Pose2 g = graph_.pose(i);
+      const float dx = g.x - initial.x, dy = g.y - initial.y;
+      if (dx * dx + dy * dy < r2) nearby_.emplace_back(dx * dx + dy * dy, i);
+    }
+    const size_t m = std::min(nearby_.size(), static_cast<size_t>(params_.max_matches));
+    std::partial_sort(nearby_.begin(), nearby_.begin() + m, nearby_.end());
+    nearby_.resize(m);
+  }
+  int added = 0;
+  for (const auto &c : nearby_) {
+    PoseGraphEdge e;
+    if (!match_submaps(*frozen_[c.second], between(graph_.pose(c.second), initial), radius, e)) continue;
+    e.from = c.second;
+    e.to = n;
+    graph_.add_edge(e);
+    ++added;
+  }
+
+  // until the step moves no node past the relinearization threshold
+  for (int step = 0; step < graph_.params().max_iterations; ++step)
+    if (graph_.optimize_incremental().iterations == 0) break;
+
+  std::vector<Pose2> out(graph_.node_count());
+  for (int i = 0; i < graph_.node_count(); ++i) out[i] = graph_.pose(i);
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    published_.swap(out);
+    stats_.constraints += added;
+    version_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+// Matches obstacles_ (the new submap's, within radius of its origin) into
+// the older submap's grid from the placed guess prior, the new origin in the
+// older frame. Accepted like a loop closure: most points on obstacles, the
+// position pinned down in every direction.
+bool Submaps::match_submaps(const FrozenSubmap &older, const Pose2 &prior, float radius, PoseGraphEdge &edge) {
+  OccupancyGrid *g = target_.get();
+  occ_clear(g);
+  for (int32_t y = 0; y < older.height; ++y)
+    for (int32_t x = 0; x < older.width; ++x) {
+      const int32_t cx = older.min_cx + x, cy = older.min_cy + y;
+      const int16_t v = older.log_odds(cx, cy);
+      if (v == 0) continue;
+      int16_t *t = tile_get(&g->tiles, cx >> TILE_SHIFT, cy >> TILE_SHIFT, true);
+      if (t) t[((cy & TILE_MASK) << TILE_SHIFT) | (cx & TILE_MASK)] = v;
+    }
+  global_matcher_.reset_map(*g, prior.x, prior.y, radius + params_.global_match.linear_window);
+  const ScanMatchResult r = global_matcher_.match(obstacles_, prior);
+  if (!r.ok || r.inliers < params_.min_inliers * obstacles_.size) return false;
+  // larger eigenvalue of the position covariance
+  const float a = r.covariance[0], b = r.covariance[1], d = r.covariance[4];
+  const float worst = 0.5f * (a + d) + sqrtf(0.25f * (a - d) * (a - d) + b * b);
+  if (!(worst < params_.max_sigma * params_.max_sigma)) return false;
+
+  float cov[9];
+  std::copy(r.covariance, r.covariance + 9, cov);
+  cov[0] += kMatchFloorXY * kMatchFloorXY;
+  cov[4] += kMatchFloorXY * kMatchFloorXY;
+  cov[8] += kMatchFloorTheta * kMatchFloorTheta;
+  if (!invert3(cov, edge.information)) return false;
+  edge.measurement = r.pose;
+  edge.kernel = RobustKernel::kHuber;
+  edge.kernel_width = 1.0f;
+  return true;
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "occupancy_grid.h"
+#include "pose2.h"
+#include "pose_graph.h"
+#include "scan_matcher.h"
+
+// Mapping into local submaps, as in Cartographer, instead of one grid that
+// keeps growing.
+//
+// A submap is a small OccupancyGrid in its own frame, whose origin is the
+// front-end pose of its first scan. Two are active at a time and overlap: a
+// new one starts when the newer has taken half of scans_per_submap, and the
+// older is finished once it has all of them, so there is always a well
+// filled one to match against. A scan is matched against one window of the
+// older submap and ray cast into both, so its cost does not depend on how
+// much has been mapped.
+//
+// Finished grids go to a background thread. It freezes each one (cropped to
+// the cells that were updated, log-odds quantized to a byte; immutable from
+// then on and shared with readers) and returns the grid to the front-end's
+// pool for a later submap, so the front-end stops allocating once a few
+// grids are in circulation. It then places the submap globally: one
+// PoseGraph node per submap, chained by the front-end's motion between
+// their origins, plus an edge for every older submap within match_radius
+// that the new one's obstacles match against (a revisit the front-end's
+// drift has pulled apart). The optimized origins are published under a
+// version number, like PoseGraphWorker's poses.
+//
+// It needs threads, so it builds natively and under WASI (slam_main); the
+// -nostdlib map.wasm keeps its single grid.
+
+// ScanMatcher settings for the front-end: a scan at 10 Hz is a few
+// centimeters of odometry from the last, and a wall coming into range
+// at the far end of the view must not pull the pose along a corridor.
+inline ScanMatchParams frontend_match_params() {
+  ScanMatchParams p;
+  p.prior_sigma_xy = 0.02f;
+  return p;
+}
+
+// ScanMatcher settings for matching a finished submap's obstacles against
+// an older submap: a wide window, since the front-end may have drifted by
+// a lap's worth, and no prior to speak of.
+inline ScanMatchParams submap_match_params() {
+  ScanMatchParams p;
+  p.linear_window = 1.5f;
+  p.angular_window = 0.2f;
+  p.min_score = 0.5f;
+  p.prior_sigma_xy = 10.0f;
+  p.prior_sigma_theta = 1.0f;
+  return p;
+}
+
+struct SubmapParams {
+  float resolution = 0.05f;       // meters per cell
+  int scans_per_submap = 60;      // a new submap starts every half of this
+  OccupancyParams occupancy = {218, -102, -512, 896, 10.0f}; // map.cpp's defaults
+  float match_half_extent = 5.5f; // meters around the prior the front-end matches in; the scan range plus the window
+  ScanMatchParams match = frontend_match_params(); // scan against the older active submap
+  // global placement
+  float chain_sigma_xy = 0.05f;    // meters and radians, of the front-end's motion between consecutive origins
+  float chain_sigma_theta = 0.01f;
+  float match_radius = 6.0f;       // meters between origins for an older submap to be matched
+  int exclude_recent = 2;          // the newest submaps share scans with the finished one
+  int max_matches = 3;             // closest older submaps tried per finished one
+  int match_points = 400;          // of the finished submap's obstacle cells, evenly spread
+  float min_inliers = 0.6f;        // share of them near the older submap's obstacles after the match
+  float max_sigma = 0.1f;          // meters, position uncertainty of the match along its worst direction
+  ScanMatchParams global_match = submap_match_params();
+  PoseGraphParams graph;
+};
+
+// A finished submap, frozen.
+struct FrozenSubmap {
+  int id;
+  Pose2 origin; // front-end pose of its first scan; cells are in this frame
+  int scans;
+  float resolution;
+  int32_t min_cx, min_cy; // cell of cells[0]
+  int width, height;
+  // row-major from the lowest y: 0 unknown, else 1..255 spread linearly
+  // over [min_log_odds, max_log_odds]
+  std::vector<uint8_t> cells;
+  int16_t min_log_odds, max_log_odds;
+
+  // Q8.8 log-odds of cell (cx, cy) of the submap frame, 0 if unknown
+  int16_t log_odds(int32_t cx, int32_t cy) const;
+  size_t bytes() const { return sizeof(*this) + cells.size(); }
+};
+
+// crops grid to its updated cells and quantizes them; the clamps are the
+// ones the grid was integrated with
+void freeze_submap(OccupancyGrid &grid, const OccupancyParams &params, FrozenSubmap &out);
+
+struct SubmapStats {
+  int frozen = 0;
+  int constraints = 0;      // match edges between submaps in the graph
+  double freeze_us = 0.0;   // per submap, mean
+  double place_us = 0.0;    // per submap, mean: matching and optimization
+};
+
+class Submaps {
+public:
+  explicit Submaps(const SubmapParams &params = SubmapParams{});
+  ~Submaps();
+  Submaps(const Submaps &) = delete;
+  Submaps &operator=(const Submaps &) = delete;
+
+  const SubmapParams &params() const { return params_; }
+
+  // Front-end, one thread.
+  //
+  // scan-to-submap match of a robot-frame scan from a front-end prior; not
+  // ok, with the prior, before there is a submap to match against
+  ScanMatchResult match(const Scan2D &scan, const Pose2 &prior);
+  // integrates the scan at its front-end pose; returns the id of the submap
+  // it finished, -1 if none
+  int insert(const Pose2 &pose, const Scan2D &scan);
+  // finishes the active submaps, e.g. at the end of a run
+  void flush();
+  // submaps started so far; ids are consecutive from 0
+  int submap_count() const { return next_id_; }
+  // grids the front-end ever allocated
+  int grids_allocated() const { return grids_; }
+  // tiles in the active grids
+  int active_tiles() const;
+
+  // Any thread.
+  //
+  // copies the optimized origin of every placed submap, by id, and returns
+  // their version, 0 before the first
+  uint64_t placements(std::vector<Pose2> &out) const;
+  uint64_t version() const { return version_.load(std::memory_order_acquire); }
+  // a front-end pose in the optimized frame, through the newest placed submap
+  Pose2 global_pose(const Pose2 &frontend) const;
+  // nullptr until submap id has been frozen
+  std::shared_ptr<const FrozenSubmap> frozen(int id) const;
+  SubmapStats stats() const;
+  // blocks until every finished submap is frozen and placed; for tests and
+  // shutdown, not the front-end
+  void wait_idle();
+
+private:
+  struct GridDeleter {
+    void operator()(OccupancyGrid *g) const;
+  };
+  using GridPtr = std::unique_ptr<OccupancyGrid, GridDeleter>;
+  struct Active {
+    int id;
+    Pose2 origin;
+    int scans;
+    GridPtr grid;
+  };
+
+  GridPtr take_grid();
+  void finish_oldest();
+  void run();
+  void place(const FrozenSubmap &s);
+  bool match_submaps(const FrozenSubmap &older, const Pose2 &prior, float radius, PoseGraphEdge &edge);
+
+  SubmapParams params_;
+
+  // front-end
+  std::vector<Active> active_; // oldest first, at most two
+  int next_id_ = 0, grids_ = 0;
+  ScanMatcher matcher_;
+  int matched_id_ = -1; // the submap matcher_'s field follows
+  std::vector<float> xy_;
+  std::vector<uint32_t> keys_;
+
+  // the thread's alone
+  PoseGraph graph_;
+  ScanMatcher global_matcher_;
+  GridPtr target_; // an older submap thawed for matching
+  Scan2D obstacles_;
+  std::vector<std::pair<float, int>> nearby_;
+
+  mutable std::mutex m_;
+  std::condition_variable wake_, idle_;
+  std::vector<Active> queue_;
+  std::vector<GridPtr> pool_;
+  std::vector<std::shared_ptr<const FrozenSubmap>> frozen_;
+  std::vector<Pose2> published_;
+  SubmapStats stats_;
+  bool busy_ = false, stop_ = false;
+  std::atomic<uint64_t> version_{0};
+  std::thread thread_;
+};
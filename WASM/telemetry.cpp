@@ -1,34 +1,106 @@
 #include "telemetry.h"
-#include "lidar_camera.h"
-#include <mutex>
+#include <string.h>
 
-// log sensors without significant delays in processing
-void log_sensors(std::mutex& m_imu, const IMUData& imu_data, std::mutex& m_lc, const LidarCameraData& lc_data){
-  std::cout << std::fixed << std::setprecision(5);
-  while (true) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(log_interval_ms));
-
-    IMUData imu_copy;
-    {
-      std::lock_guard<std::mutex> lk(m_imu);
-      imu_copy = imu_data;
-    }
+namespace {
+
+// one line per TelemetryType, in enum order
+const char telemetry_schema[] =
+  "imu:acc_timestamp,acc_x,acc_y,acc_z,gyro_timestamp,gyro_x,gyro_y,gyro_z\n"
+  "frame:timestamp,generation,depth_width,depth_height,image_width,image_height,image_channels,imu_timestamp\n";
+
+constexpr size_t drain_batch = 64; // keeps the drainer's stack use small under WASM
+
+} // namespace
+
+void TelemetryProducer::log_imu(const IMUData& d){
+  TelemetryRecord r{};
+  r.type = TELEMETRY_IMU;
+  r.f[0] = d.acc_timestamp;
+  r.f[1] = d.acc_x;
+  r.f[2] = d.acc_y;
+  r.f[3] = d.acc_z;
+  r.f[4] = d.gyro_timestamp;
+  r.f[5] = d.gyro_x;
+  r.f[6] = d.gyro_y;
+  r.f[7] = d.gyro_z;
+  push(r);
+}
+
+void TelemetryProducer::log_frame(const FrameSlot& frame, const IMUData& latest_imu){
+  TelemetryRecord r{};
+  r.type = TELEMETRY_FRAME;
+  r.f[0] = frame.timestamp;
+  r.f[1] = frame.generation;
+  r.f[2] = frame.depth_width;
+  r.f[3] = frame.depth_height;
+  r.f[4] = frame.image_width;
+  r.f[5] = frame.image_height;
+  r.f[6] = frame.image_channels;
+  r.f[7] = latest_imu.gyro_timestamp;
+  push(r);
+}
 
-    // very expensive to copy everything!
-    // LidarCameraData lc_copy;
-    double lc_timestamp;
-    size_t img_w, img_h;
-    {
-      std::lock_guard<std::mutex> lk(m_lc);
-      lc_timestamp = lc_data.timestamp;
-      img_h = lc_data.image_height;
-      img_w = lc_data.image_width;
+TelemetryLog::~TelemetryLog(){
+  if (file_) fclose(file_);
+  for (int i = 0; i < producer_count_.load(); ++i) delete producers_[i];
+}
+
+bool TelemetryLog::open(const char* path){
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    fprintf(stderr, "telemetry: cannot open %s, records will be dropped\n", path);
+    return false;
+  }
+  TelemetryFileHeader h{};
+  memcpy(h.magic, "ROAMRTLM", sizeof(h.magic));
+  h.version = TelemetryVersion;
+  h.record_size = sizeof(TelemetryRecord);
+  h.schema_bytes = sizeof(telemetry_schema) - 1;
+  fwrite(&h, sizeof(h), 1, file_);
+  fwrite(telemetry_schema, 1, h.schema_bytes, file_);
+  fflush(file_);
+  return true;
+}
+
+TelemetryProducer* TelemetryLog::add_producer(){
+  const int n = producer_count_.load(std::memory_order_relaxed);
+  if (n == TelemetryMaxProducers) return nullptr;
+  producers_[n] = new TelemetryProducer(static_cast<uint16_t>(n));
+  producer_count_.store(n + 1, std::memory_order_release);
+  return producers_[n];
+}
+
+size_t TelemetryLog::drain(){
+  TelemetryRecord batch[drain_batch];
+  size_t total = 0;
+  const int n = producer_count_.load(std::memory_order_acquire);
+  for (int i = 0; i < n; ++i) {
+    size_t got;
+    while ((got = producers_[i]->ring_.pop_batch(batch, drain_batch)) > 0) {
+      if (file_) fwrite(batch, sizeof(TelemetryRecord), got, file_);
+      total += got;
     }
+  }
+  if (!file_) return 0;
+  if (total) fflush(file_);
+  written_ += total;
+  return total;
+}
+
+uint64_t TelemetryLog::dropped() const{
+  uint64_t d = 0;
+  const int n = producer_count_.load(std::memory_order_acquire);
+  for (int i = 0; i < n; ++i) d += producers_[i]->ring_.dropped();
+  return d;
+}
 
-        std::cout << "T:" << imu_copy.acc_timestamp << " acc:" << imu_copy.acc_x << "," << imu_copy.acc_y << "," << imu_copy.acc_z << std::endl
-                    << "T:" << imu_copy.gyro_timestamp << " gyro:" << imu_copy.gyro_x << "," << imu_copy.gyro_y << "," << imu_copy.gyro_z <<
-                    std::endl;
-        // not sure what the best way to log lidar_camera_data is
-        std::cout << "T:" << lc_timestamp << " lidar camera: " << img_h << ", " << img_w << std::endl;
+// log sensors without significant delays in processing
+void log_sensors(TelemetryLog& log, StopSignal& stop){
+  PeriodicTimer timer(std::chrono::milliseconds(log_interval_ms), stop);
+  while (timer.wait()) {
+    log.drain();
   }
+  log.drain();
+  fprintf(stderr, "telemetry: %llu records written, %llu dropped\n",
+          static_cast<unsigned long long>(log.written()), static_cast<unsigned long long>(log.dropped()));
 };
@@ -1,13 +1,103 @@
 #pragma once
-#include <mutex>
-#include <thread>
-#include <chrono>
-#include <iomanip>
-#include <iostream>
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "imu.h"
-#include "lidar_camera.h"
+#include "frame_pool.h"
+#include "scheduler.h"
+#include "spsc_ring.h"
+
+// Binary telemetry log. Sensor threads push fixed-size records into their own
+// lock-free ring (never blocking, a full ring drops and counts), and
+// log_sensors drains every ring in batches to a file on log_interval_ms ticks.
+// Decode offline with tools/telemetry_decode.cpp.
+//
+// File layout (little-endian):
+//   TelemetryFileHeader
+//   schema: schema_bytes of text, one line per record type in type order,
+//           "name:field0,field1,..." (unused trailing fields are omitted)
+//   TelemetryRecord * N
 
 constexpr int log_interval_ms = 100;
+constexpr const char* telemetry_log_path = "telemetry.bin";
+
+constexpr int TelemetryRecordFields = 8;
+constexpr int TelemetryRingSize = 1024; // ~10 s of 100 Hz IMU per producer
+constexpr int TelemetryMaxProducers = 8;
+
+enum TelemetryType : uint16_t {
+  TELEMETRY_IMU = 0,
+  TELEMETRY_FRAME = 1,
+  TELEMETRY_TYPE_COUNT,
+};
+
+struct TelemetryRecord {
+  uint16_t type;
+  uint16_t producer;
+  uint32_t seq; // per producer, gaps mean dropped records
+  double f[TelemetryRecordFields];
+};
+static_assert(sizeof(TelemetryRecord) == 72, "TelemetryRecord layout is part of the file format");
+
+struct TelemetryFileHeader {
+  char magic[8]; // "ROAMRTLM"
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t schema_bytes;
+  uint32_t reserved;
+};
+
+constexpr uint32_t TelemetryVersion = 1;
+
+// one per producing thread
+class TelemetryProducer {
+public:
+  explicit TelemetryProducer(uint16_t id) : id_(id) {}
+
+  void log_imu(const IMUData& d);
+  // latest_imu is the newest IMU sample when the frame was handled, so the
+  // log shows how far the IMU stream runs ahead of or behind the frames
+  void log_frame(const FrameSlot& frame, const IMUData& latest_imu);
+
+private:
+  friend class TelemetryLog;
+  void push(TelemetryRecord& r) {
+    r.producer = id_;
+    r.seq = seq_++;
+    ring_.push(r);
+  }
+
+  uint16_t id_;
+  uint32_t seq_ = 0;
+  SpscRing<TelemetryRecord, TelemetryRingSize> ring_;
+};
+
+class TelemetryLog {
+public:
+  TelemetryLog() = default;
+  ~TelemetryLog();
+  TelemetryLog(const TelemetryLog&) = delete;
+  TelemetryLog& operator=(const TelemetryLog&) = delete;
+
+  // writes the header; false if the file cannot be opened (records are dropped)
+  bool open(const char* path);
+
+  // call before the producing thread starts, not thread-safe against drain()
+  TelemetryProducer* add_producer();
+
+  // moves every pending record to the file, returns how many were written
+  size_t drain();
+
+  uint64_t written() const { return written_; }
+  uint64_t dropped() const;
+
+private:
+  FILE* file_ = nullptr;
+  TelemetryProducer* producers_[TelemetryMaxProducers] = {};
+  std::atomic<int> producer_count_{0};
+  uint64_t written_ = 0;
+};
 
-void log_sensors(std::mutex& m_imu, const IMUData& imu_data, std::mutex& m_lc, const LidarCameraData& lc_data);
+// drainer thread body, returns after a final drain once stop is requested
+void log_sensors(TelemetryLog& log, StopSignal& stop);
@@ -0,0 +1,146 @@
+// Sparse tiled storage for map.cpp: the plane is split into TILE_SIZE x
+// TILE_SIZE cell tiles that are allocated on first write and found through an
+// open-addressing hash on tile coordinates, so memory follows the explored
+// area rather than its bounding box. Tiles come from memory.grow on wasm
+// (malloc natively), one page at a time, and are recycled after a reset but
+// never returned. Header-only and libc-free on wasm so map.wasm can stay
+// -nostdlib; under WASI (slam_main) tiles come from malloc, which owns
+// memory.grow there.
+#pragma once
+#include <stdint.h>
+#if !defined(__wasm__) || defined(__wasi__)
+#include <stdlib.h>
+#define TILE_USE_MALLOC 1
+#endif
+
+static const int32_t TILE_SHIFT = 6;
+static const int32_t TILE_SIZE = 1 << TILE_SHIFT; // cells per side
+static const int32_t TILE_MASK = TILE_SIZE - 1;
+static const int32_t TILE_CELLS = TILE_SIZE * TILE_SIZE;
+static const int32_t TILE_BLOCK_BYTES = 65536; // one wasm page
+static const int32_t TILE_INDEX_SLOTS = 8192;  // power of two, twice the tile limit
+
+// tile limit that keeps the index at most half full
+static const int32_t TILE_MAX_TILES = TILE_INDEX_SLOTS / 2;
+
+struct TileSlot {
+	int32_t tx, ty;
+	int16_t* cells; // nullptr marks an empty slot
+};
+
+struct TileMap {
+	TileSlot slots[TILE_INDEX_SLOTS];
+	int32_t count;    // tiles in the index
+	int32_t limit;    // no new tiles past this, see tile_get
+	int32_t reserved; // tiles ever allocated (in the index or on the free list)
+	int16_t* freeList; // recycled tiles, linked through their first bytes
+	uint8_t* block;    // current allocation block and bytes left in it
+	int32_t blockLeft;
+	void* blocks;      // malloc'd blocks, linked through their headers (unused on map.wasm)
+};
+
+// malloc'd blocks start with a link to the previous one, padded to keep tiles aligned
+static const int32_t TILE_BLOCK_HEADER = 16;
+
+static inline void* tile_alloc_block(TileMap* m) {
+#if !defined(TILE_USE_MALLOC)
+	(void)m;
+	const int32_t page = __builtin_wasm_memory_grow(0, 1);
+	if (page < 0) return nullptr;
+	return (void*)((uintptr_t)page * 65536u);
+#else
+	uint8_t* b = (uint8_t*)malloc(TILE_BLOCK_HEADER + TILE_BLOCK_BYTES);
+	if (!b) return nullptr;
+	__builtin_memcpy(b, &m->blocks, sizeof(void*));
+	m->blocks = b;
+	return b + TILE_BLOCK_HEADER;
+#endif
+}
+
+// Sets up an uninitialized map (map.cpp constant-initializes its own).
+static inline void tile_init(TileMap* m) {
+	for (int32_t i = 0; i < TILE_INDEX_SLOTS; ++i) m->slots[i].cells = nullptr;
+	m->count = 0;
+	m->limit = TILE_MAX_TILES;
+	m->reserved = 0;
+	m->freeList = nullptr;
+	m->block = nullptr;
+	m->blockLeft = 0;
+	m->blocks = nullptr;
+}
+
+static inline uint32_t tile_hash(int32_t tx, int32_t ty) {
+	return ((uint32_t)tx * 73856093u) ^ ((uint32_t)ty * 19349663u);
+}
+
+// Tiles are zero-filled; with log-odds cells that means unknown.
+static inline int16_t* tile_new(TileMap* m) {
+	int16_t* t = m->freeList;
+	if (t) {
+		__builtin_memcpy(&m->freeList, t, sizeof(int16_t*));
+	} else {
+		const int32_t bytes = TILE_CELLS * (int32_t)sizeof(int16_t);
+		if (m->blockLeft < bytes) {
+			m->block = (uint8_t*)tile_alloc_block(m);
+			m->blockLeft = m->block ? TILE_BLOCK_BYTES : 0;
+			if (!m->block) return nullptr;
+		}
+		t = (int16_t*)m->block;
+		m->block += bytes;
+		m->blockLeft -= bytes;
+		++m->reserved;
+	}
+	for (int32_t i = 0; i < TILE_CELLS; ++i) t[i] = 0;
+	return t;
+}
+
+// Cells of tile (tx, ty), row-major with row 0 at the lowest y. Returns
+// nullptr if the tile does not exist and create is false, or if it would
+// exceed the limit or memory cannot grow.
+static inline int16_t* tile_get(TileMap* m, int32_t tx, int32_t ty, bool create) {
+	uint32_t h = tile_hash(tx, ty) & (uint32_t)(TILE_INDEX_SLOTS - 1);
+	for (;;) {
+		TileSlot& s = m->slots[h];
+		if (!s.cells) break;
+		if (s.tx == tx && s.ty == ty) return s.cells;
+		h = (h + 1) & (uint32_t)(TILE_INDEX_SLOTS - 1);
+	}
+	if (!create || m->count >= m->limit) return nullptr;
+	int16_t* t = tile_new(m);
+	if (!t) return nullptr;
+	TileSlot& s = m->slots[h];
+	s.tx = tx;
+	s.ty = ty;
+	s.cells = t;
+	++m->count;
+	return t;
+}
+
+// Drops every tile; their memory goes on the free list for reuse.
+static inline void tile_reset(TileMap* m) {
+	for (int32_t i = 0; i < TILE_INDEX_SLOTS; ++i) {
+		int16_t* t = m->slots[i].cells;
+		if (!t) continue;
+		__builtin_memcpy(t, &m->freeList, sizeof(int16_t*));
+		m->freeList = t;
+		m->slots[i].cells = nullptr;
+	}
+	m->count = 0;
+}
+
+#if defined(TILE_USE_MALLOC)
+// Drops every tile and frees their memory; only where tiles come from malloc.
+static inline void tile_release(TileMap* m) {
+	tile_reset(m);
+	while (m->blocks) {
+		void* next;
+		__builtin_memcpy(&next, m->blocks, sizeof(void*));
+		free(m->blocks);
+		m->blocks = next;
+	}
+	m->freeList = nullptr;
+	m->block = nullptr;
+	m->blockLeft = 0;
+	m->reserved = 0;
+}
+#endif
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Rebuilds the checked-in slam_main.wasm and map.wasm with the wasi-sdk image
+# (the commands in README.md). Run it whenever slam_main's host imports or
+# map.cpp's exports change, and commit both binaries with the change: the iOS
+# and web hosts load these files, not the sources.
+#
+#   WASM/tools/build_wasm.sh
+set -eu
+cd "$(dirname "$0")/.."
+
+wasi() {
+	tool=$1
+	shift
+	docker run --rm -v "$(pwd)":/src -w /src ghcr.io/webassembly/wasi-sdk "/opt/wasi-sdk/bin/$tool" "$@"
+}
+
+wasi clang++ --target=wasm32-wasip1-threads -pthread \
+	-Wl,--import-memory \
+	-Wl,--export-memory \
+	-Wl,--shared-memory \
+	-Wl,--max-memory=67108864 \
+	-o slam_main.wasm slam_main.cpp telemetry.cpp recording.cpp
+
+# every function declared in map.h is an export
+exports=$(sed -n 's/^[A-Za-z_].*[ *]\([a-z_][a-z0-9_]*\)(.*);$/-Wl,--export=\1/p' map.h)
+# shellcheck disable=SC2086 # one flag per word
+wasi clang --target=wasm32 -O2 -msimd128 -ffp-contract=off -nostdlib \
+	-Wl,--no-entry \
+	-Wl,--export-memory \
+	$exports \
+	-o map.wasm map.cpp
+
+echo "rebuilt slam_main.wasm and map.wasm; commit them with the interface change"
@@ -0,0 +1,113 @@
+// Offline decoder for the binary telemetry log written by log_sensors.
+//
+//   bazel run //WASM:telemetry_decode -- $PWD/telemetry.bin            # one text line per record
+//   bazel run //WASM:telemetry_decode -- $PWD/telemetry.bin --csv imu  # CSV of a single record type
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "telemetry.h"
+
+namespace {
+
+struct RecordSchema {
+    std::string name;
+    std::vector<std::string> fields;
+};
+
+std::vector<RecordSchema> parse_schema(const std::string& text) {
+    std::vector<RecordSchema> types;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        const std::string line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        RecordSchema t;
+        t.name = line.substr(0, colon);
+        size_t f = colon + 1;
+        while (f <= line.size()) {
+            size_t comma = line.find(',', f);
+            if (comma == std::string::npos) comma = line.size();
+            t.fields.push_back(line.substr(f, comma - f));
+            f = comma + 1;
+        }
+        types.push_back(t);
+    }
+    return types;
+}
+
+int usage() {
+    std::fprintf(stderr, "usage: telemetry_decode <log> [--csv <type>]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2 && argc != 4) return usage();
+    const char* csv_type = nullptr;
+    if (argc == 4) {
+        if (std::strcmp(argv[2], "--csv") != 0) return usage();
+        csv_type = argv[3];
+    }
+
+    FILE* f = std::fopen(argv[1], "rb");
+    if (!f) {
+        std::perror(argv[1]);
+        return 1;
+    }
+    TelemetryFileHeader h;
+    if (std::fread(&h, sizeof(h), 1, f) != 1 || std::memcmp(h.magic, "ROAMRTLM", sizeof(h.magic)) != 0) {
+        std::fprintf(stderr, "%s: not a telemetry log\n", argv[1]);
+        return 1;
+    }
+    if (h.version != TelemetryVersion || h.record_size != sizeof(TelemetryRecord)) {
+        std::fprintf(stderr, "%s: unsupported version %u (record size %u)\n", argv[1], h.version, h.record_size);
+        return 1;
+    }
+    std::string schema_text(h.schema_bytes, '\0');
+    if (std::fread(&schema_text[0], 1, h.schema_bytes, f) != h.schema_bytes) {
+        std::fprintf(stderr, "%s: truncated schema\n", argv[1]);
+        return 1;
+    }
+    const std::vector<RecordSchema> schema = parse_schema(schema_text);
+
+    int csv_index = -1;
+    if (csv_type) {
+        for (size_t i = 0; i < schema.size(); ++i)
+            if (schema[i].name == csv_type) csv_index = static_cast<int>(i);
+        if (csv_index < 0) {
+            std::fprintf(stderr, "unknown record type '%s'\n", csv_type);
+            return 1;
+        }
+        std::printf("producer,seq");
+        for (const auto& name : schema[csv_index].fields) std::printf(",%s", name.c_str());
+        std::printf("\n");
+    }
+
+    TelemetryRecord batch[256];
+    size_t n;
+    while ((n = std::fread(batch, sizeof(TelemetryRecord), 256, f)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const TelemetryRecord& r = batch[i];
+            if (r.type >= schema.size()) continue;
+            const RecordSchema& t = schema[r.type];
+            const size_t nf = t.fields.size() < TelemetryRecordFields ? t.fields.size() : TelemetryRecordFields;
+            if (csv_index >= 0) {
+                if (r.type != csv_index) continue;
+                std::printf("%u,%u", r.producer, r.seq);
+                for (size_t k = 0; k < nf; ++k) std::printf(",%.9g", r.f[k]);
+                std::printf("\n");
+            } else {
+                std::printf("%s p%u #%u", t.name.c_str(), r.producer, r.seq);
+                for (size_t k = 0; k < nf; ++k) std::printf(" %s=%.6f", t.fields[k].c_str(), r.f[k]);
+                std::printf("\n");
+            }
+        }
+    }
+    std::fclose(f);
+}
@@ -0,0 +1,309 @@
+#include "tsdf_mesher.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h> // memcpy
+#include <algorithm>
+
+namespace {
+
+// brick coordinates packed as in tsdf_volume.cpp, 21 bits per axis
+constexpr int kAxisBits = 21;
+constexpr int32_t kAxisOffset = 1 << (kAxisBits - 1);
+constexpr uint64_t kAxisMask = (uint64_t{1} << kAxisBits) - 1;
+
+uint64_t pack(const TsdfBrickCoord &b) {
+  return (static_cast<uint64_t>(b.bx + kAxisOffset) << (2 * kAxisBits)) |
+         (static_cast<uint64_t>(b.by + kAxisOffset) << kAxisBits) | static_cast<uint64_t>(b.bz + kAxisOffset);
+}
+
+TsdfBrickCoord unpack(uint64_t key) {
+  return TsdfBrickCoord{static_cast<int32_t>((key >> (2 * kAxisBits)) & kAxisMask) - kAxisOffset,
+                        static_cast<int32_t>((key >> kAxisBits) & kAxisMask) - kAxisOffset,
+                        static_cast<int32_t>(key & kAxisMask) - kAxisOffset};
+}
+
+// Corner c of a cube is at (c & 1, c >> 1 & 1, c >> 2). Edge e runs from
+// corner edge_corner[e] one step along axis edge_axis[e]. tris[config] lists
+// the triangles, as edges, for the cube whose corners in bit set config are
+// inside (negative distance).
+struct CubeTables {
+  static constexpr int kMaxIndices = 15; // five triangles, as in the classic table
+  int8_t edge_corner[12];
+  int8_t edge_axis[12];
+  int8_t tris[256][kMaxIndices];
+  uint8_t count[256];
+
+  CubeTables() {
+    int n = 0;
+    for (int a = 0; a < 3; ++a)
+      for (int c = 0; c < 8; ++c)
+        if (!(c & (1 << a))) {
+          edge_corner[n] = static_cast<int8_t>(c);
+          edge_axis[n++] = static_cast<int8_t>(a);
+        }
+    for (int config = 0; config < 256; ++config) build(config);
+  }
+
+  int edge_of(int c0, int c1) const {
+    const int lo = std::min(c0, c1), axis = (c0 ^ c1) == 1 ? 0 : (c0 ^ c1) == 2 ? 1 : 2;
+    for (int e = 0; e < 12; ++e)
+      if (edge_corner[e] == lo && edge_axis[e] == axis) return e;
+    return -1;
+  }
+
+  void midpoint(int e, float *m) const {
+    for (int a = 0; a < 3; ++a) m[a] = static_cast<float>((edge_corner[e] >> a) & 1) + (edge_axis[e] == a ? 0.5f : 0.0f);
+  }
+
+  void build(int config) {
+    auto inside = [config](int c) { return (config >> c) & 1; };
+    // the surface's outline on each face, as segments between edges,
+    // directed so that the surface's normal points into free space
+    int next[12];
+    for (int &x : next) x = -1;
+    for (int a = 0; a < 3; ++a) {
+      const int u = (a + 1) % 3, v = (a + 2) % 3;
+      for (int side = 0; side < 2; ++side) {
+        const int q0 = side << a;
+        const int q[4] = {q0, q0 | 1 << u, q0 | 1 << u | 1 << v, q0 | 1 << v};
+        int crossing[4], nc = 0;
+        for (int i = 0; i < 4; ++i)
+          if (inside(q[i]) != inside(q[(i + 1) % 4])) crossing[nc++] = edge_of(q[i], q[(i + 1) % 4]);
+        int segs[2][2], ns = 0;
+        if (nc == 2) {
+          segs[ns][0] = crossing[0];
+          segs[ns++][1] = crossing[1];
+        } else if (nc == 4) {
+          // two inside corners on a diagonal: cut each off on its own
+          for (int i = 0; i < 4; ++i)
+            if (inside(q[i])) {
+              segs[ns][0] = edge_of(q[(i + 3) % 4], q[i]);
+              segs[ns++][1] = edge_of(q[i], q[(i + 1) % 4]);
+            }
+        }
+        float n[3] = {0, 0, 0};
+        n[a] = side ? 1.0f : -1.0f;
+        for (int s = 0; s < ns; ++s) {
+          int e0 = segs[s][0], e1 = segs[s][1];
+          float m0[3], m1[3], o[3];
+          midpoint(e0, m0);
+          midpoint(e1, m1);
+          // the outside end of e0 lies on the free side of the segment,
+          // which must be to the left of it seen from outside the cube
+          const int c0 = edge_corner[e0], c1 = c0 | 1 << edge_axis[e0];
+          const int out = inside(c0) ? c1 : c0;
+          for (int k = 0; k < 3; ++k) o[k] = static_cast<float>((out >> k) & 1) - 0.5f * (m0[k] + m1[k]);
+          const float d[3] = {m1[0] - m0[0], m1[1] - m0[1], m1[2] - m0[2]};
+          const float left[3] = {n[1] * d[2] - n[2] * d[1], n[2] * d[0] - n[0] * d[2], n[0] * d[1] - n[1] * d[0]};
+          if (left[0] * o[0] + left[1] * o[1] + left[2] * o[2] < 0.0f) std::swap(e0, e1);
+          next[e0] = e1;
+        }
+      }
+    }
+    // every crossed edge is on two faces, so the segments close into
+    // loops; each becomes a fan
+    bool used[12] = {};
+    int k = 0;
+    for (int start = 0; start < 12; ++start) {
+      if (next[start] < 0 || used[start]) continue;
+      int loop[12], len = 0;
+      for (int e = start; !used[e]; e = next[e]) {
+        used[e] = true;
+        loop[len++] = e;
+      }
+      for (int i = 1; i + 1 < len; ++i) {
+        tris[config][k++] = static_cast<int8_t>(loop[0]);
+        tris[config][k++] = static_cast<int8_t>(loop[i]);
+        tris[config][k++] = static_cast<int8_t>(loop[i + 1]);
+      }
+    }
+    count[config] = static_cast<uint8_t>(k);
+  }
+};
+
+const CubeTables &cube_tables() {
+  static const CubeTables tables;
+  return tables;
+}
+
+} // namespace
+
+TsdfMesher::TsdfMesher(const MeshParams &params) : params_(params) {
+  if (params_.min_weight < 1) params_.min_weight = 1;
+  cube_tables(); // built once, before any update
+}
+
+int TsdfMesher::update(TsdfVolume &volume) {
+  volume.take_dirty(dirty_);
+  if (!primed_) {
+    // the volume may have been read before, or by another mesher
+    dirty_.clear();
+    for (int i = 0; i < volume.block_count(); ++i) {
+      const TsdfBlock &b = volume.block(i);
+      dirty_.push_back(TsdfBrickCoord{b.bx, b.by, b.bz});
+    }
+    primed_ = true;
+  }
+  // a brick's samples feed the cubes of the bricks below it on any axis too
+  keys_.clear();
+  for (const TsdfBrickCoord &b : dirty_)
+    for (int d = 0; d < 8; ++d)
+      keys_.push_back(pack(TsdfBrickCoord{b.bx - (d & 1), b.by - ((d >> 1) & 1), b.bz - (d >> 2)}));
+  std::sort(keys_.begin(), keys_.end());
+  keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+
+  changed_.clear();
+  for (uint64_t key : keys_) {
+    const TsdfBrickCoord b = unpack(key);
+    auto it = chunks_.find(key);
+    if (!volume.find(b.bx, b.by, b.bz)) {
+      if (it == chunks_.end()) continue;
+      chunks_.erase(it);
+    } else {
+      mesh_brick(volume, b);
+      if (scratch_.indices.empty()) {
+        if (it == chunks_.end()) continue;
+        chunks_.erase(it);
+      } else {
+        if (it == chunks_.end()) it = chunks_.emplace(key, MeshChunk{}).first;
+        // swap keeps both buffers' capacity in use
+        std::swap(it->second, scratch_);
+      }
+    }
+    changed_.push_back(b);
+  }
+  return static_cast<int>(changed_.size());
+}
+
+void TsdfMesher::mesh_brick(const TsdfVolume &volume, const TsdfBrickCoord &brick) {
+  const CubeTables &t = cube_tables();
+  const float vs = volume.params().voxel_size;
+  scratch_.brick = brick;
+  scratch_.vertices.clear();
+  scratch_.indices.clear();
+
+  // the brick's voxels plus the layer above on each axis
+  const TsdfBlock *nb[8];
+  for (int d = 0; d < 8; ++d) nb[d] = volume.find(brick.bx + (d & 1), brick.by + ((d >> 1) & 1), brick.bz + (d >> 2));
+  for (int k = 0; k < kSide; ++k)
+    for (int j = 0; j < kSide; ++j)
+      for (int i = 0; i < kSide; ++i) {
+        const int s = (k * kSide + j) * kSide + i;
+        const TsdfBlock *b = nb[(i >> 3) | ((j >> 3) << 1) | ((k >> 3) << 2)];
+        const TsdfVoxel *v = b ? &b->at(i & 7, j & 7, k & 7) : nullptr;
+        known_[s] = v && v->weight >= params_.min_weight;
+        sdf_[s] = v ? static_cast<float>(v->sdf) : 0.0f;
+      }
+  std::fill(std::begin(edge_vertex_), std::end(edge_vertex_), -1);
+
+  const int step[3] = {1, kSide, kSide * kSide};
+  const int32_t gx = brick.bx * kTsdfBlockSide, gy = brick.by * kTsdfBlockSide, gz = brick.bz * kTsdfBlockSide;
+  for (int k = 0; k < kTsdfBlockSide; ++k)
+    for (int j = 0; j < kTsdfBlockSide; ++j)
+      for (int i = 0; i < kTsdfBlockSide; ++i) {
+        const int s0 = (k * kSide + j) * kSide + i;
+        int config = 0;
+        bool known = true;
+        for (int c = 0; c < 8; ++c) {
+          const int s = s0 + (c & 1) * step[0] + ((c >> 1) & 1) * step[1] + (c >> 2) * step[2];
+          known &= known_[s];
+          config |= (sdf_[s] < 0.0f) << c;
+        }
+        if (!known || config == 0 || config == 255) continue;
+        const int8_t *tri = t.tris[config];
+        for (int n = 0; n < t.count[config]; ++n) {
+          const int e = tri[n], c = t.edge_corner[e], a = t.edge_axis[e];
+          const int s = s0 + (c & 1) * step[0] + ((c >> 1) & 1) * step[1] + (c >> 2) * step[2];
+          int32_t &vi = edge_vertex_[s * 3 + a];
+          if (vi < 0) {
+            // where the distance crosses zero along the edge; from the
+            // integer voxel coordinates, so the brick sharing the edge
+            // computes the same point
+            const float d0 = sdf_[s], d1 = sdf_[s + step[a]];
+            const float f = d0 / (d0 - d1);
+            const int ix = i + (c & 1), iy = j + ((c >> 1) & 1), iz = k + (c >> 2);
+            float p[3] = {static_cast<float>(gx + ix) + 0.5f, static_cast<float>(gy + iy) + 0.5f,
+                          static_cast<float>(gz + iz) + 0.5f};
+            p[a] += f;
+            vi = static_cast<int32_t>(scratch_.vertices.size() / kMeshVertexFloats);
+            scratch_.vertices.insert(scratch_.vertices.end(), {p[0] * vs, p[1] * vs, p[2] * vs, 0.0f, 0.0f, 0.0f});
+          }
+          scratch_.indices.push_back(static_cast<uint32_t>(vi));
+        }
+      }
+
+  // vertex normals: area-weighted sums of the faces around them
+  float *v = scratch_.vertices.data();
+  const uint32_t *idx = scratch_.indices.data();
+  for (size_t n = 0; n < scratch_.indices.size(); n += 3) {
+    float *p0 = v + idx[n] * kMeshVertexFloats, *p1 = v + idx[n + 1] * kMeshVertexFloats,
+          *p2 = v + idx[n + 2] * kMeshVertexFloats;
+    const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    const float fn[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+    for (float *p : {p0, p1, p2})
+      for (int a = 0; a < 3; ++a) p[3 + a] += fn[a];
+  }
+  for (size_t n = 0; n < scratch_.vertices.size(); n += kMeshVertexFloats) {
+    float *p = v + n;
+    const float len = sqrtf(p[3] * p[3] + p[4] * p[4] + p[5] * p[5]);
+    if (len > 0.0f)
+      for (int a = 3; a < 6; ++a) p[a] /= len;
+  }
+}
+
+const MeshChunk *TsdfMesher::chunk(const TsdfBrickCoord &brick) const {
+  auto it = chunks_.find(pack(brick));
+  return it == chunks_.end() ? nullptr : &it->second;
+}
+
+size_t TsdfMesher::vertex_count() const {
+  size_t n = 0;
+  for (const auto &c : chunks_) n += c.second.vertices.size() / kMeshVertexFloats;
+  return n;
+}
+
+size_t TsdfMesher::triangle_count() const {
+  size_t n = 0;
+  for (const auto &c : chunks_) n += c.second.indices.size() / 3;
+  return n;
+}
+
+void TsdfMesher::flatten(std::vector<float> &vertices, std::vector<uint32_t> &indices) const {
+  vertices.clear();
+  indices.clear();
+  for (const auto &c : chunks_) {
+    const uint32_t base = static_cast<uint32_t>(vertices.size() / kMeshVertexFloats);
+    vertices.insert(vertices.end(), c.second.vertices.begin(), c.second.vertices.end());
+    for (uint32_t i : c.second.indices) indices.push_back(base + i);
+  }
+}
+
+bool TsdfMesher::write_ply(const char *path) const {
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  fprintf(f,
+          "ply\nformat binary_little_endian 1.0\nelement vertex %zu\n"
+          "property float x\nproperty float y\nproperty float z\n"
+          "property float nx\nproperty float ny\nproperty float nz\n"
+          "element face %zu\nproperty list uchar uint vertex_indices\nend_header\n",
+          vertex_count(), triangle_count());
+  // x86, arm64 and wasm32 are all little-endian, so floats go out as they are
+  for (const auto &c : chunks_)
+    fwrite(c.second.vertices.data(), sizeof(float), c.second.vertices.size(), f);
+  uint32_t base = 0;
+  for (const auto &c : chunks_) {
+    const std::vector<uint32_t> &idx = c.second.indices;
+    for (size_t n = 0; n < idx.size(); n += 3) {
+      unsigned char face[13];
+      face[0] = 3;
+      const uint32_t tri[3] = {base + idx[n], base + idx[n + 1], base + idx[n + 2]};
+      memcpy(face + 1, tri, sizeof(tri));
+      fwrite(face, 1, sizeof(face), f);
+    }
+    base += static_cast<uint32_t>(c.second.vertices.size() / kMeshVertexFloats);
+  }
+  const bool written = !ferror(f);
+  return fclose(f) == 0 && written;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "tsdf_volume.h"
+
+// Marching-cubes surface of a TsdfVolume, kept up to date brick by brick.
+//
+// The mesh is split into one chunk per brick: the cubes whose lowest corner
+// is one of the brick's voxels, which reach one voxel into the bricks above
+// it on each axis. update() takes the bricks the volume changed since the
+// last call (take_dirty) and re-meshes those and the seven below them, so
+// a frame costs what it touched however large the mesh has grown; a
+// dropped brick takes its chunk with it. Chunks are flat buffers that can
+// be streamed as they change (changed()), or joined into one for upload or
+// a PLY file (flatten, write_ply).
+//
+// Cube cases come from a table generated at startup rather than the usual
+// hand-written one: the surface's outline on each face is traced, and an
+// ambiguous face (two inside corners diagonal to each other) always keeps
+// its inside corners apart. Neighbouring cubes share the face, so they
+// resolve it the same way and the mesh has no cracks.
+
+struct MeshParams {
+  int min_weight = 2; // voxels observed fewer times count as unknown; cubes with one are skipped
+};
+
+struct MeshChunk {
+  TsdfBrickCoord brick;
+  // x, y, z, nx, ny, nz per vertex, world meters, normals toward free space
+  std::vector<float> vertices;
+  // three per triangle, into this chunk's vertices, counter-clockwise seen
+  // from free space
+  std::vector<uint32_t> indices;
+};
+
+constexpr int kMeshVertexFloats = 6;
+
+class TsdfMesher {
+public:
+  explicit TsdfMesher(const MeshParams &params = MeshParams{});
+
+  // re-meshes what changed in volume since the previous call (everything,
+  // the first time); returns the chunks rebuilt or removed. The volume's
+  // dirty list has one reader: a second mesher on it only ever sees its
+  // first update's bricks.
+  int update(TsdfVolume &volume);
+  // bricks whose chunk the last update rebuilt or removed; chunk() is
+  // nullptr for a removed one, or one left without triangles
+  const std::vector<TsdfBrickCoord> &changed() const { return changed_; }
+  const MeshChunk *chunk(const TsdfBrickCoord &brick) const;
+
+  int chunk_count() const { return static_cast<int>(chunks_.size()); }
+  size_t vertex_count() const;
+  size_t triangle_count() const;
+  // the whole mesh in one pair of buffers, chunk after chunk, same layout
+  void flatten(std::vector<float> &vertices, std::vector<uint32_t> &indices) const;
+  // binary little-endian PLY with normals; false if the file cannot be written
+  bool write_ply(const char *path) const;
+
+private:
+  static constexpr int kSide = kTsdfBlockSide + 1; // samples per axis: the brick plus the layer above
+
+  void mesh_brick(const TsdfVolume &volume, const TsdfBrickCoord &brick);
+
+  MeshParams params_;
+  bool primed_ = false;
+  std::unordered_map<uint64_t, MeshChunk> chunks_;
+  std::vector<TsdfBrickCoord> dirty_, changed_;
+  std::vector<uint64_t> keys_;
+  // one brick's samples and the vertex on each of their edges
+  float sdf_[kSide * kSide * kSide];
+  bool known_[kSide * kSide * kSide];
+  int32_t edge_vertex_[kSide * kSide * kSide * 3];
+  MeshChunk scratch_;
+};
@@ -0,0 +1,377 @@
+#include "tsdf_volume.h"
+
+#include <string.h> // memset
+#include <algorithm>
+
+// brick coordinates are packed into 21 bits per axis, offset to be unsigned
+static constexpr int kAxisBits = 21;
+static constexpr int32_t kAxisOffset = 1 << (kAxisBits - 1);
+static constexpr uint64_t kAxisMask = (uint64_t{1} << kAxisBits) - 1;
+static constexpr uint64_t kEmpty = ~0ull;
+static constexpr int kBlocksPerTask = 8;
+static constexpr int kRecentBits = 6;
+static constexpr float kSdfScale = 32767.0f;
+
+static inline uint64_t pack(int32_t bx, int32_t by, int32_t bz) {
+  return (static_cast<uint64_t>(bx + kAxisOffset) << (2 * kAxisBits)) |
+         (static_cast<uint64_t>(by + kAxisOffset) << kAxisBits) | static_cast<uint64_t>(bz + kAxisOffset);
+}
+
+static inline int32_t unpack(uint64_t key, int shift) {
+  return static_cast<int32_t>((key >> shift) & kAxisMask) - kAxisOffset;
+}
+
+// floor without a floorf call (libm on baseline x86-64); v is finite and
+// well inside the packable range
+static inline int32_t floor_i(float v) {
+  const int32_t i = static_cast<int32_t>(v);
+  return i - (static_cast<float>(i) > v);
+}
+
+TsdfVolume::TsdfVolume(const CameraIntrinsics &k, const TsdfParams &params) : k_(k), params_(params) {
+  if (!(params_.voxel_size > 0.0f)) params_.voxel_size = 0.04f;
+  if (!(params_.truncation > 0.0f)) params_.truncation = 3.0f * params_.voxel_size;
+  params_.max_weight = std::min(std::max(params_.max_weight, 1), 65535);
+  if (params_.max_blocks < 1) params_.max_blocks = 1;
+  if (params_.threads < 1) params_.threads = 1;
+  // the table stays at most half full
+  size_t slots = 64;
+  while (slots < 2 * static_cast<size_t>(params_.max_blocks)) slots *= 2;
+  table_.assign(slots, Slot{kEmpty, 0});
+  while ((size_t{1} << bits_) < slots) ++bits_;
+  pose_ = CameraPose::identity();
+  for (int i = 1; i < params_.threads; ++i)
+    workers_.emplace_back([this] {
+      uint64_t seen = 0;
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lk(m_);
+          start_.wait(lk, [&] { return stop_ || generation_ != seen; });
+          if (stop_) return;
+          seen = generation_;
+        }
+        work();
+        std::lock_guard<std::mutex> lk(m_);
+        if (--running_ == 0) done_.notify_one();
+      }
+    });
+}
+
+TsdfVolume::~TsdfVolume() {
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (std::thread &t : workers_) t.join();
+}
+
+uint64_t TsdfVolume::slot_of(uint64_t key) const {
+  // Fibonacci hashing: top bits of the product, linear probing
+  const uint64_t mask = table_.size() - 1;
+  uint64_t h = (key * 0x9E3779B97F4A7C15ull) >> (64 - bits_);
+  while (table_[h].key != kEmpty && table_[h].key != key) h = (h + 1) & mask;
+  return h;
+}
+
+const TsdfBlock *TsdfVolume::find(int32_t bx, int32_t by, int32_t bz) const {
+  if (bx <= -kAxisOffset || bx >= kAxisOffset || by <= -kAxisOffset || by >= kAxisOffset || bz <= -kAxisOffset ||
+      bz >= kAxisOffset)
+    return nullptr;
+  const Slot &s = table_[slot_of(pack(bx, by, bz))];
+  return s.key == kEmpty ? nullptr : &block(static_cast<int>(s.index));
+}
+
+int TsdfVolume::allocate(uint64_t key, int32_t bx, int32_t by, int32_t bz) {
+  if (free_.empty() && count_ >= params_.max_blocks) evict();
+  int index;
+  if (!free_.empty()) {
+    index = static_cast<int>(free_.back());
+    free_.pop_back();
+  } else if (count_ < params_.max_blocks) {
+    if (count_ == static_cast<int>(chunks_.size()) * kChunkBlocks)
+      chunks_.emplace_back(new TsdfBlock[kChunkBlocks]);
+    index = count_++;
+  } else {
+    return -1;
+  }
+  TsdfBlock &b = block_mut(index);
+  b.bx = bx;
+  b.by = by;
+  b.bz = bz;
+  b.stamp = frame_;
+  memset(b.voxels, 0, sizeof(b.voxels));
+  if (track_dirty_) dirty_.push_back(TsdfBrickCoord{bx, by, bz});
+  // evict may have moved the key's slot
+  table_[slot_of(key)] = Slot{key, static_cast<uint32_t>(index)};
+  touched_.push_back(static_cast<uint32_t>(index));
+  return index;
+}
+
+void TsdfVolume::evict() {
+  order_.clear();
+  for (int i = 0; i < count_; ++i) {
+    const uint32_t stamp = block(i).stamp;
+    if (stamp != 0 && stamp != frame_) order_.push_back(static_cast<uint32_t>(i));
+  }
+  const size_t n = std::min(order_.size(), static_cast<size_t>(std::max(params_.max_blocks / 8, 1)));
+  // oldest stamps first; ties by index, so the choice is deterministic
+  auto older = [this](uint32_t a, uint32_t b) {
+    const uint32_t sa = block(static_cast<int>(a)).stamp, sb = block(static_cast<int>(b)).stamp;
+    return sa != sb ? sa < sb : a < b;
+  };
+  if (n < order_.size()) std::nth_element(order_.begin(), order_.begin() + n, order_.end(), older);
+  for (size_t i = 0; i < n; ++i) remove(static_cast<int>(order_[i]));
+  stats_.evicted += static_cast<int64_t>(n);
+}
+
+void TsdfVolume::remove(int index) {
+  TsdfBlock &b = block_mut(index);
+  // backward-shift deletion keeps every probe chain unbroken
+  const uint64_t mask = table_.size() - 1;
+  uint64_t hole = slot_of(pack(b.bx, b.by, b.bz));
+  for (uint64_t j = (hole + 1) & mask; table_[j].key != kEmpty; j = (j + 1) & mask) {
+    const uint64_t home = (table_[j].key * 0x9E3779B97F4A7C15ull) >> (64 - bits_);
+    // the entry at j may fill the hole unless its home lies in (hole, j]
+    const bool stays = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+    if (stays) continue;
+    table_[hole] = table_[j];
+    hole = j;
+  }
+  table_[hole].key = kEmpty;
+  if (track_dirty_) dirty_.push_back(TsdfBrickCoord{b.bx, b.by, b.bz});
+  b.stamp = 0;
+  free_.push_back(static_cast<uint32_t>(index));
+}
+
+void TsdfVolume::compact() {
+  // fill the holes eviction left with the last bricks
+  while (!free_.empty()) {
+    const int hole = static_cast<int>(free_.back());
+    free_.pop_back();
+    while (count_ > 0 && block(count_ - 1).stamp == 0) --count_;
+    if (hole >= count_) continue;
+    TsdfBlock &last = block_mut(count_ - 1);
+    table_[slot_of(pack(last.bx, last.by, last.bz))].index = static_cast<uint32_t>(hole);
+    memcpy(&block_mut(hole), &last, sizeof(TsdfBlock));
+    last.stamp = 0;
+    --count_;
+  }
+}
+
+void TsdfVolume::parallel(Pass pass, int tasks) {
+  pass_ = pass;
+  tasks_ = tasks;
+  next_task_.store(0, std::memory_order_relaxed);
+  if (!workers_.empty()) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      ++generation_;
+      running_ = static_cast<int>(workers_.size());
+    }
+    start_.notify_all();
+  }
+  work();
+  if (!workers_.empty()) {
+    std::unique_lock<std::mutex> lk(m_);
+    done_.wait(lk, [this] { return running_ == 0; });
+  }
+}
+
+void TsdfVolume::work() {
+  for (;;) {
+    const int t = next_task_.fetch_add(1, std::memory_order_relaxed);
+    if (t >= tasks_) return;
+    if (pass_ == Pass::kTouch) {
+      touch_rows(t);
+    } else {
+      const int first = t * kBlocksPerTask;
+      update_blocks(first, std::min(first + kBlocksPerTask, static_cast<int>(touched_.size())));
+    }
+  }
+}
+
+void TsdfVolume::touch_rows(int band) {
+  std::vector<uint64_t> &keys = band_keys_[band];
+  keys.clear();
+  const float *R = pose_.r, *T = pose_.t;
+  const float inv_block = 1.0f / (params_.voxel_size * kTsdfBlockSide);
+  const float trunc = params_.truncation;
+  const float inv_fx = 1.0f / k_.fx, inv_fy = 1.0f / k_.fy;
+  const int v1 = std::min((band + 1) * rows_per_band_, height_);
+  // the band's samples cover a few dozen bricks many times over; a small
+  // direct-mapped cache of keys already listed drops most repeats before
+  // they reach the merge
+  uint64_t recent[1 << kRecentBits];
+  for (uint64_t &r : recent) r = kEmpty;
+  for (int v = band * rows_per_band_; v < v1; ++v) {
+    const float *row = depth_ + static_cast<size_t>(v) * width_;
+    const float yn = (static_cast<float>(v) - k_.cy) * inv_fy;
+    // neighbouring samples mostly cover the same bricks; a repeat of the
+    // previous sample's box adds nothing
+    int32_t last[6] = {0, 0, 0, 0, 0, 0};
+    bool have_last = false;
+    for (int u = 0; u < width_; ++u) {
+      const float z = row[u];
+      if (!(z >= params_.min_depth && z <= params_.max_depth)) continue;
+      const float c[3] = {(static_cast<float>(u) - k_.cx) * inv_fx * z, yn * z, z};
+      int32_t box[6];
+      for (int a = 0; a < 3; ++a) {
+        const float w = R[3 * a] * c[0] + R[3 * a + 1] * c[1] + R[3 * a + 2] * c[2] + T[a];
+        box[a] = floor_i((w - trunc) * inv_block);
+        box[a + 3] = floor_i((w + trunc) * inv_block);
+      }
+      if (have_last && memcmp(box, last, sizeof(box)) == 0) continue;
+      memcpy(last, box, sizeof(box));
+      have_last = true;
+      for (int32_t bz = box[2]; bz <= box[5]; ++bz)
+        for (int32_t by = box[1]; by <= box[4]; ++by)
+          for (int32_t bx = box[0]; bx <= box[3]; ++bx) {
+            const uint64_t key = pack(bx, by, bz);
+            uint64_t &r = recent[(key * 0x9E3779B97F4A7C15ull) >> (64 - kRecentBits)];
+            if (r == key) continue;
+            r = key;
+            keys.push_back(key);
+          }
+    }
+  }
+}
+
+void TsdfVolume::update_blocks(int first, int last) {
+  const float *R = pose_.r, *T = pose_.t;
+  const float vs = params_.voxel_size;
+  const float trunc = params_.truncation, inv_trunc = 1.0f / trunc;
+  const float min_depth = params_.min_depth, max_depth = params_.max_depth;
+  const float umax = static_cast<float>(width_) - 0.5f, vmax = static_cast<float>(height_) - 0.5f;
+  const int max_weight = params_.max_weight;
+  // camera-frame step for one voxel along each world axis: the columns of
+  // R^T are R's rows
+  const float sx[3] = {R[0] * vs, R[1] * vs, R[2] * vs};
+  const float sy[3] = {R[3] * vs, R[4] * vs, R[5] * vs};
+  const float sz[3] = {R[6] * vs, R[7] * vs, R[8] * vs};
+  for (int n = first; n < last; ++n) {
+    TsdfBlock &b = block_mut(static_cast<int>(touched_[n]));
+    // camera-frame center of the brick's voxel (0, 0, 0)
+    float o[3] = {(static_cast<float>(b.bx * kTsdfBlockSide) + 0.5f) * vs - T[0],
+                  (static_cast<float>(b.by * kTsdfBlockSide) + 0.5f) * vs - T[1],
+                  (static_cast<float>(b.bz * kTsdfBlockSide) + 0.5f) * vs - T[2]};
+    const float base[3] = {R[0] * o[0] + R[3] * o[1] + R[6] * o[2], R[1] * o[0] + R[4] * o[1] + R[7] * o[2],
+                           R[2] * o[0] + R[5] * o[1] + R[8] * o[2]};
+    TsdfVoxel *vox = b.voxels;
+    for (int k = 0; k < kTsdfBlockSide; ++k) {
+      for (int j = 0; j < kTsdfBlockSide; ++j) {
+        float cx = base[0] + j * sy[0] + k * sz[0];
+        float cy = base[1] + j * sy[1] + k * sz[1];
+        float cz = base[2] + j * sy[2] + k * sz[2];
+        for (int i = 0; i < kTsdfBlockSide; ++i, ++vox, cx += sx[0], cy += sx[1], cz += sx[2]) {
+          if (cz < min_depth) continue;
+          const float inv_z = 1.0f / cz;
+          const float uf = k_.fx * cx * inv_z + k_.cx, vf = k_.fy * cy * inv_z + k_.cy;
+          // nearest depth sample; the comparisons also reject NaN
+          if (!(uf >= -0.5f && uf < umax && vf >= -0.5f && vf < vmax)) continue;
+          const float d = depth_[static_cast<size_t>(vf + 0.5f) * width_ + static_cast<size_t>(uf + 0.5f)];
+          if (!(d >= min_depth && d <= max_depth)) continue;
+          const float sdf = d - cz;
+          // occluded: the surface lies more than the truncation in front
+          if (sdf < -trunc) continue;
+          const float t = sdf >= trunc ? 1.0f : sdf * inv_trunc;
+          const int w = vox->weight;
+          const float avg = (static_cast<float>(vox->sdf) * w + t * kSdfScale) / static_cast<float>(w + 1);
+          vox->sdf = static_cast<int16_t>(avg >= 0.0f ? avg + 0.5f : avg - 0.5f);
+          if (w < max_weight) vox->weight = static_cast<uint16_t>(w + 1);
+        }
+      }
+    }
+  }
+}
+
+int TsdfVolume::integrate(const float *depth, int width, int height, const CameraPose &pose) {
+  if (!depth || width <= 0 || height <= 0) return 0;
+  ++frame_;
+  depth_ = depth;
+  width_ = width;
+  height_ = height;
+  pose_ = pose;
+
+  const int bands = (height + rows_per_band_ - 1) / rows_per_band_;
+  if (static_cast<int>(band_keys_.size()) < bands) band_keys_.resize(bands);
+  parallel(Pass::kTouch, bands);
+
+  // merged in band order, so brick indices do not depend on the threads.
+  // Every allocated brick the frame touches is stamped before anything is
+  // allocated, so eviction cannot drop one of them.
+  touched_.clear();
+  missing_.clear();
+  for (int band = 0; band < bands; ++band) {
+    for (uint64_t key : band_keys_[band]) {
+      const Slot &s = table_[slot_of(key)];
+      if (s.key == kEmpty) {
+        missing_.push_back(key);
+        continue;
+      }
+      TsdfBlock &b = block_mut(static_cast<int>(s.index));
+      if (b.stamp == frame_) continue;
+      if (track_dirty_ && b.stamp <= dirty_frame_) dirty_.push_back(TsdfBrickCoord{b.bx, b.by, b.bz});
+      b.stamp = frame_;
+      touched_.push_back(s.index);
+    }
+  }
+  for (uint64_t key : missing_) {
+    // bands overlap in the bricks they touch
+    if (table_[slot_of(key)].key != kEmpty) continue;
+    if (allocate(key, unpack(key, 2 * kAxisBits), unpack(key, kAxisBits), unpack(key, 0)) < 0) ++stats_.rejected;
+  }
+
+  const int touched = static_cast<int>(touched_.size());
+  parallel(Pass::kUpdate, (touched + kBlocksPerTask - 1) / kBlocksPerTask);
+  compact();
+  stats_.touched = touched;
+  return touched;
+}
+
+bool TsdfVolume::distance(float x, float y, float z, float &out) const {
+  const float inv = 1.0f / params_.voxel_size;
+  const float g[3] = {x * inv - 0.5f, y * inv - 0.5f, z * inv - 0.5f};
+  int32_t v0[3];
+  float f[3];
+  for (int a = 0; a < 3; ++a) {
+    if (!(g[a] > -1e6f && g[a] < 1e6f)) return false;
+    v0[a] = floor_i(g[a]);
+    f[a] = g[a] - static_cast<float>(v0[a]);
+  }
+  float sum = 0.0f;
+  for (int c = 0; c < 8; ++c) {
+    const int32_t vx = v0[0] + (c & 1), vy = v0[1] + ((c >> 1) & 1), vz = v0[2] + (c >> 2);
+    // arithmetic shifts and masks floor toward -inf for negative voxels
+    const TsdfBlock *b = find(vx >> 3, vy >> 3, vz >> 3);
+    if (!b) return false;
+    const TsdfVoxel &vox = b->at(vx & 7, vy & 7, vz & 7);
+    if (vox.weight == 0) return false;
+    const float w = ((c & 1) ? f[0] : 1.0f - f[0]) * (((c >> 1) & 1) ? f[1] : 1.0f - f[1]) *
+                    ((c >> 2) ? f[2] : 1.0f - f[2]);
+    sum += w * static_cast<float>(vox.sdf);
+  }
+  out = sum * (params_.truncation / kSdfScale);
+  return true;
+}
+
+void TsdfVolume::take_dirty(std::vector<TsdfBrickCoord> &out) {
+  out.clear();
+  if (track_dirty_) {
+    out.swap(dirty_);
+  } else {
+    for (int i = 0; i < count_; ++i) out.push_back(TsdfBrickCoord{block(i).bx, block(i).by, block(i).bz});
+    track_dirty_ = true;
+  }
+  dirty_frame_ = frame_;
+}
+
+TsdfStats TsdfVolume::stats() const {
+  TsdfStats s = stats_;
+  s.blocks = count_;
+  return s;
+}
+
+size_t TsdfVolume::memory_bytes() const {
+  return chunks_.size() * kChunkBlocks * sizeof(TsdfBlock) + table_.size() * sizeof(Slot);
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "depth_projection.h"
+#include "lidar_camera.h"
+
+// Truncated signed distance volume fused from depth maps, with voxel
+// hashing (Niessner et al. 2013): space is cut into bricks of 8x8x8 voxels
+// that are allocated only where a depth sample puts a surface within the
+// truncation distance, and found through an open-addressing hash of their
+// packed brick coordinates (linear probing, Fibonacci hashing, as in
+// voxel_filter.h). Empty space costs nothing, so a room at 4 cm takes a few
+// MB where a dense grid of its bounding box would take hundreds.
+//
+// A frame is fused in two passes that both run on the caller plus
+// params.threads - 1 workers. The first splits the depth map into bands of
+// rows; each band lists the bricks its samples touch, and the bands are
+// merged in order into the table, bricks already there first and then the
+// new ones, so brick indices do not depend on the thread count. The second
+// splits those bricks: every voxel of a brick is projected into the depth
+// map and its running average updated with the projective distance (depth
+// minus the voxel's own depth), clamped to the truncation. Each voxel is
+// written by one thread, so the result is the same for any thread count.
+//
+// Memory is bounded by max_blocks. Once the table is full, the bricks that
+// have gone unseen longest are dropped to make room, an eighth of them at
+// a time; bricks of the frame being fused are never dropped.
+//
+// The workers are std::threads, which rules out the -nostdlib map.wasm;
+// slam_main's wasm32-wasip1-threads build and native builds have them.
+
+struct TsdfParams {
+  float voxel_size = 0.04f;   // meters
+  float truncation = 0.12f;   // meters, distances clamp to +-this
+  int max_weight = 64;        // observations a voxel averages over; lower forgets faster
+  float min_depth = 0.1f;     // depths outside, NaN and inf are skipped
+  float max_depth = 5.0f;
+  int max_blocks = 16384;     // 2 KB each: 32 MB
+  int threads = 2;            // including the caller
+};
+
+// distance in 1/32767 of the truncation, 0 weight if never observed
+struct TsdfVoxel {
+  int16_t sdf;
+  uint16_t weight;
+};
+
+constexpr int kTsdfBlockSide = 8;
+constexpr int kTsdfBlockVoxels = kTsdfBlockSide * kTsdfBlockSide * kTsdfBlockSide;
+
+struct TsdfBlock {
+  int32_t bx, by, bz;  // brick coordinates; voxel (i, j, k) of it is voxel 8 * b + (i, j, k)
+  uint32_t stamp;      // frame that last updated it
+  TsdfVoxel voxels[kTsdfBlockVoxels]; // x fastest, then y, then z
+
+  const TsdfVoxel &at(int i, int j, int k) const {
+    return voxels[(k * kTsdfBlockSide + j) * kTsdfBlockSide + i];
+  }
+};
+
+struct TsdfBrickCoord {
+  int32_t bx, by, bz;
+};
+
+struct TsdfStats {
+  int blocks = 0;          // allocated now
+  int touched = 0;         // by the last frame
+  int64_t evicted = 0;     // dropped for room, ever
+  int64_t rejected = 0;    // bricks a frame touched that found no room
+};
+
+class TsdfVolume {
+public:
+  TsdfVolume(const CameraIntrinsics &k, const TsdfParams &params = TsdfParams{});
+  ~TsdfVolume();
+  TsdfVolume(const TsdfVolume &) = delete;
+  TsdfVolume &operator=(const TsdfVolume &) = delete;
+
+  const TsdfParams &params() const { return params_; }
+
+  // fuses a row-major width x height depth map (meters along the optical
+  // axis, DepthProjector's camera model) seen from pose; returns the bricks
+  // it touched
+  int integrate(const float *depth, int width, int height, const CameraPose &pose);
+  int integrate(const LidarCameraData &frame, const CameraPose &pose) {
+    return integrate(frame.depth_map, frame.depth_width, frame.depth_height, pose);
+  }
+
+  // signed distance in meters at a world point, trilinear over the eight
+  // nearest voxel centers; false if any of them was never observed
+  bool distance(float x, float y, float z, float &out) const;
+  // nullptr if brick (bx, by, bz) is not allocated
+  const TsdfBlock *find(int32_t bx, int32_t by, int32_t bz) const;
+
+  // allocated bricks, densely indexed; an index is stable until the next
+  // integrate
+  int block_count() const { return count_; }
+  const TsdfBlock &block(int i) const { return chunks_[i >> kChunkBits][i & (kChunkBlocks - 1)]; }
+  // frames fused so far; a brick's stamp is the count after its last update
+  uint32_t frame() const { return frame_; }
+  // bricks updated, allocated or dropped since the previous call, for one
+  // incremental reader such as a mesher; find() tells the dropped ones
+  // apart. Tracking starts with the first call, which lists every brick.
+  void take_dirty(std::vector<TsdfBrickCoord> &out);
+  TsdfStats stats() const;
+  // bricks plus table
+  size_t memory_bytes() const;
+
+private:
+  static constexpr int kChunkBits = 8;
+  static constexpr int kChunkBlocks = 1 << kChunkBits;
+
+  enum class Pass { kTouch, kUpdate };
+
+  TsdfBlock &block_mut(int i) { return chunks_[i >> kChunkBits][i & (kChunkBlocks - 1)]; }
+  uint64_t slot_of(uint64_t key) const;
+  int allocate(uint64_t key, int32_t bx, int32_t by, int32_t bz);
+  void evict();
+  void remove(int index);
+  void compact();
+  void parallel(Pass pass, int tasks);
+  void work();
+  void touch_rows(int band);
+  void update_blocks(int first, int last);
+
+  CameraIntrinsics k_;
+  TsdfParams params_;
+
+  // the hash: packed brick coordinates -> index into the bricks
+  struct Slot {
+    uint64_t key;
+    uint32_t index;
+  };
+  std::vector<Slot> table_;
+  int bits_ = 0;
+  std::vector<std::unique_ptr<TsdfBlock[]>> chunks_; // kChunkBlocks bricks each, never moved
+  int count_ = 0;
+  uint32_t frame_ = 0;
+  TsdfStats stats_;
+  bool track_dirty_ = false;
+  uint32_t dirty_frame_ = 0; // frame_ at the last take_dirty; newer stamps are listed
+  std::vector<TsdfBrickCoord> dirty_;
+
+  // the frame being fused, for the workers
+  const float *depth_ = nullptr;
+  int width_ = 0, height_ = 0;
+  CameraPose pose_;
+  int rows_per_band_ = 8;
+  std::vector<std::vector<uint64_t>> band_keys_; // bricks each band of rows touched
+  std::vector<uint32_t> touched_;                // their indices, for the update pass
+  std::vector<uint64_t> missing_;                // touched bricks not allocated yet
+  std::vector<uint32_t> free_;                   // bricks evicted this frame, filled in by compact
+  std::vector<uint32_t> order_;                  // scratch for evict
+
+  // workers
+  Pass pass_ = Pass::kTouch;
+  int tasks_ = 0;
+  std::atomic<int> next_task_{0};
+  std::mutex m_;
+  std::condition_variable start_, done_;
+  uint64_t generation_ = 0;
+  int running_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
@@ -0,0 +1,118 @@
+#include "voxel_filter.h"
+
+// voxel coordinates are packed into 21 bits per axis, offset to be unsigned
+static constexpr int kAxisBits = 21;
+static constexpr int32_t kAxisOffset = 1 << (kAxisBits - 1);
+static constexpr float kAxisLimit = static_cast<float>(kAxisOffset - 1);
+
+// floor(v) + kAxisOffset without a floorf call (libm on baseline x86-64)
+static inline uint64_t voxel_coord(float v) {
+  const int32_t i = static_cast<int32_t>(v);
+  return static_cast<uint64_t>(i - (static_cast<float>(i) > v) + kAxisOffset);
+}
+
+// inside the packable range; false for NaN
+static inline bool voxel_in_range(float v) { return v > -kAxisLimit && v < kAxisLimit; }
+
+VoxelFilter::VoxelFilter(float leaf_size, int min_points) {
+  set_leaf_size(leaf_size);
+  set_min_points(min_points);
+  rehash(4096);
+}
+
+void VoxelFilter::set_leaf_size(float leaf_size) {
+  leaf_ = leaf_size > 0.0f ? leaf_size : 0.05f;
+  inv_leaf_ = 1.0f / leaf_;
+}
+
+void VoxelFilter::rehash(size_t slots) {
+  std::vector<Slot> old;
+  old.swap(table_);
+  table_.assign(slots, Slot{kEmpty, 0, 0, 0, 0, 0});
+  bits_ = 0;
+  while ((size_t{1} << bits_) < slots) ++bits_;
+  const uint64_t mask = slots - 1;
+  for (uint32_t &u : used_) {
+    const Slot &s = old[u];
+    uint64_t h = (s.key * 0x9E3779B97F4A7C15ull) >> (64 - bits_);
+    while (table_[h].key != kEmpty) h = (h + 1) & mask;
+    table_[h] = s;
+    u = static_cast<uint32_t>(h);
+  }
+}
+
+int VoxelFilter::filter(const PointCloud &in, PointCloud &out) {
+  out.reserve(in.size);
+  const float *xs = in.x.data(), *ys = in.y.data(), *zs = in.z.data();
+  const float inv = inv_leaf_;
+  Slot *table = table_.data();
+  uint64_t mask = table_.size() - 1;
+  int shift = 64 - bits_;
+  // depth images are scanned row by row, so neighbours usually share a
+  // voxel: sums for the current run of equal keys stay in registers and are
+  // flushed to the slot when the key changes
+  Slot *run = nullptr;
+  float ax = 0.0f, ay = 0.0f, az = 0.0f;
+  uint32_t an = 0;
+  for (int i = 0; i < in.size; ++i) {
+    const float x = xs[i], y = ys[i], z = zs[i];
+    const float gx = x * inv, gy = y * inv, gz = z * inv;
+    // one branch for all three axes
+    if (!(voxel_in_range(gx) & voxel_in_range(gy) & voxel_in_range(gz))) continue;
+    const uint64_t key = (voxel_coord(gx) << (2 * kAxisBits)) | (voxel_coord(gy) << kAxisBits) | voxel_coord(gz);
+    if (!run || run->key != key) {
+      if (run) {
+        run->sx += ax;
+        run->sy += ay;
+        run->sz += az;
+        run->count += an;
+      }
+      ax = ay = az = 0.0f;
+      an = 0;
+      // Fibonacci hashing: top bits of the product, linear probing
+      uint64_t h = (key * 0x9E3779B97F4A7C15ull) >> shift;
+      while (table[h].key != kEmpty && table[h].key != key) h = (h + 1) & mask;
+      if (table[h].key == kEmpty) {
+        // keep the load factor at or below 1/2
+        if (2 * (used_.size() + 1) > table_.size()) {
+          rehash(2 * table_.size());
+          table = table_.data();
+          mask = table_.size() - 1;
+          shift = 64 - bits_;
+          h = (key * 0x9E3779B97F4A7C15ull) >> shift;
+          while (table[h].key != kEmpty) h = (h + 1) & mask;
+        }
+        table[h] = Slot{key, 0.0f, 0.0f, 0.0f, 0, in.pixel[i]};
+        used_.push_back(static_cast<uint32_t>(h));
+      }
+      run = &table[h];
+    }
+    ax += x;
+    ay += y;
+    az += z;
+    ++an;
+  }
+  if (run) {
+    run->sx += ax;
+    run->sy += ay;
+    run->sz += az;
+    run->count += an;
+  }
+
+  int n = 0;
+  for (uint32_t u : used_) {
+    Slot &s = table_[u];
+    if (s.count >= static_cast<uint32_t>(min_points_)) {
+      const float inv = 1.0f / static_cast<float>(s.count);
+      out.x[n] = s.sx * inv;
+      out.y[n] = s.sy * inv;
+      out.z[n] = s.sz * inv;
+      out.pixel[n] = s.pixel;
+      ++n;
+    }
+    s.key = kEmpty; // reset for the next frame
+  }
+  used_.clear();
+  out.size = n;
+  return n;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h> // size_t
+#include <stdint.h>
+#include <vector>
+
+#include "depth_projection.h"
+
+// Voxel-grid downsampling: every occupied leaf_size cube is replaced by the
+// centroid of the points in it. Voxels are found through an open-addressing
+// hash of packed voxel coordinates whose storage is kept between frames
+// (cleared slot by slot, grown only when a frame has more voxels than ever
+// before), so steady-state filtering does not allocate.
+
+class VoxelFilter {
+public:
+  explicit VoxelFilter(float leaf_size, int min_points = 1);
+
+  float leaf_size() const { return leaf_; }
+  void set_leaf_size(float leaf_size);
+  // voxels with fewer points are dropped (isolated returns are mostly noise)
+  void set_min_points(int min_points) { min_points_ = min_points < 1 ? 1 : min_points; }
+
+  // writes one centroid per kept voxel into out, in order of each voxel's
+  // first point, and returns their count. out.pixel holds that first
+  // point's pixel. out is reserved to in.size if it is smaller.
+  int filter(const PointCloud &in, PointCloud &out);
+
+private:
+  struct Slot {
+    uint64_t key; // kEmpty if unused
+    float sx, sy, sz;
+    uint32_t count;
+    uint32_t pixel;
+  };
+  static constexpr uint64_t kEmpty = ~0ull;
+
+  void rehash(size_t slots);
+
+  float leaf_;
+  float inv_leaf_;
+  int min_points_;
+  int bits_ = 0;
+  std::vector<Slot> table_;
+  std::vector<uint32_t> used_; // occupied slots in insertion order
+};
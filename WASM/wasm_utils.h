@@ -1,3 +1,8 @@
 #pragma once
 
+#if defined(__wasm__)
 #define WASM_IMPORT(A, B) __attribute__((__import_module__((A)), __import_name__((B))))
+#else
+// native builds link the imports against a C++ stand-in host
+#define WASM_IMPORT(A, B)
+#endif
@@ -0,0 +1,107 @@
+//
+//  FramePoolHost.h
+//  roamr
+//
+//  Producer side of FramePool (WASM/frame_pool.h) for the iOS host, which
+//  writes LiDAR/camera frames straight into WASM linear memory. Swift cannot
+//  use the C++ atomics, so this mirrors acquire_write()/publish() on the
+//  pool's wasm32 byte layout; frame_pool.h static_asserts the same offsets.
+//
+
+#pragma once
+#include <stdint.h>
+
+#define FRAME_POOL_SLOTS 3
+#define FRAME_MAX_DEPTH_WIDTH 256
+#define FRAME_MAX_DEPTH_HEIGHT 192
+#define FRAME_MAX_IMAGE_WIDTH 640
+#define FRAME_MAX_IMAGE_HEIGHT 480
+#define FRAME_MAX_IMAGE_CHANNELS 4
+
+// FrameSlot
+#define FRAME_SLOT_STATE 0
+#define FRAME_SLOT_READERS 4
+#define FRAME_SLOT_GENERATION 8
+#define FRAME_SLOT_TIMESTAMP 16
+#define FRAME_SLOT_DEPTH_WIDTH 24
+#define FRAME_SLOT_DEPTH_HEIGHT 28
+#define FRAME_SLOT_IMAGE_WIDTH 32
+#define FRAME_SLOT_IMAGE_HEIGHT 36
+#define FRAME_SLOT_IMAGE_CHANNELS 40
+#define FRAME_SLOT_DEPTH_MAP 44
+#define FRAME_SLOT_IMAGE 196652
+#define FRAME_SLOT_BYTES 1425456
+
+// FramePool
+#define FRAME_POOL_LATEST 4276368
+#define FRAME_POOL_PUBLISHED 4276372
+#define FRAME_POOL_BYTES 4276376
+
+// FrameSlotState
+#define FRAME_STATE_FREE 0u
+#define FRAME_STATE_WRITING 1u
+#define FRAME_STATE_READY 2u
+
+static inline uint8_t *frame_pool_slot(void *pool, int32_t index) {
+    return (uint8_t *)pool + (intptr_t)index * FRAME_SLOT_BYTES;
+}
+
+static inline uint32_t *frame_slot_field(uint8_t *slot, int offset) {
+    return (uint32_t *)(slot + offset);
+}
+
+static inline float *frame_slot_depth_map(uint8_t *slot) {
+    return (float *)(slot + FRAME_SLOT_DEPTH_MAP);
+}
+
+static inline uint8_t *frame_slot_image(uint8_t *slot) {
+    return slot + FRAME_SLOT_IMAGE;
+}
+
+// index of a slot claimed for writing, or -1 if every other slot is borrowed
+// (drop the frame then)
+static inline int32_t frame_pool_acquire_write(void *pool) {
+    const int32_t latest = __atomic_load_n((int32_t *)((uint8_t *)pool + FRAME_POOL_LATEST), __ATOMIC_ACQUIRE);
+    for (int32_t i = 0; i < FRAME_POOL_SLOTS; ++i) {
+        if (i == latest) continue;
+        uint8_t *slot = frame_pool_slot(pool, i);
+        uint32_t *state = frame_slot_field(slot, FRAME_SLOT_STATE);
+        uint32_t expected = __atomic_load_n(state, __ATOMIC_RELAXED);
+        if (expected == FRAME_STATE_WRITING) continue;
+        // same order as FramePool::acquire_write: claim, then look for readers
+        if (!__atomic_compare_exchange_n(state, &expected, FRAME_STATE_WRITING, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) continue;
+        if (__atomic_load_n(frame_slot_field(slot, FRAME_SLOT_READERS), __ATOMIC_SEQ_CST) != 0) {
+            __atomic_store_n(state, expected, __ATOMIC_RELEASE);
+            continue;
+        }
+        return i;
+    }
+    return -1;
+}
+
+// gives back a slot from frame_pool_acquire_write without publishing it
+static inline void frame_pool_cancel_write(void *pool, int32_t index) {
+    __atomic_store_n(frame_slot_field(frame_pool_slot(pool, index), FRAME_SLOT_STATE), FRAME_STATE_FREE, __ATOMIC_RELEASE);
+}
+
+static inline void frame_slot_set_size(uint8_t *slot, int32_t depth_width, int32_t depth_height,
+                                       int32_t image_width, int32_t image_height, int32_t image_channels) {
+    *(int32_t *)(slot + FRAME_SLOT_DEPTH_WIDTH) = depth_width;
+    *(int32_t *)(slot + FRAME_SLOT_DEPTH_HEIGHT) = depth_height;
+    *(int32_t *)(slot + FRAME_SLOT_IMAGE_WIDTH) = image_width;
+    *(int32_t *)(slot + FRAME_SLOT_IMAGE_HEIGHT) = image_height;
+    *(int32_t *)(slot + FRAME_SLOT_IMAGE_CHANNELS) = image_channels;
+}
+
+// publishes a written slot as the latest frame; returns its generation
+static inline uint32_t frame_pool_publish(void *pool, int32_t index, double timestamp) {
+    uint8_t *slot = frame_pool_slot(pool, index);
+    uint32_t *published = (uint32_t *)((uint8_t *)pool + FRAME_POOL_PUBLISHED);
+    const uint32_t generation = __atomic_load_n(published, __ATOMIC_RELAXED) + 1;
+    *(double *)(slot + FRAME_SLOT_TIMESTAMP) = timestamp;
+    *frame_slot_field(slot, FRAME_SLOT_GENERATION) = generation;
+    __atomic_store_n(frame_slot_field(slot, FRAME_SLOT_STATE), FRAME_STATE_READY, __ATOMIC_RELEASE);
+    __atomic_store_n((int32_t *)((uint8_t *)pool + FRAME_POOL_LATEST), index, __ATOMIC_RELEASE);
+    __atomic_store_n(published, generation, __ATOMIC_RELEASE);
+    return generation;
+}
@@ -27,8 +27,36 @@ class IMUManager {
     var currentData = IMUData(acc_timestamp: 0, acc_x: 0, acc_y: 0, acc_z: 0, gyro_timestamp: 0, gyro_x: 0, gyro_y: 0, gyro_z: 0
     )
 
+    // every sample since the last read_imu_batch, oldest first (WASM/imu.h IMUHostRingSize)
+    static let ringCapacity = 256
+    private var ring = [IMUData](repeating: IMUData(acc_timestamp: 0, acc_x: 0, acc_y: 0, acc_z: 0, gyro_timestamp: 0, gyro_x: 0, gyro_y: 0, gyro_z: 0),
+                                 count: ringCapacity)
+    private var ringHead = 0
+    private var ringCount = 0
+
     private init() {}
 
+    // caller holds lock; drops the oldest sample when WASM falls a full ring behind
+    private func pushSample() {
+        ring[(ringHead + ringCount) % IMUManager.ringCapacity] = currentData
+        if ringCount == IMUManager.ringCapacity {
+            ringHead = (ringHead + 1) % IMUManager.ringCapacity
+        } else {
+            ringCount += 1
+        }
+    }
+
+    // caller holds lock
+    func popSamples(into out: UnsafeMutablePointer<IMUData>, max: Int) -> Int {
+        let n = min(max, ringCount)
+        for i in 0..<n {
+            out[i] = ring[(ringHead + i) % IMUManager.ringCapacity]
+        }
+        ringHead = (ringHead + n) % IMUManager.ringCapacity
+        ringCount -= n
+        return n
+    }
+
     func start() {
         let IMUIntervalHz = 100.0 // same for accelerometer and gyro
 
@@ -57,6 +85,8 @@ class IMUManager {
                 self.currentData.gyro_x = data.rotationRate.x
                 self.currentData.gyro_y = data.rotationRate.y
                 self.currentData.gyro_z = data.rotationRate.z
+                // gyro and accel share a rate, one sample per gyro update
+                self.pushSample()
                 self.lock.unlock()
             }
         }
@@ -82,3 +112,20 @@ func read_imu_impl(exec_env: wasm_exec_env_t?, ptr: UnsafeMutableRawPointer?) {
 
     imuDataPtr.pointee = data
 }
+
+// exported function for Wasm: drains buffered samples in one boundary crossing
+func read_imu_batch_impl(exec_env: wasm_exec_env_t?, ptr: UnsafeMutableRawPointer?, max: Int32) -> Int32 {
+    guard let exec_env = exec_env, let ptr = ptr, max > 0 else { return 0 }
+
+    let byteCount = UInt64(max) * UInt64(MemoryLayout<IMUData>.stride)
+    guard wasm_runtime_validate_native_addr(wasm_runtime_get_module_inst(exec_env), ptr, byteCount) else { return 0 }
+
+    let out = ptr.bindMemory(to: IMUData.self, capacity: Int(max))
+
+    let manager = IMUManager.shared
+    manager.lock.lock()
+    let count = manager.popSamples(into: out, max: Int(max))
+    manager.lock.unlock()
+
+    return Int32(count)
+}
@@ -5,8 +5,10 @@
 //  Created by Thomason Zhou on 2025-11-23.
 //
 
-// uses AVFoundation for lower level access of sensors
+// uses ARKit for the LiDAR depth map and the camera image of the same frame
 import Foundation
+import ARKit
+import CoreImage
 
 struct LidarCameraData {
     var timestamp: Double
@@ -14,14 +16,123 @@ struct LidarCameraData {
     var image_width: Int32
 }
 
-class LidarCameraManager {
+class LidarCameraManager: NSObject, ARSessionDelegate {
     static let shared = LidarCameraManager()
 
     let lock = NSLock()
 
     var currentData = LidarCameraData(timestamp: 0, image_height: 0, image_width: 0)
 
-    private init() {}
+    // FramePool in WASM linear memory (see WASM/frame_pool.h), nil until attached;
+    // only touched under lock so a detach never lands in the middle of a write
+    var framePool: UnsafeMutableRawPointer?
+
+    // signalled whenever a frame is published into framePool
+    let frameCondition = NSCondition()
+    var frameGeneration: UInt32 = 0
+
+    func didPublishFrame(generation: UInt32) {
+        frameCondition.lock()
+        frameGeneration = generation
+        frameCondition.broadcast()
+        frameCondition.unlock()
+    }
+
+    private let session = ARSession()
+    private let frameQueue = DispatchQueue(label: "roamr.lidarcamera", qos: .userInitiated)
+    private let ciContext = CIContext()
+    private let colorSpace = CGColorSpaceCreateDeviceRGB()
+
+    private override init() {
+        super.init()
+        session.delegate = self
+        session.delegateQueue = frameQueue
+    }
+
+    func start() {
+        guard ARWorldTrackingConfiguration.supportsFrameSemantics(.sceneDepth) else {
+            print("LiDAR scene depth not supported on this device.")
+            return
+        }
+
+        let config = ARWorldTrackingConfiguration()
+        config.frameSemantics.insert(.sceneDepth)
+        session.run(config)
+    }
+
+    func stop() {
+        session.pause()
+    }
+
+    func detachFramePool() {
+        lock.lock()
+        framePool = nil
+        lock.unlock()
+    }
+
+    // MARK: - ARSessionDelegate
+    func session(_ session: ARSession, didUpdate frame: ARFrame) {
+        lock.lock()
+        defer { lock.unlock() }
+
+        currentData.timestamp = frame.timestamp
+        currentData.image_width = Int32(CVPixelBufferGetWidth(frame.capturedImage))
+        currentData.image_height = Int32(CVPixelBufferGetHeight(frame.capturedImage))
+
+        guard let pool = framePool, let depth = frame.sceneDepth?.depthMap else { return }
+
+        // every other slot is still borrowed: drop this frame, the consumer
+        // is behind anyway
+        let index = frame_pool_acquire_write(pool)
+        guard index >= 0, let slot = frame_pool_slot(pool, index) else { return }
+
+        guard let depthSize = copyDepth(depth, into: slot) else {
+            frame_pool_cancel_write(pool, index)
+            return
+        }
+        let imageSize = renderImage(frame.capturedImage, into: slot)
+        frame_slot_set_size(slot, depthSize.width, depthSize.height, imageSize.width, imageSize.height, FRAME_MAX_IMAGE_CHANNELS)
+
+        // wakes WASM threads blocked in wait_frame
+        didPublishFrame(generation: frame_pool_publish(pool, index, frame.timestamp))
+    }
+
+    // Float32 meters, row by row since the pixel buffer rows may be padded
+    private func copyDepth(_ depth: CVPixelBuffer, into slot: UnsafeMutablePointer<UInt8>) -> (width: Int32, height: Int32)? {
+        guard CVPixelBufferGetPixelFormatType(depth) == kCVPixelFormatType_DepthFloat32 else { return nil }
+
+        CVPixelBufferLockBaseAddress(depth, .readOnly)
+        defer { CVPixelBufferUnlockBaseAddress(depth, .readOnly) }
+        guard let base = CVPixelBufferGetBaseAddress(depth) else { return nil }
+
+        let width = min(CVPixelBufferGetWidth(depth), Int(FRAME_MAX_DEPTH_WIDTH))
+        let height = min(CVPixelBufferGetHeight(depth), Int(FRAME_MAX_DEPTH_HEIGHT))
+        let bytesPerRow = CVPixelBufferGetBytesPerRow(depth)
+        let rowBytes = width * MemoryLayout<Float32>.size
+        let out = UnsafeMutableRawPointer(frame_slot_depth_map(slot)!)
+        for row in 0..<height {
+            memcpy(out + row * rowBytes, base + row * bytesPerRow, rowBytes)
+        }
+        return (Int32(width), Int32(height))
+    }
+
+    // downscales the YCbCr camera image to fit the slot and converts it to RGBA8
+    private func renderImage(_ image: CVPixelBuffer, into slot: UnsafeMutablePointer<UInt8>) -> (width: Int32, height: Int32) {
+        let sourceWidth = CGFloat(CVPixelBufferGetWidth(image))
+        let sourceHeight = CGFloat(CVPixelBufferGetHeight(image))
+        let scale = min(1, CGFloat(FRAME_MAX_IMAGE_WIDTH) / sourceWidth, CGFloat(FRAME_MAX_IMAGE_HEIGHT) / sourceHeight)
+        let width = Int(sourceWidth * scale)
+        let height = Int(sourceHeight * scale)
+
+        let scaled = CIImage(cvPixelBuffer: image).transformed(by: CGAffineTransform(scaleX: scale, y: scale))
+        ciContext.render(scaled,
+                         toBitmap: frame_slot_image(slot),
+                         rowBytes: width * Int(FRAME_MAX_IMAGE_CHANNELS),
+                         bounds: CGRect(x: 0, y: 0, width: width, height: height),
+                         format: .RGBA8,
+                         colorSpace: colorSpace)
+        return (Int32(width), Int32(height))
+    }
 }
 
 // exported function for Wasm
@@ -37,3 +148,32 @@ func read_lidar_camera_impl(exec_env: wasm_exec_env_t?, ptr: UnsafeMutableRawPoi
 
     lidarCameraDataPtr.pointee = data
 }
+
+// exported function for Wasm
+func attach_frame_pool_impl(exec_env: wasm_exec_env_t?, ptr: UnsafeMutableRawPointer?) {
+    guard let exec_env = exec_env, let ptr = ptr else { return }
+
+    // the whole pool has to be inside the module's linear memory before the
+    // frame writer is let loose on it
+    guard wasm_runtime_validate_native_addr(wasm_runtime_get_module_inst(exec_env), ptr, UInt64(FRAME_POOL_BYTES)) else { return }
+
+    let manager = LidarCameraManager.shared
+    manager.lock.lock()
+    manager.framePool = ptr
+    manager.lock.unlock()
+}
+
+// exported function for Wasm: blocks the calling WASM thread until a newer frame is published
+func wait_frame_impl(exec_env: wasm_exec_env_t?, afterGeneration: UInt32, timeoutMs: Int32) -> UInt32 {
+    let manager = LidarCameraManager.shared
+    let deadline = Date(timeIntervalSinceNow: Double(max(timeoutMs, 0)) / 1000.0)
+
+    manager.frameCondition.lock()
+    while manager.frameGeneration == afterGeneration {
+        if !manager.frameCondition.wait(until: deadline) { break }
+    }
+    let generation = manager.frameGeneration
+    manager.frameCondition.unlock()
+
+    return generation
+}
@@ -8,6 +8,8 @@
 import Foundation
 
 typealias CFunction = @convention(c) (wasm_exec_env_t?, UnsafeMutableRawPointer?) -> Void
+typealias CBatchFunction = @convention(c) (wasm_exec_env_t?, UnsafeMutableRawPointer?, Int32) -> Int32
+typealias CWaitFunction = @convention(c) (wasm_exec_env_t?, UInt32, Int32) -> UInt32
 
 class WasmManager {
     static let shared = WasmManager()
@@ -31,12 +33,33 @@ class WasmManager {
         struct NativeFunction {
             let name: String
             let signature: String
-            let impl: CFunction
+            let impl: UnsafeMutableRawPointer
+
+            init(name: String, signature: String, impl: CFunction) {
+                self.name = name
+                self.signature = signature
+                self.impl = unsafeBitCast(impl, to: UnsafeMutableRawPointer.self)
+            }
+
+            init(name: String, signature: String, impl: CBatchFunction) {
+                self.name = name
+                self.signature = signature
+                self.impl = unsafeBitCast(impl, to: UnsafeMutableRawPointer.self)
+            }
+
+            init(name: String, signature: String, impl: CWaitFunction) {
+                self.name = name
+                self.signature = signature
+                self.impl = unsafeBitCast(impl, to: UnsafeMutableRawPointer.self)
+            }
         }
 
         let nativeFunctions: [NativeFunction] = [
             NativeFunction(name: "read_imu", signature: "(*)", impl: read_imu_impl),
-            NativeFunction(name: "read_lidar_camera", signature: "(*)", impl: read_lidar_camera_impl)
+            NativeFunction(name: "read_imu_batch", signature: "(*i)i", impl: read_imu_batch_impl),
+            NativeFunction(name: "read_lidar_camera", signature: "(*)", impl: read_lidar_camera_impl),
+            NativeFunction(name: "attach_frame_pool", signature: "(*)", impl: attach_frame_pool_impl),
+            NativeFunction(name: "wait_frame", signature: "(ii)i", impl: wait_frame_impl)
         ]
 
         let nativeSymbolPtr = UnsafeMutablePointer<NativeSymbol>.allocate(capacity: nativeFunctions.count)
@@ -51,11 +74,9 @@ class WasmManager {
                 symbolPtrs.append(namePtr)
                 symbolPtrs.append(sigPtr)
 
-                let funcPtr = unsafeBitCast(function.impl, to: UnsafeMutableRawPointer.self)
-
                 nativeSymbolPtr[index] = NativeSymbol(
                     symbol: UnsafePointer(namePtr),
-                    func_ptr: funcPtr,
+                    func_ptr: function.impl,
                     signature: UnsafePointer(sigPtr),
                     attachment: nil
                 )
@@ -145,6 +166,9 @@ class WasmManager {
                     print("Error: Could not find _start function")
                 }
 
+                // the frame pool lives in this instance's memory
+                LidarCameraManager.shared.detachFramePool()
+
                 // Cleanup instance-specific resources
                 wasm_runtime_destroy_exec_env(execEnv)
                 wasm_runtime_deinstantiate(moduleInstance)
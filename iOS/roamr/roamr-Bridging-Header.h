@@ -8,3 +8,4 @@
 
 #include "wasm_export.h"
 #include "wasm_c_api.h"
+#include "FramePoolHost.h"